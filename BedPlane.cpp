@@ -0,0 +1,340 @@
+#include "BedPlane.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define BEDPLANE_X86
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define BEDPLANE_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+using namespace SDKTemplate;
+
+// Fewer valid points than this in a frame's sample aren't enough to tell the plate from noise.
+static constexpr size_t minSampleSize = 64;
+
+// Cross products shorter than this come from nearly collinear points, which don't define a plane.
+static constexpr float minNormalLength = 1e-9f;
+
+BedPlaneEstimator::BedPlaneEstimator(const BedPlaneSettings& settings) :
+    m_settings(settings),
+    m_random(1)
+{
+    // Room for a sample grid a little denser than requested, since the grid size is rounded.
+    const size_t capacity = size_t(m_settings.sampleCount) * 2 + 64;
+    m_sampleX.resize(capacity);
+    m_sampleY.resize(capacity);
+    m_sampleZ.resize(capacity);
+}
+
+void BedPlaneEstimator::Reset()
+{
+    m_hasPlane = false;
+    m_fitInlierFraction = 0.0f;
+    m_frame = 0;
+    m_lastFitFrame = 0;
+}
+
+void BedPlaneEstimator::GatherSample(const RayTable& rays, const float* depth)
+{
+    const uint32_t width = rays.GetWidth();
+    const uint32_t height = rays.GetHeight();
+    const uint32_t stride = (std::max)(1u, static_cast<uint32_t>(std::ceil(std::sqrt(double(width) * height / m_settings.sampleCount))));
+
+    // A different grid offset every frame, so over time the sample covers every pixel.
+    const uint32_t offsetX = static_cast<uint32_t>(m_random() % stride);
+    const uint32_t offsetY = static_cast<uint32_t>(m_random() % stride);
+
+    const float* rayX = rays.GetRayX();
+    const float* rayY = rays.GetRayY();
+    const size_t capacity = m_sampleX.size();
+
+    m_sampleSize = 0;
+    for (uint32_t v = offsetY; v < height && m_sampleSize < capacity; v += stride)
+    {
+        for (uint32_t u = offsetX; u < width && m_sampleSize < capacity; u += stride)
+        {
+            const size_t index = size_t(v) * width + u;
+            const float z = depth[index];
+            if (z > 0.0f)
+            {
+                m_sampleX[m_sampleSize] = rayX[index] * z;
+                m_sampleY[m_sampleSize] = rayY[index] * z;
+                m_sampleZ[m_sampleSize] = z;
+                m_sampleSize++;
+            }
+        }
+    }
+}
+
+size_t BedPlaneEstimator::CountInliers(const BedPlane& plane) const
+{
+    const float nx = plane.normal[0];
+    const float ny = plane.normal[1];
+    const float nz = plane.normal[2];
+    const float offset = plane.offset;
+    const float threshold = m_settings.inlierThreshold;
+    const float* x = m_sampleX.data();
+    const float* y = m_sampleY.data();
+    const float* z = m_sampleZ.data();
+    const size_t count = m_sampleSize;
+
+    size_t inliers = 0;
+    size_t i = 0;
+
+#if defined(BEDPLANE_X86)
+    // Scores 4 points per iteration. Each lane of the comparison is all ones for an inlier, so subtracting
+    // it counts the inliers per lane.
+    const __m128 vx = _mm_set1_ps(nx);
+    const __m128 vy = _mm_set1_ps(ny);
+    const __m128 vz = _mm_set1_ps(nz);
+    const __m128 vOffset = _mm_set1_ps(offset);
+    const __m128 vThreshold = _mm_set1_ps(threshold);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128i laneCounts = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(x + i)), _mm_mul_ps(vy, _mm_loadu_ps(y + i))),
+            _mm_add_ps(_mm_mul_ps(vz, _mm_loadu_ps(z + i)), vOffset));
+        __m128 inside = _mm_cmplt_ps(_mm_and_ps(distance, absMask), vThreshold);
+        laneCounts = _mm_sub_epi32(laneCounts, _mm_castps_si128(inside));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), laneCounts);
+    inliers = size_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#elif defined(BEDPLANE_NEON)
+    const float32x4_t vOffset = vdupq_n_f32(offset);
+    const float32x4_t vThreshold = vdupq_n_f32(threshold);
+    uint32x4_t laneCounts = vdupq_n_u32(0);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t distance = vmlaq_n_f32(vOffset, vld1q_f32(x + i), nx);
+        distance = vmlaq_n_f32(distance, vld1q_f32(y + i), ny);
+        distance = vmlaq_n_f32(distance, vld1q_f32(z + i), nz);
+        laneCounts = vsubq_u32(laneCounts, vcltq_f32(vabsq_f32(distance), vThreshold));
+    }
+    inliers = vaddvq_u32(laneCounts);
+#endif
+
+    for (; i < count; i++)
+    {
+        const float distance = nx * x[i] + ny * y[i] + nz * z[i] + offset;
+        inliers += (std::fabs(distance) < threshold) ? 1 : 0;
+    }
+    return inliers;
+}
+
+bool BedPlaneEstimator::Fit(uint32_t iterations, bool startFromCurrent)
+{
+    auto fitStart = std::chrono::steady_clock::now();
+
+    const size_t count = m_sampleSize;
+    const float* x = m_sampleX.data();
+    const float* y = m_sampleY.data();
+    const float* z = m_sampleZ.data();
+
+    BedPlane best;
+    size_t bestInliers = 0;
+    if (startFromCurrent && m_hasPlane)
+    {
+        best = m_plane;
+        bestInliers = CountInliers(best);
+    }
+
+    std::uniform_int_distribution<size_t> pick(0, count - 1);
+    for (uint32_t iteration = 0; iteration < iterations; iteration++)
+    {
+        const size_t a = pick(m_random);
+        const size_t b = pick(m_random);
+        const size_t c = pick(m_random);
+        if (a == b || b == c || a == c)
+        {
+            continue;
+        }
+
+        const float abX = x[b] - x[a], abY = y[b] - y[a], abZ = z[b] - z[a];
+        const float acX = x[c] - x[a], acY = y[c] - y[a], acZ = z[c] - z[a];
+        BedPlane hypothesis;
+        hypothesis.normal[0] = abY * acZ - abZ * acY;
+        hypothesis.normal[1] = abZ * acX - abX * acZ;
+        hypothesis.normal[2] = abX * acY - abY * acX;
+        const float length = std::sqrt(hypothesis.normal[0] * hypothesis.normal[0] +
+            hypothesis.normal[1] * hypothesis.normal[1] + hypothesis.normal[2] * hypothesis.normal[2]);
+        if (!(length > minNormalLength))
+        {
+            continue;
+        }
+        for (float& component : hypothesis.normal)
+        {
+            component /= length;
+        }
+        hypothesis.offset = -(hypothesis.normal[0] * x[a] + hypothesis.normal[1] * y[a] + hypothesis.normal[2] * z[a]);
+
+        const size_t inliers = CountInliers(hypothesis);
+        if (inliers > bestInliers)
+        {
+            best = hypothesis;
+            bestInliers = inliers;
+        }
+    }
+
+    if (bestInliers < m_settings.minInlierFraction * count)
+    {
+        return false;
+    }
+
+    // Least squares over the inliers, as z = a * x + b * y + c. The camera looks at the plate, so the plate
+    // is never parallel to the z axis. The normal equations are solved with Cramer's rule.
+    double sxx = 0, sxy = 0, sx = 0, syy = 0, sy = 0, sn = 0, sxz = 0, syz = 0, sz = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const float distance = best.normal[0] * x[i] + best.normal[1] * y[i] + best.normal[2] * z[i] + best.offset;
+        if (std::fabs(distance) < m_settings.inlierThreshold)
+        {
+            sxx += double(x[i]) * x[i]; sxy += double(x[i]) * y[i]; sx += x[i];
+            syy += double(y[i]) * y[i]; sy += y[i]; sn += 1.0;
+            sxz += double(x[i]) * z[i]; syz += double(y[i]) * z[i]; sz += z[i];
+        }
+    }
+    const double determinant = sxx * (syy * sn - sy * sy) - sxy * (sxy * sn - sy * sx) + sx * (sxy * sy - syy * sx);
+    if (std::fabs(determinant) > std::numeric_limits<double>::epsilon())
+    {
+        const double a = (sxz * (syy * sn - sy * sy) - sxy * (syz * sn - sy * sz) + sx * (syz * sy - syy * sz)) / determinant;
+        const double b = (sxx * (syz * sn - sz * sy) - sxz * (sxy * sn - sy * sx) + sx * (sxy * sz - syz * sx)) / determinant;
+        const double c = (sxx * (syy * sz - sy * syz) - sxy * (sxy * sz - syz * sx) + sxz * (sxy * sy - syy * sx)) / determinant;
+
+        // a * x + b * y - z + c = 0, normalized.
+        const double length = std::sqrt(a * a + b * b + 1.0);
+        BedPlane refined;
+        refined.normal[0] = static_cast<float>(a / length);
+        refined.normal[1] = static_cast<float>(b / length);
+        refined.normal[2] = static_cast<float>(-1.0 / length);
+        refined.offset = static_cast<float>(c / length);
+
+        const size_t refinedInliers = CountInliers(refined);
+        if (refinedInliers >= bestInliers)
+        {
+            best = refined;
+            bestInliers = refinedInliers;
+        }
+    }
+
+    // The camera, at the origin, is on the positive side.
+    if (best.offset < 0.0f)
+    {
+        for (float& component : best.normal)
+        {
+            component = -component;
+        }
+        best.offset = -best.offset;
+    }
+
+    m_plane = best;
+    m_hasPlane = true;
+    m_fitInlierFraction = static_cast<float>(bestInliers) / count;
+    m_lastFitFrame = m_frame;
+
+    m_statistics.inlierFraction = m_fitInlierFraction;
+    m_statistics.lastFitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fitStart).count();
+    return true;
+}
+
+bool BedPlaneEstimator::Update(const RayTable& rays, const float* depth)
+{
+    m_frame++;
+
+    GatherSample(rays, depth);
+    if (m_sampleSize < minSampleSize)
+    {
+        return m_hasPlane;
+    }
+
+    if (!m_hasPlane)
+    {
+        if (Fit(m_settings.iterations, false))
+        {
+            m_statistics.fits++;
+        }
+    }
+    else if (m_frame - m_lastFitFrame >= m_settings.refitInterval)
+    {
+        // A failed refit keeps the current plane; the drift check still catches a plate that moved.
+        if (Fit(m_settings.refitIterations, true))
+        {
+            m_statistics.refits++;
+        }
+        else
+        {
+            m_lastFitFrame = m_frame;
+        }
+    }
+    else
+    {
+        const float inlierFraction = static_cast<float>(CountInliers(m_plane)) / m_sampleSize;
+        if (inlierFraction < m_fitInlierFraction * m_settings.driftInlierRatio)
+        {
+            m_statistics.drifts++;
+            m_hasPlane = Fit(m_settings.iterations, false);
+            if (m_hasPlane)
+            {
+                m_statistics.fits++;
+            }
+        }
+    }
+    return m_hasPlane;
+}
+
+void SDKTemplate::ComputeHeightsAbovePlane(const BedPlane& plane, const RayTable& rays, const float* depth, float* heights)
+{
+    const float nx = plane.normal[0];
+    const float ny = plane.normal[1];
+    const float nz = plane.normal[2];
+    const float offset = plane.offset;
+    const float* rayX = rays.GetRayX();
+    const float* rayY = rays.GetRayY();
+    const float invalid = std::numeric_limits<float>::quiet_NaN();
+    const size_t count = rays.GetCount();
+
+    // The point is depth * (rayX, rayY, 1), so its height is depth times the ray's height gain plus the offset.
+    size_t i = 0;
+#if defined(BEDPLANE_X86)
+    const __m128 vx = _mm_set1_ps(nx);
+    const __m128 vy = _mm_set1_ps(ny);
+    const __m128 vz = _mm_set1_ps(nz);
+    const __m128 vOffset = _mm_set1_ps(offset);
+    const __m128 vInvalid = _mm_set1_ps(invalid);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 d = _mm_loadu_ps(depth + i);
+        __m128 gain = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(rayX + i)), _mm_mul_ps(vy, _mm_loadu_ps(rayY + i))), vz);
+        __m128 height = _mm_add_ps(_mm_mul_ps(d, gain), vOffset);
+        __m128 valid = _mm_cmpgt_ps(d, _mm_setzero_ps());
+        _mm_storeu_ps(heights + i, _mm_or_ps(_mm_and_ps(valid, height), _mm_andnot_ps(valid, vInvalid)));
+    }
+#elif defined(BEDPLANE_NEON)
+    const float32x4_t vOffset = vdupq_n_f32(offset);
+    const float32x4_t vInvalid = vdupq_n_f32(invalid);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t d = vld1q_f32(depth + i);
+        float32x4_t gain = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(nz), vld1q_f32(rayX + i), nx), vld1q_f32(rayY + i), ny);
+        float32x4_t height = vmlaq_f32(vOffset, d, gain);
+        vst1q_f32(heights + i, vbslq_f32(vcgtq_f32(d, vdupq_n_f32(0.0f)), height, vInvalid));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const float d = depth[i];
+        heights[i] = (d > 0.0f) ? d * (nx * rayX[i] + ny * rayY[i] + nz) + offset : invalid;
+    }
+}
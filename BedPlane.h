@@ -0,0 +1,112 @@
+#pragma once
+
+#include "RayTable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // A plane in camera space. The signed height of a point p above it is dot(normal, p) + offset, with a unit
+    // normal pointing towards the camera, so points between the plane and the camera have a positive height.
+    struct BedPlane
+    {
+        float normal[3] = { 0.0f, 0.0f, -1.0f };
+        float offset = 0.0f;
+    };
+
+    // How BedPlaneEstimator samples points and decides when to fit again.
+    struct BedPlaneSettings
+    {
+        // Points taken from a frame, on a grid over the image.
+        uint32_t sampleCount = 2048;
+
+        // Plane hypotheses tried by a fit from scratch, and by a periodic refit, which also tries the current plane.
+        uint32_t iterations = 128;
+        uint32_t refitIterations = 24;
+
+        // Distance, in meters, within which a point supports a plane.
+        float inlierThreshold = 0.004f;
+
+        // A fit is only accepted if at least this fraction of the sample supports it.
+        float minInlierFraction = 0.25f;
+
+        // Frames between periodic refits.
+        uint32_t refitInterval = 30;
+
+        // The plane has drifted when the fraction of the sample supporting it drops below this share of the
+        // fraction at the last fit. A drift fits from scratch right away.
+        float driftInlierRatio = 0.75f;
+    };
+
+    // Counters of a BedPlaneEstimator.
+    struct BedPlaneStatistics
+    {
+        uint64_t fits = 0; // Fits from scratch, including those after a drift.
+        uint64_t refits = 0; // Periodic refits.
+        uint64_t drifts = 0;
+        double lastFitMilliseconds = 0.0;
+        float inlierFraction = 0.0f; // Fraction of the sample supporting the plane at the last fit.
+    };
+
+    // Finds the build plate as the dominant plane of a depth image with RANSAC, then keeps it up to date
+    // cheaply: the plane is checked against a small sample every frame, refit every few frames starting from
+    // the current plane, and fit from scratch only when it no longer matches. Hypotheses are scored over the
+    // sample stored as separate x, y and z arrays, several points per instruction.
+    class BedPlaneEstimator
+    {
+    public:
+        explicit BedPlaneEstimator(const BedPlaneSettings& settings = BedPlaneSettings());
+
+        /// <summary>
+        /// Updates the plane from a depth image with one depth in meters per ray of rays. Depths that are not
+        /// greater than 0, including NaN, are invalid. Returns whether a plane is known.
+        /// </summary>
+        bool Update(const RayTable& rays, const float* depth);
+
+        /// <summary>
+        /// Forgets the plane, so the next update fits from scratch.
+        /// </summary>
+        void Reset();
+
+        bool HasPlane() const { return m_hasPlane; }
+        const BedPlane& GetPlane() const { return m_plane; }
+        const BedPlaneStatistics& GetStatistics() const { return m_statistics; }
+
+    private:
+        void GatherSample(const RayTable& rays, const float* depth);
+        size_t CountInliers(const BedPlane& plane) const;
+
+        /// <summary>
+        /// Runs RANSAC over the sample, starting from the current plane if there is one, and refines the best
+        /// hypothesis by least squares over its inliers. Returns false and leaves the plane alone if no
+        /// hypothesis has enough support.
+        /// </summary>
+        bool Fit(uint32_t iterations, bool startFromCurrent);
+
+        const BedPlaneSettings m_settings;
+
+        // The sample of the current frame.
+        std::vector<float> m_sampleX;
+        std::vector<float> m_sampleY;
+        std::vector<float> m_sampleZ;
+        size_t m_sampleSize = 0;
+
+        std::minstd_rand m_random;
+
+        BedPlane m_plane;
+        bool m_hasPlane = false;
+        float m_fitInlierFraction = 0.0f;
+        uint64_t m_frame = 0;
+        uint64_t m_lastFitFrame = 0;
+        BedPlaneStatistics m_statistics;
+    };
+
+    /// <summary>
+    /// Fills heights with the height above plane of the point each ray of rays sees at depth, or NaN where
+    /// the depth is invalid.
+    /// </summary>
+    void ComputeHeightsAbovePlane(const BedPlane& plane, const RayTable& rays, const float* depth, float* heights);
+} // SDKTemplate
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // Queue capacity that absorbs a frame of jitter without letting latency build up.
+    constexpr size_t DefaultFrameQueueCapacity = 2;
+
+    // What a full BoundedFrameQueue does with another item.
+    enum class FrameDropPolicy
+    {
+        DropOldest, // Discard the oldest queued item, so the consumer always gets the most recent ones.
+        DropNewest, // Discard the item being pushed, so queued items are never lost.
+    };
+
+    // A fixed-capacity FIFO between the threads that receive frames and the thread that processes them.
+    // Pushing never waits for the consumer: when the queue is full, an item is dropped according to the
+    // drop policy. Items live in a ring allocated up front, so steady-state pushes don't allocate.
+    template<typename T>
+    class BoundedFrameQueue
+    {
+    public:
+        BoundedFrameQueue(size_t capacity, FrameDropPolicy dropPolicy) :
+            m_items(capacity > 0 ? capacity : 1),
+            m_dropPolicy(dropPolicy)
+        {
+        }
+
+        BoundedFrameQueue(const BoundedFrameQueue&) = delete;
+        BoundedFrameQueue& operator=(const BoundedFrameQueue&) = delete;
+
+        /// <summary>
+        /// Changes how many items can wait at once. When shrinking, the oldest items that no longer fit are dropped.
+        /// </summary>
+        void SetCapacity(size_t capacity)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            std::vector<T> items(capacity > 0 ? capacity : 1);
+            while (m_count > items.size())
+            {
+                PopFront();
+                m_dropped++;
+            }
+
+            size_t count = m_count;
+            for (size_t i = 0; i < count; i++)
+            {
+                items[i] = PopFront();
+            }
+            m_items = std::move(items);
+            m_head = 0;
+            m_count = count;
+        }
+
+        void SetDropPolicy(FrameDropPolicy dropPolicy)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_dropPolicy = dropPolicy;
+        }
+
+        /// <summary>
+        /// Queues an item for the consumer. Returns false when an item was dropped to make room, or when
+        /// the queue is closed.
+        /// </summary>
+        bool Push(T item)
+        {
+            bool dropped = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_closed)
+                {
+                    return false;
+                }
+
+                if (m_count == m_items.size())
+                {
+                    m_dropped++;
+                    dropped = true;
+                    if (m_dropPolicy == FrameDropPolicy::DropNewest)
+                    {
+                        return false;
+                    }
+                    PopFront();
+                }
+
+                m_items[(m_head + m_count) % m_items.size()] = std::move(item);
+                m_count++;
+                m_pushed++;
+                m_maxDepth = (m_count > m_maxDepth) ? m_count : m_maxDepth;
+            }
+            m_itemAvailable.notify_one();
+            return !dropped;
+        }
+
+        /// <summary>
+        /// Waits for the oldest item and removes it. Returns false once the queue is closed and empty.
+        /// </summary>
+        bool Pop(T& item)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_itemAvailable.wait(lock, [this]() { return m_count > 0 || m_closed; });
+
+            if (m_count == 0)
+            {
+                return false;
+            }
+            item = PopFront();
+            return true;
+        }
+
+        /// <summary>
+        /// Drops every queued item.
+        /// </summary>
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (m_count > 0)
+            {
+                PopFront();
+            }
+        }
+
+        /// <summary>
+        /// Wakes the consumer and makes later pushes fail. Items already queued can still be popped.
+        /// </summary>
+        void Close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_closed = true;
+            }
+            m_itemAvailable.notify_all();
+        }
+
+        /// <summary>
+        /// Reopens a closed queue so it can be used again.
+        /// </summary>
+        void Reopen()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = false;
+        }
+
+        size_t GetDepth() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_count;
+        }
+
+        // The most items that have waited at once.
+        size_t GetMaxDepth() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_maxDepth;
+        }
+
+        uint64_t GetPushedCount() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_pushed;
+        }
+
+        uint64_t GetDroppedCount() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_dropped;
+        }
+
+    private:
+        T PopFront()
+        {
+            // Leave an empty value behind, so the ring doesn't keep dropped frames alive.
+            T item = std::move(m_items[m_head]);
+            m_items[m_head] = T();
+            m_head = (m_head + 1) % m_items.size();
+            m_count--;
+            return item;
+        }
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_itemAvailable;
+
+        std::vector<T> m_items;
+        size_t m_head = 0;
+        size_t m_count = 0;
+        FrameDropPolicy m_dropPolicy;
+        bool m_closed = false;
+
+        size_t m_maxDepth = 0;
+        uint64_t m_pushed = 0;
+        uint64_t m_dropped = 0;
+    };
+} // SDKTemplate
@@ -0,0 +1,82 @@
+#include "CpuFeatures.h"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+using namespace SDKTemplate;
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+
+static void QueryCpuid(int leaf, int subleaf, int registers[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex(registers, leaf, subleaf);
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    registers[0] = static_cast<int>(a);
+    registers[1] = static_cast<int>(b);
+    registers[2] = static_cast<int>(c);
+    registers[3] = static_cast<int>(d);
+#endif
+}
+
+static unsigned long long QueryXcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+static CpuFeatures DetectCpuFeatures()
+{
+    CpuFeatures features;
+
+    int registers[4];
+    QueryCpuid(0, 0, registers);
+    int maxLeaf = registers[0];
+
+    QueryCpuid(1, 0, registers);
+    features.Sse41 = (registers[2] & (1 << 19)) != 0;
+    features.Popcnt = (registers[2] & (1 << 23)) != 0;
+
+    // AVX2 also needs the OS to save the upper halves of the YMM registers on context switch.
+    bool osxsave = (registers[2] & (1 << 27)) != 0;
+    bool avx = (registers[2] & (1 << 28)) != 0;
+    if (maxLeaf >= 7 && osxsave && avx && (QueryXcr0() & 0x6) == 0x6)
+    {
+        QueryCpuid(7, 0, registers);
+        features.Avx2 = (registers[1] & (1 << 5)) != 0;
+    }
+
+    return features;
+}
+
+#else
+
+static CpuFeatures DetectCpuFeatures()
+{
+    CpuFeatures features;
+
+    // Advanced SIMD is a mandatory part of AArch64.
+#if defined(_M_ARM64) || defined(__aarch64__)
+    features.Neon = true;
+#endif
+
+    return features;
+}
+
+#endif
+
+const CpuFeatures& SDKTemplate::GetCpuFeatures()
+{
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
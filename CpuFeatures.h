@@ -0,0 +1,19 @@
+#pragma once
+
+namespace SDKTemplate
+{
+    // Instruction set extensions that the pixel kernels can dispatch on.
+    struct CpuFeatures
+    {
+        bool Popcnt = false;
+        bool Sse41 = false;
+        bool Avx2 = false;
+        bool Neon = false;
+    };
+
+    /// <summary>
+    /// Returns the instruction set extensions supported by the processor and the OS.
+    /// Detection runs once; later calls return the cached result.
+    /// </summary>
+    const CpuFeatures& GetCpuFeatures();
+} // SDKTemplate
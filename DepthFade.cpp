@@ -0,0 +1,241 @@
+#include "DepthFade.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define DEPTHFADE_X86
+#include <immintrin.h>
+// MSVC accepts any intrinsic in any function; GCC and Clang need the instruction set enabled per function,
+// since the file is built for the baseline processor and the variants are only called where supported.
+#if defined(__GNUC__)
+#define DEPTHFADE_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+#define DEPTHFADE_TARGET(instructionSet)
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define DEPTHFADE_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+using namespace SDKTemplate;
+
+// The color channels are multiplied by a factor in [0, 256] and shifted right by 8, so a factor of 256
+// leaves a channel unchanged and the product of a channel and a factor always fits in 16 bits.
+static constexpr float fadeFactorOne = 256.0f;
+
+// Reference implementation. The SIMD variants perform the same float operations in the same order,
+// including the min before the max that sends NaN depths to black, so the factors match bit for bit.
+static void ApplyDepthFadeScalar(uint32_t pixelCount, const float* depth, size_t depthStride, ColorBGRA* pixels, float fadeStart, float inverseRange)
+{
+	for (uint32_t i = 0; i < pixelCount; i++)
+	{
+		float t = (depth[i * depthStride] - fadeStart) * inverseRange;
+		t = (t < 1.0f) ? t : 1.0f;
+		t = (t > 0.0f) ? t : 0.0f;
+		uint32_t factor = static_cast<uint32_t>((1.0f - t) * fadeFactorOne + 0.5f);
+
+		pixels[i].B = static_cast<uint8_t>((pixels[i].B * factor) >> 8);
+		pixels[i].G = static_cast<uint8_t>((pixels[i].G * factor) >> 8);
+		pixels[i].R = static_cast<uint8_t>((pixels[i].R * factor) >> 8);
+	}
+}
+
+#if defined(DEPTHFADE_X86)
+
+// Converts 4 depths to fade factors. _mm_min_ps and _mm_max_ps return their second operand when the
+// first is NaN, which is what the scalar comparisons above do.
+DEPTHFADE_TARGET("sse4.1")
+static inline __m128i FadeFactorsSse(__m128 depth, __m128 start, __m128 inverseRange, __m128 one, __m128 factorOne, __m128 half)
+{
+	__m128 t = _mm_mul_ps(_mm_sub_ps(depth, start), inverseRange);
+	t = _mm_max_ps(_mm_min_ps(t, one), _mm_setzero_ps());
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(one, t), factorOne), half));
+}
+
+// Processes 4 pixels per iteration. The factors are spread over the B, G and R words of each
+// widened pixel with a uint8_t shuffle; the alpha words get 256 so alpha passes through unchanged.
+DEPTHFADE_TARGET("sse4.1")
+static void ApplyDepthFadeSse41(uint32_t pixelCount, const float* depth, size_t depthStride, ColorBGRA* pixels, float fadeStart, float inverseRange)
+{
+	const __m128 start = _mm_set1_ps(fadeStart);
+	const __m128 range = _mm_set1_ps(inverseRange);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 factorOne = _mm_set1_ps(fadeFactorOne);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128i alphaFactor = _mm_setr_epi16(0, 0, 0, 256, 0, 0, 0, 256);
+	const __m128i spreadLow = _mm_setr_epi8(0, 1, 0, 1, 0, 1, -1, -1, 2, 3, 2, 3, 2, 3, -1, -1);
+	const __m128i spreadHigh = _mm_setr_epi8(4, 5, 4, 5, 4, 5, -1, -1, 6, 7, 6, 7, 6, 7, -1, -1);
+
+	uint32_t i = 0;
+	for (; i + 4 <= pixelCount; i += 4)
+	{
+		__m128 z = (depthStride == 1) ?
+			_mm_loadu_ps(depth + i) :
+			_mm_setr_ps(depth[i * depthStride], depth[(i + 1) * depthStride], depth[(i + 2) * depthStride], depth[(i + 3) * depthStride]);
+
+		__m128i factors = FadeFactorsSse(z, start, range, one, factorOne, half);
+		factors = _mm_packs_epi32(factors, factors);
+
+		__m128i* pixelVector = reinterpret_cast<__m128i*>(pixels + i);
+		__m128i bgra = _mm_loadu_si128(pixelVector);
+		__m128i low = _mm_cvtepu8_epi16(bgra);
+		__m128i high = _mm_unpackhi_epi8(bgra, _mm_setzero_si128());
+
+		low = _mm_srli_epi16(_mm_mullo_epi16(low, _mm_or_si128(_mm_shuffle_epi8(factors, spreadLow), alphaFactor)), 8);
+		high = _mm_srli_epi16(_mm_mullo_epi16(high, _mm_or_si128(_mm_shuffle_epi8(factors, spreadHigh), alphaFactor)), 8);
+
+		_mm_storeu_si128(pixelVector, _mm_packus_epi16(low, high));
+	}
+
+	ApplyDepthFadeScalar(pixelCount - i, depth + i * depthStride, depthStride, pixels + i, fadeStart, inverseRange);
+}
+
+// Processes 8 pixels per iteration. Strided depths are read with a hardware gather.
+DEPTHFADE_TARGET("avx2")
+static void ApplyDepthFadeAvx2(uint32_t pixelCount, const float* depth, size_t depthStride, ColorBGRA* pixels, float fadeStart, float inverseRange)
+{
+	const __m256 start = _mm256_set1_ps(fadeStart);
+	const __m256 range = _mm256_set1_ps(inverseRange);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 factorOne = _mm256_set1_ps(fadeFactorOne);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const int stride = static_cast<int>(depthStride);
+	const __m256i gatherOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+	const __m256i alphaFactor = _mm256_setr_epi16(0, 0, 0, 256, 0, 0, 0, 256, 0, 0, 0, 256, 0, 0, 0, 256);
+
+	// The shuffle works within each 128-bit lane, so the 8 factors are broadcast to both lanes and
+	// each lane picks the factors of the two pixels it holds.
+	const __m256i spreadLow = _mm256_setr_epi8(
+		0, 1, 0, 1, 0, 1, -1, -1, 2, 3, 2, 3, 2, 3, -1, -1,
+		4, 5, 4, 5, 4, 5, -1, -1, 6, 7, 6, 7, 6, 7, -1, -1);
+	const __m256i spreadHigh = _mm256_setr_epi8(
+		8, 9, 8, 9, 8, 9, -1, -1, 10, 11, 10, 11, 10, 11, -1, -1,
+		12, 13, 12, 13, 12, 13, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+
+	uint32_t i = 0;
+	for (; i + 8 <= pixelCount; i += 8)
+	{
+		const float* depthBase = depth + i * depthStride;
+		__m256 z = (depthStride == 1) ?
+			_mm256_loadu_ps(depthBase) :
+			_mm256_i32gather_ps(depthBase, gatherOffsets, sizeof(float));
+
+		__m256 t = _mm256_mul_ps(_mm256_sub_ps(z, start), range);
+		t = _mm256_max_ps(_mm256_min_ps(t, one), _mm256_setzero_ps());
+		__m256i factors32 = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(one, t), factorOne), half));
+		__m128i factors16 = _mm_packs_epi32(_mm256_castsi256_si128(factors32), _mm256_extracti128_si256(factors32, 1));
+		__m256i factors = _mm256_broadcastsi128_si256(factors16);
+
+		__m256i* pixelVector = reinterpret_cast<__m256i*>(pixels + i);
+		__m256i bgra = _mm256_loadu_si256(pixelVector);
+		__m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bgra));
+		__m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bgra, 1));
+
+		low = _mm256_srli_epi16(_mm256_mullo_epi16(low, _mm256_or_si256(_mm256_shuffle_epi8(factors, spreadLow), alphaFactor)), 8);
+		high = _mm256_srli_epi16(_mm256_mullo_epi16(high, _mm256_or_si256(_mm256_shuffle_epi8(factors, spreadHigh), alphaFactor)), 8);
+
+		// packus interleaves the 128-bit lanes of its operands; the permute restores pixel order.
+		_mm256_storeu_si256(pixelVector, _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8));
+	}
+
+	ApplyDepthFadeScalar(pixelCount - i, depth + i * depthStride, depthStride, pixels + i, fadeStart, inverseRange);
+}
+
+#elif defined(DEPTHFADE_NEON)
+
+// Converts 4 depths to fade factors. vminq_f32 propagates NaN, so the clamps are written as
+// compare and select to match the scalar comparisons.
+static inline uint32x4_t FadeFactorsNeon(float32x4_t depth, float32x4_t start, float32x4_t inverseRange, float32x4_t one, float32x4_t factorOne, float32x4_t half)
+{
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	float32x4_t t = vmulq_f32(vsubq_f32(depth, start), inverseRange);
+	t = vbslq_f32(vcltq_f32(t, one), t, one);
+	t = vbslq_f32(vcgtq_f32(t, zero), t, zero);
+	return vcvtq_u32_f32(vaddq_f32(vmulq_f32(vsubq_f32(one, t), factorOne), half));
+}
+
+// Processes 8 pixels per iteration, with the channels deinterleaved into separate registers.
+static void ApplyDepthFadeNeon(uint32_t pixelCount, const float* depth, size_t depthStride, ColorBGRA* pixels, float fadeStart, float inverseRange)
+{
+	const float32x4_t start = vdupq_n_f32(fadeStart);
+	const float32x4_t range = vdupq_n_f32(inverseRange);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t factorOne = vdupq_n_f32(fadeFactorOne);
+	const float32x4_t half = vdupq_n_f32(0.5f);
+
+	uint32_t i = 0;
+	for (; i + 8 <= pixelCount; i += 8)
+	{
+		float32x4_t z[2];
+		if (depthStride == 1)
+		{
+			z[0] = vld1q_f32(depth + i);
+			z[1] = vld1q_f32(depth + i + 4);
+		}
+		else
+		{
+			float samples[8];
+			for (int lane = 0; lane < 8; lane++)
+			{
+				samples[lane] = depth[(i + lane) * depthStride];
+			}
+			z[0] = vld1q_f32(samples);
+			z[1] = vld1q_f32(samples + 4);
+		}
+
+		uint16x8_t factors = vcombine_u16(
+			vmovn_u32(FadeFactorsNeon(z[0], start, range, one, factorOne, half)),
+			vmovn_u32(FadeFactorsNeon(z[1], start, range, one, factorOne, half)));
+
+		uint8_t* pixelBytes = reinterpret_cast<uint8_t*>(pixels + i);
+		uint8x8x4_t bgra = vld4_u8(pixelBytes);
+		for (int channel = 0; channel < 3; channel++)
+		{
+			bgra.val[channel] = vshrn_n_u16(vmulq_u16(vmovl_u8(bgra.val[channel]), factors), 8);
+		}
+		vst4_u8(pixelBytes, bgra);
+	}
+
+	ApplyDepthFadeScalar(pixelCount - i, depth + i * depthStride, depthStride, pixels + i, fadeStart, inverseRange);
+}
+
+#endif
+
+typedef void(*DepthFadeKernel)(uint32_t, const float*, size_t, ColorBGRA*, float, float);
+
+static DepthFadeKernel SelectDepthFadeKernel(const CpuFeatures& features)
+{
+#if defined(DEPTHFADE_X86)
+	if (features.Avx2)
+	{
+		return ApplyDepthFadeAvx2;
+	}
+	if (features.Sse41)
+	{
+		return ApplyDepthFadeSse41;
+	}
+#elif defined(DEPTHFADE_NEON)
+	if (features.Neon)
+	{
+		return ApplyDepthFadeNeon;
+	}
+#endif
+
+	(void)features;
+	return ApplyDepthFadeScalar;
+}
+
+static const DepthFadeKernel depthFadeKernel = SelectDepthFadeKernel(GetCpuFeatures());
+
+void SDKTemplate::ApplyDepthFade(uint32_t pixelCount, const float* depth, size_t depthStride, ColorBGRA* pixels, float fadeStart, float fadeEnd)
+{
+	depthFadeKernel(pixelCount, depth, depthStride, pixels, fadeStart, 1.0f / (fadeEnd - fadeStart));
+}
+
+void SDKTemplate::ApplyDepthFade(uint32_t pixelCount, const float* depth, size_t depthStride, ColorBGRA* pixels, float fadeStart, float fadeEnd,
+	const CpuFeatures& features)
+{
+	SelectDepthFadeKernel(features)(pixelCount, depth, depthStride, pixels, fadeStart, 1.0f / (fadeEnd - fadeStart));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "PseudoColorKernels.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SDKTemplate
+{
+    // Default depth range, in meters, over which the correlated color image fades to black.
+    constexpr float DefaultDepthFadeStart = 0.6f;
+    constexpr float DefaultDepthFadeEnd = 0.61f;
+
+    // Default height range, in meters above the build plate, over which the correlated color image fades to black.
+    // Pixels at least the start height above the plate keep their color; the plate itself is black.
+    constexpr float DefaultPlateFadeStartHeight = 0.005f;
+    constexpr float DefaultPlateFadeEndHeight = 0.002f;
+
+    /// <summary>
+    /// Fades each color pixel by the depth sampled for it: pixels closer than fadeStart keep their color,
+    /// pixels beyond fadeEnd (or with a NaN depth) become black, and the alpha channel is left unchanged.
+    /// depth[i * depthStride] is the depth of pixels[i], so the z member of an array of float3 can be
+    /// passed directly with a stride of 3. fadeEnd must be greater than fadeStart.
+    /// The fade factor is quantized to 1/256 steps and every SIMD variant produces the same output.
+    /// </summary>
+    void ApplyDepthFade(uint32_t pixelCount, const float* depth, size_t depthStride, ColorBGRA* pixels, float fadeStart, float fadeEnd);
+
+    /// <summary>
+    /// ApplyDepthFade using the widest SIMD variant among features, so that the variants can be compared
+    /// and timed against each other. features must not name extensions the processor lacks.
+    /// </summary>
+    void ApplyDepthFade(uint32_t pixelCount, const float* depth, size_t depthStride, ColorBGRA* pixels, float fadeStart, float fadeEnd,
+        const CpuFeatures& features);
+} // SDKTemplate
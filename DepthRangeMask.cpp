@@ -0,0 +1,313 @@
+#include "DepthRangeMask.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define DEPTHMASK_X86
+#include <immintrin.h>
+// MSVC accepts any intrinsic in any function; GCC and Clang need the instruction set enabled per function,
+// since the file is built for the baseline processor and the variants are only called where supported.
+#if defined(__GNUC__)
+#define DEPTHMASK_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+#define DEPTHMASK_TARGET(instructionSet)
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define DEPTHMASK_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace SDKTemplate;
+
+static inline unsigned int CountTrailingZeros(uint64_t word)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(word)))
+    {
+        return index;
+    }
+    _BitScanForward(&index, static_cast<unsigned long>(word >> 32));
+    return index + 32;
+#else
+    return static_cast<unsigned int>(__builtin_ctzll(word));
+#endif
+}
+
+// Mask selecting bits [begin, end) of a word, for 0 <= begin < end <= 64.
+static inline uint64_t BitRange(uint32_t begin, uint32_t end)
+{
+    uint64_t upTo = (end == 64) ? ~0ull : ((1ull << end) - 1);
+    return upTo & ~((1ull << begin) - 1);
+}
+
+static inline uint64_t CountWord(uint64_t v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (v * 0x0101010101010101ull) >> 56;
+}
+
+static uint64_t CountWordsScalar(const uint64_t* words, size_t count)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        total += CountWord(words[i]);
+    }
+    return total;
+}
+
+#if defined(DEPTHMASK_X86)
+
+DEPTHMASK_TARGET("popcnt")
+static uint64_t CountWordsPopcnt(const uint64_t* words, size_t count)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+#if defined(_M_X64) || defined(__x86_64__)
+        total += _mm_popcnt_u64(words[i]);
+#else
+        total += _mm_popcnt_u32(static_cast<uint32_t>(words[i])) + _mm_popcnt_u32(static_cast<uint32_t>(words[i] >> 32));
+#endif
+    }
+    return total;
+}
+
+// Counts 4 words per iteration with a nibble lookup in a byte shuffle, summing the byte counts
+// with sad against zero (Mula's method). Faster than popcnt once there are more than a few words.
+DEPTHMASK_TARGET("avx2,popcnt")
+static uint64_t CountWordsAvx2(const uint64_t* words, size_t count)
+{
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+
+    __m256i totals = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+        __m256i low = _mm256_and_si256(v, lowNibbles);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibbles);
+        __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+        totals = _mm256_add_epi64(totals, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), totals);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + CountWordsPopcnt(words + i, count - i);
+}
+
+#elif defined(DEPTHMASK_NEON)
+
+// Counts 2 words per iteration with the per-byte population count instruction.
+static uint64_t CountWordsNeon(const uint64_t* words, size_t count)
+{
+    uint64_t total = 0;
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        uint8x16_t bytes = vcntq_u8(vreinterpretq_u8_u64(vld1q_u64(words + i)));
+        total += vaddlvq_u8(bytes);
+    }
+    return total + CountWordsScalar(words + i, count - i);
+}
+
+#endif
+
+typedef uint64_t(*CountWordsKernel)(const uint64_t*, size_t);
+
+static CountWordsKernel SelectCountWordsKernel(const CpuFeatures& features)
+{
+#if defined(DEPTHMASK_X86)
+    // The AVX2 tail uses popcnt, which every AVX2 processor has.
+    if (features.Avx2 && features.Popcnt)
+    {
+        return CountWordsAvx2;
+    }
+    if (features.Popcnt)
+    {
+        return CountWordsPopcnt;
+    }
+#elif defined(DEPTHMASK_NEON)
+    if (features.Neon)
+    {
+        return CountWordsNeon;
+    }
+#endif
+
+    (void)features;
+    return CountWordsScalar;
+}
+
+static const CountWordsKernel countWords = SelectCountWordsKernel(GetCpuFeatures());
+
+
+void DepthRangeMask::Build(const float* depth, uint32_t width, uint32_t height, float nearLimit, float farLimit)
+{
+    m_width = width;
+    m_height = height;
+    m_wordsPerRow = (width + 63) / 64;
+    m_words.assign(m_wordsPerRow * height, 0);
+
+#if defined(DEPTHMASK_X86)
+    const __m128 nearVector = _mm_set1_ps(nearLimit);
+    const __m128 farVector = _mm_set1_ps(farLimit);
+#endif
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const float* depthRow = depth + size_t(y) * width;
+        uint64_t* row = m_words.data() + y * m_wordsPerRow;
+
+        uint32_t x = 0;
+#if defined(DEPTHMASK_X86)
+        // Ordered comparisons are false for NaN, so invalid depths stay outside the band.
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128 d = _mm_loadu_ps(depthRow + x);
+            __m128 inside = _mm_and_ps(_mm_cmpgt_ps(d, nearVector), _mm_cmplt_ps(d, farVector));
+            row[x / 64] |= static_cast<uint64_t>(_mm_movemask_ps(inside)) << (x % 64);
+        }
+#endif
+        for (; x < width; x++)
+        {
+            if (depthRow[x] > nearLimit && depthRow[x] < farLimit)
+            {
+                row[x / 64] |= 1ull << (x % 64);
+            }
+        }
+    }
+}
+
+// Counts the set pixels of a rectangle, clipped to the mask, with the given kernel for the words in between its edges.
+static uint64_t CountRectangle(const DepthRangeMask& mask, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, CountWordsKernel countWords)
+{
+    right = (std::min)(right, mask.GetWidth());
+    bottom = (std::min)(bottom, mask.GetHeight());
+    if (left >= right || top >= bottom)
+    {
+        return 0;
+    }
+
+    const uint32_t firstWord = left / 64;
+    const uint32_t lastWord = (right - 1) / 64;
+    const uint64_t firstMask = BitRange(left % 64, (firstWord == lastWord) ? (right - 1) % 64 + 1 : 64);
+    const uint64_t lastMask = BitRange(0, (right - 1) % 64 + 1);
+
+    uint64_t total = 0;
+    for (uint32_t y = top; y < bottom; y++)
+    {
+        const uint64_t* row = mask.GetRow(y);
+        if (firstWord == lastWord)
+        {
+            total += CountWord(row[firstWord] & firstMask);
+        }
+        else
+        {
+            total += CountWord(row[firstWord] & firstMask) + CountWord(row[lastWord] & lastMask) +
+                countWords(row + firstWord + 1, lastWord - firstWord - 1);
+        }
+    }
+    return total;
+}
+
+uint64_t DepthRangeMask::CountSet() const
+{
+    // Padding bits are 0, so the whole mask can be counted as one run of words.
+    return countWords(m_words.data(), m_words.size());
+}
+
+uint64_t DepthRangeMask::CountSet(const CpuFeatures& features) const
+{
+    return SelectCountWordsKernel(features)(m_words.data(), m_words.size());
+}
+
+uint64_t DepthRangeMask::CountSet(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) const
+{
+    return CountRectangle(*this, left, top, right, bottom, countWords);
+}
+
+uint64_t DepthRangeMask::CountSet(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, const CpuFeatures& features) const
+{
+    return CountRectangle(*this, left, top, right, bottom, SelectCountWordsKernel(features));
+}
+
+double DepthRangeMask::Coverage(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) const
+{
+    right = (std::min)(right, m_width);
+    bottom = (std::min)(bottom, m_height);
+    if (left >= right || top >= bottom)
+    {
+        return 0.0;
+    }
+
+    const double area = static_cast<double>(right - left) * (bottom - top);
+    return CountSet(left, top, right, bottom) / area;
+}
+
+void DepthRangeMask::EncodeRuns(std::vector<MaskRun>& runs) const
+{
+    runs.clear();
+
+    for (uint32_t y = 0; y < m_height; y++)
+    {
+        const uint64_t* row = GetRow(y);
+        bool inRun = false;
+        uint32_t runBegin = 0;
+
+        // Jump from one bit transition to the next: look for set bits outside a run and clear bits inside one.
+        for (uint32_t wordIndex = 0; wordIndex < m_wordsPerRow; wordIndex++)
+        {
+            uint32_t base = wordIndex * 64;
+            uint64_t word = row[wordIndex];
+            uint64_t remaining = inRun ? ~word : word;
+
+            while (remaining != 0)
+            {
+                uint32_t bit = CountTrailingZeros(remaining);
+                uint32_t x = base + bit;
+                if (x >= m_width)
+                {
+                    break;
+                }
+
+                if (inRun)
+                {
+                    runs.push_back({ y, runBegin, x });
+                }
+                else
+                {
+                    runBegin = x;
+                }
+                inRun = !inRun;
+
+                // Look for the opposite transition above this bit.
+                uint64_t above = (bit == 63) ? 0 : (~0ull << (bit + 1));
+                remaining = (inRun ? ~word : word) & above;
+            }
+        }
+
+        if (inRun)
+        {
+            runs.push_back({ y, runBegin, m_width });
+        }
+    }
+}
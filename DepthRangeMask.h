@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CpuFeatures.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // A horizontal run of set pixels in row y, covering [xBegin, xEnd).
+    struct MaskRun
+    {
+        uint32_t y;
+        uint32_t xBegin;
+        uint32_t xEnd;
+    };
+
+    // One bit per pixel marking which pixels of a depth field lie inside a depth band.
+    // Each row starts on a new 64-bit word and the bits past the row's width are always 0, so the mask
+    // takes 1/32 of the memory of the depth field or of a BGRA image of the same size.
+    // Bit x % 64 of word x / 64 of a row holds pixel x.
+    class DepthRangeMask
+    {
+    public:
+        /// <summary>
+        /// Sets the bit of every pixel whose depth is inside the open interval (nearLimit, farLimit).
+        /// depth holds width * height values, row by row. NaN depths are outside every band.
+        /// </summary>
+        void Build(const float* depth, uint32_t width, uint32_t height, float nearLimit, float farLimit);
+
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        size_t GetWordsPerRow() const { return m_wordsPerRow; }
+        const uint64_t* GetRow(uint32_t y) const { return m_words.data() + y * m_wordsPerRow; }
+
+        bool IsSet(uint32_t x, uint32_t y) const { return ((GetRow(y)[x / 64] >> (x % 64)) & 1) != 0; }
+
+        /// <summary>
+        /// Number of set pixels in the whole mask.
+        /// </summary>
+        uint64_t CountSet() const;
+
+        /// <summary>
+        /// Number of set pixels in the rectangle [left, right) x [top, bottom), clipped to the mask.
+        /// </summary>
+        uint64_t CountSet(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) const;
+
+        /// <summary>
+        /// The counts above using the widest population count variant among features, so that the variants can be
+        /// compared and timed against each other. features must not name extensions the processor lacks.
+        /// </summary>
+        uint64_t CountSet(const CpuFeatures& features) const;
+        uint64_t CountSet(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, const CpuFeatures& features) const;
+
+        /// <summary>
+        /// Fraction of the rectangle [left, right) x [top, bottom) that is set, or 0 for an empty rectangle.
+        /// </summary>
+        double Coverage(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) const;
+
+        /// <summary>
+        /// Replaces runs with the run-length encoding of the mask, row by row and left to right.
+        /// </summary>
+        void EncodeRuns(std::vector<MaskRun>& runs) const;
+
+    private:
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        size_t m_wordsPerRow = 0;
+        std::vector<uint64_t> m_words;
+    };
+} // SDKTemplate
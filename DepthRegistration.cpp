@@ -0,0 +1,132 @@
+#include "DepthRegistration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace SDKTemplate;
+
+// Upper bound on the splat radius, so a bad calibration can't turn every depth pixel into a huge square.
+static constexpr int maxSplatRadius = 8;
+
+void DepthRegistration::SetDepthRays(std::shared_ptr<const RayTable> depthRays)
+{
+    m_depthRays = std::move(depthRays);
+    UpdateSplatRadius();
+}
+
+void DepthRegistration::SetColorIntrinsics(const PinholeIntrinsics& intrinsics)
+{
+    if (intrinsics != m_colorIntrinsics)
+    {
+        m_colorIntrinsics = intrinsics;
+        UpdateSplatRadius();
+    }
+}
+
+void DepthRegistration::SetDepthToColorTransform(const RigidTransform& transform)
+{
+    m_depthToColor = transform;
+}
+
+void DepthRegistration::UpdateSplatRadius()
+{
+    m_splatRadius = 0;
+    if (!m_depthRays || m_depthRays->GetWidth() < 2 || m_depthRays->GetHeight() < 2)
+    {
+        return;
+    }
+
+    // The angle between neighboring depth rays at the image center, scaled by the color focal length,
+    // is roughly how many color pixels one depth pixel covers. Splatting over that footprint closes
+    // the gaps between depth samples when the color camera has the higher resolution.
+    const uint32_t depthWidth = m_depthRays->GetWidth();
+    const float* rayX = m_depthRays->GetRayX();
+    const float* rayY = m_depthRays->GetRayY();
+    size_t center = size_t(m_depthRays->GetHeight() / 2) * depthWidth + depthWidth / 2;
+    float spacingX = std::fabs(rayX[center + 1] - rayX[center]);
+    float spacingY = std::fabs(rayY[center + depthWidth] - rayY[center]);
+    float footprint = (std::max)(spacingX * m_colorIntrinsics.focalLengthX, spacingY * m_colorIntrinsics.focalLengthY);
+
+    if (footprint > 1.0f)
+    {
+        m_splatRadius = (std::min)(static_cast<int>(std::ceil((footprint - 1.0f) * 0.5f)), maxSplatRadius);
+    }
+}
+
+void DepthRegistration::Register(const uint16_t* depth, size_t depthRowStride, float depthScale, float* colorDepth) const
+{
+    const int colorWidth = static_cast<int>(m_colorIntrinsics.imageWidth);
+    const int colorHeight = static_cast<int>(m_colorIntrinsics.imageHeight);
+    std::fill(colorDepth, colorDepth + size_t(colorWidth) * colorHeight, std::numeric_limits<float>::quiet_NaN());
+
+    if (!m_depthRays)
+    {
+        return;
+    }
+
+    const uint32_t depthWidth = m_depthRays->GetWidth();
+    const uint32_t depthHeight = m_depthRays->GetHeight();
+
+    const float* r = m_depthToColor.rotation;
+    const float* t = m_depthToColor.translation;
+    const int radius = m_splatRadius;
+
+    for (uint32_t y = 0; y < depthHeight; y++)
+    {
+        const uint16_t* depthRow = depth + y * depthRowStride;
+        const float* rayXRow = m_depthRays->GetRayX() + size_t(y) * depthWidth;
+        const float* rayYRow = m_depthRays->GetRayY() + size_t(y) * depthWidth;
+
+        for (uint32_t x = 0; x < depthWidth; x++)
+        {
+            if (depthRow[x] == 0)
+            {
+                continue;
+            }
+
+            // Point in depth camera space, then in color camera space.
+            float z = depthRow[x] * depthScale;
+            float px = rayXRow[x] * z;
+            float py = rayYRow[x] * z;
+
+            float cx = r[0] * px + r[1] * py + r[2] * z + t[0];
+            float cy = r[3] * px + r[4] * py + r[5] * z + t[1];
+            float cz = r[6] * px + r[7] * py + r[8] * z + t[2];
+            if (!(cz > 0.0f))
+            {
+                continue;
+            }
+
+            float pixelX, pixelY;
+            ProjectToPixel(m_colorIntrinsics, cx / cz, cy / cz, pixelX, pixelY);
+
+            // Reject points far outside the image before converting to int, which would overflow.
+            if (!(pixelX > -radius - 1.0f && pixelX < colorWidth + radius + 1.0f &&
+                  pixelY > -radius - 1.0f && pixelY < colorHeight + radius + 1.0f))
+            {
+                continue;
+            }
+
+            int centerX = static_cast<int>(std::floor(pixelX + 0.5f));
+            int centerY = static_cast<int>(std::floor(pixelY + 0.5f));
+            int left = (std::max)(centerX - radius, 0);
+            int right = (std::min)(centerX + radius, colorWidth - 1);
+            int top = (std::max)(centerY - radius, 0);
+            int bottom = (std::min)(centerY + radius, colorHeight - 1);
+
+            for (int v = top; v <= bottom; v++)
+            {
+                float* colorRow = colorDepth + size_t(v) * colorWidth;
+                for (int u = left; u <= right; u++)
+                {
+                    // Keep the nearest surface. NaN marks a color pixel nothing has landed on yet, and fails the comparison.
+                    if (!(colorRow[u] <= cz))
+                    {
+                        colorRow[u] = cz;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "RayTable.h"
+
+namespace SDKTemplate
+{
+    // Rigid transform between two camera spaces, both with +x right, +y down and +z forward.
+    // A point p maps to rotation * p + translation; rotation is stored row-major.
+    struct RigidTransform
+    {
+        float rotation[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+        float translation[3] = { 0.0f, 0.0f, 0.0f };
+    };
+
+    // Maps a depth image into the color camera by forward-projecting every depth pixel, instead of
+    // unprojecting every color pixel. Each depth pixel is splatted over the color pixels its footprint
+    // covers, and a z-buffer keeps the nearest surface where several depth pixels land on the same color pixel.
+    // Only standard C++ is used, so the engine can be exercised off-device with synthetic cameras.
+    class DepthRegistration
+    {
+    public:
+        /// <summary>
+        /// Sets the rays of the depth camera. Depth cameras report their rays directly
+        /// (CameraIntrinsics::UnprojectPixelsAtUnitDepth), so the table can come from the platform
+        /// instead of inverting the depth lens model here.
+        /// </summary>
+        void SetDepthRays(std::shared_ptr<const RayTable> depthRays);
+
+        /// <summary>
+        /// Sets the color camera that depth is registered to. The registered image has its resolution.
+        /// </summary>
+        void SetColorIntrinsics(const PinholeIntrinsics& intrinsics);
+
+        /// <summary>
+        /// Sets the transform from depth camera space to color camera space.
+        /// </summary>
+        void SetDepthToColorTransform(const RigidTransform& transform);
+
+        const std::shared_ptr<const RayTable>& GetDepthRays() const { return m_depthRays; }
+        uint32_t GetColorWidth() const { return m_colorIntrinsics.imageWidth; }
+        uint32_t GetColorHeight() const { return m_colorIntrinsics.imageHeight; }
+
+        /// <summary>
+        /// Half-width, in color pixels, of the square each depth pixel is splatted over.
+        /// </summary>
+        int GetSplatRadius() const { return m_splatRadius; }
+
+        /// <summary>
+        /// Fills colorDepth, which holds GetColorWidth() * GetColorHeight() floats, with the depth in meters
+        /// seen by every color pixel, or NaN where no depth pixel lands, as the coordinate mapper reports it, so that
+        /// both backends fade such pixels to black. depth holds raw 16 bit samples with
+        /// depthRowStride samples per row; a raw value of 0 is invalid and depthScale converts the rest to meters.
+        /// </summary>
+        void Register(const uint16_t* depth, size_t depthRowStride, float depthScale, float* colorDepth) const;
+
+    private:
+        void UpdateSplatRadius();
+
+        std::shared_ptr<const RayTable> m_depthRays;
+
+        PinholeIntrinsics m_colorIntrinsics;
+        RigidTransform m_depthToColor;
+        int m_splatRadius = 0;
+    };
+} // SDKTemplate
@@ -0,0 +1,146 @@
+#include "DepthUpsampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace SDKTemplate;
+
+// Largest scale the weight tables are sized for.
+static constexpr uint32_t maxScale = 8;
+
+// Smallest color weight. Keeps a pixel whose color matches none of its neighbors' from losing all of its
+// weight to float underflow, in which case it falls back to a distance-weighted average.
+static constexpr float minColorWeight = 1e-4f;
+
+// Written where no valid sample is near, as the correlation backends do for pixels without depth.
+static constexpr float missingDepth = std::numeric_limits<float>::quiet_NaN();
+
+static inline bool IsValidDepth(float depth)
+{
+    return depth > 0.0f;
+}
+
+void SDKTemplate::UpsampleDepthNearestValid(const LowResolutionDepth& source, float* target, uint32_t width, uint32_t rowBegin, uint32_t rowEnd)
+{
+    const int scale = static_cast<int>(source.scale);
+    const int sourceWidth = static_cast<int>(source.width);
+    const int sourceHeight = static_cast<int>(source.height);
+
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+        float* targetRow = target + size_t(y) * width;
+        const int sourceY = static_cast<int>(y) / scale;
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const int sourceX = static_cast<int>(x) / scale;
+            float depth = source.depth[size_t(sourceY) * sourceWidth + sourceX];
+
+            // The own block's sample is always the nearest one; only look around when it is invalid.
+            if (!IsValidDepth(depth))
+            {
+                depth = missingDepth;
+                int bestDistance = INT32_MAX;
+                for (int ny = (std::max)(sourceY - 1, 0); ny <= (std::min)(sourceY + 1, sourceHeight - 1); ny++)
+                {
+                    for (int nx = (std::max)(sourceX - 1, 0); nx <= (std::min)(sourceX + 1, sourceWidth - 1); nx++)
+                    {
+                        float candidate = source.depth[size_t(ny) * sourceWidth + nx];
+                        if (!IsValidDepth(candidate))
+                        {
+                            continue;
+                        }
+
+                        // Distance from the target pixel to the block center, in half target pixels.
+                        int dx = 2 * nx * scale + scale - 1 - 2 * static_cast<int>(x);
+                        int dy = 2 * ny * scale + scale - 1 - 2 * static_cast<int>(y);
+                        int distance = dx * dx + dy * dy;
+                        if (distance < bestDistance)
+                        {
+                            bestDistance = distance;
+                            depth = candidate;
+                        }
+                    }
+                }
+            }
+
+            targetRow[x] = depth;
+        }
+    }
+}
+
+JointBilateralWeights::JointBilateralWeights(uint32_t scale, float colorSigma) :
+    m_scale((std::min)((std::max)(scale, 1u), maxScale)),
+    m_colorSigma(colorSigma),
+    m_spatialOffset(static_cast<int>(maxScale * 8))
+{
+    // Offsets from a target pixel to the centers of the 3x3 surrounding blocks stay within two blocks,
+    // which is 4 * scale half pixels; the table covers the largest scale.
+    const float spatialSigma = static_cast<float>(m_scale) * 2.0f;
+    for (int i = 0; i < static_cast<int>(sizeof(m_spatial) / sizeof(m_spatial[0])); i++)
+    {
+        float offset = static_cast<float>(i - m_spatialOffset);
+        m_spatial[i] = std::exp(-0.5f * (offset * offset) / (spatialSigma * spatialSigma));
+    }
+
+    for (uint32_t difference = 0; difference < sizeof(m_color) / sizeof(m_color[0]); difference++)
+    {
+        float normalized = static_cast<float>(difference) / colorSigma;
+        m_color[difference] = (std::max)(std::exp(-0.5f * normalized * normalized), minColorWeight);
+    }
+}
+
+void SDKTemplate::UpsampleDepthJointBilateral(const LowResolutionDepth& source, const uint8_t* guideBgra, size_t guideStride,
+    const JointBilateralWeights& weights, float* target, uint32_t width, uint32_t height, uint32_t rowBegin, uint32_t rowEnd)
+{
+    const int scale = static_cast<int>(source.scale);
+    const int sourceWidth = static_cast<int>(source.width);
+    const int sourceHeight = static_cast<int>(source.height);
+
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+        float* targetRow = target + size_t(y) * width;
+        const uint8_t* guideRow = guideBgra + y * guideStride;
+        const int sourceY = static_cast<int>(y) / scale;
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const int sourceX = static_cast<int>(x) / scale;
+            const uint8_t* color = guideRow + x * 4;
+
+            float weightedDepth = 0.0f;
+            float totalWeight = 0.0f;
+
+            for (int ny = (std::max)(sourceY - 1, 0); ny <= (std::min)(sourceY + 1, sourceHeight - 1); ny++)
+            {
+                // Guide pixel at the center of the neighboring block.
+                const uint32_t centerY = (std::min)(static_cast<uint32_t>(ny * scale + scale / 2), height - 1);
+                const float spatialY = weights.Spatial(2 * ny * scale + scale - 1 - 2 * static_cast<int>(y));
+                const float* sourceRow = source.depth + size_t(ny) * sourceWidth;
+
+                for (int nx = (std::max)(sourceX - 1, 0); nx <= (std::min)(sourceX + 1, sourceWidth - 1); nx++)
+                {
+                    float depth = sourceRow[nx];
+                    if (!IsValidDepth(depth))
+                    {
+                        continue;
+                    }
+
+                    const uint32_t centerX = (std::min)(static_cast<uint32_t>(nx * scale + scale / 2), width - 1);
+                    const uint8_t* centerColor = guideBgra + centerY * guideStride + centerX * 4;
+                    uint32_t difference =
+                        static_cast<uint32_t>(std::abs(color[0] - centerColor[0])) +
+                        static_cast<uint32_t>(std::abs(color[1] - centerColor[1])) +
+                        static_cast<uint32_t>(std::abs(color[2] - centerColor[2]));
+
+                    float weight = spatialY * weights.Spatial(2 * nx * scale + scale - 1 - 2 * static_cast<int>(x)) * weights.Color(difference);
+                    weightedDepth += weight * depth;
+                    totalWeight += weight;
+                }
+            }
+
+            targetRow[x] = (totalWeight > 0.0f) ? weightedDepth / totalWeight : missingDepth;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace SDKTemplate
+{
+    // A depth image computed at 1/scale of a target resolution. Low resolution pixel (x, y) stands for the
+    // scale x scale block of target pixels starting at (x * scale, y * scale). Depths that are not
+    // greater than 0, including NaN, are invalid.
+    struct LowResolutionDepth
+    {
+        const float* depth;
+        uint32_t width;
+        uint32_t height;
+        uint32_t scale;
+    };
+
+    /// <summary>
+    /// Returns the size of one dimension of a target image of size fullSize computed at 1/scale.
+    /// </summary>
+    inline uint32_t ReducedSize(uint32_t fullSize, uint32_t scale)
+    {
+        return (fullSize + scale - 1) / scale;
+    }
+
+    /// <summary>
+    /// Fills rows [rowBegin, rowEnd) of a width-wide target depth image by taking the nearest valid
+    /// low resolution sample within one block, or NaN if there is none.
+    /// Row ranges are independent, so callers can split the image across threads.
+    /// </summary>
+    void UpsampleDepthNearestValid(const LowResolutionDepth& source, float* target, uint32_t width, uint32_t rowBegin, uint32_t rowEnd);
+
+    // Weights for the joint bilateral filter. Build once per scale and reuse across frames.
+    class JointBilateralWeights
+    {
+    public:
+        /// <summary>
+        /// colorSigma is the standard deviation, in summed absolute B, G and R difference, of the color term.
+        /// The spatial term has a standard deviation of one low resolution pixel.
+        /// </summary>
+        JointBilateralWeights(uint32_t scale, float colorSigma);
+
+        uint32_t GetScale() const { return m_scale; }
+        float GetColorSigma() const { return m_colorSigma; }
+
+        // Spatial weight for an offset given in half target pixels.
+        float Spatial(int doubledOffset) const { return m_spatial[doubledOffset + m_spatialOffset]; }
+
+        // Color weight for a summed absolute B, G and R difference in [0, 765].
+        float Color(uint32_t difference) const { return m_color[difference]; }
+
+    private:
+        uint32_t m_scale;
+        float m_colorSigma;
+        int m_spatialOffset;
+        float m_spatial[8 * 8 * 2 + 1];
+        float m_color[3 * 255 + 1];
+    };
+
+    /// <summary>
+    /// Fills rows [rowBegin, rowEnd) of a width-wide target depth image with a joint bilateral upsampling
+    /// of source, guided by a BGRA image at the target resolution with guideStride bytes per row.
+    /// Each target pixel averages the valid samples of the surrounding 3x3 low resolution pixels, weighted
+    /// by distance and by how closely the guide color at the sample matches its own, so depth edges follow
+    /// color edges instead of block boundaries. Pixels with no valid sample get NaN.
+    /// </summary>
+    void UpsampleDepthJointBilateral(const LowResolutionDepth& source, const uint8_t* guideBgra, size_t guideStride,
+        const JointBilateralWeights& weights, float* target, uint32_t width, uint32_t height, uint32_t rowBegin, uint32_t rowEnd);
+} // SDKTemplate
@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "FrameMailbox.h"
+
+using namespace SDKTemplate;
+
+using namespace Windows::Media::Capture::Frames;
+
+// Turns a reference to a frame into a raw pointer owning one reference, for the slots to hold.
+static IInspectable* DetachFrame(MediaFrameReference^ frame)
+{
+    IInspectable* rawFrame = reinterpret_cast<IInspectable*>(frame);
+    rawFrame->AddRef();
+    return rawFrame;
+}
+
+// Takes over the reference a raw pointer from the slots owns.
+static MediaFrameReference^ AttachFrame(IInspectable* rawFrame)
+{
+    MediaFrameReference^ frame = nullptr;
+    *reinterpret_cast<void**>(&frame) = rawFrame;
+    return frame;
+}
+
+FrameMailbox::FrameMailbox()
+{
+}
+
+FrameMailbox::~FrameMailbox()
+{
+    Clear();
+}
+
+bool FrameMailbox::Post(MediaFrameReference^ frame)
+{
+    IInspectable* previous = m_slots.Post(GetSlot(frame->SourceKind), DetachFrame(frame));
+    if (previous != nullptr)
+    {
+        previous->Release();
+        return false;
+    }
+    return true;
+}
+
+UINT32 FrameMailbox::GetReadySources() const
+{
+    return m_slots.GetReadySlots();
+}
+
+bool FrameMailbox::TryBeginConsume()
+{
+    return m_slots.TryBeginConsume();
+}
+
+UINT32 FrameMailbox::TakeReady(MediaFrameReference^ (&frames)[SlotCount])
+{
+    IInspectable* rawFrames[SlotCount];
+    UINT32 ready = m_slots.TakeReady(rawFrames);
+    for (size_t slot = 0; slot < SlotCount; slot++)
+    {
+        frames[slot] = (rawFrames[slot] != nullptr) ? AttachFrame(rawFrames[slot]) : nullptr;
+    }
+    return ready;
+}
+
+bool FrameMailbox::EndConsume()
+{
+    return m_slots.EndConsume();
+}
+
+void FrameMailbox::Clear()
+{
+    IInspectable* rawFrames[SlotCount];
+    m_slots.TakeAll(rawFrames);
+    for (IInspectable* rawFrame : rawFrames)
+    {
+        if (rawFrame != nullptr)
+        {
+            rawFrame->Release();
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "SlotMailbox.h"
+
+namespace SDKTemplate
+{
+    // Hands the frames of several readers from their FrameArrived callbacks to a single consumer
+    // without the callbacks blocking one another.
+    // Each source kind owns a slot of a SlotMailbox holding its newest frame that hasn't been taken yet.
+    // A callback that posts a frame tries to become the consumer; if another callback already is,
+    // it returns and the consumer picks the frame up.
+    class FrameMailbox
+    {
+    public:
+        // One slot per MediaFrameSourceKind value.
+        static const size_t SlotCount = 4;
+
+        static size_t GetSlot(Windows::Media::Capture::Frames::MediaFrameSourceKind kind)
+        {
+            return static_cast<size_t>(kind);
+        }
+
+        static UINT32 GetSourceBit(Windows::Media::Capture::Frames::MediaFrameSourceKind kind)
+        {
+            return 1u << static_cast<UINT32>(kind);
+        }
+
+        FrameMailbox();
+        ~FrameMailbox();
+
+        FrameMailbox(const FrameMailbox&) = delete;
+        FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+        /// <summary>
+        /// Stores a frame in the slot of its source kind and marks the slot ready.
+        /// Returns false when this replaced a frame that was never taken.
+        /// </summary>
+        bool Post(Windows::Media::Capture::Frames::MediaFrameReference^ frame);
+
+        /// <summary>
+        /// Bit mask of the slots holding a frame, indexed like GetSourceBit.
+        /// </summary>
+        UINT32 GetReadySources() const;
+
+        /// <summary>
+        /// Makes the calling thread the consumer, unless another thread already is.
+        /// </summary>
+        bool TryBeginConsume();
+
+        /// <summary>
+        /// Moves the frame of every ready slot into frames and returns their mask. Only the consumer calls this.
+        /// </summary>
+        UINT32 TakeReady(Windows::Media::Capture::Frames::MediaFrameReference^ (&frames)[SlotCount]);
+
+        /// <summary>
+        /// Gives up the consumer role. Returns true, with the caller the consumer again, when frames were
+        /// posted that the consumer may have missed; the caller then takes them and calls EndConsume again.
+        /// </summary>
+        bool EndConsume();
+
+        /// <summary>
+        /// Drops the frames waiting in every slot. Safe to call from any thread.
+        /// </summary>
+        void Clear();
+
+        UINT64 GetOverwrittenCount() const { return m_slots.GetOverwrittenCount(); }
+
+    private:
+        // The slots own a reference to every frame they hold.
+        SlotMailbox<IInspectable, SlotCount> m_slots;
+    };
+} // SDKTemplate
@@ -0,0 +1,422 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // Bounded lock-free FIFO for exactly one producer thread and one consumer thread.
+    // The capacity is rounded up to a power of two.
+    template<typename T>
+    class SpscRing
+    {
+    public:
+        explicit SpscRing(size_t capacity) : m_slots(RoundUpToPowerOfTwo(capacity)), m_mask(m_slots.size() - 1)
+        {
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        /// <summary>
+        /// Moves item into the ring. Returns false and leaves item alone if the ring is full. Producer only.
+        /// </summary>
+        bool TryPush(T& item)
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cachedHead == m_slots.size())
+            {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                if (tail - m_cachedHead == m_slots.size())
+                {
+                    return false;
+                }
+            }
+
+            m_slots[tail & m_mask] = std::move(item);
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// <summary>
+        /// Moves the oldest item out of the ring. Returns false if the ring is empty. Consumer only.
+        /// </summary>
+        bool TryPop(T& item)
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cachedTail)
+            {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cachedTail)
+                {
+                    return false;
+                }
+            }
+
+            // Leave an empty value behind, so the ring doesn't keep the item's resources alive.
+            item = std::move(m_slots[head & m_mask]);
+            m_slots[head & m_mask] = T();
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Number of items in the ring. Exact only when called by the producer or the consumer while the other is idle.
+        size_t GetDepth() const
+        {
+            size_t head = m_head.load(std::memory_order_acquire);
+            return m_tail.load(std::memory_order_acquire) - head;
+        }
+
+        size_t GetCapacity() const { return m_slots.size(); }
+        bool IsEmpty() const { return GetDepth() == 0; }
+        bool IsFull() const { return GetDepth() >= m_slots.size(); }
+
+    private:
+        static size_t RoundUpToPowerOfTwo(size_t value)
+        {
+            size_t result = 1;
+            while (result < value)
+            {
+                result <<= 1;
+            }
+            return result;
+        }
+
+        std::vector<T> m_slots;
+        const size_t m_mask;
+
+        // The consumer's and the producer's indices live on separate cache lines, each next to
+        // the copy of the other index that its owner caches to avoid reading the shared one.
+        char m_padding0[64];
+        std::atomic<size_t> m_head{ 0 };
+        size_t m_cachedTail = 0;
+        char m_padding1[64];
+        std::atomic<size_t> m_tail{ 0 };
+        size_t m_cachedHead = 0;
+        char m_padding2[64];
+    };
+
+    // Timing and flow counters of one pipeline stage.
+    struct PipelineStageStatistics
+    {
+        std::string name;
+        uint64_t processed = 0; // Items the stage ran on.
+        uint64_t discarded = 0; // Items the stage decided not to pass on.
+        uint64_t stalls = 0; // Times the stage waited for room in the next stage's queue.
+        uint64_t poolWaits = 0; // Times the stage found a ThreadPool busy with another caller's job.
+        double poolWaitMilliseconds = 0.0; // Time the stage spent waiting for those jobs.
+        size_t queueDepth = 0; // Items waiting for the stage.
+        double lastMilliseconds = 0.0; // Time the stage spent on its most recent item.
+        double averageMilliseconds = 0.0;
+        double maxMilliseconds = 0.0;
+    };
+
+    // What Submit does when the first stage's queue is full.
+    enum class PipelineOverflow
+    {
+        Wait, // Block until the first stage makes room, which lets a slow stage hold back the producer.
+        Drop, // Discard the submitted item.
+    };
+
+    // A chain of stages that each run on their own thread, so consecutive items overlap: while one stage
+    // works on an item, the previous stage already works on the next one.
+    // Stages are connected by bounded SpscRings. A stage whose successor's ring is full waits for it to
+    // drain, so a slow stage slows down everything before it instead of piling up work.
+    // Stages that spread their work on a shared ThreadPool take turns on it; the time a stage waits for
+    // another stage's job is reported in its poolWaits counters.
+    // Item is a movable type, typically a unique_ptr to a per-frame context that stages fill in turn.
+    template<typename Item>
+    class FramePipeline
+    {
+    public:
+        // Processes an item in place. Returning false discards the item instead of passing it on.
+        typedef std::function<bool(Item&)> StageFunction;
+
+        /// <summary>
+        /// Creates an empty pipeline whose stages each queue up to queueCapacity items.
+        /// </summary>
+        FramePipeline(size_t queueCapacity, PipelineOverflow overflow) :
+            m_queueCapacity(queueCapacity > 0 ? queueCapacity : 1),
+            m_overflow(overflow)
+        {
+        }
+
+        ~FramePipeline()
+        {
+            Stop();
+        }
+
+        FramePipeline(const FramePipeline&) = delete;
+        FramePipeline& operator=(const FramePipeline&) = delete;
+
+        /// <summary>
+        /// Appends a stage. Stages can only be added before Start.
+        /// </summary>
+        void AddStage(std::string name, StageFunction function)
+        {
+            std::unique_ptr<Stage> stage = std::make_unique<Stage>(m_queueCapacity);
+            stage->name = std::move(name);
+            stage->function = std::move(function);
+            m_stages.push_back(std::move(stage));
+        }
+
+        /// <summary>
+        /// Starts one thread per stage.
+        /// </summary>
+        void Start()
+        {
+            for (size_t index = 0; index < m_stages.size(); index++)
+            {
+                m_stages[index]->thread = std::thread(&FramePipeline::RunStage, this, index);
+            }
+        }
+
+        /// <summary>
+        /// Stops the stage threads after the items they are working on. Items still queued are destroyed.
+        /// </summary>
+        void Stop()
+        {
+            // Not under m_submitMutex: a waiting Submit holds it until it sees m_stopping.
+            m_stopping = true;
+
+            for (std::unique_ptr<Stage>& stage : m_stages)
+            {
+                stage->signal.NotifyAll();
+            }
+
+            for (std::unique_ptr<Stage>& stage : m_stages)
+            {
+                if (stage->thread.joinable())
+                {
+                    stage->thread.join();
+                }
+
+                Item item;
+                while (stage->input.TryPop(item))
+                {
+                    item = Item();
+                }
+            }
+        }
+
+        /// <summary>
+        /// Hands an item to the first stage. Returns false if the item was dropped because the first stage's
+        /// queue is full and the overflow policy is Drop, or because the pipeline is stopped.
+        /// Callers on different threads are serialized.
+        /// </summary>
+        bool Submit(Item item)
+        {
+            std::lock_guard<std::mutex> lock(m_submitMutex);
+
+            if (m_stages.empty() || m_stopping)
+            {
+                m_dropped++;
+                return false;
+            }
+
+            Stage& first = *m_stages.front();
+            if (!first.input.TryPush(item))
+            {
+                if (m_overflow == PipelineOverflow::Drop)
+                {
+                    m_dropped++;
+                    return false;
+                }
+
+                first.signal.Wait([this, &first]() { return m_stopping || !first.input.IsFull(); });
+                if (m_stopping || !first.input.TryPush(item))
+                {
+                    m_dropped++;
+                    return false;
+                }
+            }
+
+            first.signal.Notify();
+            return true;
+        }
+
+        /// <summary>
+        /// Items Submit turned away.
+        /// </summary>
+        uint64_t GetDroppedCount() const { return m_dropped; }
+
+        /// <summary>
+        /// Returns the counters of every stage, in pipeline order. Safe to call from any thread.
+        /// </summary>
+        std::vector<PipelineStageStatistics> GetStatistics() const
+        {
+            std::vector<PipelineStageStatistics> statistics;
+            statistics.reserve(m_stages.size());
+            for (const std::unique_ptr<Stage>& stage : m_stages)
+            {
+                PipelineStageStatistics stageStatistics;
+                stageStatistics.name = stage->name;
+                stageStatistics.processed = stage->processed;
+                stageStatistics.discarded = stage->discarded;
+                stageStatistics.stalls = stage->stalls;
+                stageStatistics.queueDepth = stage->input.GetDepth();
+                {
+                    std::lock_guard<std::mutex> lock(stage->timingMutex);
+                    stageStatistics.poolWaits = stage->poolWaits.count;
+                    stageStatistics.poolWaitMilliseconds = stage->poolWaits.milliseconds;
+                    stageStatistics.lastMilliseconds = stage->lastMilliseconds;
+                    stageStatistics.maxMilliseconds = stage->maxMilliseconds;
+                    stageStatistics.averageMilliseconds =
+                        (stageStatistics.processed > 0) ? stage->totalMilliseconds / stageStatistics.processed : 0.0;
+                }
+                statistics.push_back(std::move(stageStatistics));
+            }
+            return statistics;
+        }
+
+    private:
+        // Lets a thread sleep until a condition on a ring holds, without the other side paying for a lock
+        // when nobody sleeps.
+        class Signal
+        {
+        public:
+            template<typename Predicate>
+            void Wait(Predicate predicate)
+            {
+                if (predicate())
+                {
+                    return;
+                }
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_sleepers++;
+                // Pairs with the fence in Notify: either the notifier sees the sleeper, or the sleeper sees the change.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                m_condition.wait(lock, predicate);
+                m_sleepers--;
+            }
+
+            void Notify()
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (m_sleepers.load(std::memory_order_relaxed) > 0)
+                {
+                    NotifyAll();
+                }
+            }
+
+            void NotifyAll()
+            {
+                // Taking the lock orders this after a sleeper's predicate check.
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                }
+                m_condition.notify_all();
+            }
+
+        private:
+            std::mutex m_mutex;
+            std::condition_variable m_condition;
+            std::atomic<int> m_sleepers{ 0 };
+        };
+
+        struct Stage
+        {
+            explicit Stage(size_t queueCapacity) : input(queueCapacity)
+            {
+            }
+
+            std::string name;
+            StageFunction function;
+            std::thread thread;
+
+            // Items waiting for this stage, and the signal both its producer and its thread sleep on.
+            SpscRing<Item> input;
+            Signal signal;
+
+            std::atomic<uint64_t> processed{ 0 };
+            std::atomic<uint64_t> discarded{ 0 };
+            std::atomic<uint64_t> stalls{ 0 };
+
+            mutable std::mutex timingMutex;
+            double lastMilliseconds = 0.0;
+            double totalMilliseconds = 0.0;
+            double maxMilliseconds = 0.0;
+            ThreadPoolWaits poolWaits;
+        };
+
+        void RunStage(size_t index)
+        {
+            Stage& stage = *m_stages[index];
+            Stage* next = (index + 1 < m_stages.size()) ? m_stages[index + 1].get() : nullptr;
+
+            Item item;
+            for (;;)
+            {
+                stage.signal.Wait([this, &stage]() { return m_stopping || !stage.input.IsEmpty(); });
+                if (m_stopping || !stage.input.TryPop(item))
+                {
+                    return;
+                }
+
+                // The producer may be waiting for the room just made.
+                stage.signal.Notify();
+
+                auto start = std::chrono::steady_clock::now();
+                bool passOn = stage.function(item);
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                // The stage thread only runs this stage, so its pool waits are the stage's.
+                ThreadPoolWaits poolWaits = ThreadPool::GetCallerWaits();
+
+                stage.processed++;
+                {
+                    std::lock_guard<std::mutex> lock(stage.timingMutex);
+                    stage.poolWaits = poolWaits;
+                    stage.lastMilliseconds = milliseconds;
+                    stage.totalMilliseconds += milliseconds;
+                    stage.maxMilliseconds = (std::max)(stage.maxMilliseconds, milliseconds);
+                }
+
+                if (!passOn)
+                {
+                    stage.discarded++;
+                }
+                else if (next != nullptr)
+                {
+                    // Backpressure: wait for the next stage rather than dropping work it already has.
+                    if (!next->input.TryPush(item))
+                    {
+                        stage.stalls++;
+                        next->signal.Wait([this, next]() { return m_stopping || !next->input.IsFull(); });
+                        if (m_stopping || !next->input.TryPush(item))
+                        {
+                            return;
+                        }
+                    }
+                    next->signal.Notify();
+                }
+
+                item = Item();
+            }
+        }
+
+        const size_t m_queueCapacity;
+        const PipelineOverflow m_overflow;
+
+        std::vector<std::unique_ptr<Stage>> m_stages;
+
+        // Serializes producers, since each ring has a single producer.
+        std::mutex m_submitMutex;
+        std::atomic<bool> m_stopping{ false };
+        std::atomic<uint64_t> m_dropped{ 0 };
+    };
+} // SDKTemplate
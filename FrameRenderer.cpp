@@ -10,9 +10,15 @@
 //*********************************************************
 
 #include "pch.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <limits>
 #include <MemoryBuffer.h>
 #include "FrameRenderer.h"
+#include "InterlockedRefPointer.h"
+#include "PseudoColorKernels.h"
 
 using namespace SDKTemplate;
 
@@ -30,18 +36,6 @@ using namespace Windows::UI::Xaml::Media::Imaging;
 
 #pragma region Low-level operations on reference pointers
 
-// InterlockedExchange for reference pointer types.
-template<typename T, typename U>
-T^ InterlockedExchangeRefPointer(T^* target, U value)
-{
-    static_assert(sizeof(T^) == sizeof(void*), "InterlockedExchangePointer is the wrong size");
-    T^ exchange = value;
-    void** rawExchange = reinterpret_cast<void**>(&exchange);
-    void** rawTarget = reinterpret_cast<void**>(target);
-    *rawExchange = static_cast<IInspectable*>(InterlockedExchangePointer(rawTarget, *rawExchange));
-    return exchange;
-}
-
 // Convert a reference pointer to a specific ComPtr.
 template<typename T>
 Microsoft::WRL::ComPtr<T> AsComPtr(Platform::Object^ object)
@@ -53,133 +47,148 @@ Microsoft::WRL::ComPtr<T> AsComPtr(Platform::Object^ object)
 
 #pragma endregion
 
-// Structure used to access colors stored in 8-bit BGRA format.
-struct ColorBGRA
-{
-	byte B, G, R, A;
-};
-
-// Colors to map values to based on intensity.
-static constexpr std::array<ColorBGRA, 9> colorRamp = {
-	ColorBGRA{ 0xFF, 0x7F, 0x00, 0x00 },
-	ColorBGRA{ 0xFF, 0xFF, 0x00, 0x00 },
-	ColorBGRA{ 0xFF, 0xFF, 0x7F, 0x00 },
-	ColorBGRA{ 0xFF, 0xFF, 0xFF, 0x00 },
-	ColorBGRA{ 0xFF, 0x7F, 0xFF, 0x7F },
-	ColorBGRA{ 0xFF, 0x00, 0xFF, 0xFF },
-	ColorBGRA{ 0xFF, 0x00, 0x7F, 0xFF },
-	ColorBGRA{ 0xFF, 0x00, 0x00, 0xFF },
-	ColorBGRA{ 0xFF, 0x00, 0x00, 0x7F }
-};
-
-static ColorBGRA ColorRampInterpolation(float value)
-{
-	static_assert(colorRamp.size() >= 2, "colorRamp table is too small");
-
-	// Map value to surrounding indexes on the color ramp.
-	size_t rampSteps = colorRamp.size() - 1;
-	float scaled = value * rampSteps;
-	int integer = static_cast<int>(scaled);
-	int index = min(static_cast<size_t>(max(0, integer)), rampSteps - 1);
-	const ColorBGRA& prev = colorRamp[index];
-	const ColorBGRA& next = colorRamp[index + 1];
-
-	// Set color based on a ratio of how closely it matches the surrounding colors.
-	UINT32 alpha = static_cast<UINT32>((scaled - integer) * 255);
-	UINT32 beta = 255 - alpha;
-	return {
-		static_cast<byte>((prev.A * beta + next.A * alpha) / 255), // Alpha
-		static_cast<byte>((prev.R * beta + next.R * alpha) / 255), // Red
-		static_cast<byte>((prev.G * beta + next.G * alpha) / 255), // Green
-		static_cast<byte>((prev.B * beta + next.B * alpha) / 255)  // Blue
-	};
-}
+// Target size of the input and output rows processed together by one TransformBitmap task.
+static constexpr size_t transformBandBytes = 64 * 1024;
 
-// Initializes pseudo-color look up table for depth pixels
-static ColorBGRA GeneratePseudoColorLookupTable(UINT32 index, UINT32 size)
+// Pool shared by all renderers, so that several preview images don't each start their own threads.
+// Its jobs run one at a time; pipeline stages that find it busy count the wait in their statistics.
+static std::shared_ptr<ThreadPool> GetDefaultThreadPool()
 {
-	return ColorRampInterpolation(static_cast<float>(index) / static_cast<float>(size));
+    static std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>(
+        max(1u, std::thread::hardware_concurrency()) - 1);
+    return threadPool;
 }
 
-// Initializes the pseudo-color look up table for infrared pixels
-static ColorBGRA GenerateInfraredRampLookupTable(UINT32 index, UINT32 size)
-{
-	const float value = static_cast<float>(index) / static_cast<float>(size);
+// Stages of the render pipeline: Convert, Correlate, Reconstruct, Analyze and Present.
+static constexpr size_t renderStageCount = 5;
 
-	// Adjust to increase color change between lower values in infrared images.
-	const float alpha = powf(1 - value, 12);
+// Frames that can wait in front of each stage. With one, a stage always has its next frame ready
+// without letting latency build up.
+static constexpr size_t renderStageQueueCapacity = 1;
 
-	return ColorRampInterpolation(alpha);
-}
+// Output bitmaps kept per renderer: one for each stage after Convert has filled it,
+// one waiting in the back buffer and one being presented.
+static constexpr size_t outputBitmapPoolSize = renderStageCount + 2;
+
+// Idle render jobs kept for reuse: enough for one in every stage and every queue.
+static constexpr size_t renderJobPoolSize = renderStageCount * (renderStageQueueCapacity + 1);
 
-static LookupTable<ColorBGRA, 1024> colorLookupTable(GeneratePseudoColorLookupTable);
-static LookupTable<ColorBGRA, 1024> infraredLookupTable(GenerateInfraredRampLookupTable);
+// At reduced correlation resolution, every this many frames also correlate at full resolution for comparison.
+static constexpr UINT64 correlationComparisonInterval = 30;
 
+// Standard deviation of the color term of the joint bilateral upsampling, in summed B, G and R levels.
+static constexpr float jointBilateralColorSigma = 30.0f;
 
-static ColorBGRA PseudoColor(float value)
+// Rows of the color image upsampled by one task.
+static constexpr UINT32 upsampleBandRows = 32;
+
+// With change detection on, point cloud colors are projected again for one row of tiles in this many every
+// frame, changed or not, so that color changes the depth doesn't see reach every point within as many frames.
+static constexpr UINT32 colorRefreshInterval = 8;
+
+// Compares a depth field against a reference of the same size. Returns the mean absolute difference
+// over pixels where both have depth, and the fraction of pixels where only one of them does.
+static void CompareDepthFields(const std::vector<float>& depth, const std::vector<float>& reference, double& meanDepthError, double& coverageMismatch)
 {
-	return colorLookupTable.GetValue(value);
+    double errorSum = 0.0;
+    size_t bothValid = 0;
+    size_t mismatched = 0;
+    for (size_t i = 0; i < depth.size(); i++)
+    {
+        bool valid = depth[i] > 0.0f;
+        bool referenceValid = reference[i] > 0.0f;
+        if (valid && referenceValid)
+        {
+            errorSum += std::fabs(depth[i] - reference[i]);
+            bothValid++;
+        }
+        else if (valid != referenceValid)
+        {
+            mismatched++;
+        }
+    }
+
+    meanDepthError = (bothValid > 0) ? errorSum / bothValid : 0.0;
+    coverageMismatch = depth.empty() ? 0.0 : static_cast<double>(mismatched) / depth.size();
 }
 
-static ColorBGRA InfraredColor(float value)
+// Calls apply(y, x, count) for every run of count pixels, starting at (x, y), of rows [rowBegin, rowEnd) that lies
+// outside region.
+template<typename RunFunction>
+static void ForEachRunOutsideRegion(const RowSpans& region, UINT32 rowBegin, UINT32 rowEnd, RunFunction apply)
 {
-	return infraredLookupTable.GetValue(value);
+    const UINT32 width = region.GetWidth();
+    for (UINT32 y = rowBegin; y < rowEnd; y++)
+    {
+        const RowSpan* spans = region.GetSpans(y);
+        const size_t spanCount = region.GetSpanCount(y);
+        UINT32 x = 0;
+        for (size_t i = 0; i < spanCount; i++)
+        {
+            if (spans[i].begin > x)
+            {
+                apply(y, x, spans[i].begin - x);
+            }
+            x = spans[i].end;
+        }
+        if (x < width)
+        {
+            apply(y, x, width - x);
+        }
+    }
 }
 
-// Maps each pixel in a scanline from a 16 bit depth value to a pseudo-color pixel.
-static void PseudoColorForDepth(int pixelWidth, byte* inputRowBytes, byte* outputRowBytes, float depthScale)
+// Sets the depth outside region of a field with region's size to NaN, which marks it invalid like the pixels
+// that correlation and upsampling find no depth for.
+static void ClearDepthOutsideRegion(const RowSpans& region, float* depth)
 {
-	// Visualize space in front of your desktop, in meters.
-	constexpr float min = 0.5f;   // 0.5 meters
-	constexpr float max = 4.0f;  // 4 meters
-	constexpr float one_min = 1.0f / min;
-	constexpr float range = 1.0f / max - one_min;
-
-	UINT16* inputRow = reinterpret_cast<UINT16*>(inputRowBytes);
-	ColorBGRA* outputRow = reinterpret_cast<ColorBGRA*>(outputRowBytes);
-	for (int x = 0; x < pixelWidth; x++)
-	{
-		float depth = static_cast<float>(inputRow[x]) * depthScale;
-
-		// Map invalid depth values to transparent pixels.
-		// This happens when depth information cannot be calculated, e.g. when objects are too close.
-		if (depth == 0)
-		{
-			outputRow[x] = { 0 };
-		}
-		else
-		{
-			float alpha = (1.0f / depth - one_min) / range;
-			outputRow[x] = PseudoColor(alpha * alpha);
-		}
-	}
+    const float invalidDepth = std::numeric_limits<float>::quiet_NaN();
+    ForEachRunOutsideRegion(region, 0, region.GetHeight(), [&](UINT32 y, UINT32 x, UINT32 count)
+    {
+        std::fill_n(depth + size_t(y) * region.GetWidth() + x, count, invalidDepth);
+    });
 }
 
-// Maps each pixel in a scanline from a 16 bit infrared value to a pseudo-color pixel.
-static void PseudoColorFor16BitInfrared(int pixelWidth, byte* inputRowBytes, byte* outputRowBytes)
+FrameRenderer::FrameRenderer(Image^ imageElement) :
+    m_outputBitmapPool(outputBitmapPoolSize),
+    m_pipeline(renderStageQueueCapacity, PipelineOverflow::Wait)
 {
-	UINT16* inputRow = reinterpret_cast<UINT16*>(inputRowBytes);
-	ColorBGRA* outputRow = reinterpret_cast<ColorBGRA*>(outputRowBytes);
-	for (int x = 0; x < pixelWidth; x++)
-	{
-		outputRow[x] = InfraredColor(inputRow[x] / static_cast<float>(UINT16_MAX));
-	}
+    m_imageElement = imageElement;
+    m_imageElement->Source = ref new SoftwareBitmapSource();
+    m_threadPool = GetDefaultThreadPool();
+
+    // Each stage runs on its own thread, so consecutive frames overlap: while one frame is faded and presented,
+    // the next is correlated and the one after that is converted. Every stage passes frames it doesn't
+    // handle straight on. Jobs go back to the free list once presented or when a stage gives up on them.
+    auto addStage = [this](const char* name, bool (FrameRenderer::*stage)(RenderJob&), bool last)
+    {
+        m_pipeline.AddStage(name, [this, stage, last](std::unique_ptr<RenderJob>& job)
+        {
+            bool passOn = (this->*stage)(*job);
+            if (!passOn || last)
+            {
+                RecycleRenderJob(std::move(job));
+            }
+            return passOn;
+        });
+    };
+    addStage("Convert", &FrameRenderer::ConvertFrame, false);
+    addStage("Correlate", &FrameRenderer::CorrelateFrame, false);
+    addStage("Reconstruct", &FrameRenderer::ReconstructFrame, false);
+    addStage("Analyze", &FrameRenderer::AnalyzeFrame, false);
+    addStage("Present", &FrameRenderer::PresentFrame, true);
+    m_pipeline.Start();
 }
 
-// Maps each pixel in a scanline from a 8 bit infrared value to a pseudo-color pixel.
-static void PseudoColorFor8BitInfrared(int pixelWidth, byte* inputRowBytes, byte* outputRowBytes)
+FrameRenderer::~FrameRenderer()
 {
-	ColorBGRA* outputRow = reinterpret_cast<ColorBGRA*>(outputRowBytes);
-	for (int x = 0; x < pixelWidth; x++)
-	{
-		outputRow[x] = InfraredColor(inputRowBytes[x] / static_cast<float>(UINT8_MAX));
-	}
+    // Stop the stage threads before the state they use goes away.
+    m_pipeline.Stop();
 }
 
-FrameRenderer::FrameRenderer(Image^ imageElement)
+void FrameRenderer::SetThreadPool(std::shared_ptr<ThreadPool> threadPool)
 {
-    m_imageElement = imageElement;
-    m_imageElement->Source = ref new SoftwareBitmapSource();
+    m_threadPool = std::move(threadPool);
 }
 
 task<void> FrameRenderer::DrainBackBufferAsync()
@@ -191,8 +200,10 @@ task<void> FrameRenderer::DrainBackBufferAsync()
         if (SoftwareBitmapSource^ imageSource = dynamic_cast<SoftwareBitmapSource^>(m_imageElement->Source))
         {
             return create_task(imageSource->SetBitmapAsync(latestBitmap))
-                .then([this]()
+                .then([this, latestBitmap]()
             {
+                // The image source has taken its own copy, so the bitmap can be reused for a later frame.
+                m_outputBitmapPool.Release(latestBitmap);
                 return DrainBackBufferAsync();
             }, task_continuation_context::use_current());
         }
@@ -214,40 +225,60 @@ void FrameRenderer::ProcessColorFrame(MediaFrameReference^ colorFrame)
         return;
     }
 
-    SoftwareBitmap^ inputBitmap = colorFrame->VideoMediaFrame->SoftwareBitmap;
+    std::unique_ptr<RenderJob> job = AcquireRenderJob(RenderJobKind::Color);
+    job->frame = colorFrame;
+    m_pipeline.Submit(std::move(job));
+}
 
-    if (inputBitmap == nullptr)
+void FrameRenderer::ProcessDepthFrame(MediaFrameReference^ depthFrame)
+{
+    if (depthFrame == nullptr)
     {
         return;
     }
 
-    // If the input bitmap is in the correct format, copy it and then buffer it for rendering.
-    if ((inputBitmap->BitmapPixelFormat == BitmapPixelFormat::Bgra8) &&
-        (inputBitmap->BitmapAlphaMode == BitmapAlphaMode::Premultiplied))
+    std::unique_ptr<RenderJob> job = AcquireRenderJob(RenderJobKind::Depth);
+    job->frame = depthFrame;
+    job->producePointCloud = m_pointCloudEnabled;
+    job->detectChanges = m_changeDetectionEnabled;
     {
-        BufferBitmapForRendering(SoftwareBitmap::Copy(inputBitmap));
+        std::lock_guard<std::mutex> settingsGuard(m_settingsMutex);
+        job->fusionVolume = m_fusionVolume;
+        job->cameraToVolume = m_cameraToVolume;
+        job->filterDepthTemporally = m_temporalFilterEnabled;
+        job->temporalFilterSettings = m_temporalFilterSettings;
+        job->filterDepthSpatially = m_spatialFilterEnabled;
+        job->spatialFilterSettings = m_spatialFilterSettings;
+        job->regionOfInterest = m_regionOfInterest;
     }
-    // Otherwise, convert the bitmap to the correct format before buffering it for rendering.
-    else
+    m_pipeline.Submit(std::move(job));
+}
+
+void FrameRenderer::ProcessInfraredFrame(MediaFrameReference^ infraredFrame)
+{
+    if (infraredFrame == nullptr)
+    {
+        return;
+    }
+
+    std::unique_ptr<RenderJob> job = AcquireRenderJob(RenderJobKind::Infrared);
+    job->frame = infraredFrame;
     {
-        BufferBitmapForRendering(SoftwareBitmap::Convert(inputBitmap, BitmapPixelFormat::Bgra8, BitmapAlphaMode::Premultiplied));
+        std::lock_guard<std::mutex> settingsGuard(m_settingsMutex);
+        job->regionOfInterest = m_regionOfInterest;
     }
+    m_pipeline.Submit(std::move(job));
 }
 
-void FrameRenderer::ProcessDepthFrame(MediaFrameReference^ depthFrame)
+SoftwareBitmap^ FrameRenderer::ConvertDepthFrame(MediaFrameReference^ depthFrame, const std::vector<UINT16>& filteredDepth, const RegionOfInterest* region)
 {
-	if (depthFrame == nullptr)
-	{
-		return;
-	}
-
 	SoftwareBitmap^ outputBitmap;
 	
 	//Convert to displayable image
 	VideoMediaFrame^ inputFrame = depthFrame->VideoMediaFrame;
 	if (inputFrame == nullptr)
 	{
-		return;
+		return nullptr;
 	}
 	SoftwareBitmap^ inputBitmap = inputFrame->SoftwareBitmap;
 	auto mode = inputBitmap->BitmapAlphaMode;
@@ -256,41 +287,46 @@ void FrameRenderer::ProcessDepthFrame(MediaFrameReference^ depthFrame)
 	// be in Gray16 format.
 	if (inputBitmap->BitmapPixelFormat == BitmapPixelFormat::Gray16)
 	{
-		using namespace std::placeholders;
-
 		// Use a special pseudo color to render 16 bits depth frame.
-		// Since we must scale the output appropriately we use std::bind to
-		// create a function that takes the depth scale as input but also matches
-		// the required signature.
+		// The color of a raw depth value only depends on the depth scale, so it is
+		// looked up in a table that is rebuilt only when the scale changes.
 		double depthScale = inputFrame->DepthMediaFrame->DepthFormat->DepthScaleInMeters;
-		outputBitmap = TransformBitmap(inputBitmap, std::bind(&PseudoColorForDepth, _1, _2, _3, static_cast<float>(depthScale)));
+		DepthTableKernel kernel{ GetDepthColorTable(static_cast<float>(depthScale)) };
+		if (filteredDepth.empty())
+		{
+			outputBitmap = TransformBitmap(inputBitmap, region, kernel);
+		}
+		else
+		{
+			// The kernels only read their input.
+			outputBitmap = TransformPixels(
+				reinterpret_cast<byte*>(const_cast<UINT16*>(filteredDepth.data())),
+				inputBitmap->PixelWidth * static_cast<int>(sizeof(UINT16)),
+				static_cast<int>(sizeof(UINT16)),
+				inputBitmap->PixelWidth,
+				inputBitmap->PixelHeight,
+				region,
+				kernel);
+		}
 	}
 	else
 	{
 		OutputDebugStringW(L"Depth format in unexpected format.\r\n");
 	}
 	
-	//Send to UI
-	if (outputBitmap != nullptr)
-	{
-		BufferBitmapForRendering(SoftwareBitmap::Copy(outputBitmap));
-	}
+	// The transformed bitmap is not shared with anything else, so it is rendered as is.
+	return outputBitmap;
 }
 
-void FrameRenderer::ProcessInfraredFrame(MediaFrameReference^ infraredFrame)
+SoftwareBitmap^ FrameRenderer::ConvertInfraredFrame(MediaFrameReference^ infraredFrame, const RegionOfInterest* region)
 {
-	if (infraredFrame == nullptr)
-	{
-		return;
-	}
-
 	SoftwareBitmap^ outputBitmap;
 
 	//Convert to displayable image
 	VideoMediaFrame^ inputFrame = infraredFrame->VideoMediaFrame;
 	if (inputFrame == nullptr)
 	{
-		return;
+		return nullptr;
 	}
 	SoftwareBitmap^ inputBitmap = inputFrame->SoftwareBitmap;
 	auto mode = inputBitmap->BitmapAlphaMode;
@@ -301,12 +337,12 @@ void FrameRenderer::ProcessInfraredFrame(MediaFrameReference^ infraredFrame)
 	{
 	case BitmapPixelFormat::Gray8:
 		// Use pseudo color to render 8 bits frames.
-		outputBitmap = TransformBitmap(inputBitmap, PseudoColorFor8BitInfrared);
+		outputBitmap = TransformBitmap(inputBitmap, region, Infrared8BitKernel());
 		break;
 
 	case BitmapPixelFormat::Gray16:
 		// Use pseudo color to render 16 bits frames.
-		outputBitmap = TransformBitmap(inputBitmap, PseudoColorFor16BitInfrared);
+		outputBitmap = TransformBitmap(inputBitmap, region, Infrared16BitKernel());
 		break;
 
 	default:
@@ -314,58 +350,135 @@ void FrameRenderer::ProcessInfraredFrame(MediaFrameReference^ infraredFrame)
 		outputBitmap = nullptr;
 	}
 
-	//Send to UI
-	if (outputBitmap != nullptr)
+	// The transformed bitmap is not shared with anything else, so it is rendered as is.
+	return outputBitmap;
+}
+
+const ColorBGRA* FrameRenderer::GetDepthColorTable(float depthScale)
+{
+	if (m_depthColorTable.empty() || m_depthColorTableScale != depthScale)
 	{
-		BufferBitmapForRendering(SoftwareBitmap::Copy(outputBitmap));
+		m_depthColorTable.resize(DepthColorTableSize);
+		BuildDepthColorTable(depthScale, m_depthColorTable.data());
+		m_depthColorTableScale = depthScale;
 	}
+
+	return m_depthColorTable.data();
 }
 
-SoftwareBitmap^ FrameRenderer::TransformBitmap(SoftwareBitmap^ inputBitmap, TransformScanline pixelTransformation)
+template<typename ScanlineKernel>
+SoftwareBitmap^ FrameRenderer::TransformBitmap(SoftwareBitmap^ inputBitmap, const RegionOfInterest* region, ScanlineKernel pixelTransformation)
 {
-	// XAML Image control only supports premultiplied Bgra8 format.
-	SoftwareBitmap^ outputBitmap = ref new SoftwareBitmap(
-		BitmapPixelFormat::Bgra8,
-		inputBitmap->PixelWidth,
-		inputBitmap->PixelHeight,
-		BitmapAlphaMode::Premultiplied);
-
 	BitmapBuffer^ input = inputBitmap->LockBuffer(BitmapBufferAccessMode::Read);
-	BitmapBuffer^ output = outputBitmap->LockBuffer(BitmapBufferAccessMode::Write);
 
-	// Get stride values to calculate buffer position for a given pixel x and y position.
+	// Get stride value to calculate buffer position for a given pixel x and y position.
 	int inputStride = input->GetPlaneDescription(0).Stride;
-	int outputStride = output->GetPlaneDescription(0).Stride;
-
-	int pixelWidth = inputBitmap->PixelWidth;
-	int pixelHeight = inputBitmap->PixelHeight;
 
 	IMemoryBufferReference^ inputReference = input->CreateReference();
-	IMemoryBufferReference^ outputReference = output->CreateReference();
 
-	// Get input and output byte access buffers.
+	// Get input byte access buffer.
 	byte* inputBytes;
 	UINT32 inputCapacity;
 	AsComPtr<IMemoryBufferByteAccess>(inputReference)->GetBuffer(&inputBytes, &inputCapacity);
 
+	// The kernels take Gray8 or Gray16 input.
+	int inputPixelBytes = (inputBitmap->BitmapPixelFormat == BitmapPixelFormat::Gray8) ? 1 : 2;
+
+	SoftwareBitmap^ outputBitmap = TransformPixels(
+		inputBytes, inputStride, inputPixelBytes, inputBitmap->PixelWidth, inputBitmap->PixelHeight, region, pixelTransformation);
+
+	// Close objects that need closing.
+	delete inputReference;
+	delete input;
+
+	return outputBitmap;
+}
+
+template<typename ScanlineKernel>
+SoftwareBitmap^ FrameRenderer::TransformPixels(
+	byte* inputBytes,
+	int inputStride,
+	int inputPixelBytes,
+	int pixelWidth,
+	int pixelHeight,
+	const RegionOfInterest* region,
+	ScanlineKernel pixelTransformation)
+{
+	std::shared_ptr<const RowSpans> spans = (region != nullptr) ?
+		region->GetSpans(static_cast<UINT32>(pixelWidth), static_cast<UINT32>(pixelHeight)) : nullptr;
+
+	SoftwareBitmap^ outputBitmap = CreateOutputBitmap(pixelWidth, pixelHeight);
+
+	BitmapBuffer^ output = outputBitmap->LockBuffer(BitmapBufferAccessMode::Write);
+
+	// Get stride value to calculate buffer position for a given pixel x and y position.
+	int outputStride = output->GetPlaneDescription(0).Stride;
+
+	IMemoryBufferReference^ outputReference = output->CreateReference();
+
+	// Get output byte access buffer.
 	byte* outputBytes;
 	UINT32 outputCapacity;
 	AsComPtr<IMemoryBufferByteAccess>(outputReference)->GetBuffer(&outputBytes, &outputCapacity);
 
-	// Iterate over all pixels, and store the converted value.
-	for (int y = 0; y < pixelHeight; y++)
+	// Split the rows into bands that fit in cache. Bands write disjoint rows of the output,
+	// so the result is the same no matter how many threads run them or in which order.
+	const int rowsPerBand = max(1, static_cast<int>(transformBandBytes / (inputStride + outputStride)));
+	const UINT32 bandCount = static_cast<UINT32>((pixelHeight + rowsPerBand - 1) / rowsPerBand);
+
+	auto transformBand = [&](UINT32 band)
 	{
-		byte* inputRowBytes = inputBytes + y * inputStride;
-		byte* outputRowBytes = outputBytes + y * outputStride;
+		int firstRow = static_cast<int>(band) * rowsPerBand;
+		int lastRow = min(firstRow + rowsPerBand, pixelHeight);
+
+		if (spans != nullptr)
+		{
+			// Only convert the pixels inside the region. The output bitmap comes from the pool, so whatever
+			// an earlier frame left outside it is cleared.
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				const RowSpan* rowSpans = spans->GetSpans(static_cast<UINT32>(y));
+				const size_t spanCount = spans->GetSpanCount(static_cast<UINT32>(y));
+				for (size_t i = 0; i < spanCount; i++)
+				{
+					pixelTransformation(
+						static_cast<int>(rowSpans[i].end - rowSpans[i].begin),
+						inputBytes + y * inputStride + rowSpans[i].begin * inputPixelBytes,
+						outputBytes + y * outputStride + rowSpans[i].begin * sizeof(ColorBGRA));
+				}
+			}
+			ForEachRunOutsideRegion(*spans, static_cast<UINT32>(firstRow), static_cast<UINT32>(lastRow), [&](UINT32 y, UINT32 x, UINT32 count)
+			{
+				std::memset(outputBytes + y * outputStride + x * sizeof(ColorBGRA), 0, count * sizeof(ColorBGRA));
+			});
+			return;
+		}
+
+		// Iterate over all pixels, and store the converted value.
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			byte* inputRowBytes = inputBytes + y * inputStride;
+			byte* outputRowBytes = outputBytes + y * outputStride;
+
+			pixelTransformation(pixelWidth, inputRowBytes, outputRowBytes);
+		}
+	};
 
-		pixelTransformation(pixelWidth, inputRowBytes, outputRowBytes);
+	if (m_threadPool != nullptr)
+	{
+		m_threadPool->ParallelFor(bandCount, transformBand);
+	}
+	else
+	{
+		for (UINT32 band = 0; band < bandCount; band++)
+		{
+			transformBand(band);
+		}
 	}
 
 	// Close objects that need closing.
 	delete outputReference;
-	delete inputReference;
 	delete output;
-	delete input;
 
 	return outputBitmap;
 }
@@ -377,38 +490,248 @@ void FrameRenderer::ProcessDepthAndColorFrames(MediaFrameReference^ colorFrame,
         return;
     }
 
-    // Create the coordinate mapper used to map depth pixels from depth space to color space.
-    DepthCorrelatedCoordinateMapper^ coordinateMapper = depthFrame->VideoMediaFrame->DepthMediaFrame->TryCreateCoordinateMapper(
-        colorFrame->VideoMediaFrame->CameraIntrinsics, colorFrame->CoordinateSystem);
+    std::unique_ptr<RenderJob> job = AcquireRenderJob(RenderJobKind::DepthAndColor);
+    job->frame = colorFrame;
+    job->depthFrame = depthFrame;
 
-    if (coordinateMapper == nullptr)
+    // Read the settings once, so every stage works with the same ones even if they change meanwhile.
+    CorrelationOutput output;
     {
-        return;
+        std::lock_guard<std::mutex> settingsGuard(m_settingsMutex);
+        job->depthFadeStart = m_depthFadeStart;
+        job->depthFadeEnd = m_depthFadeEnd;
+        job->fadeReference = m_fadeReference;
+        job->plateFadeStartHeight = m_plateFadeStartHeight;
+        job->plateFadeEndHeight = m_plateFadeEndHeight;
+        job->maskNearLimit = 0.0f;
+        job->scale = m_correlationScale;
+        job->upsampling = m_correlationUpsampling;
+        output = m_correlationOutput;
+        job->fusionVolume = m_fusionVolume;
+        job->cameraToVolume = m_cameraToVolume;
+        job->layerHeightMap = m_layerHeightMap;
+        job->filterDepthTemporally = m_temporalFilterEnabled;
+        job->temporalFilterSettings = m_temporalFilterSettings;
+        job->filterDepthSpatially = m_spatialFilterEnabled;
+        job->spatialFilterSettings = m_spatialFilterSettings;
+        job->regionOfInterest = m_regionOfInterest;
+    }
+    job->backend = m_correlationBackend;
+    job->produceImage = (output != CorrelationOutput::Mask);
+    job->produceMask = (output != CorrelationOutput::Image);
+    job->producePointCloud = m_pointCloudEnabled;
+    job->detectChanges = m_changeDetectionEnabled;
+
+    // Only forward registration and the Reconstruct stage read the filtered depth; the coordinate mapper maps the
+    // depth frame itself. Without either, filtering would be wasted, so the frame isn't filtered at all.
+    const bool filteredDepthIsRead = (job->backend == CorrelationBackend::ForwardRegistration) ||
+        job->producePointCloud || job->detectChanges || job->fusionVolume;
+    job->filterDepthTemporally = job->filterDepthTemporally && filteredDepthIsRead;
+    job->filterDepthSpatially = job->filterDepthSpatially && filteredDepthIsRead;
+
+    // Map the depth image to color space and buffer the result for rendering, across the pipeline stages.
+    m_pipeline.Submit(std::move(job));
+}
+
+SoftwareBitmap^ FrameRenderer::CreateOutputBitmap(int pixelWidth, int pixelHeight)
+{
+    return m_outputBitmapPool.Acquire(pixelWidth, pixelHeight);
+}
+
+SoftwareBitmap^ FrameRenderer::CopyToOutputBitmap(SoftwareBitmap^ inputBitmap)
+{
+    m_bitmapCopies++;
+
+    // If the input bitmap is in the correct format, copy it into a pooled bitmap.
+    if ((inputBitmap->BitmapPixelFormat == BitmapPixelFormat::Bgra8) &&
+        (inputBitmap->BitmapAlphaMode == BitmapAlphaMode::Premultiplied))
+    {
+        SoftwareBitmap^ outputBitmap = CreateOutputBitmap(inputBitmap->PixelWidth, inputBitmap->PixelHeight);
+        inputBitmap->CopyTo(outputBitmap);
+        return outputBitmap;
+    }
+    // Otherwise, convert the bitmap to the correct format. Convert always allocates its result,
+    // but the converted bitmap still goes back to the pool after it has been presented.
+    else
+    {
+        m_bitmapAllocations++;
+        return SoftwareBitmap::Convert(inputBitmap, BitmapPixelFormat::Bgra8, BitmapAlphaMode::Premultiplied);
+    }
+}
+
+FrameRendererStatistics FrameRenderer::GetStatistics() const
+{
+    FrameRendererStatistics statistics;
+    statistics.framesBuffered = m_framesBuffered;
+    statistics.framesDropped = m_framesDropped;
+    statistics.bitmapAllocations = m_bitmapAllocations + m_outputBitmapPool.GetAllocationCount();
+    statistics.bitmapCopies = m_bitmapCopies;
+    statistics.poolHits = m_outputBitmapPool.GetHitCount();
+    statistics.poolMisses = m_outputBitmapPool.GetMissCount();
+    statistics.pipelineStages = m_pipeline.GetStatistics();
+    statistics.pipelineDropped = m_pipeline.GetDroppedCount();
+    {
+        std::lock_guard<std::mutex> tileChangesGuard(m_tileChangesMutex);
+        statistics.tileChanges = m_tileChangeStatistics;
+    }
+
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    statistics.correlationScale = m_correlationScale;
+    statistics.correlationMilliseconds = m_correlationMilliseconds;
+    statistics.correlationTimeSavedMilliseconds = m_correlationTimeSavedMilliseconds;
+    statistics.correlationMeanDepthError = m_correlationMeanDepthError;
+    statistics.correlationCoverageMismatch = m_correlationCoverageMismatch;
+    statistics.bedPlaneFound = m_bedPlaneFound;
+    statistics.bedPlane = m_bedPlane;
+    statistics.bedPlaneStatistics = m_bedPlaneStatistics;
+    return statistics;
+}
+
+bool FrameRenderer::SetDepthFadeRange(float fadeStart, float fadeEnd)
+{
+    if (!(fadeEnd > fadeStart))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_depthFadeStart = fadeStart;
+    m_depthFadeEnd = fadeEnd;
+    return true;
+}
+
+bool FrameRenderer::SetPlateFadeRange(float fadeStartHeight, float fadeEndHeight)
+{
+    if (!(fadeEndHeight < fadeStartHeight))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_plateFadeStartHeight = fadeStartHeight;
+    m_plateFadeEndHeight = fadeEndHeight;
+    return true;
+}
+
+void FrameRenderer::SetDepthFadeReference(DepthFadeReference reference)
+{
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_fadeReference = reference;
+}
+
+void FrameRenderer::SetCorrelationBackend(CorrelationBackend backend)
+{
+    m_correlationBackend = backend;
+}
+
+void FrameRenderer::SetCorrelationOutput(CorrelationOutput output)
+{
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_correlationOutput = output;
+}
+
+std::shared_ptr<const DepthRangeMask> FrameRenderer::GetLatestDepthRangeMask() const
+{
+    std::lock_guard<std::mutex> guard(m_depthRangeMaskMutex);
+    return m_latestDepthRangeMask;
+}
+
+void FrameRenderer::SetPointCloudEnabled(bool enabled)
+{
+    m_pointCloudEnabled = enabled;
+}
+
+void FrameRenderer::SetChangeDetectionEnabled(bool enabled)
+{
+    m_changeDetectionEnabled = enabled;
+}
+
+std::shared_ptr<const TileChangeMap> FrameRenderer::GetLatestTileChanges() const
+{
+    std::lock_guard<std::mutex> guard(m_tileChangesMutex);
+    return m_latestTileChanges;
+}
+
+std::shared_ptr<const OrganizedPointCloud> FrameRenderer::GetLatestPointCloud() const
+{
+    std::lock_guard<std::mutex> guard(m_pointCloudMutex);
+    return m_latestPointCloud;
+}
+
+bool FrameRenderer::SetTemporalDepthFilter(bool enabled, const TemporalFilterSettings& settings)
+{
+    if (settings.historyLength < 1 || settings.historyLength > MaxTemporalFilterHistory ||
+        !(settings.decay > 0.0f && settings.decay <= 1.0f))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_temporalFilterEnabled = enabled;
+    m_temporalFilterSettings = settings;
+    return true;
+}
+
+void FrameRenderer::SetRegionOfInterest(std::shared_ptr<const RegionOfInterest> region)
+{
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_regionOfInterest = std::move(region);
+}
+
+bool FrameRenderer::SetSpatialDepthFilter(bool enabled, const SpatialFilterSettings& settings)
+{
+    if (!(settings.alpha > 0.0f && settings.alpha <= 1.0f) || !(settings.edgeThreshold > 0.0f))
+    {
+        return false;
     }
 
-    // Map the depth image to color space and buffer the result for rendering.
-    SoftwareBitmap^ softwareBitmap = MapDepthToColor(
-        colorFrame->VideoMediaFrame,
-        depthFrame->VideoMediaFrame,
-        colorFrame->VideoMediaFrame->CameraIntrinsics,
-        colorFrame->CoordinateSystem,
-        coordinateMapper);
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_spatialFilterEnabled = enabled;
+    m_spatialFilterSettings = settings;
+    return true;
+}
+
+void FrameRenderer::SetFusionVolume(std::shared_ptr<TsdfVolume> volume, const RigidTransform& cameraToVolume)
+{
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_fusionVolume = std::move(volume);
+    m_cameraToVolume = cameraToVolume;
+}
+
+void FrameRenderer::SetLayerHeightMap(std::shared_ptr<LayerHeightMap> heightMap)
+{
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_layerHeightMap = std::move(heightMap);
+}
 
-    if (softwareBitmap)
+bool FrameRenderer::SetCorrelationResolution(UINT32 scale, CorrelationUpsampling upsampling)
+{
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
     {
-        BufferBitmapForRendering(softwareBitmap);
+        return false;
     }
+
+    std::lock_guard<std::mutex> guard(m_settingsMutex);
+    m_correlationScale = scale;
+    m_correlationUpsampling = upsampling;
+    return true;
 }
 
 void FrameRenderer::BufferBitmapForRendering(SoftwareBitmap^ softwareBitmap)
 {
     if (softwareBitmap != nullptr)
     {
+        m_framesBuffered++;
+
         // Swap the processed frame to _backBuffer, and trigger the UI thread to render it.
         softwareBitmap = InterlockedExchangeRefPointer(&m_backBuffer, softwareBitmap);
 
-        // UI thread always resets m_backBuffer before using it. Unused bitmap should be disposed.
-        delete softwareBitmap;
+        // UI thread always resets m_backBuffer before using it. Unused bitmap goes back to the pool.
+        if (softwareBitmap != nullptr)
+        {
+            m_framesDropped++;
+            m_outputBitmapPool.Release(softwareBitmap);
+        }
 
         // Changes to the XAML ImageElement must happen in the UI thread, via the CoreDispatcher.
         m_imageElement->Dispatcher->RunAsync(Windows::UI::Core::CoreDispatcherPriority::Normal,
@@ -428,124 +751,933 @@ void FrameRenderer::BufferBitmapForRendering(SoftwareBitmap^ softwareBitmap)
     }
 }
 
-SoftwareBitmap^ FrameRenderer::MapDepthToColor(
-    VideoMediaFrame^ colorFrame,
-    VideoMediaFrame^ depthFrame,
-    CameraIntrinsics^ colorCameraIntrinsics,
-    SpatialCoordinateSystem^ colorCoordinateSystem,
-    DepthCorrelatedCoordinateMapper^ coordinateMapper)
+// Copies the parameters of a CameraIntrinsics into the portable camera model.
+static PinholeIntrinsics ToPinholeIntrinsics(CameraIntrinsics^ intrinsics)
 {
-    SoftwareBitmap^ inputBitmap = colorFrame->SoftwareBitmap;
-    SoftwareBitmap^ outputBitmap;
-    
-    // Copy the color input bitmap so we may overlay the depth bitmap on top of it.
-    if ((inputBitmap->BitmapPixelFormat == BitmapPixelFormat::Bgra8) &&
-        (inputBitmap->BitmapAlphaMode == BitmapAlphaMode::Premultiplied))
-    {
-        outputBitmap = SoftwareBitmap::Copy(inputBitmap);
-    }
-    else
+    PinholeIntrinsics result;
+    result.imageWidth = intrinsics->ImageWidth;
+    result.imageHeight = intrinsics->ImageHeight;
+    result.focalLengthX = intrinsics->FocalLength.x;
+    result.focalLengthY = intrinsics->FocalLength.y;
+    result.principalPointX = intrinsics->PrincipalPoint.x;
+    result.principalPointY = intrinsics->PrincipalPoint.y;
+    result.radialK1 = intrinsics->RadialDistortion.x;
+    result.radialK2 = intrinsics->RadialDistortion.y;
+    result.radialK3 = intrinsics->RadialDistortion.z;
+    result.tangentialP1 = intrinsics->TangentialDistortion.x;
+    result.tangentialP2 = intrinsics->TangentialDistortion.y;
+    return result;
+}
+
+// Returns the transform from the depth camera to the color camera in the camera convention of
+// DepthRegistration. Spatial coordinate systems have +y up and look down -z, and float4x4 transforms
+// row vectors, so the rotation is transposed and y and z are flipped on both sides.
+static bool TryGetDepthToColorTransform(SpatialCoordinateSystem^ depthCoordinateSystem, SpatialCoordinateSystem^ colorCoordinateSystem, RigidTransform& transform)
+{
+    IBox<float4x4>^ depthToColor = depthCoordinateSystem->TryGetTransformTo(colorCoordinateSystem);
+    if (depthToColor == nullptr)
     {
-        outputBitmap = SoftwareBitmap::Convert(inputBitmap, BitmapPixelFormat::Bgra8, BitmapAlphaMode::Premultiplied);
+        return false;
     }
 
-    // Create buffers used to access pixels.
-    BitmapBuffer^ depthBuffer = depthFrame->SoftwareBitmap->LockBuffer(BitmapBufferAccessMode::Read);
-    BitmapBuffer^ colorBuffer = colorFrame->SoftwareBitmap->LockBuffer(BitmapBufferAccessMode::Read);
-    BitmapBuffer^ outputBuffer = outputBitmap->LockBuffer(BitmapBufferAccessMode::Write);
+    const float4x4 m = depthToColor->Value;
+    const float rows[3][3] = {
+        { m.m11, m.m12, m.m13 },
+        { m.m21, m.m22, m.m23 },
+        { m.m31, m.m32, m.m33 }
+    };
+    const float translation[3] = { m.m41, m.m42, m.m43 };
+    const float flip[3] = { 1.0f, -1.0f, -1.0f };
 
-    if (depthBuffer == nullptr || colorBuffer == nullptr || outputBuffer == nullptr)
+    for (int i = 0; i < 3; i++)
     {
-        return nullptr;
+        for (int j = 0; j < 3; j++)
+        {
+            transform.rotation[i * 3 + j] = flip[i] * rows[j][i] * flip[j];
+        }
+        transform.translation[i] = flip[i] * translation[i];
     }
+    return true;
+}
 
-    BitmapPlaneDescription colorDesc = colorBuffer->GetPlaneDescription(0);
-    UINT32 colorWidth = static_cast<UINT32>(colorDesc.Width);
-    UINT32 colorHeight = static_cast<UINT32>(colorDesc.Height);
+// Builds the ray table of a camera from the rays the platform reports for its pixels.
+// pinhole is the portable copy of intrinsics the table is keyed on.
+static std::shared_ptr<const RayTable> CreateCameraRays(CameraIntrinsics^ intrinsics, const PinholeIntrinsics& pinhole)
+{
+    const UINT32 rayWidth = pinhole.imageWidth;
+    const UINT32 rayHeight = pinhole.imageHeight;
+    Array<Point>^ depthPixels = ref new Array<Point>(rayWidth * rayHeight);
+    for (UINT y = 0; y < rayHeight; y++)
+    {
+        for (UINT x = 0; x < rayWidth; x++)
+        {
+            depthPixels[y * rayWidth + x] = Point(static_cast<float>(x), static_cast<float>(y));
+        }
+    }
 
-    IMemoryBufferReference^ depthReference = depthBuffer->CreateReference();
-    IMemoryBufferReference^ outputReference = outputBuffer->CreateReference();
+    Array<float2>^ unprojectedRays = ref new Array<float2>(rayWidth * rayHeight);
+    intrinsics->UnprojectPixelsAtUnitDepth(depthPixels, unprojectedRays);
 
-    byte* depthBytes = nullptr;
-    UINT32 depthCapacity;
+    std::vector<float> rayX(unprojectedRays->Length);
+    std::vector<float> rayY(unprojectedRays->Length);
+    for (UINT i = 0; i < unprojectedRays->Length; i++)
+    {
+        rayX[i] = unprojectedRays[i].x;
+        rayY[i] = unprojectedRays[i].y;
+    }
+    return std::make_shared<RayTable>(pinhole, rayX.data(), rayY.data());
+}
 
-    byte* outputBytes = nullptr;
-    UINT32 outputCapacity;
+std::unique_ptr<FrameRenderer::RenderJob> FrameRenderer::AcquireRenderJob(RenderJobKind kind)
+{
+    std::unique_ptr<RenderJob> job;
+    {
+        std::lock_guard<std::mutex> guard(m_renderJobMutex);
+        if (!m_freeRenderJobs.empty())
+        {
+            job = std::move(m_freeRenderJobs.back());
+            m_freeRenderJobs.pop_back();
+        }
+    }
 
-    AsComPtr<IMemoryBufferByteAccess>(depthReference)->GetBuffer(&depthBytes, &depthCapacity);
-    AsComPtr<IMemoryBufferByteAccess>(outputReference)->GetBuffer(&outputBytes, &outputCapacity);
+    if (!job)
+    {
+        job = std::make_unique<RenderJob>();
+    }
+    job->kind = kind;
+    return job;
+}
 
-    if (depthBytes == nullptr || outputBytes == nullptr)
+void FrameRenderer::RecycleRenderJob(std::unique_ptr<RenderJob> job)
+{
+    // A job that didn't make it to presentation still owns its output bitmap.
+    UnlockOutputBitmap(*job);
+    m_outputBitmapPool.Release(job->outputBitmap);
+    job->outputBitmap = nullptr;
+    job->frame = nullptr;
+    job->depthFrame = nullptr;
+    job->fusionVolume = nullptr;
+    job->layerHeightMap = nullptr;
+    job->regionOfInterest = nullptr;
+    job->filteredDepth.clear();
+
+    // The depth field and filtered depth keep their capacity, so the next job using it doesn't allocate.
+    std::lock_guard<std::mutex> guard(m_renderJobMutex);
+    if (m_freeRenderJobs.size() < renderJobPoolSize)
     {
-        return nullptr;
+        m_freeRenderJobs.push_back(std::move(job));
     }
+}
 
-    ColorBGRA* outputPixels = reinterpret_cast<ColorBGRA*>(outputBytes);
+bool FrameRenderer::LockOutputBitmap(RenderJob& job)
+{
+    job.outputBuffer = job.outputBitmap->LockBuffer(BitmapBufferAccessMode::Write);
+    if (job.outputBuffer == nullptr)
+    {
+        return false;
+    }
 
+    BitmapPlaneDescription outputDesc = job.outputBuffer->GetPlaneDescription(0);
+    job.outputReference = job.outputBuffer->CreateReference();
+    byte* outputBytes = nullptr;
+    UINT32 outputCapacity;
+    AsComPtr<IMemoryBufferByteAccess>(job.outputReference)->GetBuffer(&outputBytes, &outputCapacity);
+    if (outputBytes == nullptr)
     {
-        // Ensure synchronous read/write access to point buffer cache.
-        std::lock_guard<std::mutex> guard(m_pointBufferMutex);
+        return false;
+    }
 
-        // If we don't have point arrays, or the ones we have are the wrong dimensions,
-        // then create new ones.
-        Array<Point>^ colorSpacePoints = m_colorSpacePoints;
-        if (colorSpacePoints == nullptr ||
-            m_previousBufferWidth != colorWidth ||
-            m_previousBufferHeight != colorHeight)
-        {
-            colorSpacePoints = ref new Array<Point>(colorWidth * colorHeight);
+    job.outputPixels = reinterpret_cast<ColorBGRA*>(outputBytes + outputDesc.StartIndex);
+    return true;
+}
 
-            // Prepare array of points we want mapped.
-            for (UINT y = 0; y < colorHeight; y++)
-            {
-                for (UINT x = 0; x < colorWidth; x++)
-                {
-                    colorSpacePoints[y * colorWidth + x] = Point(static_cast<float>(x), static_cast<float>(y));
-                }
+void FrameRenderer::UnlockOutputBitmap(RenderJob& job)
+{
+    job.outputPixels = nullptr;
+    if (job.outputReference != nullptr)
+    {
+        delete job.outputReference;
+        job.outputReference = nullptr;
+    }
+    if (job.outputBuffer != nullptr)
+    {
+        delete job.outputBuffer;
+        job.outputBuffer = nullptr;
+    }
+}
+
+bool FrameRenderer::ConvertFrame(RenderJob& job)
+{
+    if (job.kind == RenderJobKind::Depth || job.kind == RenderJobKind::DepthAndColor)
+    {
+        if (job.filterDepthTemporally || job.filterDepthSpatially)
+        {
+            FilterDepthFrame(job);
+        }
+
+        // Frames that aren't filtered temporally break the history, so filtering starts over when it is turned back on.
+        if (!job.filterDepthTemporally)
+        {
+            m_temporalFilter.Reset();
+        }
+    }
+
+    switch (job.kind)
+    {
+    case RenderJobKind::Color:
+    {
+        SoftwareBitmap^ inputBitmap = job.frame->VideoMediaFrame ? job.frame->VideoMediaFrame->SoftwareBitmap : nullptr;
+        if (inputBitmap == nullptr)
+        {
+            return false;
+        }
+
+        // The frame's bitmap belongs to the reader, so render a copy in the format XAML expects.
+        job.outputBitmap = CopyToOutputBitmap(inputBitmap);
+        return true;
+    }
+
+    case RenderJobKind::Depth:
+        job.outputBitmap = ConvertDepthFrame(job.frame, job.filteredDepth, job.regionOfInterest.get());
+        return job.outputBitmap != nullptr;
+
+    case RenderJobKind::Infrared:
+        job.outputBitmap = ConvertInfraredFrame(job.frame, job.regionOfInterest.get());
+        return job.outputBitmap != nullptr;
+
+    case RenderJobKind::DepthAndColor:
+    {
+        VideoMediaFrame^ colorVideoFrame = job.frame->VideoMediaFrame;
+        if (colorVideoFrame == nullptr || job.depthFrame->VideoMediaFrame == nullptr)
+        {
+            return false;
+        }
+
+        SoftwareBitmap^ colorBitmap = colorVideoFrame->SoftwareBitmap;
+        job.colorWidth = static_cast<UINT32>(colorBitmap->PixelWidth);
+        job.colorHeight = static_cast<UINT32>(colorBitmap->PixelHeight);
+
+        // Without an image, the color frame is never copied; only the mask is produced.
+        if (job.produceImage)
+        {
+            // Copy the color input bitmap so we may overlay the depth bitmap on top of it. It stays locked
+            // until the fade is applied, since the joint bilateral upsampling reads it too.
+            job.outputBitmap = CopyToOutputBitmap(colorBitmap);
+            return LockOutputBitmap(job);
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+void FrameRenderer::FilterDepthFrame(RenderJob& job)
+{
+    MediaFrameReference^ depthFrame = (job.kind == RenderJobKind::Depth) ? job.frame : job.depthFrame;
+    VideoMediaFrame^ depthVideoFrame = depthFrame->VideoMediaFrame;
+    if (depthVideoFrame == nullptr || depthVideoFrame->DepthMediaFrame == nullptr)
+    {
+        return;
+    }
+
+    SoftwareBitmap^ depthBitmap = depthVideoFrame->SoftwareBitmap;
+    if (depthBitmap == nullptr || depthBitmap->BitmapPixelFormat != BitmapPixelFormat::Gray16)
+    {
+        return;
+    }
+
+    BitmapBuffer^ depthBuffer = depthBitmap->LockBuffer(BitmapBufferAccessMode::Read);
+    if (depthBuffer == nullptr)
+    {
+        return;
+    }
+
+    BitmapPlaneDescription depthDesc = depthBuffer->GetPlaneDescription(0);
+    IMemoryBufferReference^ depthReference = depthBuffer->CreateReference();
+
+    byte* depthBytes = nullptr;
+    UINT32 depthCapacity;
+    AsComPtr<IMemoryBufferByteAccess>(depthReference)->GetBuffer(&depthBytes, &depthCapacity);
+    if (depthBytes != nullptr)
+    {
+        const UINT32 width = static_cast<UINT32>(depthBitmap->PixelWidth);
+        const UINT32 height = static_cast<UINT32>(depthBitmap->PixelHeight);
+        const UINT16* depth = reinterpret_cast<const UINT16*>(depthBytes + depthDesc.StartIndex);
+        const size_t depthRowStride = depthDesc.Stride / sizeof(UINT16);
+        const float depthScale = static_cast<float>(depthVideoFrame->DepthMediaFrame->DepthFormat->DepthScaleInMeters);
+
+        job.filteredDepth.resize(size_t(width) * height);
+        if (job.filterDepthTemporally)
+        {
+            m_temporalFilter.Configure(job.temporalFilterSettings);
+            m_temporalFilter.Filter(width, height, depth, depthRowStride, depthScale, job.filteredDepth.data());
+        }
+        else
+        {
+            for (UINT32 y = 0; y < height; y++)
+            {
+                std::copy(depth + y * depthRowStride, depth + y * depthRowStride + width, job.filteredDepth.begin() + size_t(y) * width);
+            }
+        }
+
+        // The spatial filter works in place, on the job's copy.
+        if (job.filterDepthSpatially)
+        {
+            m_spatialFilter.Configure(job.spatialFilterSettings);
+            m_spatialFilter.Filter(width, height, job.filteredDepth.data(), width, depthScale);
+        }
+    }
+
+    // Close objects that need closing.
+    delete depthReference;
+    delete depthBuffer;
+}
+
+bool FrameRenderer::CorrelateFrame(RenderJob& job)
+{
+    if (job.kind != RenderJobKind::DepthAndColor)
+    {
+        return true;
+    }
+
+    // Ensure synchronous read/write access to the correlation caches.
+    std::lock_guard<std::mutex> guard(m_pointBufferMutex);
+
+    auto correlationStart = std::chrono::steady_clock::now();
+
+    // The field ends up in the job, so the next frame's correlation can start while this one is still faded.
+    const UINT32 scale = job.scale;
+    if (!CorrelateDepth(job.backend, job.frame, job.depthFrame, job.filteredDepth, job.regionOfInterest.get(), scale, (scale > 1) ? m_correlatedDepth : job.depth))
+    {
+        return false;
+    }
+
+    if (scale > 1)
+    {
+        UpsampleDepth(m_correlatedDepth, scale, job.upsampling, job.outputPixels, job.colorWidth, job.colorHeight,
+            job.regionOfInterest.get(), job.depth);
+    }
+
+    const double correlationMilliseconds =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - correlationStart).count();
+
+    // Every so often, compute the full resolution field as well to measure what the reduced one costs in accuracy.
+    bool compared = false;
+    double timeSavedMilliseconds = 0.0;
+    double meanDepthError = 0.0;
+    double coverageMismatch = 0.0;
+    if (scale > 1 && (m_correlatedFrames % correlationComparisonInterval) == 0)
+    {
+        auto fullResolutionStart = std::chrono::steady_clock::now();
+        if (CorrelateDepth(job.backend, job.frame, job.depthFrame, job.filteredDepth, job.regionOfInterest.get(), 1, m_fullResolutionDepth))
+        {
+            timeSavedMilliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - fullResolutionStart).count() - correlationMilliseconds;
+
+            CompareDepthFields(job.depth, m_fullResolutionDepth, meanDepthError, coverageMismatch);
+            compared = true;
+        }
+    }
+    m_correlatedFrames++;
+
+    std::lock_guard<std::mutex> settingsGuard(m_settingsMutex);
+    m_correlationMilliseconds = correlationMilliseconds;
+    if (scale == 1)
+    {
+        m_correlationTimeSavedMilliseconds = 0.0;
+        m_correlationMeanDepthError = 0.0;
+        m_correlationCoverageMismatch = 0.0;
+    }
+    else if (compared)
+    {
+        m_correlationTimeSavedMilliseconds = timeSavedMilliseconds;
+        m_correlationMeanDepthError = meanDepthError;
+        m_correlationCoverageMismatch = coverageMismatch;
+    }
+    return true;
+}
+
+bool FrameRenderer::ReconstructFrame(RenderJob& job)
+{
+    if ((!job.producePointCloud && !job.fusionVolume && !job.detectChanges) ||
+        (job.kind != RenderJobKind::Depth && job.kind != RenderJobKind::DepthAndColor))
+    {
+        return true;
+    }
+
+    // A frame that can't be turned into points is still rendered; there is just no new cloud or fusion.
+    MediaFrameReference^ depthFrame = (job.kind == RenderJobKind::Depth) ? job.frame : job.depthFrame;
+    VideoMediaFrame^ depthVideoFrame = depthFrame->VideoMediaFrame;
+    if (depthVideoFrame == nullptr || depthVideoFrame->DepthMediaFrame == nullptr || depthVideoFrame->CameraIntrinsics == nullptr)
+    {
+        return true;
+    }
+
+    CameraIntrinsics^ depthIntrinsics = depthVideoFrame->CameraIntrinsics;
+    SoftwareBitmap^ depthBitmap = depthVideoFrame->SoftwareBitmap;
+    if (depthBitmap == nullptr ||
+        depthBitmap->BitmapPixelFormat != BitmapPixelFormat::Gray16 ||
+        static_cast<UINT32>(depthBitmap->PixelWidth) != depthIntrinsics->ImageWidth ||
+        static_cast<UINT32>(depthBitmap->PixelHeight) != depthIntrinsics->ImageHeight)
+    {
+        return true;
+    }
+
+    // Same caching as the registration's depth rays, but owned by this stage so the two never race.
+    PinholeIntrinsics depthPinhole = ToPinholeIntrinsics(depthIntrinsics);
+    if (!m_pointCloudRays || m_pointCloudRays->GetIntrinsics() != depthPinhole)
+    {
+        m_pointCloudRays = CreateCameraRays(depthIntrinsics, depthPinhole);
+    }
+
+    // The color image is only there, and not faded yet, when the job renders one.
+    RigidTransform depthToColor;
+    CameraIntrinsics^ colorIntrinsics = nullptr;
+    if (job.producePointCloud && job.kind == RenderJobKind::DepthAndColor && job.outputPixels != nullptr &&
+        job.frame->CoordinateSystem != nullptr && depthFrame->CoordinateSystem != nullptr)
+    {
+        colorIntrinsics = job.frame->VideoMediaFrame->CameraIntrinsics;
+        if (colorIntrinsics == nullptr ||
+            colorIntrinsics->ImageWidth != job.colorWidth ||
+            colorIntrinsics->ImageHeight != job.colorHeight ||
+            !TryGetDepthToColorTransform(depthFrame->CoordinateSystem, job.frame->CoordinateSystem, depthToColor))
+        {
+            colorIntrinsics = nullptr;
+        }
+    }
+
+    // The filtered depth, if any, replaces the frame's pixels.
+    const UINT16* depth = job.filteredDepth.empty() ? nullptr : job.filteredDepth.data();
+    size_t depthRowStride = depthPinhole.imageWidth;
+    BitmapBuffer^ depthBuffer = nullptr;
+    IMemoryBufferReference^ depthReference = nullptr;
+    if (depth == nullptr)
+    {
+        depthBuffer = depthBitmap->LockBuffer(BitmapBufferAccessMode::Read);
+        if (depthBuffer == nullptr)
+        {
+            return true;
+        }
+
+        BitmapPlaneDescription depthDesc = depthBuffer->GetPlaneDescription(0);
+        depthReference = depthBuffer->CreateReference();
+
+        byte* depthBytes = nullptr;
+        UINT32 depthCapacity;
+        AsComPtr<IMemoryBufferByteAccess>(depthReference)->GetBuffer(&depthBytes, &depthCapacity);
+        if (depthBytes != nullptr)
+        {
+            depth = reinterpret_cast<const UINT16*>(depthBytes + depthDesc.StartIndex);
+            depthRowStride = depthDesc.Stride / sizeof(UINT16);
+        }
+    }
+
+    // Reuse the previously published cloud and tile map if no consumer still holds them.
+    std::shared_ptr<OrganizedPointCloud> cloud;
+    std::shared_ptr<TileChangeMap> changes;
+    if (depth != nullptr)
+    {
+        const float depthScale = static_cast<float>(depthVideoFrame->DepthMediaFrame->DepthFormat->DepthScaleInMeters);
+
+        if (job.detectChanges)
+        {
+            changes = std::move(m_spareTileChanges);
+            if (!changes)
+            {
+                changes = std::make_shared<TileChangeMap>();
+            }
+            m_changeDetector.Detect(depthPinhole.imageWidth, depthPinhole.imageHeight, depth, depthRowStride, depthScale,
+                nullptr, 0, *changes);
+        }
+
+        if (job.producePointCloud)
+        {
+            cloud = std::move(m_sparePointCloud);
+            if (!cloud)
+            {
+                cloud = std::make_shared<OrganizedPointCloud>();
             }
+            cloud->Resize(depthPinhole.imageWidth, depthPinhole.imageHeight, colorIntrinsics != nullptr);
+            GeneratePointCloud(*m_pointCloudRays, depth, depthRowStride, depthScale, *cloud);
+        }
+
+        if (job.fusionVolume)
+        {
+            job.fusionVolume->Integrate(*m_pointCloudRays, depth, depthRowStride, depthScale, job.cameraToVolume, m_threadPool.get());
+        }
+    }
+
+    // Close objects that need closing.
+    if (depthBuffer != nullptr)
+    {
+        delete depthReference;
+        delete depthBuffer;
+    }
+
+    if (changes)
+    {
+        std::lock_guard<std::mutex> tileChangesGuard(m_tileChangesMutex);
+        m_tileChangeStatistics = m_changeDetector.GetStatistics();
+        std::swap(m_latestTileChanges, changes);
+    }
+    if (changes && changes.use_count() == 1)
+    {
+        m_spareTileChanges = std::move(changes);
+    }
+
+    if (!cloud)
+    {
+        return true;
+    }
+
+    if (colorIntrinsics != nullptr)
+    {
+        // With change detection on, the colors of unchanged tiles are taken over from the published cloud,
+        // except for the row of tiles refreshed this frame.
+        std::shared_ptr<const OrganizedPointCloud> previousCloud;
+        std::shared_ptr<const TileChangeMap> changedTiles;
+        if (job.detectChanges)
+        {
+            previousCloud = GetLatestPointCloud();
+            changedTiles = GetLatestTileChanges();
         }
+        ColorizePointCloud(depthToColor, ToPinholeIntrinsics(colorIntrinsics),
+            reinterpret_cast<const uint32_t*>(job.outputPixels), job.colorWidth, *cloud,
+            changedTiles.get(), previousCloud.get(), colorRefreshInterval, m_colorizedFrames++);
+    }
+
+    {
+        std::lock_guard<std::mutex> cloudGuard(m_pointCloudMutex);
+        std::swap(m_latestPointCloud, cloud);
+    }
+    if (cloud && cloud.use_count() == 1)
+    {
+        m_sparePointCloud = std::move(cloud);
+    }
+    return true;
+}
+
+bool FrameRenderer::UpdateBedPlane(RenderJob& job)
+{
+    CameraIntrinsics^ colorIntrinsics = job.frame->VideoMediaFrame->CameraIntrinsics;
+    if (colorIntrinsics == nullptr ||
+        colorIntrinsics->ImageWidth != job.colorWidth ||
+        colorIntrinsics->ImageHeight != job.colorHeight)
+    {
+        return false;
+    }
+
+    // The depth field is in color camera space at full color resolution, so the plane is fit there.
+    PinholeIntrinsics colorPinhole = ToPinholeIntrinsics(colorIntrinsics);
+    if (!m_colorRays || m_colorRays->GetIntrinsics() != colorPinhole)
+    {
+        m_colorRays = CreateCameraRays(colorIntrinsics, colorPinhole);
+    }
+
+    const bool found = m_bedPlaneEstimator.Update(*m_colorRays, job.depth.data());
+    {
+        std::lock_guard<std::mutex> settingsGuard(m_settingsMutex);
+        m_bedPlaneFound = found;
+        m_bedPlane = m_bedPlaneEstimator.GetPlane();
+        m_bedPlaneStatistics = m_bedPlaneEstimator.GetStatistics();
+    }
+    return found;
+}
 
-        Array<float3>^ depthSpacePoints = m_depthSpacePoints;
-        if (depthSpacePoints == nullptr ||
-            m_previousBufferWidth != colorWidth ||
-            m_previousBufferHeight != colorHeight)
+void FrameRenderer::FadeFromBedPlane(RenderJob& job)
+{
+    // The fade and the mask keep what is near, so they are given the depth below the plate, the negated height,
+    // with the plate fade range negated to match. Pixels without depth stay NaN, which both treat as out of range.
+    BedPlane flipped = m_bedPlaneEstimator.GetPlane();
+    flipped.normal[0] = -flipped.normal[0];
+    flipped.normal[1] = -flipped.normal[1];
+    flipped.normal[2] = -flipped.normal[2];
+    flipped.offset = -flipped.offset;
+    ComputeHeightsAbovePlane(flipped, *m_colorRays, job.depth.data(), job.depth.data());
+
+    job.depthFadeStart = -job.plateFadeStartHeight;
+    job.depthFadeEnd = -job.plateFadeEndHeight;
+    job.maskNearLimit = -std::numeric_limits<float>::infinity();
+}
+
+bool FrameRenderer::AnalyzeFrame(RenderJob& job)
+{
+    if (job.kind != RenderJobKind::DepthAndColor)
+    {
+        return true;
+    }
+
+    // Until the plate is found, the fade follows the distance from the camera. The height map is updated
+    // first, since a fade from the plate replaces the depth field.
+    if ((job.fadeReference == DepthFadeReference::BuildPlate || job.layerHeightMap) && UpdateBedPlane(job))
+    {
+        if (job.layerHeightMap)
+        {
+            job.layerHeightMap->Update(m_bedPlaneEstimator.GetPlane(), *m_colorRays, job.depth.data());
+        }
+        if (job.fadeReference == DepthFadeReference::BuildPlate)
         {
-            depthSpacePoints = ref new Array<float3>(colorWidth * colorHeight);
+            FadeFromBedPlane(job);
         }
+    }
 
-        // Save the (possibly updated) values now that they are all known to be good.
-        m_colorSpacePoints = colorSpacePoints;
-        m_depthSpacePoints = depthSpacePoints;
-        m_previousBufferWidth = colorWidth;
-        m_previousBufferHeight = colorHeight;
+    if (!job.produceMask)
+    {
+        return true;
+    }
 
-        // Unproject depth points to color image.
-        coordinateMapper->UnprojectPoints(
-            m_colorSpacePoints, colorCoordinateSystem, m_depthSpacePoints);
+    // The mask marks the pixels with depth that the fade doesn't turn completely black.
+    // Reuse the previously published mask if no consumer still holds it.
+    std::shared_ptr<DepthRangeMask> mask = std::move(m_spareDepthRangeMask);
+    if (!mask)
+    {
+        mask = std::make_shared<DepthRangeMask>();
+    }
+    mask->Build(job.depth.data(), job.colorWidth, job.colorHeight, job.maskNearLimit, job.depthFadeEnd);
 
-//        constexpr float depthFadeStart = 1;
-  //      constexpr float depthFadeEnd = 1.5;
-		constexpr float depthFadeStart = 0.6;
-		constexpr float depthFadeEnd = 0.61;
+    {
+        std::lock_guard<std::mutex> maskGuard(m_depthRangeMaskMutex);
+        std::swap(m_latestDepthRangeMask, mask);
+    }
+    if (mask && mask.use_count() == 1)
+    {
+        m_spareDepthRangeMask = std::move(mask);
+    }
+    return true;
+}
 
+bool FrameRenderer::PresentFrame(RenderJob& job)
+{
+    if (job.kind == RenderJobKind::DepthAndColor && job.outputPixels != nullptr)
+    {
         // Using the depth values we fade the color pixels of the ouput if they are too far away.
-        for (UINT y = 0; y < colorHeight; y++)
+        // Fading starts at depthFadeStart meters and is completely black by depthFadeEnd meters. Once the
+        // Analyze stage has found the build plate, these are depths below the plate rather than from the camera.
+        if (job.regionOfInterest)
         {
-            for (UINT x = 0; x < colorWidth; x++)
+            // Only the region is faded; the color outside it is blacked out, as its depth was never correlated.
+            std::shared_ptr<const RowSpans> spans = job.regionOfInterest->GetSpans(job.colorWidth, job.colorHeight);
+            for (UINT32 y = spans->GetFirstRow(); y < spans->GetEndRow(); y++)
+            {
+                const RowSpan* rowSpans = spans->GetSpans(y);
+                for (size_t i = 0; i < spans->GetSpanCount(y); i++)
+                {
+                    const size_t offset = size_t(y) * job.colorWidth + rowSpans[i].begin;
+                    ApplyDepthFade(rowSpans[i].end - rowSpans[i].begin, job.depth.data() + offset, 1, job.outputPixels + offset,
+                        job.depthFadeStart, job.depthFadeEnd);
+                }
+            }
+            ForEachRunOutsideRegion(*spans, 0, job.colorHeight, [&](UINT32 y, UINT32 x, UINT32 count)
+            {
+                ColorBGRA* pixels = job.outputPixels + size_t(y) * job.colorWidth + x;
+                for (UINT32 i = 0; i < count; i++)
+                {
+                    pixels[i].B = 0;
+                    pixels[i].G = 0;
+                    pixels[i].R = 0;
+                }
+            });
+        }
+        else
+        {
+            ApplyDepthFade(job.colorWidth * job.colorHeight, job.depth.data(), 1, job.outputPixels, job.depthFadeStart, job.depthFadeEnd);
+        }
+    }
+    UnlockOutputBitmap(job);
+
+    // The back buffer owns the bitmap from here on.
+    BufferBitmapForRendering(job.outputBitmap);
+    job.outputBitmap = nullptr;
+    return true;
+}
+
+bool FrameRenderer::CorrelateDepth(
+    CorrelationBackend backend,
+    MediaFrameReference^ colorFrame,
+    MediaFrameReference^ depthFrame,
+    const std::vector<UINT16>& filteredDepth,
+    const RegionOfInterest* region,
+    UINT32 scale,
+    std::vector<float>& depth)
+{
+    if (backend == CorrelationBackend::ForwardRegistration &&
+        RegisterDepthToColor(colorFrame, depthFrame, filteredDepth, region, scale, depth))
+    {
+        return true;
+    }
+    return CorrelateWithCoordinateMapper(colorFrame, depthFrame, region, scale, depth);
+}
+
+bool FrameRenderer::CorrelateWithCoordinateMapper(
+    MediaFrameReference^ colorFrame,
+    MediaFrameReference^ depthFrame,
+    const RegionOfInterest* region,
+    UINT32 scale,
+    std::vector<float>& depth)
+{
+    // Create the coordinate mapper used to map depth pixels from depth space to color space.
+    DepthCorrelatedCoordinateMapper^ coordinateMapper = depthFrame->VideoMediaFrame->DepthMediaFrame->TryCreateCoordinateMapper(
+        colorFrame->VideoMediaFrame->CameraIntrinsics, colorFrame->CoordinateSystem);
+
+    if (coordinateMapper == nullptr)
+    {
+        return false;
+    }
+
+    SoftwareBitmap^ colorBitmap = colorFrame->VideoMediaFrame->SoftwareBitmap;
+    UINT32 colorWidth = static_cast<UINT32>(colorBitmap->PixelWidth);
+    UINT32 colorHeight = static_cast<UINT32>(colorBitmap->PixelHeight);
+    UINT32 width = ReducedSize(colorWidth, scale);
+    UINT32 height = ReducedSize(colorHeight, scale);
+
+    // The region's pixels at the reduced size; a block is inside it when its center is.
+    std::shared_ptr<const RowSpans> spans = (region != nullptr) ? region->GetSpans(width, height) : nullptr;
+
+    // If we don't have point arrays, or the ones we have are for another size, scale or region,
+    // then create new ones.
+    UnprojectionGrid& grid = (scale == 1) ? m_fullResolutionGrid : m_reducedResolutionGrid;
+    if (grid.colorSpacePoints == nullptr ||
+        grid.colorWidth != colorWidth ||
+        grid.colorHeight != colorHeight ||
+        grid.scale != scale ||
+        grid.region != spans)
+    {
+        const UINT32 pointCount = spans ? static_cast<UINT32>(spans->GetPixelCount()) : width * height;
+        Array<Point>^ colorSpacePoints = ref new Array<Point>(pointCount);
+
+        // Prepare array of points we want mapped: the center of every scale x scale block, in the region if there is one.
+        const float blockCenter = (scale - 1) * 0.5f;
+        auto blockPoint = [&](UINT32 x, UINT32 y)
+        {
+            return Point(
+                min(x * scale + blockCenter, static_cast<float>(colorWidth - 1)),
+                min(y * scale + blockCenter, static_cast<float>(colorHeight - 1)));
+        };
+        UINT32 point = 0;
+        for (UINT y = 0; y < height; y++)
+        {
+            if (spans)
+            {
+                const RowSpan* rowSpans = spans->GetSpans(y);
+                for (size_t i = 0; i < spans->GetSpanCount(y); i++)
+                {
+                    for (UINT x = rowSpans[i].begin; x < rowSpans[i].end; x++)
+                    {
+                        colorSpacePoints[point++] = blockPoint(x, y);
+                    }
+                }
+            }
+            else
             {
-                UINT index = y * colorWidth + x;
+                for (UINT x = 0; x < width; x++)
+                {
+                    colorSpacePoints[point++] = blockPoint(x, y);
+                }
+            }
+        }
 
-                // The z value of each depth space point contains the depth value of the point.
-                // This value is mapped to a fade value. Fading starts at depthFadeStart meters
-                // and is completely black by depthFadeEnd meters.
-                float fadeValue = 1 - max(0, min(((m_depthSpacePoints[index].z - depthFadeStart) / (depthFadeEnd - depthFadeStart)), 1));
+        grid.colorSpacePoints = colorSpacePoints;
+        grid.depthSpacePoints = ref new Array<float3>(pointCount);
+        grid.colorWidth = colorWidth;
+        grid.colorHeight = colorHeight;
+        grid.scale = scale;
+        grid.region = spans;
+    }
 
-                outputPixels[index].R = static_cast<byte>(static_cast<float>(outputPixels[index].R) * fadeValue);
-                outputPixels[index].G = static_cast<byte>(static_cast<float>(outputPixels[index].G) * fadeValue);
-                outputPixels[index].B = static_cast<byte>(static_cast<float>(outputPixels[index].B) * fadeValue);
+    // Unproject depth points to color image.
+    if (grid.colorSpacePoints->Length > 0)
+    {
+        coordinateMapper->UnprojectPoints(grid.colorSpacePoints, colorFrame->CoordinateSystem, grid.depthSpacePoints);
+    }
+
+    // The z value of each depth space point contains the depth value of the point.
+    depth.resize(width * height);
+    const float3* points = grid.depthSpacePoints->Data;
+    if (spans)
+    {
+        // Points were mapped span by span, so they are put back the same way.
+        ClearDepthOutsideRegion(*spans, depth.data());
+        for (UINT y = spans->GetFirstRow(); y < spans->GetEndRow(); y++)
+        {
+            const RowSpan* rowSpans = spans->GetSpans(y);
+            for (size_t i = 0; i < spans->GetSpanCount(y); i++)
+            {
+                for (UINT x = rowSpans[i].begin; x < rowSpans[i].end; x++)
+                {
+                    depth[y * width + x] = (points++)->z;
+                }
             }
         }
+        return true;
+    }
+    for (UINT i = 0; i < width * height; i++)
+    {
+        depth[i] = points[i].z;
+    }
+    return true;
+}
+
+bool FrameRenderer::RegisterDepthToColor(
+    MediaFrameReference^ colorFrame,
+    MediaFrameReference^ depthFrame,
+    const std::vector<UINT16>& filteredDepth,
+    const RegionOfInterest* region,
+    UINT32 scale,
+    std::vector<float>& depth)
+{
+    VideoMediaFrame^ colorVideoFrame = colorFrame->VideoMediaFrame;
+    VideoMediaFrame^ depthVideoFrame = depthFrame->VideoMediaFrame;
+    if (depthVideoFrame->DepthMediaFrame == nullptr)
+    {
+        return false;
+    }
+
+    CameraIntrinsics^ colorIntrinsics = colorVideoFrame->CameraIntrinsics;
+    CameraIntrinsics^ depthIntrinsics = depthVideoFrame->CameraIntrinsics;
+    if (colorIntrinsics == nullptr || depthIntrinsics == nullptr ||
+        colorFrame->CoordinateSystem == nullptr || depthFrame->CoordinateSystem == nullptr)
+    {
+        return false;
+    }
+
+    RigidTransform depthToColor;
+    if (!TryGetDepthToColorTransform(depthFrame->CoordinateSystem, colorFrame->CoordinateSystem, depthToColor))
+    {
+        return false;
+    }
+
+    SoftwareBitmap^ depthBitmap = depthVideoFrame->SoftwareBitmap;
+    SoftwareBitmap^ colorBitmap = colorVideoFrame->SoftwareBitmap;
+
+    // The rays and the registered depth are indexed by pixel, so the frames must have the intrinsics' resolution.
+    if (depthBitmap->BitmapPixelFormat != BitmapPixelFormat::Gray16 ||
+        static_cast<UINT32>(depthBitmap->PixelWidth) != depthIntrinsics->ImageWidth ||
+        static_cast<UINT32>(depthBitmap->PixelHeight) != depthIntrinsics->ImageHeight ||
+        static_cast<UINT32>(colorBitmap->PixelWidth) != colorIntrinsics->ImageWidth ||
+        static_cast<UINT32>(colorBitmap->PixelHeight) != colorIntrinsics->ImageHeight)
+    {
+        OutputDebugStringW(L"Depth or color frame does not match the format needed for registration.\r\n");
+        return false;
+    }
+
+    // The filtered depth, if any, replaces the frame's pixels.
+    const UINT16* depthPixels = filteredDepth.data();
+    size_t depthRowStride = depthIntrinsics->ImageWidth;
+    BitmapBuffer^ depthBuffer = nullptr;
+    IMemoryBufferReference^ depthReference = nullptr;
+    if (filteredDepth.empty())
+    {
+        depthBuffer = depthBitmap->LockBuffer(BitmapBufferAccessMode::Read);
+        if (depthBuffer == nullptr)
+        {
+            return false;
+        }
+
+        BitmapPlaneDescription depthDesc = depthBuffer->GetPlaneDescription(0);
+        depthReference = depthBuffer->CreateReference();
+
+        byte* depthBytes = nullptr;
+        UINT32 depthCapacity;
+        AsComPtr<IMemoryBufferByteAccess>(depthReference)->GetBuffer(&depthBytes, &depthCapacity);
+        if (depthBytes == nullptr)
+        {
+            delete depthReference;
+            delete depthBuffer;
+            return false;
+        }
+        depthPixels = reinterpret_cast<const UINT16*>(depthBytes + depthDesc.StartIndex);
+        depthRowStride = depthDesc.Stride / sizeof(UINT16);
     }
 
-    return outputBitmap;
+    // The depth rays only change with the depth camera's intrinsics, so they are unprojected once
+    // and kept until the intrinsics reported with the frame differ by value.
+    PinholeIntrinsics depthPinhole = ToPinholeIntrinsics(depthIntrinsics);
+    const std::shared_ptr<const RayTable>& depthRays = m_depthRegistration.GetDepthRays();
+    if (!depthRays || depthRays->GetIntrinsics() != depthPinhole)
+    {
+        m_depthRegistration.SetDepthRays(CreateCameraRays(depthIntrinsics, depthPinhole));
+    }
+
+    // Registering into the intrinsics of a smaller image samples the color camera at block centers.
+    PinholeIntrinsics colorPinhole = ToPinholeIntrinsics(colorIntrinsics);
+    m_depthRegistration.SetColorIntrinsics(scale == 1 ? colorPinhole : ScaleIntrinsics(colorPinhole, scale));
+    m_depthRegistration.SetDepthToColorTransform(depthToColor);
+
+    depth.resize(m_depthRegistration.GetColorWidth() * m_depthRegistration.GetColorHeight());
+    m_depthRegistration.Register(
+        depthPixels,
+        depthRowStride,
+        static_cast<float>(depthVideoFrame->DepthMediaFrame->DepthFormat->DepthScaleInMeters),
+        depth.data());
+    if (region != nullptr)
+    {
+        ClearDepthOutsideRegion(*region->GetSpans(m_depthRegistration.GetColorWidth(), m_depthRegistration.GetColorHeight()), depth.data());
+    }
+
+    // Close objects that need closing.
+    if (depthReference != nullptr)
+    {
+        delete depthReference;
+        delete depthBuffer;
+    }
+    return true;
+}
+
+void FrameRenderer::UpsampleDepth(
+    const std::vector<float>& lowResolutionDepth,
+    UINT32 scale,
+    CorrelationUpsampling upsampling,
+    const ColorBGRA* colorPixels,
+    UINT32 colorWidth,
+    UINT32 colorHeight,
+    const RegionOfInterest* region,
+    std::vector<float>& depth)
+{
+    const LowResolutionDepth source = { lowResolutionDepth.data(), ReducedSize(colorWidth, scale), ReducedSize(colorHeight, scale), scale };
+    depth.resize(colorWidth * colorHeight);
+
+    if (upsampling == CorrelationUpsampling::JointBilateral && colorPixels != nullptr &&
+        (!m_jointBilateralWeights || m_jointBilateralWeights->GetScale() != scale))
+    {
+        m_jointBilateralWeights.reset(new JointBilateralWeights(scale, jointBilateralColorSigma));
+    }
+
+    // With a region, only the rows it covers are upsampled; everything outside it is cleared afterwards.
+    std::shared_ptr<const RowSpans> spans = (region != nullptr) ? region->GetSpans(colorWidth, colorHeight) : nullptr;
+    const UINT32 firstRow = spans ? spans->GetFirstRow() : 0;
+    const UINT32 endRow = spans ? spans->GetEndRow() : colorHeight;
+
+    // Rows are independent, so the upsampling is split into bands across the thread pool.
+    const UINT32 bandCount = (endRow - firstRow + upsampleBandRows - 1) / upsampleBandRows;
+    auto upsampleBand = [&](uint32_t band)
+    {
+        UINT32 rowBegin = firstRow + band * upsampleBandRows;
+        UINT32 rowEnd = min(rowBegin + upsampleBandRows, endRow);
+        if (upsampling == CorrelationUpsampling::JointBilateral && colorPixels != nullptr)
+        {
+            UpsampleDepthJointBilateral(source, reinterpret_cast<const uint8_t*>(colorPixels), colorWidth * sizeof(ColorBGRA),
+                *m_jointBilateralWeights, depth.data(), colorWidth, colorHeight, rowBegin, rowEnd);
+        }
+        else
+        {
+            UpsampleDepthNearestValid(source, depth.data(), colorWidth, rowBegin, rowEnd);
+        }
+    };
+
+    if (m_threadPool != nullptr)
+    {
+        m_threadPool->ParallelFor(bandCount, upsampleBand);
+    }
+    else
+    {
+        for (UINT32 band = 0; band < bandCount; band++)
+        {
+            upsampleBand(band);
+        }
+    }
+
+    if (spans)
+    {
+        ClearDepthOutsideRegion(*spans, depth.data());
+    }
 }
\ No newline at end of file
@@ -11,17 +11,229 @@
 
 #pragma once
 
+#include "BedPlane.h"
+#include "DepthFade.h"
+#include "DepthRangeMask.h"
+#include "DepthRegistration.h"
+#include "DepthUpsampling.h"
+#include "FramePipeline.h"
+#include "LayerHeightMap.h"
 #include "LookupTable.h"
+#include "PointCloud.h"
+#include "PseudoColorKernels.h"
+#include "RegionOfInterest.h"
+#include "SoftwareBitmapPool.h"
+#include "SpatialDepthFilter.h"
+#include "TemporalDepthFilter.h"
+#include "ThreadPool.h"
+#include "TsdfVolume.h"
 
 namespace SDKTemplate
 {
-    // Function type used to map scanline of pixels to an alternate format.
-    typedef std::function<void(int, byte*, byte*)> TransformScanline;
+    // Counters describing how much work a FrameRenderer does to produce its output frames.
+    struct FrameRendererStatistics
+    {
+        UINT64 framesBuffered = 0; // Output frames handed to the UI for rendering.
+        UINT64 framesDropped = 0; // Buffered frames replaced by a newer frame before the UI presented them.
+        UINT64 bitmapAllocations = 0; // Full-frame output bitmaps allocated.
+        UINT64 bitmapCopies = 0; // Full-frame bitmap copies and format conversions.
+        UINT64 poolHits = 0; // Output bitmaps reused from the pool.
+        UINT64 poolMisses = 0; // Output bitmaps allocated because every pooled bitmap was in use.
+
+        // Correlation of depth and color frames. The accuracy figures compare the reduced resolution field
+        // against a full resolution one computed every few frames, and stay 0 at full resolution.
+        UINT64 correlationScale = 1; // Color resolution divisor the depth field is computed at.
+        double correlationMilliseconds = 0.0; // Time to compute the last depth field, including upsampling.
+        double correlationTimeSavedMilliseconds = 0.0; // Full resolution time minus reduced time, at the last comparison.
+        double correlationMeanDepthError = 0.0; // Mean absolute depth difference, in meters, where both fields have depth.
+        double correlationCoverageMismatch = 0.0; // Fraction of pixels with depth in one field but not the other.
+
+        // Build plate estimation. The plane is in color camera space and only valid if bedPlaneFound is set.
+        bool bedPlaneFound = false;
+        BedPlane bedPlane;
+        BedPlaneStatistics bedPlaneStatistics;
+
+        // Change detection on the depth frames.
+        TileChangeStatistics tileChanges;
+
+        // Timing of the render pipeline stages, in order, and frames turned away at its entrance.
+        std::vector<PipelineStageStatistics> pipelineStages;
+        UINT64 pipelineDropped = 0;
+    };
+
+    // How ProcessDepthAndColorFrames finds the depth behind each color pixel.
+    enum class CorrelationBackend
+    {
+        CoordinateMapper, // DepthCorrelatedCoordinateMapper unprojects every color pixel.
+        ForwardRegistration, // DepthRegistration projects every depth pixel into the color image.
+    };
+
+    // How a depth field computed below color resolution is brought back up to it.
+    enum class CorrelationUpsampling
+    {
+        NearestValid, // Each pixel takes the nearest valid sample.
+        JointBilateral, // Samples are weighted by distance and color similarity, so depth edges follow color edges.
+    };
+
+    // What the depth fade of ProcessDepthAndColorFrames is measured from.
+    enum class DepthFadeReference
+    {
+        Camera, // Distance from the color camera, within the depth fade range.
+        BuildPlate, // Height above the build plate, within the plate fade range. The camera range applies until the plate is found.
+    };
+
+    // What ProcessDepthAndColorFrames produces.
+    enum class CorrelationOutput
+    {
+        Image, // The faded color image, sent to the Image element.
+        Mask, // Only the in-range mask, from GetLatestDepthRangeMask. The color frame is not copied.
+        ImageAndMask,
+    };
 
     class FrameRenderer
     {
     public:
         FrameRenderer(Windows::UI::Xaml::Controls::Image^ image);
+        ~FrameRenderer();
+
+        FrameRenderer(const FrameRenderer&) = delete;
+        FrameRenderer& operator=(const FrameRenderer&) = delete;
+
+        /// <summary>
+        /// Sets the pool that pixel conversions are spread across. By default all renderers share a pool
+        /// with one thread per core; pass a pool with a different thread count to change that,
+        /// or nullptr to convert on the calling thread only.
+        /// The Convert, Correlate and Reconstruct stages all spread their work on this pool, which runs one
+        /// job at a time, so a stage can wait for another stage's job. The pipelineStages statistics report
+        /// those waits as poolWaits and poolWaitMilliseconds.
+        /// </summary>
+        void SetThreadPool(std::shared_ptr<ThreadPool> threadPool);
+
+        /// <summary>
+        /// Returns the renderer's counters. Safe to call from any thread.
+        /// Allocations and copies divided by framesBuffered give the per-frame cost.
+        /// </summary>
+        FrameRendererStatistics GetStatistics() const;
+
+        /// <summary>
+        /// Sets the depth range, in meters, over which correlated color pixels fade to black.
+        /// Pixels closer than fadeStart keep their color and pixels beyond fadeEnd are black.
+        /// Returns false and keeps the current range if fadeEnd is not greater than fadeStart.
+        /// </summary>
+        bool SetDepthFadeRange(float fadeStart, float fadeEnd);
+
+        /// <summary>
+        /// Sets the height range, in meters above the build plate, over which correlated color pixels fade to black
+        /// when the fade reference is BuildPlate. Pixels at least fadeStartHeight above the plate keep their color,
+        /// and pixels no higher than fadeEndHeight are black. Returns false and keeps the current range if
+        /// fadeEndHeight is not below fadeStartHeight.
+        /// </summary>
+        bool SetPlateFadeRange(float fadeStartHeight, float fadeEndHeight);
+
+        /// <summary>
+        /// Selects whether the fade, and the in-range mask, follow the distance from the camera or the height
+        /// above the build plate. The default is BuildPlate.
+        /// </summary>
+        void SetDepthFadeReference(DepthFadeReference reference);
+
+        /// <summary>
+        /// Selects how ProcessDepthAndColorFrames correlates depth with color. The default is ForwardRegistration,
+        /// which only unprojects the depth camera's rays when its intrinsics change; frames it can't register, for
+        /// lack of intrinsics, coordinate systems or a matching format, are correlated with the CoordinateMapper.
+        /// </summary>
+        void SetCorrelationBackend(CorrelationBackend backend);
+
+        /// <summary>
+        /// Makes ProcessDepthAndColorFrames compute the depth field at 1/scale of the color resolution and
+        /// upsample it before fading. scale must be 1, 2, 4 or 8; returns false and keeps the current mode otherwise.
+        /// </summary>
+        bool SetCorrelationResolution(UINT32 scale, CorrelationUpsampling upsampling);
+
+        /// <summary>
+        /// Selects whether ProcessDepthAndColorFrames renders the faded image, publishes the in-range mask, or both.
+        /// The mask has a bit set for every color pixel with depth closer than the end of the fade range.
+        /// In Mask mode, joint bilateral upsampling has no color image to follow and falls back to nearest valid.
+        /// </summary>
+        void SetCorrelationOutput(CorrelationOutput output);
+
+        /// <summary>
+        /// Returns the mask of the most recent correlated frame, or nullptr if none was produced yet.
+        /// The mask is not modified while a caller holds it. Safe to call from any thread.
+        /// </summary>
+        std::shared_ptr<const DepthRangeMask> GetLatestDepthRangeMask() const;
+
+        /// <summary>
+        /// Makes ProcessDepthFrame and ProcessDepthAndColorFrames also turn the depth frame into an organized
+        /// point cloud. Frames without camera intrinsics produce no cloud. Off by default.
+        /// </summary>
+        void SetPointCloudEnabled(bool enabled);
+
+        /// <summary>
+        /// Returns the point cloud of the most recent depth frame, or nullptr if none was produced yet.
+        /// With ProcessDepthAndColorFrames in an image mode, the points carry the color the color camera
+        /// sees them with. The cloud is not modified while a caller holds it. Safe to call from any thread.
+        /// </summary>
+        std::shared_ptr<const OrganizedPointCloud> GetLatestPointCloud() const;
+
+        /// <summary>
+        /// Fuses every depth frame of ProcessDepthFrame and ProcessDepthAndColorFrames into volume, on the
+        /// renderer's thread pool. cameraToVolume maps depth camera space to the volume's space.
+        /// Pass nullptr to stop fusing. Frames without camera intrinsics are not fused.
+        /// </summary>
+        void SetFusionVolume(std::shared_ptr<TsdfVolume> volume, const RigidTransform& cameraToVolume);
+
+        /// <summary>
+        /// Updates heightMap with the depth of every ProcessDepthAndColorFrames frame once the build plate is
+        /// found, whatever the depth fade reference. Pass nullptr to stop updating it.
+        /// </summary>
+        void SetLayerHeightMap(std::shared_ptr<LayerHeightMap> heightMap);
+
+        /// <summary>
+        /// Makes ProcessDepthFrame and ProcessDepthAndColorFrames find the 16x16 tiles of every depth frame that
+        /// changed. While it is on, point clouds keep the colors of the tiles whose depth didn't change instead of
+        /// projecting them again, except that every tile is projected again at least every few frames so that
+        /// lighting changes still show. Off by default.
+        /// </summary>
+        void SetChangeDetectionEnabled(bool enabled);
+
+        /// <summary>
+        /// Returns the tiles of the most recent depth frame that changed, or nullptr if change detection didn't
+        /// run yet. The map is not modified while a caller holds it. Safe to call from any thread.
+        /// </summary>
+        std::shared_ptr<const TileChangeMap> GetLatestTileChanges() const;
+
+        /// <summary>
+        /// Makes ProcessDepthFrame and ProcessDepthAndColorFrames filter every depth frame over the frames before it,
+        /// with settings, before anything else reads it: the pseudo-color image, forward registration, point clouds,
+        /// fusion and change detection all see the filtered depth. The CoordinateMapper backend maps the frame itself
+        /// and stays unfiltered, as do frames forward registration falls back to it for. With that backend and no
+        /// point cloud, fusion or change detection, nothing reads the filtered depth of ProcessDepthAndColorFrames,
+        /// so those frames are not filtered and the history starts over once something does. Returns false, changing
+        /// nothing, if the history length is not between 1 and MaxTemporalFilterHistory or the decay not above 0 and
+        /// at most 1. Off by default.
+        /// </summary>
+        bool SetTemporalDepthFilter(bool enabled, const TemporalFilterSettings& settings = TemporalFilterSettings());
+
+        /// <summary>
+        /// Makes ProcessDepthFrame and ProcessDepthAndColorFrames smooth every depth frame within edges and fill its
+        /// small holes with settings, after the temporal filter and before anything else reads the frame, so holes no
+        /// longer show as transparent in the pseudo-color image or unfaded in the correlated image. Like the temporal
+        /// filter, it doesn't reach the CoordinateMapper backend, and ProcessDepthAndColorFrames frames that nothing
+        /// else reads the depth of are not filtered. Returns false, changing nothing, if alpha is not above 0 and at
+        /// most 1 or the edge threshold not above 0. Off by default.
+        /// </summary>
+        bool SetSpatialDepthFilter(bool enabled, const SpatialFilterSettings& settings = SpatialFilterSettings());
+
+        /// <summary>
+        /// Limits the rendering of depth, infrared and correlated frames to region, given in coordinates normalized
+        /// to the rendered image, from the next frame on. Pseudo-coloring, correlation and the depth fade only process
+        /// the pixels inside it. Outside it, depth and infrared images are transparent, correlated images black, and
+        /// the correlated depth, and so the mask and build plate, invalid. Pass nullptr to render whole frames.
+        /// </summary>
+        void SetRegionOfInterest(std::shared_ptr<const RegionOfInterest> region);
+
+        // The Process methods hand the frames to the render pipeline and return without waiting for them to
+        // be rendered, unless the pipeline is full. They should be called from one thread.
 
         /// <summary>
         /// Buffer and render color frame.
@@ -45,24 +257,241 @@ namespace SDKTemplate
             Windows::Media::Capture::Frames::MediaFrameReference^ colorFrame,
             Windows::Media::Capture::Frames::MediaFrameReference^ depthFrame);
 
+    private: // private types
+        // Which Process method a RenderJob comes from.
+        enum class RenderJobKind
+        {
+            Color,
+            Depth,
+            Infrared,
+            DepthAndColor,
+        };
+
+        // A frame travelling through the render pipeline, and everything the stages produce from it.
+        struct RenderJob
+        {
+            RenderJobKind kind = RenderJobKind::Color;
+
+            // The frame to render; for DepthAndColor, the color frame.
+            Windows::Media::Capture::Frames::MediaFrameReference^ frame;
+            Windows::Media::Capture::Frames::MediaFrameReference^ depthFrame;
+
+            // DepthAndColor settings, read when the job is submitted.
+            CorrelationBackend backend = CorrelationBackend::ForwardRegistration;
+            float depthFadeStart = DefaultDepthFadeStart;
+            float depthFadeEnd = DefaultDepthFadeEnd;
+            DepthFadeReference fadeReference = DepthFadeReference::BuildPlate;
+            float plateFadeStartHeight = DefaultPlateFadeStartHeight;
+            float plateFadeEndHeight = DefaultPlateFadeEndHeight;
+
+            // Lower bound of the in-range mask, whose upper bound is depthFadeEnd.
+            float maskNearLimit = 0.0f;
+
+            UINT32 scale = 1;
+            CorrelationUpsampling upsampling = CorrelationUpsampling::NearestValid;
+            bool produceImage = true;
+            bool produceMask = false;
+            bool producePointCloud = false;
+            bool detectChanges = false;
+            bool filterDepthTemporally = false;
+            TemporalFilterSettings temporalFilterSettings;
+            bool filterDepthSpatially = false;
+            SpatialFilterSettings spatialFilterSettings;
+            std::shared_ptr<TsdfVolume> fusionVolume;
+            std::shared_ptr<LayerHeightMap> layerHeightMap;
+            RigidTransform cameraToVolume;
+            std::shared_ptr<const RegionOfInterest> regionOfInterest;
+
+            // The output bitmap, and its pixels while the DepthAndColor stages write to it.
+            Windows::Graphics::Imaging::SoftwareBitmap^ outputBitmap;
+            Windows::Graphics::Imaging::BitmapBuffer^ outputBuffer;
+            Windows::Foundation::IMemoryBufferReference^ outputReference;
+            ColorBGRA* outputPixels = nullptr;
+            UINT32 colorWidth = 0;
+            UINT32 colorHeight = 0;
+
+            // Depth behind every color pixel. Each job has its own, so that correlating the next frame
+            // doesn't overwrite the field this one is still being faded with.
+            std::vector<float> depth;
+
+            // The depth frame after temporal and spatial filtering, one row after another without padding. Empty if the
+            // frame isn't filtered.
+            std::vector<UINT16> filteredDepth;
+        };
+
     private: // private methods
 		/// <summary>
 		/// Transforms pixels of inputBitmap to an output bitmap using the supplied pixel transformation method.
+		/// ScanlineKernel is called as pixelTransformation(pixelWidth, inputRowBytes, outputRowBytes) for each
+		/// row, or for each span of a row inside region if that isn't nullptr; it is a template parameter so that
+		/// the kernel is inlined into the row loop. Output pixels outside region are transparent.
 		/// Returns nullptr if translation fails.
 		/// </summary>
-		static Windows::Graphics::Imaging::SoftwareBitmap^ TransformBitmap(
+		template<typename ScanlineKernel>
+		Windows::Graphics::Imaging::SoftwareBitmap^ TransformBitmap(
 			Windows::Graphics::Imaging::SoftwareBitmap^ inputBitmap,
-			TransformScanline pixelTransformation);
+			const RegionOfInterest* region,
+			ScanlineKernel pixelTransformation);
+
+        /// <summary>
+        /// TransformBitmap from pixels already in memory, inputStride bytes per row and inputPixelBytes per pixel.
+        /// </summary>
+        template<typename ScanlineKernel>
+        Windows::Graphics::Imaging::SoftwareBitmap^ TransformPixels(
+            byte* inputBytes,
+            int inputStride,
+            int inputPixelBytes,
+            int pixelWidth,
+            int pixelHeight,
+            const RegionOfInterest* region,
+            ScanlineKernel pixelTransformation);
+
+        /// <summary>
+        /// Returns the raw depth to pseudo-color table for depthScale, rebuilding it if the scale changed.
+        /// </summary>
+        const ColorBGRA* GetDepthColorTable(float depthScale);
+
+        /// <summary>
+        /// Converts a depth or infrared frame to a displayable pseudo-color bitmap. Returns nullptr on failure.
+        /// A depth frame is converted from filteredDepth instead of its own pixels when that isn't empty.
+        /// Only the pixels inside region are converted, unless it is nullptr.
+        /// </summary>
+        Windows::Graphics::Imaging::SoftwareBitmap^ ConvertDepthFrame(
+            Windows::Media::Capture::Frames::MediaFrameReference^ depthFrame,
+            const std::vector<UINT16>& filteredDepth,
+            const RegionOfInterest* region);
+        Windows::Graphics::Imaging::SoftwareBitmap^ ConvertInfraredFrame(
+            Windows::Media::Capture::Frames::MediaFrameReference^ infraredFrame,
+            const RegionOfInterest* region);
+
+        /// <summary>
+        /// Returns an idle job from the free list, or a new one.
+        /// </summary>
+        std::unique_ptr<RenderJob> AcquireRenderJob(RenderJobKind kind);
+
+        /// <summary>
+        /// Returns the job's output bitmap to the pool, if it still has one, and puts the job on the free list.
+        /// </summary>
+        void RecycleRenderJob(std::unique_ptr<RenderJob> job);
+
+        /// <summary>
+        /// Locks the job's output bitmap for writing and sets its outputPixels.
+        /// </summary>
+        bool LockOutputBitmap(RenderJob& job);
+        void UnlockOutputBitmap(RenderJob& job);
+
+        // Pipeline stages, in order. Each returns false to drop the job, and passes on jobs it has nothing to do for.
+
+        /// <summary>
+        /// Filters the depth of a Depth or DepthAndColor job, if requested, and produces the output bitmap:
+        /// a copy of the color frame or a pseudo-color conversion.
+        /// </summary>
+        bool ConvertFrame(RenderJob& job);
+
+        /// <summary>
+        /// Runs the job's depth frame through the requested filters into the job's filteredDepth.
+        /// Leaves filteredDepth empty if the frame isn't Gray16 depth.
+        /// </summary>
+        void FilterDepthFrame(RenderJob& job);
+
+        /// <summary>
+        /// Computes the depth behind every color pixel of a DepthAndColor job.
+        /// </summary>
+        bool CorrelateFrame(RenderJob& job);
+
+        /// <summary>
+        /// Builds and publishes the point cloud of a Depth or DepthAndColor job, and fuses its depth
+        /// into the fusion volume, if requested.
+        /// </summary>
+        bool ReconstructFrame(RenderJob& job);
+
+        /// <summary>
+        /// Updates the layer height map of a DepthAndColor job and measures its fade from the build plate,
+        /// if requested, and builds and publishes its in-range mask, if requested.
+        /// </summary>
+        bool AnalyzeFrame(RenderJob& job);
+
+        /// <summary>
+        /// Updates the build plate estimate from the job's depth field. Returns whether a plate is known.
+        /// </summary>
+        bool UpdateBedPlane(RenderJob& job);
 
         /// <summary>
-        /// Perform mapping of depth pixels to color pixels.
+        /// Replaces the job's depth field with the depth below the known build plate and sets the job's fade
+        /// range to the plate fade range.
         /// </summary>
-        Windows::Graphics::Imaging::SoftwareBitmap^ MapDepthToColor(
-            Windows::Media::Capture::Frames::VideoMediaFrame^ colorFrame,
-            Windows::Media::Capture::Frames::VideoMediaFrame^ depthFrame,
-            Windows::Media::Devices::Core::CameraIntrinsics^ colorCameraIntrinsics,
-            Windows::Perception::Spatial::SpatialCoordinateSystem^ colorCoordinateSystem,
-            Windows::Media::Devices::Core::DepthCorrelatedCoordinateMapper^ coordinateMapper);
+        void FadeFromBedPlane(RenderJob& job);
+
+        /// <summary>
+        /// Applies the depth fade to a DepthAndColor job and hands the output bitmap to the UI.
+        /// </summary>
+        bool PresentFrame(RenderJob& job);
+
+        /// <summary>
+        /// Fills depth with the depth behind every color pixel at 1/scale of the color resolution,
+        /// using the given backend, falling back to the coordinate mapper for frames forward registration
+        /// can't handle. Returns false if the frames can't be correlated. Forward registration
+        /// reads filteredDepth instead of the depth frame's pixels when it isn't empty. Unless region is nullptr,
+        /// only pixels inside it are correlated, and the depth outside it is NaN.
+        /// Must be called with m_pointBufferMutex held.
+        /// </summary>
+        bool CorrelateDepth(
+            CorrelationBackend backend,
+            Windows::Media::Capture::Frames::MediaFrameReference^ colorFrame,
+            Windows::Media::Capture::Frames::MediaFrameReference^ depthFrame,
+            const std::vector<UINT16>& filteredDepth,
+            const RegionOfInterest* region,
+            UINT32 scale,
+            std::vector<float>& depth);
+
+        /// <summary>
+        /// CorrelateDepth using DepthCorrelatedCoordinateMapper::UnprojectPoints on the center of every block
+        /// inside region.
+        /// </summary>
+        bool CorrelateWithCoordinateMapper(
+            Windows::Media::Capture::Frames::MediaFrameReference^ colorFrame,
+            Windows::Media::Capture::Frames::MediaFrameReference^ depthFrame,
+            const RegionOfInterest* region,
+            UINT32 scale,
+            std::vector<float>& depth);
+
+        /// <summary>
+        /// CorrelateDepth by forward-projecting the depth frame with DepthRegistration. Every depth pixel is
+        /// projected, since which of them land inside region is only known once they are.
+        /// Fails if the frames lack the intrinsics or coordinate systems it needs.
+        /// </summary>
+        bool RegisterDepthToColor(
+            Windows::Media::Capture::Frames::MediaFrameReference^ colorFrame,
+            Windows::Media::Capture::Frames::MediaFrameReference^ depthFrame,
+            const std::vector<UINT16>& filteredDepth,
+            const RegionOfInterest* region,
+            UINT32 scale,
+            std::vector<float>& depth);
+
+        /// <summary>
+        /// Upsamples a depth field computed at 1/scale to the color resolution, guided by colorPixels.
+        /// colorPixels may be nullptr, in which case nearest valid upsampling is used. Unless region is nullptr,
+        /// only the rows it covers are upsampled, and the depth outside it is NaN.
+        /// </summary>
+        void UpsampleDepth(
+            const std::vector<float>& lowResolutionDepth,
+            UINT32 scale,
+            CorrelationUpsampling upsampling,
+            const ColorBGRA* colorPixels,
+            UINT32 colorWidth,
+            UINT32 colorHeight,
+            const RegionOfInterest* region,
+            std::vector<float>& depth);
+
+        /// <summary>
+        /// Returns a premultiplied Bgra8 bitmap from the pool for the renderer's output.
+        /// </summary>
+        Windows::Graphics::Imaging::SoftwareBitmap^ CreateOutputBitmap(int pixelWidth, int pixelHeight);
+
+        /// <summary>
+        /// Copies inputBitmap into a premultiplied Bgra8 output bitmap, converting it if needed.
+        /// </summary>
+        Windows::Graphics::Imaging::SoftwareBitmap^ CopyToOutputBitmap(Windows::Graphics::Imaging::SoftwareBitmap^ inputBitmap);
 
         /// <summary>
         /// Buffer processed bitmap and render on UI.
@@ -78,16 +507,117 @@ namespace SDKTemplate
         Windows::UI::Xaml::Controls::Image^ m_imageElement;
         Windows::Graphics::Imaging::SoftwareBitmap^ m_backBuffer;
 
-        Platform::Array<Windows::Foundation::Point>^ m_colorSpacePoints;
-        Platform::Array<Windows::Foundation::Numerics::float3>^ m_depthSpacePoints;
+        // Color pixels handed to UnprojectPoints and the points it returns, for one color size, scale and
+        // region. The points are those of region's spans, in order, or of every pixel if region is nullptr.
+        struct UnprojectionGrid
+        {
+            Platform::Array<Windows::Foundation::Point>^ colorSpacePoints;
+            Platform::Array<Windows::Foundation::Numerics::float3>^ depthSpacePoints;
+            UINT32 colorWidth = 0;
+            UINT32 colorHeight = 0;
+            UINT32 scale = 0;
+            std::shared_ptr<const RowSpans> region;
+        };
+
+        // Full resolution and reduced resolution grids are kept apart so that the periodic
+        // full resolution comparison doesn't rebuild the reduced one.
+        UnprojectionGrid m_fullResolutionGrid;
+        UnprojectionGrid m_reducedResolutionGrid;
+
+        // Pseudo-color for every raw depth value, valid for m_depthColorTableScale.
+        std::vector<ColorBGRA> m_depthColorTable;
+        float m_depthColorTableScale = 0.0f;
+
+        // Forward registration state.
+        DepthRegistration m_depthRegistration;
+        std::atomic<CorrelationBackend> m_correlationBackend{ CorrelationBackend::ForwardRegistration };
+
+        // Depth fields: as correlated below color resolution, and at full resolution for comparison.
+        // The field at color resolution belongs to the RenderJob.
+        std::vector<float> m_correlatedDepth;
+        std::vector<float> m_fullResolutionDepth;
+        std::unique_ptr<JointBilateralWeights> m_jointBilateralWeights;
+        UINT64 m_correlatedFrames = 0;
+
+        // The published in-range mask, and a previously published one kept for reuse.
+        std::shared_ptr<DepthRangeMask> m_latestDepthRangeMask;
+        std::shared_ptr<DepthRangeMask> m_spareDepthRangeMask;
+
+        // Rays of the depth camera the point clouds are built and volumes fused with, the published cloud
+        // and a spare one.
+        std::shared_ptr<const RayTable> m_pointCloudRays;
+        std::shared_ptr<OrganizedPointCloud> m_latestPointCloud;
+        std::shared_ptr<OrganizedPointCloud> m_sparePointCloud;
+        std::atomic<bool> m_pointCloudEnabled{ false };
 
-        UINT32 m_previousBufferWidth = 0;
-        UINT32 m_previousBufferHeight = 0;
+        // Colored point clouds produced, which picks the row of tiles whose colors are refreshed.
+        UINT64 m_colorizedFrames = 0;
+
+        // Change detection state, used by the Reconstruct stage, and the published tile map and a spare one.
+        // The published map and the statistics are guarded by m_tileChangesMutex.
+        TileChangeDetector m_changeDetector;
+        std::shared_ptr<TileChangeMap> m_latestTileChanges;
+        std::shared_ptr<TileChangeMap> m_spareTileChanges;
+        TileChangeStatistics m_tileChangeStatistics;
+        std::atomic<bool> m_changeDetectionEnabled{ false };
+
+        // Depth filter state, used by the Convert stage, which sees the depth frames in order.
+        TemporalDepthFilter m_temporalFilter;
+        SpatialDepthFilter m_spatialFilter;
+
+        // Build plate estimation state, used by the Analyze stage. The color rays turn the depth field into points.
+        std::shared_ptr<const RayTable> m_colorRays;
+        BedPlaneEstimator m_bedPlaneEstimator;
+
+        // Settings and correlation statistics, guarded by m_settingsMutex.
+        float m_depthFadeStart = DefaultDepthFadeStart;
+        float m_depthFadeEnd = DefaultDepthFadeEnd;
+        DepthFadeReference m_fadeReference = DepthFadeReference::BuildPlate;
+        float m_plateFadeStartHeight = DefaultPlateFadeStartHeight;
+        float m_plateFadeEndHeight = DefaultPlateFadeEndHeight;
+        bool m_bedPlaneFound = false;
+        BedPlane m_bedPlane;
+        BedPlaneStatistics m_bedPlaneStatistics;
+        UINT32 m_correlationScale = 1;
+        CorrelationUpsampling m_correlationUpsampling = CorrelationUpsampling::NearestValid;
+        CorrelationOutput m_correlationOutput = CorrelationOutput::Image;
+        std::shared_ptr<TsdfVolume> m_fusionVolume;
+        std::shared_ptr<LayerHeightMap> m_layerHeightMap;
+        RigidTransform m_cameraToVolume;
+        bool m_temporalFilterEnabled = false;
+        TemporalFilterSettings m_temporalFilterSettings;
+        bool m_spatialFilterEnabled = false;
+        SpatialFilterSettings m_spatialFilterSettings;
+        std::shared_ptr<const RegionOfInterest> m_regionOfInterest;
+        double m_correlationMilliseconds = 0.0;
+        double m_correlationTimeSavedMilliseconds = 0.0;
+        double m_correlationMeanDepthError = 0.0;
+        double m_correlationCoverageMismatch = 0.0;
 
         bool m_taskRunning = false;
 
+        std::shared_ptr<ThreadPool> m_threadPool;
+
+        SoftwareBitmapPool m_outputBitmapPool;
+
+        std::atomic<UINT64> m_framesBuffered{ 0 };
+        std::atomic<UINT64> m_framesDropped{ 0 };
+        std::atomic<UINT64> m_bitmapAllocations{ 0 };
+        std::atomic<UINT64> m_bitmapCopies{ 0 };
+
     private: // private synchronization
         std::mutex m_pointBufferMutex;
+        mutable std::mutex m_settingsMutex;
+        mutable std::mutex m_depthRangeMaskMutex;
+        mutable std::mutex m_pointCloudMutex;
+        mutable std::mutex m_tileChangesMutex;
+        std::mutex m_renderJobMutex;
+
+    private: // render pipeline
+        std::vector<std::unique_ptr<RenderJob>> m_freeRenderJobs;
+
+        // Declared last, so its threads stop before anything they use is destroyed.
+        FramePipeline<std::unique_ptr<RenderJob>> m_pipeline;
 
     };
 } // CameraStreamCorrelation
\ No newline at end of file
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace SDKTemplate
+{
+    // Largest difference between the timestamps of matched frames, in 100ns ticks (15ms, about half a frame at 30fps).
+    constexpr int64_t DefaultFrameMatchTolerance = 150000;
+
+    // Counters describing how well the frames of different sources line up.
+    struct FrameSynchronizerStatistics
+    {
+        uint64_t matched = 0; // Frame sets emitted.
+        uint64_t dropped = 0; // Frames discarded without being part of a set.
+        uint64_t late = 0; // Frames that arrived with a timestamp older than their source's last emitted frame.
+    };
+
+    // Groups frames from several sources into sets captured at about the same time.
+    // Every source keeps a small ring of recent frames ordered by timestamp. When a frame arrives, it is
+    // matched with the nearest frame of every other enabled source; if all of them are within the tolerance,
+    // the set is emitted once and those frames, along with any older ones, leave the rings.
+    // Timestamps share one clock, e.g. MediaFrameReference::SystemRelativeTime in 100ns ticks.
+    // Frame is any copyable handle type. The synchronizer is not thread-safe; callers serialize AddFrame.
+    template<typename Frame, size_t SourceCount, size_t RingCapacity = 4>
+    class FrameSynchronizer
+    {
+    public:
+        // Frames of one set, indexed by source. Entries of disabled sources are empty.
+        typedef std::array<Frame, SourceCount> FrameSet;
+
+        explicit FrameSynchronizer(int64_t tolerance) : m_tolerance(tolerance)
+        {
+        }
+
+        /// <summary>
+        /// Sets the largest timestamp difference between a frame and the frames it is matched with.
+        /// </summary>
+        void SetTolerance(int64_t tolerance)
+        {
+            m_tolerance = tolerance;
+        }
+
+        /// <summary>
+        /// Sets which sources a set needs a frame from, as a bit per source index.
+        /// Frames buffered for sources that are no longer enabled are dropped.
+        /// </summary>
+        void SetEnabledSources(uint32_t enabledSources)
+        {
+            uint32_t disabled = m_enabledSources & ~enabledSources;
+            for (size_t source = 0; source < SourceCount; source++)
+            {
+                if (disabled & (1u << source))
+                {
+                    DropOlderThan(source, INT64_MAX);
+                }
+            }
+            m_enabledSources = enabledSources;
+        }
+
+        uint32_t GetEnabledSources() const { return m_enabledSources; }
+
+        /// <summary>
+        /// Adds a frame captured at timestamp by source. Returns true and fills frameSet when the frame
+        /// completes a set. Frames of sources that are not enabled are ignored.
+        /// </summary>
+        bool AddFrame(size_t source, int64_t timestamp, Frame frame, FrameSet& frameSet)
+        {
+            if (source >= SourceCount || !(m_enabledSources & (1u << source)))
+            {
+                return false;
+            }
+
+            // A set newer than this frame was already emitted, so it can't be part of one any more.
+            if (m_hasEmitted[source] && timestamp <= m_lastEmitted[source])
+            {
+                m_statistics.late++;
+                return false;
+            }
+
+            Insert(source, timestamp, std::move(frame));
+
+            // Any set that becomes possible now includes the new frame, because every earlier
+            // possible set was emitted as soon as it was complete.
+            std::array<size_t, SourceCount> matches;
+            for (size_t other = 0; other < SourceCount; other++)
+            {
+                if (!(m_enabledSources & (1u << other)))
+                {
+                    continue;
+                }
+
+                if (other == source)
+                {
+                    matches[other] = Find(source, timestamp);
+                    continue;
+                }
+
+                size_t nearest = Nearest(other, timestamp);
+                if (nearest == RingCapacity)
+                {
+                    return false;
+                }
+                matches[other] = nearest;
+            }
+
+            for (size_t other = 0; other < SourceCount; other++)
+            {
+                if (!(m_enabledSources & (1u << other)))
+                {
+                    frameSet[other] = Frame();
+                    continue;
+                }
+
+                Ring& ring = m_rings[other];
+                Entry& match = ring.entries[matches[other]];
+                frameSet[other] = std::move(match.frame);
+                m_lastEmitted[other] = match.timestamp;
+                m_hasEmitted[other] = true;
+
+                // Remove the matched frame; anything older can no longer be emitted.
+                size_t older = matches[other];
+                m_statistics.dropped += older;
+                Erase(other, older + 1);
+            }
+
+            m_statistics.matched++;
+            return true;
+        }
+
+        FrameSynchronizerStatistics GetStatistics() const { return m_statistics; }
+
+        /// <summary>
+        /// Drops every buffered frame and forgets the last emitted timestamps, e.g. when streaming restarts.
+        /// The counters are kept.
+        /// </summary>
+        void Reset()
+        {
+            for (size_t source = 0; source < SourceCount; source++)
+            {
+                Erase(source, m_rings[source].count);
+                m_hasEmitted[source] = false;
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            int64_t timestamp = 0;
+            Frame frame = Frame();
+        };
+
+        // Entries ordered from oldest to newest.
+        struct Ring
+        {
+            std::array<Entry, RingCapacity> entries;
+            size_t count = 0;
+        };
+
+        void Insert(size_t source, int64_t timestamp, Frame frame)
+        {
+            Ring& ring = m_rings[source];
+
+            // A full ring loses its oldest frame.
+            if (ring.count == RingCapacity)
+            {
+                m_statistics.dropped++;
+                Erase(source, 1);
+            }
+
+            // Frames of one source nearly always arrive in order, so this rarely moves anything.
+            size_t position = ring.count;
+            while (position > 0 && ring.entries[position - 1].timestamp > timestamp)
+            {
+                ring.entries[position] = std::move(ring.entries[position - 1]);
+                position--;
+            }
+            ring.entries[position].timestamp = timestamp;
+            ring.entries[position].frame = std::move(frame);
+            ring.count++;
+        }
+
+        // Removes the count oldest entries of a ring.
+        void Erase(size_t source, size_t count)
+        {
+            Ring& ring = m_rings[source];
+            for (size_t i = count; i < ring.count; i++)
+            {
+                ring.entries[i - count] = std::move(ring.entries[i]);
+            }
+            for (size_t i = ring.count - count; i < ring.count; i++)
+            {
+                ring.entries[i].frame = Frame();
+            }
+            ring.count -= count;
+        }
+
+        void DropOlderThan(size_t source, int64_t timestamp)
+        {
+            Ring& ring = m_rings[source];
+            size_t count = 0;
+            while (count < ring.count && ring.entries[count].timestamp < timestamp)
+            {
+                count++;
+            }
+            m_statistics.dropped += count;
+            Erase(source, count);
+        }
+
+        size_t Find(size_t source, int64_t timestamp) const
+        {
+            const Ring& ring = m_rings[source];
+            for (size_t i = 0; i < ring.count; i++)
+            {
+                if (ring.entries[i].timestamp == timestamp)
+                {
+                    return i;
+                }
+            }
+            return RingCapacity;
+        }
+
+        // Index of the entry closest to timestamp and within the tolerance, or RingCapacity if there is none.
+        // On a tie the older entry wins, so the choice doesn't depend on arrival order.
+        size_t Nearest(size_t source, int64_t timestamp) const
+        {
+            const Ring& ring = m_rings[source];
+            size_t nearest = RingCapacity;
+            int64_t nearestDistance = m_tolerance;
+            for (size_t i = 0; i < ring.count; i++)
+            {
+                int64_t distance = ring.entries[i].timestamp - timestamp;
+                distance = (distance < 0) ? -distance : distance;
+                if (distance < nearestDistance || (distance == nearestDistance && nearest == RingCapacity))
+                {
+                    nearest = i;
+                    nearestDistance = distance;
+                }
+            }
+            return nearest;
+        }
+
+        int64_t m_tolerance;
+        uint32_t m_enabledSources = 0;
+        std::array<Ring, SourceCount> m_rings;
+        std::array<int64_t, SourceCount> m_lastEmitted = {};
+        std::array<bool, SourceCount> m_hasEmitted = {};
+        FrameSynchronizerStatistics m_statistics;
+    };
+} // SDKTemplate
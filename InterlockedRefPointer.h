@@ -0,0 +1,16 @@
+#pragma once
+
+namespace SDKTemplate
+{
+    // InterlockedExchange for reference pointer types.
+    template<typename T, typename U>
+    T^ InterlockedExchangeRefPointer(T^* target, U value)
+    {
+        static_assert(sizeof(T^) == sizeof(void*), "InterlockedExchangePointer is the wrong size");
+        T^ exchange = value;
+        void** rawExchange = reinterpret_cast<void**>(&exchange);
+        void** rawTarget = reinterpret_cast<void**>(target);
+        *rawExchange = static_cast<IInspectable*>(InterlockedExchangePointer(rawTarget, *rawExchange));
+        return exchange;
+    }
+} // SDKTemplate
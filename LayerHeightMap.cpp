@@ -0,0 +1,356 @@
+#include "LayerHeightMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace SDKTemplate;
+
+// Probe pixel values that are not pixel indices.
+static constexpr uint32_t unprojectedPixel = UINT32_MAX;
+static constexpr uint32_t outsideImage = UINT32_MAX - 1;
+
+// The grid is only placed on a plate the optical axis meets at less than about 84 degrees from its normal.
+static constexpr float minAxisCosine = 0.1f;
+
+static float Dot(const float* a, const float* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+LayerHeightMap::LayerHeightMap(const LayerHeightMapSettings& settings) :
+    m_settings(settings)
+{
+    const size_t cellCount = size_t(m_settings.width) * m_settings.height;
+    m_cells.resize(cellCount);
+    m_probeHeights.resize(cellCount);
+    m_probePixels.resize(cellCount);
+    m_pendingFrames.resize(cellCount);
+
+    const size_t binCount = static_cast<size_t>(std::ceil(m_settings.maxHistogramHeight / m_settings.histogramBinSize)) + 1;
+    m_histogram.resize(binCount);
+    m_cumulativeHistogram.resize(binCount);
+
+    ClearCells();
+}
+
+void LayerHeightMap::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ClearCells();
+    m_anchored = false;
+    m_frame = 0;
+    m_statistics = LayerHeightMapStatistics();
+}
+
+void LayerHeightMap::ClearCells()
+{
+    LayerHeightCell unobserved;
+    unobserved.height = std::numeric_limits<float>::quiet_NaN();
+    unobserved.peakHeight = unobserved.height;
+    std::fill(m_cells.begin(), m_cells.end(), unobserved);
+
+    // Unobserved columns are first sampled where they meet the plate.
+    std::fill(m_probeHeights.begin(), m_probeHeights.end(), 0.0f);
+    std::fill(m_probePixels.begin(), m_probePixels.end(), unprojectedPixel);
+    std::fill(m_pendingFrames.begin(), m_pendingFrames.end(), uint8_t(0));
+
+    std::fill(m_histogram.begin(), m_histogram.end(), 0u);
+    std::fill(m_cumulativeHistogram.begin(), m_cumulativeHistogram.end(), 0u);
+    m_histogramChanged = false;
+
+    m_maxCell = 0;
+    m_maxCellLowered = false;
+    m_statistics.cellsObserved = 0;
+}
+
+bool LayerHeightMap::Anchor(const BedPlane& plane)
+{
+    const float* normal = plane.normal;
+    if (!(normal[2] < -minAxisCosine))
+    {
+        return false;
+    }
+
+    // The grid's x axis is the camera's x axis laid onto the plate, and its y axis completes the frame.
+    float axisLength = std::sqrt(1.0f - normal[0] * normal[0]);
+    m_axisX[0] = (1.0f - normal[0] * normal[0]) / axisLength;
+    m_axisX[1] = -normal[0] * normal[1] / axisLength;
+    m_axisX[2] = -normal[0] * normal[2] / axisLength;
+    m_axisY[0] = normal[1] * m_axisX[2] - normal[2] * m_axisX[1];
+    m_axisY[1] = normal[2] * m_axisX[0] - normal[0] * m_axisX[2];
+    m_axisY[2] = normal[0] * m_axisX[1] - normal[1] * m_axisX[0];
+
+    // The optical axis meets the plate at depth -offset / normal z, which is the center of the grid.
+    const float centerDepth = -plane.offset / normal[2];
+    const float halfWidth = 0.5f * m_settings.width * m_settings.cellSize;
+    const float halfHeight = 0.5f * m_settings.height * m_settings.cellSize;
+    for (int i = 0; i < 3; i++)
+    {
+        m_origin[i] = -halfWidth * m_axisX[i] - halfHeight * m_axisY[i];
+    }
+    m_origin[2] += centerDepth;
+
+    m_plane = plane;
+    m_anchored = true;
+    return true;
+}
+
+bool LayerHeightMap::HasPlateMoved(const BedPlane& plane) const
+{
+    const float gridWidth = m_settings.width * m_settings.cellSize;
+    const float gridHeight = m_settings.height * m_settings.cellSize;
+    for (int corner = 0; corner < 4; corner++)
+    {
+        const float alongX = (corner & 1) ? gridWidth : 0.0f;
+        const float alongY = (corner & 2) ? gridHeight : 0.0f;
+        float point[3];
+        for (int i = 0; i < 3; i++)
+        {
+            point[i] = m_origin[i] + alongX * m_axisX[i] + alongY * m_axisY[i];
+        }
+        if (!(std::fabs(Dot(plane.normal, point) + plane.offset) <= m_settings.planeResetDistance))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t LayerHeightMap::ProjectProbe(float cellX, float cellY, float probeHeight, const PinholeIntrinsics& intrinsics) const
+{
+    float probe[3];
+    for (int i = 0; i < 3; i++)
+    {
+        probe[i] = m_origin[i] + cellX * m_axisX[i] + cellY * m_axisY[i] + probeHeight * m_plane.normal[i];
+    }
+    if (!(probe[2] > 0.0f))
+    {
+        return outsideImage;
+    }
+
+    float pixelX;
+    float pixelY;
+    ProjectToPixel(intrinsics, probe[0] / probe[2], probe[1] / probe[2], pixelX, pixelY);
+    const float u = std::floor(pixelX + 0.5f);
+    const float v = std::floor(pixelY + 0.5f);
+    if (!(u >= 0.0f && v >= 0.0f && u < intrinsics.imageWidth && v < intrinsics.imageHeight))
+    {
+        return outsideImage;
+    }
+    return static_cast<uint32_t>(v) * intrinsics.imageWidth + static_cast<uint32_t>(u);
+}
+
+void LayerHeightMap::MoveProbe(size_t cell, float probeHeight)
+{
+    m_probeHeights[cell] = probeHeight;
+    m_probePixels[cell] = unprojectedPixel;
+}
+
+size_t LayerHeightMap::GetBin(float height) const
+{
+    if (!(height > 0.0f))
+    {
+        return 0;
+    }
+    return (std::min)(static_cast<size_t>(height / m_settings.histogramBinSize), m_histogram.size() - 1);
+}
+
+void LayerHeightMap::ChangeCell(size_t cell, float height)
+{
+    LayerHeightCell& state = m_cells[cell];
+    const float previousHeight = state.height;
+    if (std::isnan(previousHeight))
+    {
+        state.peakHeight = height;
+        m_statistics.cellsObserved++;
+    }
+    else
+    {
+        m_histogram[GetBin(previousHeight)]--;
+    }
+
+    state.height = height;
+    state.peakHeight = (std::max)(state.peakHeight, height);
+    state.changes++;
+    state.lastChangeFrame = m_frame;
+    m_histogram[GetBin(height)]++;
+    m_histogramChanged = true;
+
+    // A new highest cell is a comparison. Only the highest cell getting lower needs a search, after the frame.
+    if (cell == m_maxCell)
+    {
+        m_maxCellLowered |= (height < previousHeight);
+    }
+    else if (!(m_cells[m_maxCell].height >= height))
+    {
+        m_maxCell = cell;
+    }
+}
+
+void LayerHeightMap::Update(const BedPlane& plane, const RayTable& rays, const float* depth)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_frame++;
+    m_statistics.framesProcessed++;
+    m_statistics.cellsChangedLastFrame = 0;
+
+    if (m_anchored && HasPlateMoved(plane))
+    {
+        ClearCells();
+        m_anchored = false;
+        m_statistics.resets++;
+    }
+    if (!m_anchored && !Anchor(plane))
+    {
+        return;
+    }
+
+    const PinholeIntrinsics& intrinsics = rays.GetIntrinsics();
+    if (intrinsics != m_probeIntrinsics)
+    {
+        std::fill(m_probePixels.begin(), m_probePixels.end(), unprojectedPixel);
+        m_probeIntrinsics = intrinsics;
+    }
+
+    const float* rayX = rays.GetRayX();
+    const float* rayY = rays.GetRayY();
+    const float* normal = m_plane.normal;
+    const float cellSize = m_settings.cellSize;
+
+    size_t changed = 0;
+    for (uint32_t y = 0; y < m_settings.height; y++)
+    {
+        for (uint32_t x = 0; x < m_settings.width; x++)
+        {
+            const size_t cell = size_t(y) * m_settings.width + x;
+            const float cellX = (x + 0.5f) * cellSize;
+            const float cellY = (y + 0.5f) * cellSize;
+
+            // Sample the depth where the cell's column is seen at its probe height. The pixel only moves when
+            // the probe height does, so a static scene reads one cached index per cell.
+            uint32_t pixel = m_probePixels[cell];
+            if (pixel == unprojectedPixel)
+            {
+                pixel = ProjectProbe(cellX, cellY, m_probeHeights[cell], intrinsics);
+                m_probePixels[cell] = pixel;
+            }
+            if (pixel == outsideImage)
+            {
+                continue;
+            }
+
+            const float pointDepth = depth[pixel];
+            if (!(pointDepth > 0.0f))
+            {
+                continue;
+            }
+
+            const float point[3] = { rayX[pixel] * pointDepth, rayY[pixel] * pointDepth, pointDepth };
+            const float measuredHeight = Dot(normal, point) + m_plane.offset;
+
+            // A surface seen away from the column belongs to another cell, either because it occludes the
+            // column or because the column changed height. The next frame samples at the new height instead.
+            const float relative[3] = { point[0] - m_origin[0], point[1] - m_origin[1], point[2] - m_origin[2] };
+            if (!(std::fabs(Dot(m_axisX, relative) - cellX) <= cellSize &&
+                std::fabs(Dot(m_axisY, relative) - cellY) <= cellSize))
+            {
+                MoveProbe(cell, measuredHeight);
+                m_pendingFrames[cell] = 0;
+                continue;
+            }
+
+            if (std::fabs(measuredHeight - m_cells[cell].height) <= m_settings.noiseThreshold)
+            {
+                m_pendingFrames[cell] = 0;
+                continue;
+            }
+            if (++m_pendingFrames[cell] < m_settings.confirmFrames)
+            {
+                continue;
+            }
+
+            m_pendingFrames[cell] = 0;
+            MoveProbe(cell, measuredHeight);
+            ChangeCell(cell, measuredHeight);
+            changed++;
+        }
+    }
+
+    if (m_maxCellLowered)
+    {
+        for (size_t cell = 0; cell < m_cells.size(); cell++)
+        {
+            if (m_cells[cell].height > m_cells[m_maxCell].height || std::isnan(m_cells[m_maxCell].height))
+            {
+                m_maxCell = cell;
+            }
+        }
+        m_maxCellLowered = false;
+    }
+
+    if (m_histogramChanged)
+    {
+        uint32_t total = 0;
+        for (size_t bin = 0; bin < m_histogram.size(); bin++)
+        {
+            total += m_histogram[bin];
+            m_cumulativeHistogram[bin] = total;
+        }
+        m_histogramChanged = false;
+    }
+
+    m_statistics.cellsChangedLastFrame = changed;
+    m_statistics.cellsChanged += changed;
+}
+
+float LayerHeightMap::GetMaxHeight() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_statistics.cellsObserved > 0 ? m_cells[m_maxCell].height : std::numeric_limits<float>::quiet_NaN();
+}
+
+float LayerHeightMap::GetHeightPercentile(float fraction) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const size_t observed = m_statistics.cellsObserved;
+    if (observed == 0)
+    {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+
+    // The first bin whose running count reaches the requested share of the observed cells.
+    const float clamped = (std::min)((std::max)(fraction, 0.0f), 1.0f);
+    const uint32_t rank = (std::max)(1u, static_cast<uint32_t>(std::ceil(clamped * observed)));
+    const size_t bin = std::lower_bound(m_cumulativeHistogram.begin(), m_cumulativeHistogram.end(), rank) - m_cumulativeHistogram.begin();
+    return (std::min)((bin + 1) * m_settings.histogramBinSize, m_cells[m_maxCell].height);
+}
+
+LayerHeightCell LayerHeightMap::GetCell(uint32_t x, uint32_t y) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_cells[size_t(y) * m_settings.width + x];
+}
+
+void LayerHeightMap::CopyHeights(std::vector<float>& heights) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    heights.resize(m_cells.size());
+    for (size_t cell = 0; cell < m_cells.size(); cell++)
+    {
+        heights[cell] = m_cells[cell].height;
+    }
+}
+
+LayerHeightMapStatistics LayerHeightMap::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_statistics;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "BedPlane.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // Size and sensitivity of a LayerHeightMap.
+    struct LayerHeightMapSettings
+    {
+        // Cells of the grid, and their edge length in meters. The grid is centered where the color camera's
+        // optical axis meets the build plate.
+        uint32_t width = 160;
+        uint32_t height = 160;
+        float cellSize = 0.002f;
+
+        // A cell only changes once its measured height differs from its current height by more than the
+        // noise threshold, in meters, on this many frames in a row.
+        float noiseThreshold = 0.002f;
+        uint32_t confirmFrames = 2;
+
+        // Bins of the height histogram, from 0 up to maxHistogramHeight. Heights outside go to the end bins.
+        float histogramBinSize = 0.0005f;
+        float maxHistogramHeight = 0.25f;
+
+        // The map starts over when the plate moves by more than this distance, in meters, under the grid.
+        float planeResetDistance = 0.003f;
+    };
+
+    // What a LayerHeightMap knows about one cell.
+    struct LayerHeightCell
+    {
+        float height = 0.0f; // Current height above the plate in meters, NaN until the cell is first observed.
+        float peakHeight = 0.0f; // Highest height the cell has had.
+        uint32_t changes = 0; // Times the height changed.
+        uint64_t lastChangeFrame = 0; // Frame of the last change, counted from 1 since the map was reset.
+    };
+
+    // Counters of a LayerHeightMap.
+    struct LayerHeightMapStatistics
+    {
+        uint64_t framesProcessed = 0;
+        size_t cellsObserved = 0;
+        size_t cellsChangedLastFrame = 0;
+        uint64_t cellsChanged = 0;
+        uint64_t resets = 0; // Restarts because the plate moved.
+    };
+
+    // Grid of heights above the build plate, kept up to date over a whole print.
+    // The grid lies in the plane of the plate. Every frame, the depth is read where each cell's column is seen
+    // at the height it was last measured at, so a frame costs one sample per cell rather than one per pixel.
+    // Until that height moves beyond the noise threshold, the sampled pixel is cached and the cell is not written.
+    // A histogram of the cell heights and the highest cell are maintained as cells change, so the maximum is
+    // a lookup and a percentile a search over the fixed number of bins, however large the grid.
+    // Only standard C++ is used, so the map can be exercised off-device with synthetic depth.
+    class LayerHeightMap
+    {
+    public:
+        explicit LayerHeightMap(const LayerHeightMapSettings& settings = LayerHeightMapSettings());
+
+        LayerHeightMap(const LayerHeightMap&) = delete;
+        LayerHeightMap& operator=(const LayerHeightMap&) = delete;
+
+        const LayerHeightMapSettings& GetSettings() const { return m_settings; }
+
+        /// <summary>
+        /// Forgets every cell. The grid is placed again on the plate of the next update.
+        /// </summary>
+        void Reset();
+
+        /// <summary>
+        /// Updates the cells from a depth field with one depth in meters per ray of rays, in the camera space
+        /// plane was fit in. Depths that are not greater than 0, including NaN, are invalid.
+        /// </summary>
+        void Update(const BedPlane& plane, const RayTable& rays, const float* depth);
+
+        /// <summary>
+        /// Returns the height of the highest cell, or NaN if no cell was observed yet.
+        /// </summary>
+        float GetMaxHeight() const;
+
+        /// <summary>
+        /// Returns a height that the given fraction, between 0 and 1, of the observed cells don't exceed,
+        /// rounded up to the histogram's bin size, or NaN if no cell was observed yet.
+        /// </summary>
+        float GetHeightPercentile(float fraction) const;
+
+        /// <summary>
+        /// Returns the cell at column x and row y, which must be inside the grid.
+        /// </summary>
+        LayerHeightCell GetCell(uint32_t x, uint32_t y) const;
+
+        /// <summary>
+        /// Copies the current height of every cell, row by row, NaN where a cell was not observed yet.
+        /// </summary>
+        void CopyHeights(std::vector<float>& heights) const;
+
+        LayerHeightMapStatistics GetStatistics() const;
+
+    private:
+        /// <summary>
+        /// Places the grid on plane. Returns false if the camera doesn't look at the plane.
+        /// </summary>
+        bool Anchor(const BedPlane& plane);
+
+        /// <summary>
+        /// Returns whether plane is farther than planeResetDistance from the anchored plane under a grid corner.
+        /// </summary>
+        bool HasPlateMoved(const BedPlane& plane) const;
+
+        /// <summary>
+        /// Returns the index of the pixel the cell's column projects to at probeHeight, or outsideImage.
+        /// </summary>
+        uint32_t ProjectProbe(float cellX, float cellY, float probeHeight, const PinholeIntrinsics& intrinsics) const;
+
+        void MoveProbe(size_t cell, float probeHeight);
+        void ChangeCell(size_t cell, float height);
+        void ClearCells();
+        size_t GetBin(float height) const;
+
+        const LayerHeightMapSettings m_settings;
+
+        // Guards everything below, so updates and queries don't overlap.
+        mutable std::mutex m_mutex;
+
+        // The plane the grid was placed on, and the grid's axes in camera space. Cell (x, y) lies at
+        // m_origin + (x + 0.5) * cellSize * m_axisX + (y + 0.5) * cellSize * m_axisY.
+        bool m_anchored = false;
+        BedPlane m_plane;
+        float m_origin[3];
+        float m_axisX[3];
+        float m_axisY[3];
+
+        std::vector<LayerHeightCell> m_cells;
+
+        // Height at which each cell's column is sampled, the pixel that height projects to, and frames in a row
+        // the cell's measurement differed. Pixels are projected again when the probe height or intrinsics change.
+        std::vector<float> m_probeHeights;
+        std::vector<uint32_t> m_probePixels;
+        std::vector<uint8_t> m_pendingFrames;
+        PinholeIntrinsics m_probeIntrinsics;
+
+        // Observed cells per height bin, and their running sum, rebuilt after frames that changed a cell.
+        std::vector<uint32_t> m_histogram;
+        std::vector<uint32_t> m_cumulativeHistogram;
+        bool m_histogramChanged = false;
+
+        size_t m_maxCell = 0;
+        bool m_maxCellLowered = false;
+
+        uint64_t m_frame = 0;
+        LayerHeightMapStatistics m_statistics;
+    };
+} // SDKTemplate
@@ -11,35 +11,50 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+
 namespace SDKTemplate
 {
-    template<typename T, UINT32 LookupTableSize>
+    template<typename T, uint32_t LookupTableSize>
     class LookupTable
     {
     public:
 
-        // Function type for lookup table generation.
-        typedef std::function<T(UINT32, UINT32)> LookupTableGenerator;
-
         /// <summary>
         /// The values of the lookup table are generated using a function passed into the constructor.
+        /// The generator is called as Generator(index, LookupTableSize). When it is a constexpr function
+        /// the table can be declared constexpr and is computed by the compiler instead of at startup.
         /// </summary>
-        LookupTable(LookupTableGenerator Generator)
+        template<typename LookupTableGenerator>
+        constexpr LookupTable(LookupTableGenerator Generator) : m_lookuptable{}
         {
-            for (int i = 0; i < LookupTableSize; i++)
+            for (uint32_t i = 0; i < LookupTableSize; i++)
             {
                 // Generate values for lookup table
                 m_lookuptable[i] = Generator(i, LookupTableSize);
             }
         }
 
-        T GetValue(float value)
+        constexpr T GetValue(float value) const
+        {
+            // Clamp before truncating so that out of range values saturate instead of overflowing the int conversion.
+            float scaled = (std::min)((std::max)(0.0f, value * LookupTableSize), static_cast<float>(LookupTableSize - 1));
+            return m_lookuptable[static_cast<int>(scaled)];
+        }
+
+        // Integer-indexed lookup for callers that already have an index in [0, LookupTableSize).
+        constexpr T GetValueAtIndex(uint32_t index) const
         {
-            int index = static_cast<int>(value * LookupTableSize);
-            index = min(max(0, index), LookupTableSize - 1);
             return m_lookuptable[index];
         }
 
+        // Raw access to the table, for kernels that index it directly.
+        constexpr const T* Data() const
+        {
+            return m_lookuptable;
+        }
+
     private:
         T m_lookuptable[LookupTableSize];
     };
@@ -0,0 +1,263 @@
+#include "PointCloud.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define POINTCLOUD_X86
+#include <immintrin.h>
+// MSVC accepts any intrinsic in any function; GCC and Clang need the instruction set enabled per function,
+// since the file is built for the baseline processor and the variants are only called where supported.
+#if defined(__GNUC__)
+#define POINTCLOUD_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+#define POINTCLOUD_TARGET(instructionSet)
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define POINTCLOUD_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+using namespace SDKTemplate;
+
+// Computes count points of one row. Every variant converts the raw depth to float exactly and then
+// performs the same two multiplies per coordinate, so the results match bit for bit.
+typedef void(*PointRowKernel)(const uint16_t* depth, const float* rayX, const float* rayY, float depthScale,
+    float* x, float* y, float* z, size_t count);
+
+static void GeneratePointRowScalar(const uint16_t* depth, const float* rayX, const float* rayY, float depthScale,
+    float* x, float* y, float* z, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        float pointZ = static_cast<float>(depth[i]) * depthScale;
+        x[i] = rayX[i] * pointZ;
+        y[i] = rayY[i] * pointZ;
+        z[i] = pointZ;
+    }
+}
+
+#if defined(POINTCLOUD_X86)
+
+// Processes 4 pixels per iteration. Raw depths are zero-extended to 32 bits, so the conversion to float is exact.
+POINTCLOUD_TARGET("sse4.1")
+static void GeneratePointRowSse41(const uint16_t* depth, const float* rayX, const float* rayY, float depthScale,
+    float* x, float* y, float* z, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(depthScale);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i raw = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(depth + i)));
+        __m128 pointZ = _mm_mul_ps(_mm_cvtepi32_ps(raw), scale);
+        _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(rayX + i), pointZ));
+        _mm_storeu_ps(y + i, _mm_mul_ps(_mm_loadu_ps(rayY + i), pointZ));
+        _mm_storeu_ps(z + i, pointZ);
+    }
+    GeneratePointRowScalar(depth + i, rayX + i, rayY + i, depthScale, x + i, y + i, z + i, count - i);
+}
+
+// Processes 8 pixels per iteration.
+POINTCLOUD_TARGET("avx2")
+static void GeneratePointRowAvx2(const uint16_t* depth, const float* rayX, const float* rayY, float depthScale,
+    float* x, float* y, float* z, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(depthScale);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i raw = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i)));
+        __m256 pointZ = _mm256_mul_ps(_mm256_cvtepi32_ps(raw), scale);
+        _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(rayX + i), pointZ));
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_loadu_ps(rayY + i), pointZ));
+        _mm256_storeu_ps(z + i, pointZ);
+    }
+    GeneratePointRowScalar(depth + i, rayX + i, rayY + i, depthScale, x + i, y + i, z + i, count - i);
+}
+
+#elif defined(POINTCLOUD_NEON)
+
+// Processes 4 pixels per iteration.
+static void GeneratePointRowNeon(const uint16_t* depth, const float* rayX, const float* rayY, float depthScale,
+    float* x, float* y, float* z, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(depthScale);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t pointZ = vmulq_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(depth + i))), scale);
+        vst1q_f32(x + i, vmulq_f32(vld1q_f32(rayX + i), pointZ));
+        vst1q_f32(y + i, vmulq_f32(vld1q_f32(rayY + i), pointZ));
+        vst1q_f32(z + i, pointZ);
+    }
+    GeneratePointRowScalar(depth + i, rayX + i, rayY + i, depthScale, x + i, y + i, z + i, count - i);
+}
+
+#endif
+
+static PointRowKernel SelectPointRowKernel(const CpuFeatures& features)
+{
+#if defined(POINTCLOUD_X86)
+    if (features.Avx2)
+    {
+        return GeneratePointRowAvx2;
+    }
+    if (features.Sse41)
+    {
+        return GeneratePointRowSse41;
+    }
+#elif defined(POINTCLOUD_NEON)
+    if (features.Neon)
+    {
+        return GeneratePointRowNeon;
+    }
+#endif
+
+    (void)features;
+    return GeneratePointRowScalar;
+}
+
+static const PointRowKernel generatePointRow = SelectPointRowKernel(GetCpuFeatures());
+
+void OrganizedPointCloud::Resize(uint32_t width, uint32_t height, bool withColors)
+{
+    m_width = width;
+    m_height = height;
+    m_hasColors = withColors;
+
+    const size_t count = GetCount();
+    m_x.resize(count);
+    m_y.resize(count);
+    m_z.resize(count);
+    m_colors.resize(withColors ? count : 0);
+}
+
+// Fills cloud with the points of depth, one row at a time with generateRow.
+static void GeneratePointCloudRows(PointRowKernel generateRow, const RayTable& rays, const uint16_t* depth, size_t depthRowStride,
+    float depthScale, OrganizedPointCloud& cloud)
+{
+    const uint32_t width = cloud.GetWidth();
+    const uint32_t height = cloud.GetHeight();
+
+    // The rays and the cloud are both dense, so only the depth image's rows are strided.
+    for (uint32_t v = 0; v < height; v++)
+    {
+        const size_t rowStart = size_t(v) * width;
+        generateRow(depth + v * depthRowStride, rays.GetRayX() + rowStart, rays.GetRayY() + rowStart, depthScale,
+            cloud.GetX() + rowStart, cloud.GetY() + rowStart, cloud.GetZ() + rowStart, width);
+    }
+}
+
+void SDKTemplate::GeneratePointCloud(const RayTable& rays, const uint16_t* depth, size_t depthRowStride, float depthScale, OrganizedPointCloud& cloud)
+{
+    GeneratePointCloudRows(generatePointRow, rays, depth, depthRowStride, depthScale, cloud);
+}
+
+void SDKTemplate::GeneratePointCloud(const RayTable& rays, const uint16_t* depth, size_t depthRowStride, float depthScale, OrganizedPointCloud& cloud,
+    const CpuFeatures& features)
+{
+    GeneratePointCloudRows(SelectPointRowKernel(features), rays, depth, depthRowStride, depthScale, cloud);
+}
+
+// Colors count points of cloud starting at first.
+static void ColorizePoints(
+    const RigidTransform& depthToColor,
+    const PinholeIntrinsics& colorIntrinsics,
+    const uint32_t* colorPixels,
+    size_t colorRowStride,
+    OrganizedPointCloud& cloud,
+    size_t first,
+    size_t count)
+{
+    const float* r = depthToColor.rotation;
+    const float* t = depthToColor.translation;
+    const float* pointX = cloud.GetX();
+    const float* pointY = cloud.GetY();
+    const float* pointZ = cloud.GetZ();
+    uint32_t* colors = cloud.GetColors();
+
+    for (size_t i = first; i < first + count; i++)
+    {
+        colors[i] = 0;
+        if (!cloud.IsValid(i))
+        {
+            continue;
+        }
+
+        const float x = r[0] * pointX[i] + r[1] * pointY[i] + r[2] * pointZ[i] + t[0];
+        const float y = r[3] * pointX[i] + r[4] * pointY[i] + r[5] * pointZ[i] + t[1];
+        const float z = r[6] * pointX[i] + r[7] * pointY[i] + r[8] * pointZ[i] + t[2];
+        if (z <= 0.0f)
+        {
+            continue;
+        }
+
+        float pixelX;
+        float pixelY;
+        ProjectToPixel(colorIntrinsics, x / z, y / z, pixelX, pixelY);
+
+        // Pixel centers are at integer coordinates, so rounding picks the nearest pixel.
+        const float u = std::floor(pixelX + 0.5f);
+        const float v = std::floor(pixelY + 0.5f);
+        if (u >= 0.0f && v >= 0.0f && u < colorIntrinsics.imageWidth && v < colorIntrinsics.imageHeight)
+        {
+            colors[i] = colorPixels[static_cast<size_t>(v) * colorRowStride + static_cast<size_t>(u)];
+        }
+    }
+}
+
+void SDKTemplate::ColorizePointCloud(
+    const RigidTransform& depthToColor,
+    const PinholeIntrinsics& colorIntrinsics,
+    const uint32_t* colorPixels,
+    size_t colorRowStride,
+    OrganizedPointCloud& cloud,
+    const TileChangeMap* changedTiles,
+    const OrganizedPointCloud* previousCloud,
+    uint32_t refreshInterval,
+    uint64_t refreshPhase)
+{
+    const uint32_t width = cloud.GetWidth();
+    const uint32_t height = cloud.GetHeight();
+    if (changedTiles == nullptr || previousCloud == nullptr || !previousCloud->HasColors() ||
+        previousCloud->GetWidth() != width || previousCloud->GetHeight() != height ||
+        changedTiles->GetTilesX() != (width + ChangeTileSize - 1) / ChangeTileSize ||
+        changedTiles->GetTilesY() != (height + ChangeTileSize - 1) / ChangeTileSize)
+    {
+        ColorizePoints(depthToColor, colorIntrinsics, colorPixels, colorRowStride, cloud, 0, cloud.GetCount());
+        return;
+    }
+
+    // Rows of unchanged tiles are copied, which is much cheaper than projecting their points.
+    const uint32_t* previousColors = previousCloud->GetColors();
+    uint32_t* colors = cloud.GetColors();
+    const uint32_t refreshRow = (refreshInterval > 0) ? static_cast<uint32_t>(refreshPhase % refreshInterval) : 0;
+    for (uint32_t v = 0; v < height; v++)
+    {
+        const uint32_t tileY = v / ChangeTileSize;
+        const bool refresh = (refreshInterval > 0) && (tileY % refreshInterval == refreshRow);
+        for (uint32_t tileX = 0; tileX < changedTiles->GetTilesX(); tileX++)
+        {
+            const uint32_t u = tileX * ChangeTileSize;
+            const size_t first = size_t(v) * width + u;
+            const size_t count = (std::min)(ChangeTileSize, width - u);
+            if (refresh || changedTiles->IsChanged(tileX, tileY))
+            {
+                ColorizePoints(depthToColor, colorIntrinsics, colorPixels, colorRowStride, cloud, first, count);
+            }
+            else
+            {
+                std::memcpy(colors + first, previousColors + first, count * sizeof(uint32_t));
+            }
+        }
+    }
+}
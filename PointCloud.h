@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "DepthRegistration.h"
+#include "TileChangeDetector.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // One point per depth pixel, in the depth camera's space (+x right, +y down, +z forward, in meters).
+    // The cloud keeps the pixel grid, so point (u, v) is at index v * width + u and neighbors in the image
+    // are neighbors in the cloud. x, y and z are separate planes, so consumers that only need one coordinate,
+    // such as a height map, read contiguous memory. Pixels without depth have a point at the origin.
+    class OrganizedPointCloud
+    {
+    public:
+        /// <summary>
+        /// Sets the size of the cloud, reusing the planes' memory when it doesn't grow. withColors keeps
+        /// a color plane as well. The contents are undefined until the cloud is generated.
+        /// </summary>
+        void Resize(uint32_t width, uint32_t height, bool withColors);
+
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        size_t GetCount() const { return size_t(m_width) * m_height; }
+
+        const float* GetX() const { return m_x.data(); }
+        const float* GetY() const { return m_y.data(); }
+        const float* GetZ() const { return m_z.data(); }
+        float* GetX() { return m_x.data(); }
+        float* GetY() { return m_y.data(); }
+        float* GetZ() { return m_z.data(); }
+
+        bool IsValid(size_t index) const { return m_z[index] > 0.0f; }
+
+        /// <summary>
+        /// Color of every point as packed 8-bit BGRA, with an alpha of 0 where the color camera doesn't see
+        /// the point. Empty if the cloud has no colors.
+        /// </summary>
+        bool HasColors() const { return m_hasColors; }
+        const uint32_t* GetColors() const { return m_colors.data(); }
+        uint32_t* GetColors() { return m_colors.data(); }
+
+    private:
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        bool m_hasColors = false;
+        std::vector<float> m_x;
+        std::vector<float> m_y;
+        std::vector<float> m_z;
+        std::vector<uint32_t> m_colors;
+    };
+
+    /// <summary>
+    /// Turns a raw 16 bit depth image into the points of cloud, which must already have the rays' size:
+    /// z = raw * depthScale, x = rayX * z and y = rayY * z. depth has depthRowStride samples per row and a raw
+    /// value of 0 is invalid. Uses the widest SIMD variant the processor supports; every variant produces
+    /// the same output.
+    /// </summary>
+    void GeneratePointCloud(const RayTable& rays, const uint16_t* depth, size_t depthRowStride, float depthScale, OrganizedPointCloud& cloud);
+
+    /// <summary>
+    /// GeneratePointCloud using the widest SIMD variant among features, so that the variants can be compared
+    /// and timed against each other. features must not name extensions the processor lacks.
+    /// </summary>
+    void GeneratePointCloud(const RayTable& rays, const uint16_t* depth, size_t depthRowStride, float depthScale, OrganizedPointCloud& cloud,
+        const CpuFeatures& features);
+
+    /// <summary>
+    /// Fills the color plane of cloud by projecting every valid point into a color image taken with
+    /// colorIntrinsics and picking the nearest pixel. colorPixels holds packed BGRA pixels with
+    /// colorRowStride pixels per row. If changedTiles and a colored previousCloud of the same size are given,
+    /// points in the tiles of the depth image that didn't change keep the color they had in previousCloud.
+    /// A color change the depth doesn't show, such as lighting, would then never reach those points, so if
+    /// refreshInterval isn't 0, every refreshInterval-th row of tiles, starting at row refreshPhase modulo
+    /// refreshInterval, is projected again anyway. Calls with consecutive phases refresh every tile within
+    /// refreshInterval calls.
+    /// </summary>
+    void ColorizePointCloud(
+        const RigidTransform& depthToColor,
+        const PinholeIntrinsics& colorIntrinsics,
+        const uint32_t* colorPixels,
+        size_t colorRowStride,
+        OrganizedPointCloud& cloud,
+        const TileChangeMap* changedTiles = nullptr,
+        const OrganizedPointCloud* previousCloud = nullptr,
+        uint32_t refreshInterval = 0,
+        uint64_t refreshPhase = 0);
+} // SDKTemplate
@@ -0,0 +1,349 @@
+#include "PseudoColorKernels.h"
+#include "LookupTable.h"
+
+#include <array>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PSEUDOCOLOR_X86
+#include <immintrin.h>
+// MSVC accepts any intrinsic in any function; GCC and Clang need the instruction set enabled per function,
+// since the file is built for the baseline processor and the variants are only called where supported.
+#if defined(__GNUC__)
+#define PSEUDOCOLOR_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+#define PSEUDOCOLOR_TARGET(instructionSet)
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PSEUDOCOLOR_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+using namespace SDKTemplate;
+
+// Colors to map values to based on intensity.
+static constexpr std::array<ColorBGRA, 9> colorRamp = {
+	ColorBGRA{ 0xFF, 0x7F, 0x00, 0x00 },
+	ColorBGRA{ 0xFF, 0xFF, 0x00, 0x00 },
+	ColorBGRA{ 0xFF, 0xFF, 0x7F, 0x00 },
+	ColorBGRA{ 0xFF, 0xFF, 0xFF, 0x00 },
+	ColorBGRA{ 0xFF, 0x7F, 0xFF, 0x7F },
+	ColorBGRA{ 0xFF, 0x00, 0xFF, 0xFF },
+	ColorBGRA{ 0xFF, 0x00, 0x7F, 0xFF },
+	ColorBGRA{ 0xFF, 0x00, 0x00, 0xFF },
+	ColorBGRA{ 0xFF, 0x00, 0x00, 0x7F }
+};
+
+// Interpolates between the colors of a ramp. Any constexpr std::array of colors can be used as a ramp,
+// so an additional named colormap is one ramp array plus one constexpr LookupTable built from it.
+template<size_t RampSize>
+static constexpr ColorBGRA ColorRampInterpolation(const std::array<ColorBGRA, RampSize>& ramp, float value)
+{
+	static_assert(RampSize >= 2, "color ramp table is too small");
+
+	// Map value to surrounding indexes on the color ramp.
+	size_t rampSteps = RampSize - 1;
+	float scaled = value * rampSteps;
+	int integer = static_cast<int>(scaled);
+	size_t index = (std::min)(static_cast<size_t>((std::max)(0, integer)), rampSteps - 1);
+	const ColorBGRA& prev = ramp[index];
+	const ColorBGRA& next = ramp[index + 1];
+
+	// Set color based on a ratio of how closely it matches the surrounding colors.
+	uint32_t alpha = static_cast<uint32_t>((scaled - integer) * 255);
+	uint32_t beta = 255 - alpha;
+	return {
+		static_cast<uint8_t>((prev.A * beta + next.A * alpha) / 255), // Alpha
+		static_cast<uint8_t>((prev.R * beta + next.R * alpha) / 255), // Red
+		static_cast<uint8_t>((prev.G * beta + next.G * alpha) / 255), // Green
+		static_cast<uint8_t>((prev.B * beta + next.B * alpha) / 255)  // Blue
+	};
+}
+
+// powf is not constexpr, so integer powers are computed by repeated squaring.
+// The result can differ from powf in the last bit of the mantissa.
+static constexpr float ConstexprPower(float base, uint32_t exponent)
+{
+	float result = 1.0f;
+	while (exponent != 0)
+	{
+		if (exponent & 1)
+		{
+			result *= base;
+		}
+		base *= base;
+		exponent >>= 1;
+	}
+	return result;
+}
+
+// Initializes pseudo-color look up table for depth pixels
+static constexpr ColorBGRA GeneratePseudoColorLookupTable(uint32_t index, uint32_t size)
+{
+	return ColorRampInterpolation(colorRamp, static_cast<float>(index) / static_cast<float>(size));
+}
+
+// Initializes the pseudo-color look up table for infrared pixels
+static constexpr ColorBGRA GenerateInfraredRampLookupTable(uint32_t index, uint32_t size)
+{
+	const float value = static_cast<float>(index) / static_cast<float>(size);
+
+	// Adjust to increase color change between lower values in infrared images.
+	const float alpha = ConstexprPower(1 - value, 12);
+
+	return ColorRampInterpolation(colorRamp, alpha);
+}
+
+static constexpr uint32_t colorLookupTableSize = 1024;
+
+// The tables are constant expressions, so they are baked into read-only data instead of being built during static initialization.
+static constexpr LookupTable<ColorBGRA, colorLookupTableSize> colorLookupTable(GeneratePseudoColorLookupTable);
+static constexpr LookupTable<ColorBGRA, colorLookupTableSize> infraredLookupTable(GenerateInfraredRampLookupTable);
+
+// Initializes the infrared look up table for 8 bit pixels, one entry per possible sample.
+static constexpr ColorBGRA GenerateInfrared8BitLookupTable(uint32_t index, uint32_t size)
+{
+	return infraredLookupTable.GetValue(index / static_cast<float>(UINT8_MAX));
+}
+
+static constexpr LookupTable<ColorBGRA, UINT8_MAX + 1> infrared8BitLookupTable(GenerateInfrared8BitLookupTable);
+
+static_assert(colorLookupTableSize == 1024, "InfraredIndexFor16Bit assumes a 1024-entry infrared table");
+
+static constexpr bool IsColor(const ColorBGRA& color, uint8_t b, uint8_t g, uint8_t r, uint8_t a)
+{
+	return color.B == b && color.G == g && color.R == r && color.A == a;
+}
+
+// static_assert only accepts constant expressions, so these fail to compile if a table stops being built by the compiler.
+static_assert(IsColor(colorLookupTable.GetValueAtIndex(0), 0x00, 0x00, 0x7F, 0xFF), "depth table starts on the first ramp color");
+static_assert(IsColor(colorLookupTable.GetValueAtIndex(colorLookupTableSize / 2), 0x7F, 0xFF, 0x7F, 0xFF), "depth table is on the middle ramp color half way");
+static_assert(IsColor(infraredLookupTable.GetValueAtIndex(0), 0xFF, 0x00, 0x00, 0xFF), "infrared table starts on the last ramp color");
+static_assert(IsColor(infrared8BitLookupTable.GetValueAtIndex(0), 0xFF, 0x00, 0x00, 0xFF), "8 bit infrared table starts where the infrared table does");
+static_assert(IsColor(infrared8BitLookupTable.GetValueAtIndex(UINT8_MAX), 0x00, 0x00, 0x7F, 0xFF), "8 bit infrared table ends where the infrared table does");
+
+static ColorBGRA PseudoColor(float value)
+{
+	return colorLookupTable.GetValue(value);
+}
+
+
+// Visualize space in front of your desktop, in meters.
+static constexpr float depthMin = 0.5f;   // 0.5 meters
+static constexpr float depthMax = 4.0f;  // 4 meters
+static constexpr float depthOneMin = 1.0f / depthMin;
+static constexpr float depthRange = 1.0f / depthMax - depthOneMin;
+
+// Reference implementation of the depth kernel. The SIMD variants below must match it bit for bit,
+// so they perform the same IEEE operations in the same order and only differ in how many pixels
+// they process at a time.
+static void PseudoColorForDepthScalar(int pixelWidth, const uint16_t* inputRow, ColorBGRA* outputRow, float depthScale)
+{
+	for (int x = 0; x < pixelWidth; x++)
+	{
+		float depth = static_cast<float>(inputRow[x]) * depthScale;
+
+		// Map invalid depth values to transparent pixels.
+		// This happens when depth information cannot be calculated, e.g. when objects are too close.
+		if (depth == 0)
+		{
+			outputRow[x] = { 0 };
+		}
+		else
+		{
+			float alpha = (1.0f / depth - depthOneMin) / depthRange;
+			outputRow[x] = PseudoColor(alpha * alpha);
+		}
+	}
+}
+
+#if defined(PSEUDOCOLOR_X86)
+
+// Converts 4 depth values to lookup table indexes. Division is done with divps rather than
+// the rcpps estimate so that the result is identical to the scalar path.
+PSEUDOCOLOR_TARGET("sse4.1")
+static inline __m128i DepthToIndexSse(__m128i raw, __m128 scale, __m128 one, __m128 oneMin, __m128 range, __m128 size, __m128 maxIndex, __m128i& invalid)
+{
+	__m128 depth = _mm_mul_ps(_mm_cvtepi32_ps(raw), scale);
+	invalid = _mm_castps_si128(_mm_cmpeq_ps(depth, _mm_setzero_ps()));
+
+	__m128 alpha = _mm_div_ps(_mm_sub_ps(_mm_div_ps(one, depth), oneMin), range);
+	__m128 scaled = _mm_mul_ps(_mm_mul_ps(alpha, alpha), size);
+	return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), maxIndex));
+}
+
+// SSE4.1 has no gather, so the four table reads are done with scalar loads.
+PSEUDOCOLOR_TARGET("sse4.1")
+static inline __m128i GatherSse(const int* table, __m128i index)
+{
+	return _mm_setr_epi32(
+		table[_mm_cvtsi128_si32(index)],
+		table[_mm_extract_epi32(index, 1)],
+		table[_mm_extract_epi32(index, 2)],
+		table[_mm_extract_epi32(index, 3)]);
+}
+
+// Processes 8 pixels per iteration as two 4-lane halves.
+PSEUDOCOLOR_TARGET("sse4.1")
+static void PseudoColorForDepthSse41(int pixelWidth, const uint16_t* inputRow, ColorBGRA* outputRow, float depthScale)
+{
+	const int* table = reinterpret_cast<const int*>(colorLookupTable.Data());
+	const __m128 scale = _mm_set1_ps(depthScale);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 oneMin = _mm_set1_ps(depthOneMin);
+	const __m128 range = _mm_set1_ps(depthRange);
+	const __m128 size = _mm_set1_ps(static_cast<float>(colorLookupTableSize));
+	const __m128 maxIndex = _mm_set1_ps(static_cast<float>(colorLookupTableSize - 1));
+
+	int x = 0;
+	for (; x + 8 <= pixelWidth; x += 8)
+	{
+		__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow + x));
+
+		__m128i invalidLow, invalidHigh;
+		__m128i indexLow = DepthToIndexSse(_mm_cvtepu16_epi32(raw), scale, one, oneMin, range, size, maxIndex, invalidLow);
+		__m128i indexHigh = DepthToIndexSse(_mm_cvtepu16_epi32(_mm_srli_si128(raw, 8)), scale, one, oneMin, range, size, maxIndex, invalidHigh);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(outputRow + x), _mm_andnot_si128(invalidLow, GatherSse(table, indexLow)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(outputRow + x + 4), _mm_andnot_si128(invalidHigh, GatherSse(table, indexHigh)));
+	}
+
+	PseudoColorForDepthScalar(pixelWidth - x, inputRow + x, outputRow + x, depthScale);
+}
+
+// Processes 8 pixels per iteration and reads the colors with a hardware gather.
+PSEUDOCOLOR_TARGET("avx2")
+static void PseudoColorForDepthAvx2(int pixelWidth, const uint16_t* inputRow, ColorBGRA* outputRow, float depthScale)
+{
+	const int* table = reinterpret_cast<const int*>(colorLookupTable.Data());
+	const __m256 scale = _mm256_set1_ps(depthScale);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 oneMin = _mm256_set1_ps(depthOneMin);
+	const __m256 range = _mm256_set1_ps(depthRange);
+	const __m256 size = _mm256_set1_ps(static_cast<float>(colorLookupTableSize));
+	const __m256 maxIndex = _mm256_set1_ps(static_cast<float>(colorLookupTableSize - 1));
+
+	int x = 0;
+	for (; x + 8 <= pixelWidth; x += 8)
+	{
+		__m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inputRow + x));
+		__m256 depth = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(raw)), scale);
+		__m256i invalid = _mm256_castps_si256(_mm256_cmp_ps(depth, _mm256_setzero_ps(), _CMP_EQ_OQ));
+
+		__m256 alpha = _mm256_div_ps(_mm256_sub_ps(_mm256_div_ps(one, depth), oneMin), range);
+		__m256 scaled = _mm256_mul_ps(_mm256_mul_ps(alpha, alpha), size);
+		__m256i index = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), maxIndex));
+
+		__m256i color = _mm256_i32gather_epi32(table, index, sizeof(ColorBGRA));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(outputRow + x), _mm256_andnot_si256(invalid, color));
+	}
+
+	PseudoColorForDepthScalar(pixelWidth - x, inputRow + x, outputRow + x, depthScale);
+}
+
+#elif defined(PSEUDOCOLOR_NEON)
+
+// Processes 8 pixels per iteration as two 4-lane halves. AArch64 has a true vector divide,
+// which keeps the output identical to the scalar path.
+static void PseudoColorForDepthNeon(int pixelWidth, const uint16_t* inputRow, ColorBGRA* outputRow, float depthScale)
+{
+	const uint32_t* table = reinterpret_cast<const uint32_t*>(colorLookupTable.Data());
+	const float32x4_t scale = vdupq_n_f32(depthScale);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t oneMin = vdupq_n_f32(depthOneMin);
+	const float32x4_t range = vdupq_n_f32(depthRange);
+	const float32x4_t size = vdupq_n_f32(static_cast<float>(colorLookupTableSize));
+	const float32x4_t maxIndex = vdupq_n_f32(static_cast<float>(colorLookupTableSize - 1));
+
+	int x = 0;
+	for (; x + 8 <= pixelWidth; x += 8)
+	{
+		uint16x8_t raw = vld1q_u16(inputRow + x);
+		uint32x4_t halves[2] = { vmovl_u16(vget_low_u16(raw)), vmovl_u16(vget_high_u16(raw)) };
+
+		for (int half = 0; half < 2; half++)
+		{
+			float32x4_t depth = vmulq_f32(vcvtq_f32_u32(halves[half]), scale);
+			uint32x4_t invalid = vceqq_f32(depth, vdupq_n_f32(0.0f));
+
+			float32x4_t alpha = vdivq_f32(vsubq_f32(vdivq_f32(one, depth), oneMin), range);
+			float32x4_t scaled = vmulq_f32(vmulq_f32(alpha, alpha), size);
+			int32x4_t index = vcvtq_s32_f32(vminq_f32(vmaxq_f32(scaled, vdupq_n_f32(0.0f)), maxIndex));
+
+			uint32x4_t color = vdupq_n_u32(table[vgetq_lane_s32(index, 0)]);
+			color = vsetq_lane_u32(table[vgetq_lane_s32(index, 1)], color, 1);
+			color = vsetq_lane_u32(table[vgetq_lane_s32(index, 2)], color, 2);
+			color = vsetq_lane_u32(table[vgetq_lane_s32(index, 3)], color, 3);
+
+			vst1q_u32(reinterpret_cast<uint32_t*>(outputRow + x + half * 4), vbicq_u32(color, invalid));
+		}
+	}
+
+	PseudoColorForDepthScalar(pixelWidth - x, inputRow + x, outputRow + x, depthScale);
+}
+
+#endif
+
+typedef void(*DepthKernel)(int, const uint16_t*, ColorBGRA*, float);
+
+static DepthKernel SelectDepthKernel(const CpuFeatures& features)
+{
+#if defined(PSEUDOCOLOR_X86)
+	if (features.Avx2)
+	{
+		return PseudoColorForDepthAvx2;
+	}
+	if (features.Sse41)
+	{
+		return PseudoColorForDepthSse41;
+	}
+#elif defined(PSEUDOCOLOR_NEON)
+	if (features.Neon)
+	{
+		return PseudoColorForDepthNeon;
+	}
+#endif
+
+	(void)features;
+	return PseudoColorForDepthScalar;
+}
+
+// Picked once at startup so the per-row call is a plain indirect call.
+static const DepthKernel depthKernel = SelectDepthKernel(GetCpuFeatures());
+
+void SDKTemplate::PseudoColorForDepth(int pixelWidth, uint8_t* inputRowBytes, uint8_t* outputRowBytes, float depthScale)
+{
+	depthKernel(pixelWidth, reinterpret_cast<const uint16_t*>(inputRowBytes), reinterpret_cast<ColorBGRA*>(outputRowBytes), depthScale);
+}
+
+void SDKTemplate::PseudoColorForDepth(int pixelWidth, uint8_t* inputRowBytes, uint8_t* outputRowBytes, float depthScale,
+	const CpuFeatures& features)
+{
+	SelectDepthKernel(features)(pixelWidth, reinterpret_cast<const uint16_t*>(inputRowBytes), reinterpret_cast<ColorBGRA*>(outputRowBytes), depthScale);
+}
+
+void SDKTemplate::BuildDepthColorTable(float depthScale, ColorBGRA* depthColorTable)
+{
+	// Run every possible raw value through the depth kernel once, so the table matches it exactly.
+	std::vector<uint16_t> rawValues(DepthColorTableSize);
+	for (uint32_t i = 0; i < DepthColorTableSize; i++)
+	{
+		rawValues[i] = static_cast<uint16_t>(i);
+	}
+
+	depthKernel(DepthColorTableSize, rawValues.data(), depthColorTable, depthScale);
+}
+
+const ColorBGRA* SDKTemplate::GetInfraredColorTable()
+{
+	return infraredLookupTable.Data();
+}
+
+const ColorBGRA* SDKTemplate::GetInfrared8BitColorTable()
+{
+	return infrared8BitLookupTable.Data();
+}
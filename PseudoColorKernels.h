@@ -0,0 +1,107 @@
+#pragma once
+
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace SDKTemplate
+{
+    // Structure used to access colors stored in 8-bit BGRA format.
+    struct ColorBGRA
+    {
+        uint8_t B, G, R, A;
+    };
+
+    /// <summary>
+    /// Maps each pixel in a scanline from a 16 bit depth value to a pseudo-color pixel.
+    /// Uses the widest SIMD variant the processor supports; every variant produces the same output.
+    /// </summary>
+    void PseudoColorForDepth(int pixelWidth, uint8_t* inputRowBytes, uint8_t* outputRowBytes, float depthScale);
+
+    /// <summary>
+    /// PseudoColorForDepth using the widest SIMD variant among features, so that the variants can be compared
+    /// and timed against each other. features must not name extensions the processor lacks.
+    /// </summary>
+    void PseudoColorForDepth(int pixelWidth, uint8_t* inputRowBytes, uint8_t* outputRowBytes, float depthScale,
+        const CpuFeatures& features);
+
+    // Number of entries in a table indexed by raw 16 bit depth values.
+    constexpr uint32_t DepthColorTableSize = 65536;
+
+    /// <summary>
+    /// Fills depthColorTable with the pseudo-color of every raw depth value for the given depth scale,
+    /// so that DepthTableKernel can replace PseudoColorForDepth with a single load per pixel.
+    /// </summary>
+    void BuildDepthColorTable(float depthScale, ColorBGRA* depthColorTable);
+
+    /// <summary>
+    /// Returns the 1024-entry infrared pseudo-color table.
+    /// </summary>
+    const ColorBGRA* GetInfraredColorTable();
+
+    /// <summary>
+    /// Returns the infrared pseudo-color table with one entry per 8 bit sample.
+    /// </summary>
+    const ColorBGRA* GetInfrared8BitColorTable();
+
+    // Integer equivalent of the 1024-entry table index for value / UINT16_MAX.
+    // value * 1024 / 65535 is value * 65537 / 2^22; plain value >> 6 differs only at 65471, where
+    // the float path rounds up to the last entry, and the +96 bias reproduces that rounding.
+    inline uint32_t InfraredIndexFor16Bit(uint16_t value)
+    {
+        uint32_t index = static_cast<uint32_t>((static_cast<uint64_t>(value) * 65537 + 96) >> 22);
+        return (std::min)(index, 1023u);
+    }
+
+    // The scanline kernels below are function objects rather than functions so that
+    // FrameRenderer::TransformBitmap can inline them into its row loop.
+
+    // Maps each pixel in a scanline from a 16 bit depth value to a pseudo-color pixel
+    // using a table created by BuildDepthColorTable.
+    struct DepthTableKernel
+    {
+        const ColorBGRA* depthColorTable;
+
+        void operator()(int pixelWidth, uint8_t* inputRowBytes, uint8_t* outputRowBytes) const
+        {
+            const uint16_t* inputRow = reinterpret_cast<const uint16_t*>(inputRowBytes);
+            ColorBGRA* outputRow = reinterpret_cast<ColorBGRA*>(outputRowBytes);
+            for (int x = 0; x < pixelWidth; x++)
+            {
+                outputRow[x] = depthColorTable[inputRow[x]];
+            }
+        }
+    };
+
+    // Maps each pixel in a scanline from a 16 bit infrared value to a pseudo-color pixel.
+    struct Infrared16BitKernel
+    {
+        const ColorBGRA* infraredColorTable = GetInfraredColorTable();
+
+        void operator()(int pixelWidth, uint8_t* inputRowBytes, uint8_t* outputRowBytes) const
+        {
+            const uint16_t* inputRow = reinterpret_cast<const uint16_t*>(inputRowBytes);
+            ColorBGRA* outputRow = reinterpret_cast<ColorBGRA*>(outputRowBytes);
+            for (int x = 0; x < pixelWidth; x++)
+            {
+                outputRow[x] = infraredColorTable[InfraredIndexFor16Bit(inputRow[x])];
+            }
+        }
+    };
+
+    // Maps each pixel in a scanline from a 8 bit infrared value to a pseudo-color pixel.
+    struct Infrared8BitKernel
+    {
+        const ColorBGRA* infraredColorTable = GetInfrared8BitColorTable();
+
+        void operator()(int pixelWidth, uint8_t* inputRowBytes, uint8_t* outputRowBytes) const
+        {
+            ColorBGRA* outputRow = reinterpret_cast<ColorBGRA*>(outputRowBytes);
+            for (int x = 0; x < pixelWidth; x++)
+            {
+                outputRow[x] = infraredColorTable[inputRowBytes[x]];
+            }
+        }
+    };
+} // SDKTemplate
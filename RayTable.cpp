@@ -0,0 +1,162 @@
+#include "RayTable.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+using namespace SDKTemplate;
+
+// Alignment of each ray plane: a cache line, which also covers every SIMD load width.
+static constexpr size_t rayAlignment = 64;
+
+// Newton iterations used to invert the distortion model. Starting from the distorted point,
+// the error is far below a thousandth of a pixel after a handful of steps.
+static constexpr int undistortIterations = 8;
+
+bool SDKTemplate::operator==(const PinholeIntrinsics& left, const PinholeIntrinsics& right)
+{
+    return left.imageWidth == right.imageWidth &&
+        left.imageHeight == right.imageHeight &&
+        left.focalLengthX == right.focalLengthX &&
+        left.focalLengthY == right.focalLengthY &&
+        left.principalPointX == right.principalPointX &&
+        left.principalPointY == right.principalPointY &&
+        left.radialK1 == right.radialK1 &&
+        left.radialK2 == right.radialK2 &&
+        left.radialK3 == right.radialK3 &&
+        left.tangentialP1 == right.tangentialP1 &&
+        left.tangentialP2 == right.tangentialP2;
+}
+
+void SDKTemplate::ProjectToPixel(const PinholeIntrinsics& intrinsics, float x, float y, float& pixelX, float& pixelY)
+{
+    float r2 = x * x + y * y;
+    float radial = 1.0f + r2 * (intrinsics.radialK1 + r2 * (intrinsics.radialK2 + r2 * intrinsics.radialK3));
+    float distortedX = x * radial + 2.0f * intrinsics.tangentialP1 * x * y + intrinsics.tangentialP2 * (r2 + 2.0f * x * x);
+    float distortedY = y * radial + intrinsics.tangentialP1 * (r2 + 2.0f * y * y) + 2.0f * intrinsics.tangentialP2 * x * y;
+
+    pixelX = intrinsics.focalLengthX * distortedX + intrinsics.principalPointX;
+    pixelY = intrinsics.focalLengthY * distortedY + intrinsics.principalPointY;
+}
+
+PinholeIntrinsics SDKTemplate::ScaleIntrinsics(const PinholeIntrinsics& intrinsics, uint32_t scale)
+{
+    // Original pixel u lies at reduced coordinate (u - (scale - 1) / 2) / scale.
+    const float inverseScale = 1.0f / scale;
+    const float blockCenter = (scale - 1) * 0.5f;
+
+    PinholeIntrinsics scaled = intrinsics;
+    scaled.imageWidth = (intrinsics.imageWidth + scale - 1) / scale;
+    scaled.imageHeight = (intrinsics.imageHeight + scale - 1) / scale;
+    scaled.focalLengthX = intrinsics.focalLengthX * inverseScale;
+    scaled.focalLengthY = intrinsics.focalLengthY * inverseScale;
+    scaled.principalPointX = (intrinsics.principalPointX - blockCenter) * inverseScale;
+    scaled.principalPointY = (intrinsics.principalPointY - blockCenter) * inverseScale;
+    return scaled;
+}
+
+void RayTable::AlignedDeleter::operator()(float* memory) const
+{
+#if defined(_MSC_VER)
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+void RayTable::Allocate()
+{
+    // Pad the x plane so the y plane starts on an aligned boundary as well.
+    const size_t floatsPerLine = rayAlignment / sizeof(float);
+    const size_t planeFloats = (GetCount() + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+    const size_t bytes = (std::max)(planeFloats, floatsPerLine) * 2 * sizeof(float);
+
+    void* memory = nullptr;
+#if defined(_MSC_VER)
+    memory = _aligned_malloc(bytes, rayAlignment);
+#else
+    if (posix_memalign(&memory, rayAlignment, bytes) != 0)
+    {
+        memory = nullptr;
+    }
+#endif
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    m_storage.reset(static_cast<float*>(memory));
+    m_rayX = m_storage.get();
+    m_rayY = m_storage.get() + planeFloats;
+}
+
+RayTable::RayTable(const PinholeIntrinsics& intrinsics) : m_intrinsics(intrinsics)
+{
+    Allocate();
+
+    const PinholeIntrinsics& k = m_intrinsics;
+    for (uint32_t v = 0; v < k.imageHeight; v++)
+    {
+        for (uint32_t u = 0; u < k.imageWidth; u++)
+        {
+            const float distortedX = (u - k.principalPointX) / k.focalLengthX;
+            const float distortedY = (v - k.principalPointY) / k.focalLengthY;
+
+            // Solve distort(x, y) = distorted with Newton's method. Plain fixed-point iteration diverges
+            // near the image corners for lenses with a strong negative k2, which depth cameras often have.
+            float x = distortedX;
+            float y = distortedY;
+            for (int i = 0; i < undistortIterations; i++)
+            {
+                float r2 = x * x + y * y;
+                float radial = 1.0f + r2 * (k.radialK1 + r2 * (k.radialK2 + r2 * k.radialK3));
+                float radialSlope = k.radialK1 + r2 * (2.0f * k.radialK2 + r2 * 3.0f * k.radialK3);
+
+                float errorX = x * radial + 2.0f * k.tangentialP1 * x * y + k.tangentialP2 * (r2 + 2.0f * x * x) - distortedX;
+                float errorY = y * radial + k.tangentialP1 * (r2 + 2.0f * y * y) + 2.0f * k.tangentialP2 * x * y - distortedY;
+
+                float dxdx = radial + 2.0f * x * x * radialSlope + 2.0f * k.tangentialP1 * y + 6.0f * k.tangentialP2 * x;
+                float dydy = radial + 2.0f * y * y * radialSlope + 6.0f * k.tangentialP1 * y + 2.0f * k.tangentialP2 * x;
+                float dxdy = 2.0f * x * y * radialSlope + 2.0f * k.tangentialP1 * x + 2.0f * k.tangentialP2 * y;
+
+                float determinant = dxdx * dydy - dxdy * dxdy;
+                if (determinant == 0.0f)
+                {
+                    break;
+                }
+                x -= (dydy * errorX - dxdy * errorY) / determinant;
+                y -= (dxdx * errorY - dxdy * errorX) / determinant;
+            }
+
+            size_t index = size_t(v) * k.imageWidth + u;
+            m_rayX[index] = x;
+            m_rayY[index] = y;
+        }
+    }
+}
+
+RayTable::RayTable(const PinholeIntrinsics& intrinsics, const float* rayX, const float* rayY) : m_intrinsics(intrinsics)
+{
+    Allocate();
+    memcpy(m_rayX, rayX, GetCount() * sizeof(float));
+    memcpy(m_rayY, rayY, GetCount() * sizeof(float));
+}
+
+void RayTable::Unproject(const float* depth, float* pointX, float* pointY) const
+{
+    const float* rayX = m_rayX;
+    const float* rayY = m_rayY;
+    const size_t count = GetCount();
+
+    // No branches or cross-iteration dependencies, so the compiler vectorizes this loop.
+    for (size_t i = 0; i < count; i++)
+    {
+        pointX[i] = rayX[i] * depth[i];
+        pointY[i] = rayY[i] * depth[i];
+    }
+}
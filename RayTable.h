@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace SDKTemplate
+{
+    // Pinhole camera with Brown-Conrady lens distortion, using the same parameters as
+    // Windows::Media::Devices::Core::CameraIntrinsics. Pixel coordinates are in pixels of the full image.
+    struct PinholeIntrinsics
+    {
+        uint32_t imageWidth = 0;
+        uint32_t imageHeight = 0;
+        float focalLengthX = 0.0f;
+        float focalLengthY = 0.0f;
+        float principalPointX = 0.0f;
+        float principalPointY = 0.0f;
+        float radialK1 = 0.0f;
+        float radialK2 = 0.0f;
+        float radialK3 = 0.0f;
+        float tangentialP1 = 0.0f;
+        float tangentialP2 = 0.0f;
+    };
+
+    // Intrinsics compare by value, so a cache keyed on them is invalidated by recalibration as well as by resizing.
+    bool operator==(const PinholeIntrinsics& left, const PinholeIntrinsics& right);
+    inline bool operator!=(const PinholeIntrinsics& left, const PinholeIntrinsics& right) { return !(left == right); }
+
+    /// <summary>
+    /// Projects a point on the z = 1 plane of a camera to pixel coordinates, applying lens distortion.
+    /// </summary>
+    void ProjectToPixel(const PinholeIntrinsics& intrinsics, float x, float y, float& pixelX, float& pixelY);
+
+    /// <summary>
+    /// Returns the intrinsics of the same camera sampled at 1/scale of its resolution, where each
+    /// reduced pixel is the center of a scale x scale block of original pixels.
+    /// </summary>
+    PinholeIntrinsics ScaleIntrinsics(const PinholeIntrinsics& intrinsics, uint32_t scale);
+
+    // The ray through every pixel of a camera, stored as its x and y on the z = 1 plane.
+    // The x and y planes are separate 64-byte-aligned arrays, so that turning a depth image into points is a
+    // multiply per coordinate over contiguous memory. A table only depends on the intrinsics it was built for,
+    // so it is built once and reused until GetIntrinsics() no longer matches the camera.
+    class RayTable
+    {
+    public:
+        /// <summary>
+        /// Builds the rays by inverting the lens model of intrinsics.
+        /// </summary>
+        explicit RayTable(const PinholeIntrinsics& intrinsics);
+
+        /// <summary>
+        /// Copies rays computed elsewhere, e.g. by CameraIntrinsics::UnprojectPixelsAtUnitDepth.
+        /// rayX and rayY hold imageWidth * imageHeight values, row by row.
+        /// </summary>
+        RayTable(const PinholeIntrinsics& intrinsics, const float* rayX, const float* rayY);
+
+        RayTable(const RayTable&) = delete;
+        RayTable& operator=(const RayTable&) = delete;
+
+        const PinholeIntrinsics& GetIntrinsics() const { return m_intrinsics; }
+        uint32_t GetWidth() const { return m_intrinsics.imageWidth; }
+        uint32_t GetHeight() const { return m_intrinsics.imageHeight; }
+        size_t GetCount() const { return size_t(m_intrinsics.imageWidth) * m_intrinsics.imageHeight; }
+
+        const float* GetRayX() const { return m_rayX; }
+        const float* GetRayY() const { return m_rayY; }
+
+        /// <summary>
+        /// Turns a depth per pixel into camera space points: x = rayX * depth, y = rayY * depth.
+        /// Pixels with a depth of 0 get a point at the origin.
+        /// </summary>
+        void Unproject(const float* depth, float* pointX, float* pointY) const;
+
+    private:
+        struct AlignedDeleter
+        {
+            void operator()(float* memory) const;
+        };
+
+        void Allocate();
+
+        PinholeIntrinsics m_intrinsics;
+        std::unique_ptr<float[], AlignedDeleter> m_storage;
+        float* m_rayX = nullptr;
+        float* m_rayY = nullptr;
+    };
+} // SDKTemplate
@@ -0,0 +1,164 @@
+#include "RegionOfInterest.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace SDKTemplate;
+
+// Image sizes whose spans a region keeps: the depth or infrared image, the color image, and the color image at
+// the reduced correlation resolution.
+static constexpr size_t spansCacheSize = 4;
+
+bool RowSpans::Contains(uint32_t x, uint32_t y) const
+{
+    if (y >= m_height)
+    {
+        return false;
+    }
+
+    const RowSpan* spans = GetSpans(y);
+    const size_t count = GetSpanCount(y);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (x < spans[i].begin)
+        {
+            return false;
+        }
+        if (x < spans[i].end)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<const RegionOfInterest> RegionOfInterest::CreateRectangle(float left, float top, float right, float bottom)
+{
+    return CreatePolygon({ { left, top }, { right, top }, { right, bottom }, { left, bottom } });
+}
+
+std::shared_ptr<const RegionOfInterest> RegionOfInterest::CreatePolygon(std::vector<Point> vertices)
+{
+    if (vertices.size() < 3)
+    {
+        return nullptr;
+    }
+    return std::shared_ptr<const RegionOfInterest>(new RegionOfInterest(std::move(vertices)));
+}
+
+RegionOfInterest::RegionOfInterest(std::vector<Point> vertices) :
+    m_vertices(std::move(vertices))
+{
+}
+
+std::shared_ptr<const RowSpans> RegionOfInterest::GetSpans(uint32_t width, uint32_t height) const
+{
+    {
+        std::lock_guard<std::mutex> lock(m_spansMutex);
+        for (const std::shared_ptr<const RowSpans>& spans : m_spans)
+        {
+            if (spans->GetWidth() == width && spans->GetHeight() == height)
+            {
+                return spans;
+            }
+        }
+    }
+
+    // Rasterize outside the lock; if another thread does the same meanwhile, either result is the same.
+    std::shared_ptr<const RowSpans> spans = Rasterize(width, height);
+
+    std::lock_guard<std::mutex> lock(m_spansMutex);
+    if (m_spans.size() == spansCacheSize)
+    {
+        m_spans.erase(m_spans.begin());
+    }
+    m_spans.push_back(spans);
+    return spans;
+}
+
+std::shared_ptr<const RowSpans> RegionOfInterest::Rasterize(uint32_t width, uint32_t height) const
+{
+    auto spans = std::make_shared<RowSpans>();
+    spans->m_width = width;
+    spans->m_height = height;
+    spans->m_rowOffsets.assign(size_t(height) + 1, 0);
+
+    // Rows whose centers the polygon's vertical extent covers.
+    float minY = m_vertices[0].y;
+    float maxY = m_vertices[0].y;
+    for (const Point& vertex : m_vertices)
+    {
+        minY = (std::min)(minY, vertex.y);
+        maxY = (std::max)(maxY, vertex.y);
+    }
+    const float firstRow = std::ceil(minY * height - 0.5f);
+    const float endRow = std::ceil(maxY * height - 0.5f);
+    const uint32_t rowBegin = static_cast<uint32_t>((std::min)((std::max)(firstRow, 0.0f), static_cast<float>(height)));
+    const uint32_t rowEnd = static_cast<uint32_t>((std::min)((std::max)(endRow, 0.0f), static_cast<float>(height)));
+
+    // Each row's center line is crossed by the edges that straddle it, with the lower end included and the
+    // upper one not, so a vertex on the line counts once. Pairs of crossings, left to right, bound the inside.
+    std::vector<float> crossings;
+    const size_t vertexCount = m_vertices.size();
+    uint32_t firstSpanRow = height;
+    uint32_t endSpanRow = 0;
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+        const float centerY = (y + 0.5f) / height;
+        crossings.clear();
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const Point& a = m_vertices[i];
+            const Point& b = m_vertices[(i + 1) % vertexCount];
+            if ((a.y <= centerY) != (b.y <= centerY))
+            {
+                crossings.push_back(a.x + (centerY - a.y) / (b.y - a.y) * (b.x - a.x));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2)
+        {
+            // Pixels whose centers lie in [left, right).
+            const float left = std::ceil(crossings[i] * width - 0.5f);
+            const float right = std::ceil(crossings[i + 1] * width - 0.5f);
+            const uint32_t begin = static_cast<uint32_t>((std::min)((std::max)(left, 0.0f), static_cast<float>(width)));
+            const uint32_t end = static_cast<uint32_t>((std::min)((std::max)(right, 0.0f), static_cast<float>(width)));
+            if (begin >= end)
+            {
+                continue;
+            }
+
+            // Spans that touch, from edges crossing between two pixel centers, are merged.
+            if (spans->m_spans.size() > spans->m_rowOffsets[y] && spans->m_spans.back().end >= begin)
+            {
+                spans->m_spans.back().end = (std::max)(spans->m_spans.back().end, end);
+            }
+            else
+            {
+                spans->m_spans.push_back({ begin, end });
+            }
+        }
+
+        if (spans->m_spans.size() > spans->m_rowOffsets[y])
+        {
+            firstSpanRow = (std::min)(firstSpanRow, y);
+            endSpanRow = y + 1;
+        }
+        spans->m_rowOffsets[y + 1] = spans->m_spans.size();
+    }
+
+    // Rows after the polygon have no spans either.
+    for (uint32_t y = rowEnd; y < height; y++)
+    {
+        spans->m_rowOffsets[y + 1] = spans->m_spans.size();
+    }
+
+    for (const RowSpan& span : spans->m_spans)
+    {
+        spans->m_pixelCount += span.end - span.begin;
+    }
+    spans->m_firstRow = (firstSpanRow < endSpanRow) ? firstSpanRow : 0;
+    spans->m_endRow = (firstSpanRow < endSpanRow) ? endSpanRow : 0;
+    return spans;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // Pixels [begin, end) of one image row.
+    struct RowSpan
+    {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    // The pixels of an image that lie inside a region, as sorted, disjoint spans per row.
+    // Pixels are inside when their centers are.
+    class RowSpans
+    {
+    public:
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        size_t GetPixelCount() const { return m_pixelCount; }
+
+        // Rows [GetFirstRow(), GetEndRow()) hold every span; the rows outside have none.
+        uint32_t GetFirstRow() const { return m_firstRow; }
+        uint32_t GetEndRow() const { return m_endRow; }
+
+        const RowSpan* GetSpans(uint32_t y) const { return m_spans.data() + m_rowOffsets[y]; }
+        size_t GetSpanCount(uint32_t y) const { return m_rowOffsets[y + 1] - m_rowOffsets[y]; }
+
+        /// <summary>
+        /// Returns whether pixel (x, y) is inside the region.
+        /// </summary>
+        bool Contains(uint32_t x, uint32_t y) const;
+
+    private:
+        friend class RegionOfInterest;
+
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        size_t m_pixelCount = 0;
+        uint32_t m_firstRow = 0;
+        uint32_t m_endRow = 0;
+
+        // The spans of row y are m_spans[m_rowOffsets[y]] up to m_spans[m_rowOffsets[y + 1]].
+        std::vector<size_t> m_rowOffsets;
+        std::vector<RowSpan> m_spans;
+    };
+
+    // Part of an image that processing is limited to, as a polygon in coordinates normalized to the image:
+    // (0, 0) is the top left corner of the image and (1, 1) the bottom right, whatever its resolution, so the
+    // same region applies to an image and to versions of it at other resolutions. A region doesn't change once
+    // created; it is rasterized to row spans once per image size and the spans are kept.
+    class RegionOfInterest
+    {
+    public:
+        struct Point
+        {
+            float x;
+            float y;
+        };
+
+        /// <summary>
+        /// Returns the rectangle from (left, top) to (right, bottom).
+        /// </summary>
+        static std::shared_ptr<const RegionOfInterest> CreateRectangle(float left, float top, float right, float bottom);
+
+        /// <summary>
+        /// Returns the polygon with the given vertices, in order. Edges may cross; a pixel is inside if a ray from
+        /// it crosses an odd number of edges. Returns nullptr if there are fewer than 3 vertices.
+        /// </summary>
+        static std::shared_ptr<const RegionOfInterest> CreatePolygon(std::vector<Point> vertices);
+
+        RegionOfInterest(const RegionOfInterest&) = delete;
+        RegionOfInterest& operator=(const RegionOfInterest&) = delete;
+
+        const std::vector<Point>& GetVertices() const { return m_vertices; }
+
+        /// <summary>
+        /// Returns the region's pixels in an image of width x height pixels. Safe to call from any thread.
+        /// </summary>
+        std::shared_ptr<const RowSpans> GetSpans(uint32_t width, uint32_t height) const;
+
+    private:
+        explicit RegionOfInterest(std::vector<Point> vertices);
+
+        std::shared_ptr<const RowSpans> Rasterize(uint32_t width, uint32_t height) const;
+
+        const std::vector<Point> m_vertices;
+
+        // Spans of the image sizes asked for most recently, guarded by m_spansMutex.
+        mutable std::mutex m_spansMutex;
+        mutable std::vector<std::shared_ptr<const RowSpans>> m_spans;
+    };
+} // SDKTemplate
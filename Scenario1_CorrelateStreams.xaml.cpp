@@ -32,18 +32,6 @@ using namespace Windows::UI::Xaml::Media::Imaging;
 // Used to determine whether a source has a Perception major type.
 static String^ PerceptionMediaType = L"Perception";
 
-// Returns the values from a std::map as a std::vector.
-template<typename K, typename T>
-static inline std::vector<T> values(std::map<K, T> const& inputMap)
-{
-    std::vector<T> outputVector(inputMap.size());
-    std::transform(inputMap.begin(), inputMap.end(), outputVector.begin(), [](auto const& pair)
-    {
-        return pair.second;
-    });
-    return outputVector;
-}
-
 Scenario1_CorrelateStreams::Scenario1_CorrelateStreams() : rootPage(MainPage::Current)
 {
     InitializeComponent();
@@ -55,6 +43,8 @@ Scenario1_CorrelateStreams::Scenario1_CorrelateStreams() : rootPage(MainPage::Cu
 
 void Scenario1_CorrelateStreams::OnNavigatedTo(Windows::UI::Xaml::Navigation::NavigationEventArgs^ e)
 {
+    StartProcessingThread();
+
     // Start streaming from the first available source group.
     PickNextMediaSourceAsync();
 }
@@ -62,6 +52,7 @@ void Scenario1_CorrelateStreams::OnNavigatedTo(Windows::UI::Xaml::Navigation::Na
 void Scenario1_CorrelateStreams::OnNavigatedFrom(Windows::UI::Xaml::Navigation::NavigationEventArgs^ e)
 {
     CleanupMediaCaptureAsync();
+    StopProcessingThread();
 }
 
 void Scenario1_CorrelateStreams::NextButton_Click(Platform::Object^ sender, Windows::UI::Xaml::RoutedEventArgs^ e)
@@ -71,16 +62,16 @@ void Scenario1_CorrelateStreams::NextButton_Click(Platform::Object^ sender, Wind
 
 void Scenario1_CorrelateStreams::ToggleDepth_Click(Platform::Object^ sender, Windows::UI::Xaml::RoutedEventArgs^ e)
 {
-    m_frameSources[MediaFrameSourceKind::Depth].enabled = !m_frameSources[MediaFrameSourceKind::Depth].enabled;
+    SetSourceEnabled(MediaFrameSourceKind::Depth, !IsSourceEnabled(MediaFrameSourceKind::Depth));
     UpdateUI();
 }
 
 void Scenario1_CorrelateStreams::UpdateUI()
 {
-    ToggleDepth->IsEnabled = m_frameSources[MediaFrameSourceKind::Depth].sourceInfo != nullptr;
+    ToggleDepth->IsEnabled = GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo != nullptr;
 
-    DepthMessage->Text = m_frameSources[MediaFrameSourceKind::Depth].sourceInfo != nullptr
-        ? "Depth overlay " + (m_frameSources[MediaFrameSourceKind::Depth].enabled ? "enabled" : "disabled")
+    DepthMessage->Text = GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo != nullptr
+        ? "Depth overlay " + (IsSourceEnabled(MediaFrameSourceKind::Depth) ? "enabled" : "disabled")
         : "Depth source not found";
 }
 
@@ -153,30 +144,30 @@ task<void> Scenario1_CorrelateStreams::PickNextMediaSourceWorkerAsync()
             });
 
             // Reset our frame sources data
-            m_frameSources[MediaFrameSourceKind::Color] = FrameSourceState();
-            m_frameSources[MediaFrameSourceKind::Depth] = FrameSourceState();
+            GetFrameSource(MediaFrameSourceKind::Color) = FrameSourceState();
+            GetFrameSource(MediaFrameSourceKind::Depth) = FrameSourceState();
 
             // Store the source info object if a source group was found.
-            m_frameSources[MediaFrameSourceKind::Color].sourceInfo = colorSourceInfo != end(sourceInfos) ? *colorSourceInfo : nullptr;
-            m_frameSources[MediaFrameSourceKind::Depth].sourceInfo = depthSourceInfo != end(sourceInfos) ? *depthSourceInfo : nullptr;
+            GetFrameSource(MediaFrameSourceKind::Color).sourceInfo = colorSourceInfo != end(sourceInfos) ? *colorSourceInfo : nullptr;
+            GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo = depthSourceInfo != end(sourceInfos) ? *depthSourceInfo : nullptr;
 
             // Enable color always.
-            m_frameSources[MediaFrameSourceKind::Color].enabled = true;
+            SetSourceEnabled(MediaFrameSourceKind::Color, true);
 
             // Enable depth if depth is available.
-            m_frameSources[MediaFrameSourceKind::Depth].enabled = m_frameSources[MediaFrameSourceKind::Depth].sourceInfo != nullptr;
+            SetSourceEnabled(MediaFrameSourceKind::Depth, GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo != nullptr);
 
             // Create readers for found sources.
             std::vector<task<void>> createReadersTasks;
 
-            if (m_frameSources[MediaFrameSourceKind::Color].sourceInfo)
+            if (GetFrameSource(MediaFrameSourceKind::Color).sourceInfo)
             {
-                createReadersTasks.push_back(CreateReaderAsync(m_frameSources[MediaFrameSourceKind::Color].sourceInfo));
+                createReadersTasks.push_back(CreateReaderAsync(GetFrameSource(MediaFrameSourceKind::Color).sourceInfo));
             }
 
-            if (m_frameSources[MediaFrameSourceKind::Depth].sourceInfo)
+            if (GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo)
             {
-                createReadersTasks.push_back(CreateReaderAsync(m_frameSources[MediaFrameSourceKind::Depth].sourceInfo));
+                createReadersTasks.push_back(CreateReaderAsync(GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo));
             }
 
             // The when_all method will execute all tasks in parallel, and call the continuation when all tasks have completed.
@@ -200,13 +191,13 @@ task<void> Scenario1_CorrelateStreams::CreateReaderAsync(MediaFrameSourceInfo^ i
     return create_task(m_mediaCapture->CreateFrameReaderAsync(m_mediaCapture->FrameSources->Lookup(info->Id)))
         .then([this, info](MediaFrameReader^ frameReader)
     {
-        m_frameSources[info->SourceKind].frameArrivedEventToken = frameReader->FrameArrived +=
+        GetFrameSource(info->SourceKind).frameArrivedEventToken = frameReader->FrameArrived +=
             ref new TypedEventHandler<MediaFrameReader^, MediaFrameArrivedEventArgs^>(this, &Scenario1_CorrelateStreams::FrameReader_FrameArrived);
 
         m_logger->Log(info->SourceKind.ToString() + " reader created");
 
         // Keep track of created reader and event handler so it can be stopped later.
-        m_frameSources[info->SourceKind].reader = frameReader;
+        GetFrameSource(info->SourceKind).reader = frameReader;
         return create_task(frameReader->StartAsync());
     }).then([this, info](MediaFrameReaderStartStatus status)
     {
@@ -277,7 +268,7 @@ task<void> Scenario1_CorrelateStreams::CleanupMediaCaptureAsync()
 
     if (m_mediaCapture != nullptr)
     {
-        for (FrameSourceState frameSourceState : values(m_frameSources))
+        for (FrameSourceState& frameSourceState : m_frameSources)
         {
             if (frameSourceState.reader)
             {
@@ -285,12 +276,17 @@ task<void> Scenario1_CorrelateStreams::CleanupMediaCaptureAsync()
                 cleanupTask = cleanupTask && create_task(frameSourceState.reader->StopAsync());
             }
 
-            frameSourceState.enabled = false;
             frameSourceState.sourceInfo = nullptr;
             frameSourceState.reader = nullptr;
-            frameSourceState.latestFrame = nullptr;
         }
 
+        // Frames still waiting for the consumer are dropped here. The synchronizer belongs to the consumer, which
+        // resets it when it sees the generation change, so the next capture doesn't start out with these frames
+        // buffered or their timestamps counted as already emitted.
+        m_enabledSources = 0;
+        m_frameMailbox.Clear();
+        m_captureGeneration++;
+
         m_mediaCapture = nullptr;
     }
     return cleanupTask;
@@ -304,52 +300,95 @@ void Scenario1_CorrelateStreams::FrameReader_FrameArrived(MediaFrameReader^ send
     // when the reader was stopped.
     if (MediaFrameReference^ candidateFrame = sender->TryAcquireLatestFrame())
     {
-        // Since multiple sources will be receiving frames, we must synchronize access to m_frameSources.
-        auto lock = m_frameLock.LockExclusive();
-
-        // Buffer frame for later usage.
-        m_frameSources[candidateFrame->SourceKind].latestFrame = candidateFrame;
-
-        auto frameSourceObjects = values(m_frameSources);
-        bool allFramesBuffered = std::none_of(frameSourceObjects.begin(), frameSourceObjects.end(),
-            [](FrameSourceState const& frameSourceState)
+        // Frames without a timestamp can't be matched with frames from the other sources.
+        if (candidateFrame->SystemRelativeTime == nullptr)
         {
-            return frameSourceState.enabled && frameSourceState.latestFrame == nullptr;
-        });
+            return;
+        }
 
-        // If we have frames from currently enabled sources, render to UI.
-        if (allFramesBuffered)
+        // Callbacks never wait for each other: the frame goes into its source's slot, and whichever callback
+        // holds the consumer role feeds every waiting frame to the synchronizer.
+        m_frameMailbox.Post(candidateFrame);
+        if (!m_frameMailbox.TryBeginConsume())
         {
-            bool colorEnabled = m_frameSources[MediaFrameSourceKind::Color].enabled;
-            bool depthEnabled = m_frameSources[MediaFrameSourceKind::Depth].enabled;
-
-            MediaFrameReference^ colorFrame = m_frameSources[MediaFrameSourceKind::Color].latestFrame;
-            MediaFrameReference^ depthFrame = m_frameSources[MediaFrameSourceKind::Depth].latestFrame;
+            return;
+        }
 
-            // If depth and color enabled, correlate and output
-            if (colorEnabled && depthEnabled)
-            {
-                m_correlatedFrameRenderer->ProcessDepthAndColorFrames(colorFrame, depthFrame);
-            }
-            // Render only color if enabled and available
-            else if (colorEnabled)
+        do
+        {
+            MediaFrameReference^ frames[FrameMailbox::SlotCount];
+            UINT32 readySources = m_frameMailbox.TakeReady(frames);
+            UINT32 captureGeneration = m_captureGeneration;
+            if (captureGeneration != m_synchronizerGeneration)
             {
-                m_correlatedFrameRenderer->ProcessColorFrame(colorFrame);
+                m_frameSynchronizer.Reset();
+                m_synchronizerGeneration = captureGeneration;
             }
+            m_frameSynchronizer.SetEnabledSources(m_enabledSources);
 
-            // clear buffered frames if used
-            if (colorEnabled)
+            for (size_t slot = 0; slot < FrameMailbox::SlotCount; slot++)
             {
-                m_frameSources[MediaFrameSourceKind::Color].latestFrame = nullptr;
+                // Buffer the frame and queue a set once every enabled source has a frame captured at about the same time.
+                FrameSetSynchronizer::FrameSet frameSet;
+                if ((readySources & (1u << slot)) &&
+                    m_frameSynchronizer.AddFrame(slot, frames[slot]->SystemRelativeTime->Value.Duration, frames[slot], frameSet))
+                {
+                    // Rendering happens on the processing thread, so a slow frame never holds up the readers.
+                    m_frameSetQueue.Push(std::move(frameSet));
+                }
             }
-            if (depthEnabled)
-            {
-                m_frameSources[MediaFrameSourceKind::Depth].latestFrame = nullptr;
-            }
-        }
+        } while (m_frameMailbox.EndConsume());
     }
     else
     {
         m_logger->Log("Unable to acquire frame");
     }
+}
+
+void Scenario1_CorrelateStreams::StartProcessingThread()
+{
+    m_frameSetQueue.Reopen();
+    m_processingThread = std::thread([this]()
+    {
+        FrameSetSynchronizer::FrameSet frameSet;
+        while (m_frameSetQueue.Pop(frameSet))
+        {
+            ProcessFrameSet(frameSet);
+
+            // Release the frames now rather than while waiting for the next set.
+            frameSet.fill(nullptr);
+        }
+    });
+}
+
+void Scenario1_CorrelateStreams::StopProcessingThread()
+{
+    // Sets still waiting are stale by now, so the thread exits after the one it is working on.
+    m_frameSetQueue.Close();
+    m_frameSetQueue.Clear();
+    if (m_processingThread.joinable())
+    {
+        m_processingThread.join();
+    }
+
+    m_logger->Log("Frame sets queued: " + m_frameSetQueue.GetPushedCount().ToString() +
+        ", dropped: " + m_frameSetQueue.GetDroppedCount().ToString() +
+        ", max queue depth: " + m_frameSetQueue.GetMaxDepth().ToString());
+}
+
+void Scenario1_CorrelateStreams::ProcessFrameSet(const FrameSetSynchronizer::FrameSet& frameSet)
+{
+    MediaFrameReference^ colorFrame = frameSet[static_cast<size_t>(MediaFrameSourceKind::Color)];
+    MediaFrameReference^ depthFrame = frameSet[static_cast<size_t>(MediaFrameSourceKind::Depth)];
+
+    // If depth and color enabled, correlate and output
+    if (colorFrame != nullptr && depthFrame != nullptr)
+    {
+        m_correlatedFrameRenderer->ProcessDepthAndColorFrames(colorFrame, depthFrame);
+    }
+    // Render only color if enabled and available
+    else if (colorFrame != nullptr)
+    {
+        m_correlatedFrameRenderer->ProcessColorFrame(colorFrame);
+    }
 }
\ No newline at end of file
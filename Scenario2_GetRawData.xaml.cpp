@@ -21,18 +21,6 @@ using namespace Windows::UI::Xaml::Media::Imaging;
 // Used to determine whether a source has a Perception major type.
 static String^ PerceptionMediaType = L"Perception";
 
-// Returns the values from a std::map as a std::vector.
-template<typename K, typename T>
-static inline std::vector<T> values(std::map<K, T> const& inputMap)
-{
-	std::vector<T> outputVector(inputMap.size());
-	std::transform(inputMap.begin(), inputMap.end(), outputVector.begin(), [](auto const& pair)
-	{
-		return pair.second;
-	});
-	return outputVector;
-}
-
 Scenario2_GetRawData::Scenario2_GetRawData() : rootPage(MainPage::Current)
 {
 	InitializeComponent();
@@ -52,6 +40,8 @@ Scenario2_GetRawData::Scenario2_GetRawData() : rootPage(MainPage::Current)
 
 void Scenario2_GetRawData::OnNavigatedTo(Windows::UI::Xaml::Navigation::NavigationEventArgs^ e)
 {
+	StartProcessingThread();
+
 	// Start streaming from the first available source group.
 	PickNextMediaSourceAsync();
 }
@@ -59,6 +49,7 @@ void Scenario2_GetRawData::OnNavigatedTo(Windows::UI::Xaml::Navigation::Navigati
 void Scenario2_GetRawData::OnNavigatedFrom(Windows::UI::Xaml::Navigation::NavigationEventArgs^ e)
 {
 	CleanupMediaCaptureAsync();
+	StopProcessingThread();
 }
 
 void Scenario2_GetRawData::NextButton_Click(Platform::Object^ sender, Windows::UI::Xaml::RoutedEventArgs^ e)
@@ -144,40 +135,40 @@ task<void> Scenario2_GetRawData::PickNextMediaSourceWorkerAsync()
 			});
 
 			// Reset our frame sources data
-			m_frameSources[MediaFrameSourceKind::Color] = FrameSourceState2();
-			m_frameSources[MediaFrameSourceKind::Depth] = FrameSourceState2();
-			m_frameSources[MediaFrameSourceKind::Infrared] = FrameSourceState2();
+			GetFrameSource(MediaFrameSourceKind::Color) = FrameSourceState2();
+			GetFrameSource(MediaFrameSourceKind::Depth) = FrameSourceState2();
+			GetFrameSource(MediaFrameSourceKind::Infrared) = FrameSourceState2();
 
 			// Store the source info object if a source group was found.
-			m_frameSources[MediaFrameSourceKind::Color].sourceInfo = colorSourceInfo != end(sourceInfos) ? *colorSourceInfo : nullptr;
-			m_frameSources[MediaFrameSourceKind::Depth].sourceInfo = depthSourceInfo != end(sourceInfos) ? *depthSourceInfo : nullptr;
-			m_frameSources[MediaFrameSourceKind::Infrared].sourceInfo = infraredSourceInfo != end(sourceInfos) ? *infraredSourceInfo : nullptr;
+			GetFrameSource(MediaFrameSourceKind::Color).sourceInfo = colorSourceInfo != end(sourceInfos) ? *colorSourceInfo : nullptr;
+			GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo = depthSourceInfo != end(sourceInfos) ? *depthSourceInfo : nullptr;
+			GetFrameSource(MediaFrameSourceKind::Infrared).sourceInfo = infraredSourceInfo != end(sourceInfos) ? *infraredSourceInfo : nullptr;
 
 			// Enable color always.
-			m_frameSources[MediaFrameSourceKind::Color].enabled = true;
+			SetSourceEnabled(MediaFrameSourceKind::Color, true);
 
 			// Enable depth if depth is available.
-			m_frameSources[MediaFrameSourceKind::Depth].enabled = m_frameSources[MediaFrameSourceKind::Depth].sourceInfo != nullptr;
+			SetSourceEnabled(MediaFrameSourceKind::Depth, GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo != nullptr);
 
 			// Enable infrared if infrared is available.
-			m_frameSources[MediaFrameSourceKind::Infrared].enabled = m_frameSources[MediaFrameSourceKind::Infrared].sourceInfo != nullptr;
+			SetSourceEnabled(MediaFrameSourceKind::Infrared, GetFrameSource(MediaFrameSourceKind::Infrared).sourceInfo != nullptr);
 
 			// Create readers for found sources.
 			std::vector<task<void>> createReadersTasks;
 
-			if (m_frameSources[MediaFrameSourceKind::Color].sourceInfo)
+			if (GetFrameSource(MediaFrameSourceKind::Color).sourceInfo)
 			{
-				createReadersTasks.push_back(CreateReaderAsync(m_frameSources[MediaFrameSourceKind::Color].sourceInfo));
+				createReadersTasks.push_back(CreateReaderAsync(GetFrameSource(MediaFrameSourceKind::Color).sourceInfo));
 			}
 
-			if (m_frameSources[MediaFrameSourceKind::Depth].sourceInfo)
+			if (GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo)
 			{
-				createReadersTasks.push_back(CreateReaderAsync(m_frameSources[MediaFrameSourceKind::Depth].sourceInfo));
+				createReadersTasks.push_back(CreateReaderAsync(GetFrameSource(MediaFrameSourceKind::Depth).sourceInfo));
 			}
 
-			if (m_frameSources[MediaFrameSourceKind::Infrared].sourceInfo)
+			if (GetFrameSource(MediaFrameSourceKind::Infrared).sourceInfo)
 			{
-				createReadersTasks.push_back(CreateReaderAsync(m_frameSources[MediaFrameSourceKind::Infrared].sourceInfo));
+				createReadersTasks.push_back(CreateReaderAsync(GetFrameSource(MediaFrameSourceKind::Infrared).sourceInfo));
 			}
 
 			// The when_all method will execute all tasks in parallel, and call the continuation when all tasks have completed.
@@ -201,13 +192,13 @@ task<void> Scenario2_GetRawData::CreateReaderAsync(MediaFrameSourceInfo^ info)
 	return create_task(m_mediaCapture->CreateFrameReaderAsync(m_mediaCapture->FrameSources->Lookup(info->Id)))
 		.then([this, info](MediaFrameReader^ frameReader)
 	{
-		m_frameSources[info->SourceKind].frameArrivedEventToken = frameReader->FrameArrived +=
+		GetFrameSource(info->SourceKind).frameArrivedEventToken = frameReader->FrameArrived +=
 			ref new TypedEventHandler<MediaFrameReader^, MediaFrameArrivedEventArgs^>(this, &Scenario2_GetRawData::FrameReader_FrameArrived);
 
 		m_logger->Log(info->SourceKind.ToString() + " reader created");
 
 		// Keep track of created reader and event handler so it can be stopped later.
-		m_frameSources[info->SourceKind].reader = frameReader;
+		GetFrameSource(info->SourceKind).reader = frameReader;
 		return create_task(frameReader->StartAsync());
 	}).then([this, info](MediaFrameReaderStartStatus status)
 	{
@@ -278,7 +269,7 @@ task<void> Scenario2_GetRawData::CleanupMediaCaptureAsync()
 
 	if (m_mediaCapture != nullptr)
 	{
-		for (FrameSourceState2 frameSourceState : values(m_frameSources))
+		for (FrameSourceState2& frameSourceState : m_frameSources)
 		{
 			if (frameSourceState.reader)
 			{
@@ -286,12 +277,17 @@ task<void> Scenario2_GetRawData::CleanupMediaCaptureAsync()
 				cleanupTask = cleanupTask && create_task(frameSourceState.reader->StopAsync());
 			}
 
-			frameSourceState.enabled = false;
 			frameSourceState.sourceInfo = nullptr;
 			frameSourceState.reader = nullptr;
-			frameSourceState.latestFrame = nullptr;
 		}
 
+		// Frames still waiting for the consumer are dropped here. The synchronizer belongs to the consumer, which
+		// resets it when it sees the generation change, so the next capture doesn't start out with these frames
+		// buffered or their timestamps counted as already emitted.
+		m_enabledSources = 0;
+		m_frameMailbox.Clear();
+		m_captureGeneration++;
+
 		m_mediaCapture = nullptr;
 	}
 	return cleanupTask;
@@ -305,84 +301,126 @@ void Scenario2_GetRawData::FrameReader_FrameArrived(MediaFrameReader^ sender, Me
 	// when the reader was stopped.
 	if (MediaFrameReference^ candidateFrame = sender->TryAcquireLatestFrame())
 	{
-		// Since multiple sources will be receiving frames, we must synchronize access to m_frameSources.
-		auto lock = m_frameLock.LockExclusive();
-
-		// Buffer frame for later usage.
-		m_frameSources[candidateFrame->SourceKind].latestFrame = candidateFrame;
-
-		auto frameSourceObjects = values(m_frameSources);
-		bool allFramesBuffered = std::none_of(frameSourceObjects.begin(), frameSourceObjects.end(),
-			[](FrameSourceState2 const& frameSourceState)
+		// Frames without a timestamp can't be matched with frames from the other sources.
+		if (candidateFrame->SystemRelativeTime == nullptr)
 		{
-			return frameSourceState.enabled && frameSourceState.latestFrame == nullptr;
-		});
+			return;
+		}
 
-		// If we have frames from currently enabled sources, render to UI.
-		if (allFramesBuffered)
+		// Callbacks never wait for each other: the frame goes into its source's slot, and whichever callback
+		// holds the consumer role feeds every waiting frame to the synchronizer.
+		m_frameMailbox.Post(candidateFrame);
+		if (!m_frameMailbox.TryBeginConsume())
 		{
-			bool colorEnabled = m_frameSources[MediaFrameSourceKind::Color].enabled;
-			bool depthEnabled = m_frameSources[MediaFrameSourceKind::Depth].enabled;
-			bool infraredEnabled = m_frameSources[MediaFrameSourceKind::Infrared].enabled;
-
-			MediaFrameReference^ colorFrame = m_frameSources[MediaFrameSourceKind::Color].latestFrame;
-			MediaFrameReference^ depthFrame = m_frameSources[MediaFrameSourceKind::Depth].latestFrame;
-			MediaFrameReference^ infraredFrame = m_frameSources[MediaFrameSourceKind::Infrared].latestFrame;
+			return;
+		}
 
-			if (colorEnabled)
-			{
-				m_colorFrameRenderer->ProcessColorFrame(colorFrame);
-			}
-			if (depthEnabled)
-			{
-				m_depthFrameRenderer->ProcessDepthFrame(depthFrame);
-			}
-			if (infraredEnabled)
+		do
+		{
+			MediaFrameReference^ frames[FrameMailbox::SlotCount];
+			UINT32 readySources = m_frameMailbox.TakeReady(frames);
+			UINT32 captureGeneration = m_captureGeneration;
+			if (captureGeneration != m_synchronizerGeneration)
 			{
-				m_infraredFrameRenderer->ProcessInfraredFrame(infraredFrame);
+				m_frameSynchronizer.Reset();
+				m_synchronizerGeneration = captureGeneration;
 			}
+			m_frameSynchronizer.SetEnabledSources(m_enabledSources);
 
-			if (captureButtonPressed)
+			for (size_t slot = 0; slot < FrameMailbox::SlotCount; slot++)
 			{
-				m_logger->Log("Capturing Frame");
-
-				if (colorEnabled)
-				{
-					m_singleColorFrameRenderer->ProcessColorFrame(colorFrame);
-				}
-				if (depthEnabled)
-				{
-					m_singleDepthFrameRenderer->ProcessDepthFrame(depthFrame);
-				}
-				if (infraredEnabled)
+				// Buffer the frame and queue a set once every enabled source has a frame captured at about the same time.
+				FrameSetSynchronizer2::FrameSet frameSet;
+				if ((readySources & (1u << slot)) &&
+					m_frameSynchronizer.AddFrame(slot, frames[slot]->SystemRelativeTime->Value.Duration, frames[slot], frameSet))
 				{
-					m_singleInfraredFrameRenderer->ProcessInfraredFrame(infraredFrame);
+					// Rendering happens on the processing thread, so a slow frame never holds up the readers.
+					m_frameSetQueue.Push(std::move(frameSet));
 				}
-				if (colorEnabled && depthEnabled)
-				{
-					m_depthFilterFrameRenderer->ProcessDepthAndColorFrames(colorFrame, depthFrame);
-				}
-
-				captureButtonPressed = 0;
-			}
-
-			// clear buffered frames if used
-			if (colorEnabled)
-			{
-				m_frameSources[MediaFrameSourceKind::Color].latestFrame = nullptr;
 			}
-			if (depthEnabled)
-			{
-				m_frameSources[MediaFrameSourceKind::Depth].latestFrame = nullptr;
-			}
-			if (infraredEnabled)
-			{
-				m_frameSources[MediaFrameSourceKind::Infrared].latestFrame = nullptr;
-			}
-		}
+		} while (m_frameMailbox.EndConsume());
 	}
 	else
 	{
 		m_logger->Log("Unable to acquire frame");
 	}
 }
+
+void Scenario2_GetRawData::StartProcessingThread()
+{
+	m_frameSetQueue.Reopen();
+	m_processingThread = std::thread([this]()
+	{
+		FrameSetSynchronizer2::FrameSet frameSet;
+		while (m_frameSetQueue.Pop(frameSet))
+		{
+			ProcessFrameSet(frameSet);
+
+			// Release the frames now rather than while waiting for the next set.
+			frameSet.fill(nullptr);
+		}
+	});
+}
+
+void Scenario2_GetRawData::StopProcessingThread()
+{
+	// Sets still waiting are stale by now, so the thread exits after the one it is working on.
+	m_frameSetQueue.Close();
+	m_frameSetQueue.Clear();
+	if (m_processingThread.joinable())
+	{
+		m_processingThread.join();
+	}
+
+	m_logger->Log("Frame sets queued: " + m_frameSetQueue.GetPushedCount().ToString() +
+		", dropped: " + m_frameSetQueue.GetDroppedCount().ToString() +
+		", max queue depth: " + m_frameSetQueue.GetMaxDepth().ToString());
+}
+
+void Scenario2_GetRawData::ProcessFrameSet(const FrameSetSynchronizer2::FrameSet& frameSet)
+{
+	MediaFrameReference^ colorFrame = frameSet[static_cast<size_t>(MediaFrameSourceKind::Color)];
+	MediaFrameReference^ depthFrame = frameSet[static_cast<size_t>(MediaFrameSourceKind::Depth)];
+	MediaFrameReference^ infraredFrame = frameSet[static_cast<size_t>(MediaFrameSourceKind::Infrared)];
+
+	bool colorEnabled = colorFrame != nullptr;
+	bool depthEnabled = depthFrame != nullptr;
+	bool infraredEnabled = infraredFrame != nullptr;
+
+	if (colorEnabled)
+	{
+		m_colorFrameRenderer->ProcessColorFrame(colorFrame);
+	}
+	if (depthEnabled)
+	{
+		m_depthFrameRenderer->ProcessDepthFrame(depthFrame);
+	}
+	if (infraredEnabled)
+	{
+		m_infraredFrameRenderer->ProcessInfraredFrame(infraredFrame);
+	}
+
+	if (captureButtonPressed)
+	{
+		m_logger->Log("Capturing Frame");
+
+		if (colorEnabled)
+		{
+			m_singleColorFrameRenderer->ProcessColorFrame(colorFrame);
+		}
+		if (depthEnabled)
+		{
+			m_singleDepthFrameRenderer->ProcessDepthFrame(depthFrame);
+		}
+		if (infraredEnabled)
+		{
+			m_singleInfraredFrameRenderer->ProcessInfraredFrame(infraredFrame);
+		}
+		if (colorEnabled && depthEnabled)
+		{
+			m_depthFilterFrameRenderer->ProcessDepthAndColorFrames(colorFrame, depthFrame);
+		}
+
+		captureButtonPressed = 0;
+	}
+}
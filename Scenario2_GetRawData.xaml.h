@@ -3,7 +3,10 @@
 #include "Scenario2_GetRawData.g.h"
 #include "MainPage.xaml.h"
 #include "SimpleLogger.h"
+#include "BoundedFrameQueue.h"
+#include "FrameMailbox.h"
 #include "FrameRenderer.h"
+#include "FrameSynchronizer.h"
 #include <wrl.h>
 #include <wrl/client.h>
 
@@ -12,21 +15,48 @@ namespace SDKTemplate
 	// This structure stores information related to a frame source.
 	struct FrameSourceState2
 	{
-		bool enabled = false; // Whether or not this source is enabled for rendering.
-
 		Windows::Media::Capture::Frames::MediaFrameSourceInfo^ sourceInfo = nullptr; // The source info associated with this source.
-		Windows::Media::Capture::Frames::MediaFrameReference^ latestFrame = nullptr;  // The latest frame from this source.
 		Windows::Media::Capture::Frames::MediaFrameReader^ reader = nullptr; // The reader we are using to read this source.
 
 		Windows::Foundation::EventRegistrationToken frameArrivedEventToken;
 	};
 
+	// Matches frames of different sources by timestamp. Sources are indexed by their MediaFrameSourceKind value.
+	typedef FrameSynchronizer<Windows::Media::Capture::Frames::MediaFrameReference^, 4> FrameSetSynchronizer2;
+
 	[Windows::Foundation::Metadata::WebHostHidden]
 	public ref class Scenario2_GetRawData sealed
 	{
 	public:
 		Scenario2_GetRawData();
 
+	internal:
+		/// <summary>
+		/// Sets how many frame sets can wait for the processing thread. When shrinking, the oldest sets that no
+		/// longer fit are dropped. Safe to call while streaming.
+		/// </summary>
+		void SetFrameQueueCapacity(size_t capacity)
+		{
+			m_frameSetQueue.SetCapacity(capacity);
+		}
+
+		/// <summary>
+		/// Sets which frame set is dropped when the processing thread falls behind and the queue is full.
+		/// Safe to call while streaming.
+		/// </summary>
+		void SetFrameDropPolicy(FrameDropPolicy dropPolicy)
+		{
+			m_frameSetQueue.SetDropPolicy(dropPolicy);
+		}
+
+		/// <summary>
+		/// Number of frame sets waiting for the processing thread right now.
+		/// </summary>
+		size_t GetFrameQueueDepth()
+		{
+			return m_frameSetQueue.GetDepth();
+		}
+
 	protected:
 		/// <summary>
 		/// Called when user navigates to this Scenario.
@@ -85,6 +115,47 @@ namespace SDKTemplate
 			Windows::Media::Capture::Frames::MediaFrameReader^ sender,
 			Windows::Media::Capture::Frames::MediaFrameArrivedEventArgs^ args);
 
+		/// <summary>
+		/// Starts the thread that renders the frame sets queued by FrameReader_FrameArrived.
+		/// </summary>
+		void StartProcessingThread();
+
+		/// <summary>
+		/// Drops the queued frame sets and waits for the processing thread to exit.
+		/// </summary>
+		void StopProcessingThread();
+
+		/// <summary>
+		/// Renders a set of frames captured at about the same time. Entries of disabled sources are null.
+		/// Runs on the processing thread.
+		/// </summary>
+		void ProcessFrameSet(const FrameSetSynchronizer2::FrameSet& frameSet);
+
+		FrameSourceState2& GetFrameSource(Windows::Media::Capture::Frames::MediaFrameSourceKind kind)
+		{
+			return m_frameSources[FrameMailbox::GetSlot(kind)];
+		}
+
+		/// <summary>
+		/// Whether or not frames of this source kind are rendered. Safe to call from the FrameArrived handler.
+		/// </summary>
+		bool IsSourceEnabled(Windows::Media::Capture::Frames::MediaFrameSourceKind kind) const
+		{
+			return (m_enabledSources & FrameMailbox::GetSourceBit(kind)) != 0;
+		}
+
+		void SetSourceEnabled(Windows::Media::Capture::Frames::MediaFrameSourceKind kind, bool enabled)
+		{
+			if (enabled)
+			{
+				m_enabledSources |= FrameMailbox::GetSourceBit(kind);
+			}
+			else
+			{
+				m_enabledSources &= ~FrameMailbox::GetSourceBit(kind);
+			}
+		}
+
 	private: // Private data.
 		UINT16 captureButtonPressed = 0;
 
@@ -94,9 +165,23 @@ namespace SDKTemplate
 
 		Platform::Agile<Windows::Media::Capture::MediaCapture^> m_mediaCapture;
 
-		Microsoft::WRL::Wrappers::SRWLock m_frameLock;
+		// Indexed by MediaFrameSourceKind value. Only the UI thread touches these.
+		std::array<FrameSourceState2, FrameMailbox::SlotCount> m_frameSources;
+
+		// Bit per source kind, as in FrameMailbox::GetSourceBit.
+		std::atomic<UINT32> m_enabledSources{ 0 };
+
+		FrameMailbox m_frameMailbox;
+		FrameSetSynchronizer2 m_frameSynchronizer{ DefaultFrameMatchTolerance };
+
+		// Bumped by CleanupMediaCaptureAsync. The consumer compares it with the generation its synchronizer
+		// was last reset for, which only the consumer touches.
+		std::atomic<UINT32> m_captureGeneration{ 0 };
+		UINT32 m_synchronizerGeneration = 0;
 
-		std::map<Windows::Media::Capture::Frames::MediaFrameSourceKind, FrameSourceState2> m_frameSources;
+		// Frame sets waiting for the processing thread. Only the newest few are kept when it falls behind.
+		BoundedFrameQueue<FrameSetSynchronizer2::FrameSet> m_frameSetQueue{ DefaultFrameQueueCapacity, FrameDropPolicy::DropOldest };
+		std::thread m_processingThread;
 
 		std::unique_ptr<FrameRenderer> m_colorFrameRenderer;
 		std::unique_ptr<FrameRenderer> m_depthFrameRenderer;
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace SDKTemplate
+{
+    // The lock-free core of FrameMailbox, over raw pointers and standard atomics so it can be exercised off-device.
+    // Each slot holds the newest item posted to it that hasn't been taken yet, and a bit in a readiness mask
+    // is set when the slot is filled. A producer that posts an item tries to become the consumer; if another
+    // thread already is, it returns and the consumer picks the item up.
+    // Items move in and out by pointer: Post takes ownership of the item, and every pointer a call returns
+    // belongs to the caller.
+    template<typename Item, size_t SlotCount>
+    class SlotMailbox
+    {
+        static_assert(SlotCount <= 32, "The readiness mask has one bit per slot");
+
+    public:
+        SlotMailbox()
+        {
+            for (std::atomic<Item*>& slot : m_slots)
+            {
+                slot = nullptr;
+            }
+        }
+
+        SlotMailbox(const SlotMailbox&) = delete;
+        SlotMailbox& operator=(const SlotMailbox&) = delete;
+
+        /// <summary>
+        /// Stores item in slot and marks the slot ready. Returns the item it replaced, which was never taken,
+        /// or nullptr.
+        /// </summary>
+        Item* Post(size_t slot, Item* item)
+        {
+            // Fill the slot before raising its bit, so the consumer never sees a ready bit without an item behind it.
+            // It may still take an item whose bit is raised later; it then finds the slot empty on the next pass.
+            Item* previous = m_slots[slot].exchange(item);
+            m_readySlots.fetch_or(1u << slot);
+
+            if (previous != nullptr)
+            {
+                m_overwritten++;
+            }
+            return previous;
+        }
+
+        /// <summary>
+        /// Bit mask of the slots holding an item.
+        /// </summary>
+        uint32_t GetReadySlots() const
+        {
+            return m_readySlots.load();
+        }
+
+        /// <summary>
+        /// Makes the calling thread the consumer, unless another thread already is.
+        /// </summary>
+        bool TryBeginConsume()
+        {
+            return !m_consuming.exchange(true);
+        }
+
+        /// <summary>
+        /// Moves the item of every ready slot into items and returns their mask; other entries are nullptr.
+        /// Only the consumer calls this.
+        /// </summary>
+        uint32_t TakeReady(Item* (&items)[SlotCount])
+        {
+            uint32_t ready = m_readySlots.exchange(0);
+            for (size_t slot = 0; slot < SlotCount; slot++)
+            {
+                items[slot] = (ready & (1u << slot)) ? m_slots[slot].exchange(nullptr) : nullptr;
+                if (items[slot] == nullptr)
+                {
+                    ready &= ~(1u << slot);
+                }
+            }
+            return ready;
+        }
+
+        /// <summary>
+        /// Gives up the consumer role. Returns true, with the caller the consumer again, when items were
+        /// posted that the consumer may have missed; the caller then takes them and calls EndConsume again.
+        /// </summary>
+        bool EndConsume()
+        {
+            m_consuming = false;
+
+            // A producer that posted after the last TakeReady may have failed TryBeginConsume while we were still
+            // consuming. Every access is sequentially consistent, so either we see its bit here or it saw the flag cleared.
+            return GetReadySlots() != 0 && TryBeginConsume();
+        }
+
+        /// <summary>
+        /// Moves the item of every slot into items, ready or not, and returns their mask. Safe to call from any thread.
+        /// </summary>
+        uint32_t TakeAll(Item* (&items)[SlotCount])
+        {
+            m_readySlots = 0;
+            uint32_t taken = 0;
+            for (size_t slot = 0; slot < SlotCount; slot++)
+            {
+                items[slot] = m_slots[slot].exchange(nullptr);
+                if (items[slot] != nullptr)
+                {
+                    taken |= 1u << slot;
+                }
+            }
+            return taken;
+        }
+
+        uint64_t GetOverwrittenCount() const { return m_overwritten; }
+
+    private:
+        std::atomic<Item*> m_slots[SlotCount];
+        std::atomic<uint32_t> m_readySlots{ 0 };
+        std::atomic<bool> m_consuming{ false };
+        std::atomic<uint64_t> m_overwritten{ 0 };
+    };
+} // SDKTemplate
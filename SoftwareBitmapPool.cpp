@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "SoftwareBitmapPool.h"
+
+using namespace SDKTemplate;
+
+using namespace Windows::Graphics::Imaging;
+
+SoftwareBitmapPool::SoftwareBitmapPool(size_t capacity) : m_capacity(capacity)
+{
+    m_freeBitmaps.reserve(capacity);
+}
+
+SoftwareBitmapPool::~SoftwareBitmapPool()
+{
+    Clear();
+}
+
+SoftwareBitmap^ SoftwareBitmapPool::Acquire(int pixelWidth, int pixelHeight)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (pixelWidth != m_pixelWidth || pixelHeight != m_pixelHeight)
+    {
+        // The resolution changed: drop the old bitmaps and preallocate a full set for the new size.
+        Clear();
+        m_pixelWidth = pixelWidth;
+        m_pixelHeight = pixelHeight;
+
+        for (size_t i = 0; i < m_capacity; i++)
+        {
+            m_freeBitmaps.push_back(Allocate());
+        }
+    }
+
+    if (m_freeBitmaps.empty())
+    {
+        // Every pooled bitmap is still waiting to be presented.
+        m_misses++;
+        return Allocate();
+    }
+
+    m_hits++;
+    SoftwareBitmap^ bitmap = m_freeBitmaps.back();
+    m_freeBitmaps.pop_back();
+    return bitmap;
+}
+
+void SoftwareBitmapPool::Release(SoftwareBitmap^ bitmap)
+{
+    if (bitmap == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_freeBitmaps.size() < m_capacity &&
+            bitmap->PixelWidth == m_pixelWidth &&
+            bitmap->PixelHeight == m_pixelHeight &&
+            bitmap->BitmapPixelFormat == BitmapPixelFormat::Bgra8 &&
+            bitmap->BitmapAlphaMode == BitmapAlphaMode::Premultiplied)
+        {
+            m_freeBitmaps.push_back(bitmap);
+            return;
+        }
+    }
+
+    delete bitmap;
+}
+
+SoftwareBitmap^ SoftwareBitmapPool::Allocate()
+{
+    m_allocations++;
+
+    // XAML Image control only supports premultiplied Bgra8 format.
+    return ref new SoftwareBitmap(BitmapPixelFormat::Bgra8, m_pixelWidth, m_pixelHeight, BitmapAlphaMode::Premultiplied);
+}
+
+void SoftwareBitmapPool::Clear()
+{
+    for (SoftwareBitmap^ bitmap : m_freeBitmaps)
+    {
+        delete bitmap;
+    }
+    m_freeBitmaps.clear();
+}
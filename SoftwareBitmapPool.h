@@ -0,0 +1,53 @@
+#pragma once
+
+namespace SDKTemplate
+{
+    // Recycles the premultiplied Bgra8 bitmaps a renderer outputs, so that frames of the same
+    // size reuse memory instead of allocating a new bitmap each time.
+    // The pool holds bitmaps of one size at a time; asking for another size discards the old ones.
+    class SoftwareBitmapPool
+    {
+    public:
+        /// <summary>
+        /// Creates a pool that keeps at most capacity free bitmaps.
+        /// </summary>
+        explicit SoftwareBitmapPool(size_t capacity);
+        ~SoftwareBitmapPool();
+
+        SoftwareBitmapPool(const SoftwareBitmapPool&) = delete;
+        SoftwareBitmapPool& operator=(const SoftwareBitmapPool&) = delete;
+
+        /// <summary>
+        /// Returns a bitmap of the requested size. When the size differs from the previous request,
+        /// the pool is refilled with capacity bitmaps of the new size. A bitmap is only allocated
+        /// outside of a size change if every pooled bitmap is still in use.
+        /// The previous contents of the returned bitmap are undefined.
+        /// </summary>
+        Windows::Graphics::Imaging::SoftwareBitmap^ Acquire(int pixelWidth, int pixelHeight);
+
+        /// <summary>
+        /// Returns a bitmap to the pool once nothing uses it any more. Bitmaps that don't match the
+        /// pool's size or format, or that don't fit in the pool, are closed.
+        /// </summary>
+        void Release(Windows::Graphics::Imaging::SoftwareBitmap^ bitmap);
+
+        UINT64 GetHitCount() const { return m_hits; }
+        UINT64 GetMissCount() const { return m_misses; }
+        UINT64 GetAllocationCount() const { return m_allocations; }
+
+    private:
+        Windows::Graphics::Imaging::SoftwareBitmap^ Allocate();
+        void Clear();
+
+        const size_t m_capacity;
+
+        std::mutex m_mutex;
+        std::vector<Windows::Graphics::Imaging::SoftwareBitmap^> m_freeBitmaps;
+        int m_pixelWidth = 0;
+        int m_pixelHeight = 0;
+
+        std::atomic<UINT64> m_hits{ 0 };
+        std::atomic<UINT64> m_misses{ 0 };
+        std::atomic<UINT64> m_allocations{ 0 };
+    };
+} // SDKTemplate
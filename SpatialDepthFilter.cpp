@@ -0,0 +1,466 @@
+#include "SpatialDepthFilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SPATIALFILTER_X86
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define SPATIALFILTER_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+using namespace SDKTemplate;
+
+// Blends current into the running value previous of the pixels before it, unless either is invalid or they are
+// farther apart than edgeThreshold, and makes the result the running value if current is valid. A hole doesn't
+// end the run, so the pixels on either side of it are still blended if they are close enough.
+static inline float Blend(float current, float& previous, float alpha, float edgeThreshold)
+{
+    const float difference = current - previous;
+    const bool blend = current > 0.0f && previous > 0.0f && std::fabs(difference) <= edgeThreshold;
+    const float result = blend ? previous + alpha * difference : current;
+    previous = (current > 0.0f) ? result : previous;
+    return result;
+}
+
+static void SweepRow(float* row, uint32_t begin, uint32_t end, float& previous, float alpha, float edgeThreshold)
+{
+    for (uint32_t x = begin; x < end; x++)
+    {
+        row[x] = Blend(row[x], previous, alpha, edgeThreshold);
+    }
+}
+
+static void SweepRowBackward(float* row, uint32_t begin, uint32_t end, float& previous, float alpha, float edgeThreshold)
+{
+    for (uint32_t x = end; x > begin; x--)
+    {
+        row[x - 1] = Blend(row[x - 1], previous, alpha, edgeThreshold);
+    }
+}
+
+// Fills holes of a column sweep at columns [begin, end) of a row. value and distance hold, per column, the last
+// valid depth seen and how many rows ago; fill receives the depth a hole can be filled with from that side, or 0.
+static void FillColumns(const uint16_t* row, uint32_t begin, uint32_t end, uint16_t radius,
+    uint16_t* value, uint16_t* distance, uint16_t* fill)
+{
+    for (uint32_t x = begin; x < end; x++)
+    {
+        const bool hole = (row[x] == 0);
+        distance[x] = hole ? static_cast<uint16_t>((std::min)(distance[x] + 1, 0xFFFF)) : 0;
+        value[x] = hole ? value[x] : row[x];
+        fill[x] = (hole && distance[x] <= radius) ? value[x] : 0;
+    }
+}
+
+#if defined(SPATIALFILTER_X86) || defined(SPATIALFILTER_NEON)
+
+// Four floats, with the few operations the sweeps need. Each does exactly what Blend does to one float.
+#if defined(SPATIALFILTER_X86)
+typedef __m128 FloatLanes;
+
+static inline FloatLanes LoadLanes(const float* p) { return _mm_loadu_ps(p); }
+static inline void StoreLanes(float* p, FloatLanes v) { _mm_storeu_ps(p, v); }
+static inline FloatLanes SplatLanes(float v) { return _mm_set1_ps(v); }
+
+static inline FloatLanes BlendLanes(FloatLanes current, FloatLanes& previous, FloatLanes alpha, FloatLanes edgeThreshold)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 difference = _mm_sub_ps(current, previous);
+    const __m128 absoluteDifference = _mm_andnot_ps(_mm_set1_ps(-0.0f), difference);
+    const __m128 currentValid = _mm_cmpgt_ps(current, zero);
+    const __m128 blend = _mm_and_ps(_mm_and_ps(currentValid, _mm_cmpgt_ps(previous, zero)),
+        _mm_cmple_ps(absoluteDifference, edgeThreshold));
+    const __m128 blended = _mm_add_ps(previous, _mm_mul_ps(alpha, difference));
+    const __m128 result = _mm_or_ps(_mm_and_ps(blend, blended), _mm_andnot_ps(blend, current));
+    previous = _mm_or_ps(_mm_and_ps(currentValid, result), _mm_andnot_ps(currentValid, previous));
+    return result;
+}
+
+static inline void TransposeLanes(FloatLanes& a, FloatLanes& b, FloatLanes& c, FloatLanes& d)
+{
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+}
+#else
+typedef float32x4_t FloatLanes;
+
+static inline FloatLanes LoadLanes(const float* p) { return vld1q_f32(p); }
+static inline void StoreLanes(float* p, FloatLanes v) { vst1q_f32(p, v); }
+static inline FloatLanes SplatLanes(float v) { return vdupq_n_f32(v); }
+
+static inline FloatLanes BlendLanes(FloatLanes current, FloatLanes& previous, FloatLanes alpha, FloatLanes edgeThreshold)
+{
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t difference = vsubq_f32(current, previous);
+    const uint32x4_t currentValid = vcgtq_f32(current, zero);
+    const uint32x4_t blend = vandq_u32(vandq_u32(currentValid, vcgtq_f32(previous, zero)),
+        vcleq_f32(vabsq_f32(difference), edgeThreshold));
+    // Multiply and add separately, as Blend does, rather than fused.
+    const float32x4_t blended = vaddq_f32(previous, vmulq_f32(alpha, difference));
+    const float32x4_t result = vbslq_f32(blend, blended, current);
+    previous = vbslq_f32(currentValid, result, previous);
+    return result;
+}
+
+static inline void TransposeLanes(FloatLanes& a, FloatLanes& b, FloatLanes& c, FloatLanes& d)
+{
+    const float32x4x2_t ab = vtrnq_f32(a, b);
+    const float32x4x2_t cd = vtrnq_f32(c, d);
+    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+#endif
+
+// Sweeps four rows at once, one per lane: 4x4 blocks are transposed so that each vector holds one column of the
+// four rows, blended in order, and transposed back. Columns past the last whole block are blended one row at a time.
+static void SweepFourRows(float* const* rows, uint32_t width, bool forward, float alpha, float edgeThreshold)
+{
+    const FloatLanes alphaLanes = SplatLanes(alpha);
+    const FloatLanes thresholdLanes = SplatLanes(edgeThreshold);
+    FloatLanes previous = SplatLanes(0.0f);
+    const uint32_t blockEnd = width & ~3u;
+
+    if (forward)
+    {
+        for (uint32_t x = 0; x < blockEnd; x += 4)
+        {
+            FloatLanes c0 = LoadLanes(rows[0] + x), c1 = LoadLanes(rows[1] + x), c2 = LoadLanes(rows[2] + x), c3 = LoadLanes(rows[3] + x);
+            TransposeLanes(c0, c1, c2, c3);
+            c0 = BlendLanes(c0, previous, alphaLanes, thresholdLanes);
+            c1 = BlendLanes(c1, previous, alphaLanes, thresholdLanes);
+            c2 = BlendLanes(c2, previous, alphaLanes, thresholdLanes);
+            c3 = BlendLanes(c3, previous, alphaLanes, thresholdLanes);
+            TransposeLanes(c0, c1, c2, c3);
+            StoreLanes(rows[0] + x, c0);
+            StoreLanes(rows[1] + x, c1);
+            StoreLanes(rows[2] + x, c2);
+            StoreLanes(rows[3] + x, c3);
+        }
+
+        float previousPerRow[4];
+        StoreLanes(previousPerRow, previous);
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            SweepRow(rows[i], blockEnd, width, previousPerRow[i], alpha, edgeThreshold);
+        }
+    }
+    else
+    {
+        // The columns that don't fill a block come first going right to left.
+        float previousPerRow[4] = {};
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            SweepRowBackward(rows[i], blockEnd, width, previousPerRow[i], alpha, edgeThreshold);
+        }
+        previous = LoadLanes(previousPerRow);
+
+        for (uint32_t x = blockEnd; x > 0; x -= 4)
+        {
+            float* block[4] = { rows[0] + x - 4, rows[1] + x - 4, rows[2] + x - 4, rows[3] + x - 4 };
+            FloatLanes c0 = LoadLanes(block[0]), c1 = LoadLanes(block[1]), c2 = LoadLanes(block[2]), c3 = LoadLanes(block[3]);
+            TransposeLanes(c0, c1, c2, c3);
+            c3 = BlendLanes(c3, previous, alphaLanes, thresholdLanes);
+            c2 = BlendLanes(c2, previous, alphaLanes, thresholdLanes);
+            c1 = BlendLanes(c1, previous, alphaLanes, thresholdLanes);
+            c0 = BlendLanes(c0, previous, alphaLanes, thresholdLanes);
+            TransposeLanes(c0, c1, c2, c3);
+            StoreLanes(block[0], c0);
+            StoreLanes(block[1], c1);
+            StoreLanes(block[2], c2);
+            StoreLanes(block[3], c3);
+        }
+    }
+}
+
+// Blends one row of a column sweep. previous holds the running value of every column.
+static void SweepColumns(float* row, float* previous, uint32_t width, float alpha, float edgeThreshold)
+{
+    const FloatLanes alphaLanes = SplatLanes(alpha);
+    const FloatLanes thresholdLanes = SplatLanes(edgeThreshold);
+    uint32_t x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        FloatLanes previousLanes = LoadLanes(previous + x);
+        StoreLanes(row + x, BlendLanes(LoadLanes(row + x), previousLanes, alphaLanes, thresholdLanes));
+        StoreLanes(previous + x, previousLanes);
+    }
+    for (; x < width; x++)
+    {
+        row[x] = Blend(row[x], previous[x], alpha, edgeThreshold);
+    }
+}
+
+// FillColumns on eight columns at a time, returning the first column it didn't handle.
+static uint32_t FillColumnsSimd(const uint16_t* row, uint32_t width, uint16_t radius,
+    uint16_t* value, uint16_t* distance, uint16_t* fill)
+{
+    uint32_t x = 0;
+#if defined(SPATIALFILTER_X86)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i radiusLanes = _mm_set1_epi16(static_cast<short>(radius));
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m128i depth = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        const __m128i hole = _mm_cmpeq_epi16(depth, zero);
+        const __m128i holeDistance = _mm_and_si128(hole, _mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(distance + x)), one));
+        const __m128i lastValue = _mm_or_si128(_mm_and_si128(hole, _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + x))), depth);
+        const __m128i nearEnough = _mm_cmpeq_epi16(_mm_subs_epu16(holeDistance, radiusLanes), zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(distance + x), holeDistance);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(value + x), lastValue);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(fill + x), _mm_and_si128(_mm_and_si128(hole, nearEnough), lastValue));
+    }
+#elif defined(SPATIALFILTER_NEON)
+    const uint16x8_t zero = vdupq_n_u16(0);
+    const uint16x8_t one = vdupq_n_u16(1);
+    const uint16x8_t radiusLanes = vdupq_n_u16(radius);
+    for (; x + 8 <= width; x += 8)
+    {
+        const uint16x8_t depth = vld1q_u16(row + x);
+        const uint16x8_t hole = vceqq_u16(depth, zero);
+        const uint16x8_t holeDistance = vandq_u16(hole, vqaddq_u16(vld1q_u16(distance + x), one));
+        const uint16x8_t lastValue = vorrq_u16(vandq_u16(hole, vld1q_u16(value + x)), depth);
+        const uint16x8_t nearEnough = vcleq_u16(holeDistance, radiusLanes);
+        vst1q_u16(distance + x, holeDistance);
+        vst1q_u16(value + x, lastValue);
+        vst1q_u16(fill + x, vandq_u16(vandq_u16(hole, nearEnough), lastValue));
+    }
+#endif
+    return x;
+}
+
+// row = max(row, a, b) for eight columns at a time, returning the first column it didn't handle.
+static uint32_t MaxColumnsSimd(uint16_t* row, const uint16_t* a, const uint16_t* b, uint32_t width)
+{
+    uint32_t x = 0;
+#if defined(SPATIALFILTER_X86)
+    // Unsigned maximum: y + (x -sat y).
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m128i depth = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        const __m128i fromA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+        const __m128i fromB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+        const __m128i fill = _mm_add_epi16(fromB, _mm_subs_epu16(fromA, fromB));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), _mm_add_epi16(fill, _mm_subs_epu16(depth, fill)));
+    }
+#elif defined(SPATIALFILTER_NEON)
+    for (; x + 8 <= width; x += 8)
+    {
+        vst1q_u16(row + x, vmaxq_u16(vld1q_u16(row + x), vmaxq_u16(vld1q_u16(a + x), vld1q_u16(b + x))));
+    }
+#endif
+    return x;
+}
+
+#else
+
+static void SweepFourRows(float* const* rows, uint32_t width, bool forward, float alpha, float edgeThreshold)
+{
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        float previous = 0.0f;
+        if (forward)
+        {
+            SweepRow(rows[i], 0, width, previous, alpha, edgeThreshold);
+        }
+        else
+        {
+            SweepRowBackward(rows[i], 0, width, previous, alpha, edgeThreshold);
+        }
+    }
+}
+
+static void SweepColumns(float* row, float* previous, uint32_t width, float alpha, float edgeThreshold)
+{
+    for (uint32_t x = 0; x < width; x++)
+    {
+        row[x] = Blend(row[x], previous[x], alpha, edgeThreshold);
+    }
+}
+
+static uint32_t FillColumnsSimd(const uint16_t*, uint32_t, uint16_t, uint16_t*, uint16_t*, uint16_t*)
+{
+    return 0;
+}
+
+static uint32_t MaxColumnsSimd(uint16_t*, const uint16_t*, const uint16_t*, uint32_t)
+{
+    return 0;
+}
+
+#endif
+
+SpatialDepthFilter::SpatialDepthFilter(const SpatialFilterSettings& settings) :
+    m_settings(settings)
+{
+}
+
+void SpatialDepthFilter::Filter(uint32_t width, uint32_t height, uint16_t* depth, size_t rowStride, float depthScale)
+{
+    m_width = width;
+    m_height = height;
+    const size_t pixelCount = size_t(width) * height;
+
+    if (m_settings.iterations > 0)
+    {
+        m_smoothed.resize(pixelCount);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            std::copy(depth + y * rowStride, depth + y * rowStride + width, m_smoothed.begin() + size_t(y) * width);
+        }
+
+        Smooth(m_settings.edgeThreshold / depthScale);
+
+        // Blends of raw values stay within their range, so rounding can't overflow.
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const float* source = m_smoothed.data() + size_t(y) * width;
+            uint16_t* destination = depth + y * rowStride;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                destination[x] = static_cast<uint16_t>(source[x] + 0.5f);
+            }
+        }
+    }
+
+    if (m_settings.holeFillRadius > 0)
+    {
+        FillHoles(depth, rowStride);
+    }
+}
+
+void SpatialDepthFilter::Smooth(float edgeThreshold)
+{
+    const uint32_t width = m_width;
+    const uint32_t height = m_height;
+    const float alpha = m_settings.alpha;
+    std::vector<float>& previous = m_columnPrevious;
+    previous.resize(width);
+
+    for (uint32_t iteration = 0; iteration < m_settings.iterations; iteration++)
+    {
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const bool forward = (pass == 0);
+            uint32_t y = 0;
+            for (; y + 4 <= height; y += 4)
+            {
+                float* rows[4];
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    rows[i] = m_smoothed.data() + size_t(y + i) * width;
+                }
+                SweepFourRows(rows, width, forward, alpha, edgeThreshold);
+            }
+            for (; y < height; y++)
+            {
+                float rowPrevious = 0.0f;
+                float* row = m_smoothed.data() + size_t(y) * width;
+                if (forward)
+                {
+                    SweepRow(row, 0, width, rowPrevious, alpha, edgeThreshold);
+                }
+                else
+                {
+                    SweepRowBackward(row, 0, width, rowPrevious, alpha, edgeThreshold);
+                }
+            }
+        }
+
+        std::fill(previous.begin(), previous.end(), 0.0f);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            SweepColumns(m_smoothed.data() + size_t(y) * width, previous.data(), width, alpha, edgeThreshold);
+        }
+        std::fill(previous.begin(), previous.end(), 0.0f);
+        for (uint32_t y = height; y > 0; y--)
+        {
+            SweepColumns(m_smoothed.data() + size_t(y - 1) * width, previous.data(), width, alpha, edgeThreshold);
+        }
+    }
+}
+
+void SpatialDepthFilter::FillHoles(uint16_t* depth, size_t rowStride)
+{
+    const uint32_t width = m_width;
+    const uint32_t height = m_height;
+    const uint32_t radius = (std::min)(m_settings.holeFillRadius, 0xFFFEu);
+
+    // Along rows, each run of holes is filled from the valid pixels at its ends.
+    for (uint32_t y = 0; y < height; y++)
+    {
+        uint16_t* row = depth + y * rowStride;
+        uint32_t x = 0;
+        while (x < width)
+        {
+            if (row[x] != 0)
+            {
+                x++;
+                continue;
+            }
+
+            const uint32_t begin = x;
+            while (x < width && row[x] == 0)
+            {
+                x++;
+            }
+            const uint16_t left = (begin > 0) ? row[begin - 1] : 0;
+            const uint16_t right = (x < width) ? row[x] : 0;
+            const uint32_t reachEnd = (std::min)(x, begin + radius);
+            const uint32_t reachBegin = (x - begin > radius) ? x - radius : begin;
+            for (uint32_t i = begin; i < reachEnd; i++)
+            {
+                row[i] = left;
+            }
+            for (uint32_t i = reachBegin; i < x; i++)
+            {
+                row[i] = (std::max)(row[i], right);
+            }
+        }
+    }
+
+    // Along columns, the fill from above is recorded on the way down and combined with the fill from below on
+    // the way up. Holes are told apart from filled pixels by the original value, which the upward sweep reads
+    // before it writes.
+    m_fillFromAbove.resize(size_t(width) * height);
+    std::vector<uint16_t>& value = m_fillValue;
+    std::vector<uint16_t>& distance = m_fillDistance;
+    std::vector<uint16_t>& fillFromBelow = m_fillFromBelow;
+    value.assign(width, 0);
+    distance.assign(width, 0xFFFF);
+    fillFromBelow.resize(width);
+    const uint16_t fillRadius = static_cast<uint16_t>(radius);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint16_t* row = depth + y * rowStride;
+        uint16_t* fill = m_fillFromAbove.data() + size_t(y) * width;
+        const uint32_t x = FillColumnsSimd(row, width, fillRadius, value.data(), distance.data(), fill);
+        FillColumns(row, x, width, fillRadius, value.data(), distance.data(), fill);
+    }
+
+    std::fill(value.begin(), value.end(), 0);
+    std::fill(distance.begin(), distance.end(), 0xFFFF);
+    for (uint32_t y = height; y > 0; y--)
+    {
+        uint16_t* row = depth + (y - 1) * rowStride;
+        const uint16_t* fillFromAbove = m_fillFromAbove.data() + size_t(y - 1) * width;
+        uint32_t x = FillColumnsSimd(row, width, fillRadius, value.data(), distance.data(), fillFromBelow.data());
+        FillColumns(row, x, width, fillRadius, value.data(), distance.data(), fillFromBelow.data());
+
+        // Only holes have a fill from either side, and they are 0, so the maximum of the three is the fill.
+        x = MaxColumnsSimd(row, fillFromAbove, fillFromBelow.data(), width);
+        for (; x < width; x++)
+        {
+            row[x] = (std::max)(row[x], (std::max)(fillFromAbove[x], fillFromBelow[x]));
+        }
+    }
+}
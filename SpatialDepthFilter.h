@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SDKTemplate
+{
+    struct SpatialFilterSettings
+    {
+        // Weight of a pixel against the running value of its neighbours on one side, above 0 and at most 1,
+        // where 1 doesn't smooth at all.
+        float alpha = 0.5f;
+
+        // Depth step, in meters, beyond which neighbours are taken to be different surfaces and not smoothed
+        // together.
+        float edgeThreshold = 0.008f;
+
+        // Times the four smoothing sweeps are run. 0 only fills holes.
+        uint32_t iterations = 1;
+
+        // Distance, in pixels, from which a hole is filled from a valid neighbour in its row or column.
+        // 0 leaves holes alone.
+        uint32_t holeFillRadius = 4;
+    };
+
+    // Smooths raw 16 bit depth without blurring across depth edges, and fills small holes.
+    // Smoothing is a domain transform style recursive filter: every row is swept left to right and right to
+    // left, and every column top to bottom and bottom to top, each pixel blended with the running value of the
+    // pixels before it unless the depth steps by more than the edge threshold. Columns are swept four at a time
+    // with SIMD, and rows four at a time by transposing 4x4 blocks. A raw value of 0 is invalid and never
+    // blended. Holes are then filled with the farther of their nearest valid neighbours within the fill
+    // radius, first along rows, then along columns, since the holes a depth camera leaves at an edge belong
+    // to the background. Only standard C++ is used, so the filter can be exercised off-device with recorded depth.
+    class SpatialDepthFilter
+    {
+    public:
+        explicit SpatialDepthFilter(const SpatialFilterSettings& settings = SpatialFilterSettings());
+
+        const SpatialFilterSettings& GetSettings() const { return m_settings; }
+        void Configure(const SpatialFilterSettings& settings) { m_settings = settings; }
+
+        /// <summary>
+        /// Filters a raw depth image of width x height pixels in place, with rowStride samples per row and
+        /// depthScale meters per raw unit. The working buffers are kept for the next image of the same size.
+        /// </summary>
+        void Filter(uint32_t width, uint32_t height, uint16_t* depth, size_t rowStride, float depthScale);
+
+    private:
+        void Smooth(float edgeThreshold);
+        void FillHoles(uint16_t* depth, size_t rowStride);
+
+        SpatialFilterSettings m_settings;
+
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+
+        // The image being smoothed, width floats per row, and the running value of every column.
+        std::vector<float> m_smoothed;
+        std::vector<float> m_columnPrevious;
+
+        // The fill from above of every pixel, and per column, the last valid depth of a column sweep, the rows
+        // since, and the fill from below of the current row.
+        std::vector<uint16_t> m_fillFromAbove;
+        std::vector<uint16_t> m_fillValue;
+        std::vector<uint16_t> m_fillDistance;
+        std::vector<uint16_t> m_fillFromBelow;
+    };
+} // SDKTemplate
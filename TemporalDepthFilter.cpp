@@ -0,0 +1,492 @@
+#include "TemporalDepthFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TEMPORALFILTER_X86
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define TEMPORALFILTER_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+using namespace SDKTemplate;
+
+// Exponential weights are fixed point, with the newest sample weighing this much.
+static constexpr uint32_t newestWeight = 256;
+
+bool SDKTemplate::operator==(const TemporalFilterSettings& left, const TemporalFilterSettings& right)
+{
+    return left.mode == right.mode &&
+        left.historyLength == right.historyLength &&
+        left.decay == right.decay &&
+        left.motionThreshold == right.motionThreshold;
+}
+
+// The scalar filters define the output. The SIMD variants below perform the same integer and float
+// operations lane by lane, so they match them exactly.
+
+static uint16_t MedianOfSamples(const uint16_t* const* rows, uint32_t frameCount, size_t x)
+{
+    // Insertion sort of the valid samples, at most MaxTemporalFilterHistory of them.
+    uint16_t samples[MaxTemporalFilterHistory];
+    uint32_t validCount = 0;
+    for (uint32_t i = 0; i < frameCount; i++)
+    {
+        const uint16_t sample = rows[i][x];
+        if (sample != 0)
+        {
+            uint32_t j = validCount++;
+            for (; j > 0 && samples[j - 1] > sample; j--)
+            {
+                samples[j] = samples[j - 1];
+            }
+            samples[j] = sample;
+        }
+    }
+    if (validCount == 0)
+    {
+        return 0;
+    }
+
+    const uint32_t low = samples[(validCount - 1) / 2];
+    const uint32_t high = samples[validCount / 2];
+    return static_cast<uint16_t>((low + high + 1) >> 1);
+}
+
+static uint16_t WeightedAverageOfSamples(const uint16_t* const* rows, uint32_t frameCount, const uint16_t* weights,
+    uint16_t motionThreshold, size_t x)
+{
+    uint16_t reference = 0;
+    for (uint32_t i = 0; i < frameCount && reference == 0; i++)
+    {
+        reference = rows[i][x];
+    }
+
+    uint32_t weightedSum = 0;
+    uint32_t weightSum = 0;
+    for (uint32_t i = 0; i < frameCount; i++)
+    {
+        const uint16_t sample = rows[i][x];
+        const uint16_t difference = static_cast<uint16_t>(sample > reference ? sample - reference : reference - sample);
+        if (sample != 0 && difference <= motionThreshold)
+        {
+            weightedSum += uint32_t(sample) * weights[i];
+            weightSum += weights[i];
+        }
+    }
+    if (weightSum == 0)
+    {
+        return 0;
+    }
+    return static_cast<uint16_t>(static_cast<float>(weightedSum) / static_cast<float>(weightSum) + 0.5f);
+}
+
+#if defined(TEMPORALFILTER_X86) || defined(TEMPORALFILTER_NEON)
+
+// The compare-exchanges of Batcher's merge exchange sort of count elements (Knuth, The Art of Computer
+// Programming, volume 3, algorithm 5.2.2M), in an order that sorts them. Built by the compiler, so that
+// ForEachMergeExchange unrolls into straight-line code.
+struct MergeExchangeNetwork
+{
+    uint32_t size;
+    uint8_t first[32];
+    uint8_t second[32];
+};
+
+static constexpr MergeExchangeNetwork BuildMergeExchangeNetwork(uint32_t count)
+{
+    MergeExchangeNetwork network = {};
+    for (uint32_t p = 1; p < count; p <<= 1)
+    {
+        for (uint32_t k = p; k >= 1; k >>= 1)
+        {
+            for (uint32_t j = k % p; j + k < count; j += 2 * k)
+            {
+                for (uint32_t i = 0; i < k && i + j + k < count; i++)
+                {
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+                    {
+                        network.first[network.size] = static_cast<uint8_t>(i + j);
+                        network.second[network.size] = static_cast<uint8_t>(i + j + k);
+                        network.size++;
+                    }
+                }
+            }
+        }
+    }
+    return network;
+}
+
+template<uint32_t count>
+static constexpr MergeExchangeNetwork mergeExchangeNetwork = BuildMergeExchangeNetwork(count);
+
+static_assert(mergeExchangeNetwork<MaxTemporalFilterHistory>.size == 19, "merge exchange sorts 8 elements with 19 exchanges");
+
+template<uint32_t count, typename Exchange, size_t... indexes>
+static inline void ForEachMergeExchange(Exchange exchange, std::index_sequence<indexes...>)
+{
+    const int expand[] = { 0, (exchange(mergeExchangeNetwork<count>.first[indexes], mergeExchangeNetwork<count>.second[indexes]), 0)... };
+    (void)expand;
+}
+
+// Calls exchange(a, b), a < b, for every compare-exchange of the network for count elements.
+template<uint32_t count, typename Exchange>
+static inline void ForEachMergeExchange(Exchange exchange)
+{
+    ForEachMergeExchange<count>(exchange, std::make_index_sequence<mergeExchangeNetwork<count>.size>());
+}
+
+#endif
+
+#if defined(TEMPORALFILTER_X86)
+
+// Sorts the samples of eight pixels with Batcher's merge exchange network, 19 compare-exchanges for 8 frames
+// where odd-even transposition takes 28. Invalid samples are turned into the largest value first, so the valid
+// ones come out in front and the median can be picked by count. The frame count is a template argument so
+// that the network unrolls, the samples stay in registers, and exchanges that only move samples past the
+// middle, which the median never reads, are left out by the compiler.
+template<uint32_t frameCount>
+static void MedianRow(const uint16_t* const* rows, size_t width, uint16_t* output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i samples[frameCount];
+        __m128i validCount = zero;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            const __m128i sample = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + x));
+            const __m128i invalid = _mm_cmpeq_epi16(sample, zero);
+            validCount = _mm_add_epi16(validCount, _mm_andnot_si128(invalid, one));
+            samples[i] = _mm_or_si128(sample, invalid);
+        }
+
+        // Unsigned minimum and maximum: a - (a -sat b) and b + (a -sat b).
+        ForEachMergeExchange<frameCount>([&](uint32_t a, uint32_t b)
+        {
+            const __m128i excess = _mm_subs_epu16(samples[a], samples[b]);
+            samples[b] = _mm_add_epi16(samples[b], excess);
+            samples[a] = _mm_sub_epi16(samples[a], excess);
+        });
+
+        // The median is at most half way up. A count of 0 gives a low index no position has, and the result is
+        // cleared below anyway.
+        const __m128i lowIndex = _mm_srli_epi16(_mm_sub_epi16(validCount, one), 1);
+        const __m128i highIndex = _mm_srli_epi16(validCount, 1);
+        __m128i low = zero;
+        __m128i high = zero;
+        for (uint32_t i = 0; i <= frameCount / 2; i++)
+        {
+            const __m128i position = _mm_set1_epi16(static_cast<short>(i));
+            low = _mm_or_si128(low, _mm_and_si128(samples[i], _mm_cmpeq_epi16(lowIndex, position)));
+            high = _mm_or_si128(high, _mm_and_si128(samples[i], _mm_cmpeq_epi16(highIndex, position)));
+        }
+
+        const __m128i median = _mm_andnot_si128(_mm_cmpeq_epi16(validCount, zero), _mm_avg_epu16(low, high));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x), median);
+    }
+
+    for (; x < width; x++)
+    {
+        output[x] = MedianOfSamples(rows, frameCount, x);
+    }
+}
+
+template<uint32_t frameCount>
+static void WeightedAverageRow(const uint16_t* const* rows, const uint16_t* weights, uint16_t motionThreshold,
+    size_t width, uint16_t* output)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i threshold = _mm_set1_epi16(static_cast<short>(motionThreshold));
+    const __m128i signFlip = _mm_set1_epi16(static_cast<short>(0x8000));
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i reference = zero;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            const __m128i sample = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + x));
+            const __m128i unset = _mm_cmpeq_epi16(reference, zero);
+            reference = _mm_or_si128(reference, _mm_and_si128(unset, sample));
+        }
+
+        __m128i weightedSumLow = zero;
+        __m128i weightedSumHigh = zero;
+        __m128i weightSum = zero;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            const __m128i sample = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + x));
+            const __m128i difference = _mm_or_si128(_mm_subs_epu16(sample, reference), _mm_subs_epu16(reference, sample));
+            const __m128i near = _mm_cmpeq_epi16(_mm_subs_epu16(difference, threshold), zero);
+            const __m128i counted = _mm_andnot_si128(_mm_cmpeq_epi16(sample, zero), near);
+
+            // Full 32 bit products from their low and high halves. Samples that don't count are cleared before
+            // the multiply, so their products are 0.
+            const __m128i weight = _mm_set1_epi16(static_cast<short>(weights[i]));
+            const __m128i countedSample = _mm_and_si128(sample, counted);
+            const __m128i productLow = _mm_mullo_epi16(countedSample, weight);
+            const __m128i productHigh = _mm_mulhi_epu16(countedSample, weight);
+            weightedSumLow = _mm_add_epi32(weightedSumLow, _mm_unpacklo_epi16(productLow, productHigh));
+            weightedSumHigh = _mm_add_epi32(weightedSumHigh, _mm_unpackhi_epi16(productLow, productHigh));
+            weightSum = _mm_add_epi16(weightSum, _mm_and_si128(weight, counted));
+        }
+
+        const __m128i weightSumLow = _mm_unpacklo_epi16(weightSum, zero);
+        const __m128i weightSumHigh = _mm_unpackhi_epi16(weightSum, zero);
+        __m128i averageLow = _mm_cvttps_epi32(_mm_add_ps(
+            _mm_div_ps(_mm_cvtepi32_ps(weightedSumLow), _mm_cvtepi32_ps(weightSumLow)), half));
+        __m128i averageHigh = _mm_cvttps_epi32(_mm_add_ps(
+            _mm_div_ps(_mm_cvtepi32_ps(weightedSumHigh), _mm_cvtepi32_ps(weightSumHigh)), half));
+        averageLow = _mm_andnot_si128(_mm_cmpeq_epi32(weightSumLow, zero), averageLow);
+        averageHigh = _mm_andnot_si128(_mm_cmpeq_epi32(weightSumHigh, zero), averageHigh);
+
+        // Pack to unsigned 16 bits through the signed saturating pack, shifted by half the range.
+        const __m128i average = _mm_xor_si128(signFlip,
+            _mm_packs_epi32(_mm_sub_epi32(averageLow, bias), _mm_sub_epi32(averageHigh, bias)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x), average);
+    }
+
+    for (; x < width; x++)
+    {
+        output[x] = WeightedAverageOfSamples(rows, frameCount, weights, motionThreshold, x);
+    }
+}
+
+#elif defined(TEMPORALFILTER_NEON)
+
+template<uint32_t frameCount>
+static void MedianRow(const uint16_t* const* rows, size_t width, uint16_t* output)
+{
+    const uint16x8_t zero = vdupq_n_u16(0);
+    const uint16x8_t one = vdupq_n_u16(1);
+
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        uint16x8_t samples[frameCount];
+        uint16x8_t validCount = zero;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            const uint16x8_t sample = vld1q_u16(rows[i] + x);
+            const uint16x8_t invalid = vceqq_u16(sample, zero);
+            validCount = vaddq_u16(validCount, vbicq_u16(one, invalid));
+            samples[i] = vorrq_u16(sample, invalid);
+        }
+
+        ForEachMergeExchange<frameCount>([&](uint32_t a, uint32_t b)
+        {
+            const uint16x8_t smaller = vminq_u16(samples[a], samples[b]);
+            samples[b] = vmaxq_u16(samples[a], samples[b]);
+            samples[a] = smaller;
+        });
+
+        const uint16x8_t lowIndex = vshrq_n_u16(vsubq_u16(validCount, one), 1);
+        const uint16x8_t highIndex = vshrq_n_u16(validCount, 1);
+        uint16x8_t low = zero;
+        uint16x8_t high = zero;
+        for (uint32_t i = 0; i <= frameCount / 2; i++)
+        {
+            const uint16x8_t position = vdupq_n_u16(static_cast<uint16_t>(i));
+            low = vorrq_u16(low, vandq_u16(samples[i], vceqq_u16(lowIndex, position)));
+            high = vorrq_u16(high, vandq_u16(samples[i], vceqq_u16(highIndex, position)));
+        }
+
+        vst1q_u16(output + x, vbicq_u16(vrhaddq_u16(low, high), vceqq_u16(validCount, zero)));
+    }
+
+    for (; x < width; x++)
+    {
+        output[x] = MedianOfSamples(rows, frameCount, x);
+    }
+}
+
+template<uint32_t frameCount>
+static void WeightedAverageRow(const uint16_t* const* rows, const uint16_t* weights, uint16_t motionThreshold,
+    size_t width, uint16_t* output)
+{
+    const uint16x8_t zero = vdupq_n_u16(0);
+    const uint16x8_t threshold = vdupq_n_u16(motionThreshold);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        uint16x8_t reference = zero;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            reference = vbslq_u16(vceqq_u16(reference, zero), vld1q_u16(rows[i] + x), reference);
+        }
+
+        uint32x4_t weightedSumLow = vdupq_n_u32(0);
+        uint32x4_t weightedSumHigh = vdupq_n_u32(0);
+        uint16x8_t weightSum = zero;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            const uint16x8_t sample = vld1q_u16(rows[i] + x);
+            const uint16x8_t counted = vbicq_u16(vcleq_u16(vabdq_u16(sample, reference), threshold), vceqq_u16(sample, zero));
+            const uint16x8_t countedSample = vandq_u16(sample, counted);
+            const uint16_t weight = weights[i];
+            weightedSumLow = vmlal_n_u16(weightedSumLow, vget_low_u16(countedSample), weight);
+            weightedSumHigh = vmlal_n_u16(weightedSumHigh, vget_high_u16(countedSample), weight);
+            weightSum = vaddq_u16(weightSum, vandq_u16(vdupq_n_u16(weight), counted));
+        }
+
+        const uint32x4_t weightSumLow = vmovl_u16(vget_low_u16(weightSum));
+        const uint32x4_t weightSumHigh = vmovl_u16(vget_high_u16(weightSum));
+        uint32x4_t averageLow = vcvtq_u32_f32(vaddq_f32(
+            vdivq_f32(vcvtq_f32_u32(weightedSumLow), vcvtq_f32_u32(weightSumLow)), half));
+        uint32x4_t averageHigh = vcvtq_u32_f32(vaddq_f32(
+            vdivq_f32(vcvtq_f32_u32(weightedSumHigh), vcvtq_f32_u32(weightSumHigh)), half));
+        averageLow = vbicq_u32(averageLow, vceqq_u32(weightSumLow, vdupq_n_u32(0)));
+        averageHigh = vbicq_u32(averageHigh, vceqq_u32(weightSumHigh, vdupq_n_u32(0)));
+
+        vst1q_u16(output + x, vcombine_u16(vmovn_u32(averageLow), vmovn_u32(averageHigh)));
+    }
+
+    for (; x < width; x++)
+    {
+        output[x] = WeightedAverageOfSamples(rows, frameCount, weights, motionThreshold, x);
+    }
+}
+
+#endif
+
+#if defined(TEMPORALFILTER_X86) || defined(TEMPORALFILTER_NEON)
+
+// The variants for every frame count, indexed by the count less 1.
+typedef void(*MedianRowFunction)(const uint16_t* const*, size_t, uint16_t*);
+typedef void(*WeightedAverageRowFunction)(const uint16_t* const*, const uint16_t*, uint16_t, size_t, uint16_t*);
+
+static_assert(MaxTemporalFilterHistory == 8, "the row function tables cover frame counts up to 8");
+
+static const MedianRowFunction medianRows[MaxTemporalFilterHistory] = {
+    MedianRow<1>, MedianRow<2>, MedianRow<3>, MedianRow<4>, MedianRow<5>, MedianRow<6>, MedianRow<7>, MedianRow<8>
+};
+
+static const WeightedAverageRowFunction weightedAverageRows[MaxTemporalFilterHistory] = {
+    WeightedAverageRow<1>, WeightedAverageRow<2>, WeightedAverageRow<3>, WeightedAverageRow<4>,
+    WeightedAverageRow<5>, WeightedAverageRow<6>, WeightedAverageRow<7>, WeightedAverageRow<8>
+};
+
+static void MedianRow(const uint16_t* const* rows, uint32_t frameCount, size_t width, uint16_t* output)
+{
+    medianRows[frameCount - 1](rows, width, output);
+}
+
+static void WeightedAverageRow(const uint16_t* const* rows, uint32_t frameCount, const uint16_t* weights,
+    uint16_t motionThreshold, size_t width, uint16_t* output)
+{
+    weightedAverageRows[frameCount - 1](rows, weights, motionThreshold, width, output);
+}
+
+#else
+
+static void MedianRow(const uint16_t* const* rows, uint32_t frameCount, size_t width, uint16_t* output)
+{
+    for (size_t x = 0; x < width; x++)
+    {
+        output[x] = MedianOfSamples(rows, frameCount, x);
+    }
+}
+
+static void WeightedAverageRow(const uint16_t* const* rows, uint32_t frameCount, const uint16_t* weights,
+    uint16_t motionThreshold, size_t width, uint16_t* output)
+{
+    for (size_t x = 0; x < width; x++)
+    {
+        output[x] = WeightedAverageOfSamples(rows, frameCount, weights, motionThreshold, x);
+    }
+}
+
+#endif
+
+TemporalDepthFilter::TemporalDepthFilter(const TemporalFilterSettings& settings)
+{
+    Configure(settings);
+}
+
+void TemporalDepthFilter::Configure(const TemporalFilterSettings& settings)
+{
+    if (!m_history.empty() && settings == m_settings)
+    {
+        return;
+    }
+
+    m_settings = settings;
+    m_settings.historyLength = (std::min)((std::max)(m_settings.historyLength, 1u), MaxTemporalFilterHistory);
+    m_history.assign(size_t(m_settings.historyLength) * m_width * m_height, 0);
+    Reset();
+}
+
+void TemporalDepthFilter::Reset()
+{
+    m_newest = 0;
+    m_frameCount = 0;
+}
+
+void TemporalDepthFilter::Filter(uint32_t width, uint32_t height, const uint16_t* depth, size_t depthRowStride, float depthScale, uint16_t* filtered)
+{
+    const uint32_t historyLength = m_settings.historyLength;
+    const size_t frameSize = size_t(width) * height;
+    if (width != m_width || height != m_height)
+    {
+        m_width = width;
+        m_height = height;
+        m_history.assign(historyLength * frameSize, 0);
+        Reset();
+    }
+
+    // The new frame takes the slot of the oldest one.
+    m_newest = (m_frameCount == 0) ? 0 : (m_newest + 1) % historyLength;
+    m_frameCount = (std::min)(m_frameCount + 1, historyLength);
+    uint16_t* newestFrame = m_history.data() + m_newest * frameSize;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        std::memcpy(newestFrame + size_t(y) * width, depth + y * depthRowStride, width * sizeof(uint16_t));
+    }
+
+    // Weights fall off with age but never reach 0, so every valid sample can stand in for a dropout.
+    uint16_t weights[MaxTemporalFilterHistory];
+    float weight = static_cast<float>(newestWeight);
+    for (uint32_t i = 0; i < m_frameCount; i++)
+    {
+        weights[i] = static_cast<uint16_t>((std::max)(1.0f, std::floor(weight + 0.5f)));
+        weight *= m_settings.decay;
+    }
+    const uint16_t motionThreshold = static_cast<uint16_t>((std::min)(m_settings.motionThreshold / depthScale + 0.5f, 65535.0f));
+
+    // The rows of one image row in every kept frame, newest first.
+    const uint16_t* rows[MaxTemporalFilterHistory];
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t i = 0; i < m_frameCount; i++)
+        {
+            const uint32_t slot = (m_newest + historyLength - i) % historyLength;
+            rows[i] = m_history.data() + slot * frameSize + size_t(y) * width;
+        }
+
+        uint16_t* output = filtered + size_t(y) * width;
+        if (m_settings.mode == TemporalFilterMode::Median)
+        {
+            MedianRow(rows, m_frameCount, width, output);
+        }
+        else
+        {
+            WeightedAverageRow(rows, m_frameCount, weights, motionThreshold, width, output);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // Most frames a TemporalDepthFilter can keep.
+    constexpr uint32_t MaxTemporalFilterHistory = 8;
+
+    // How a TemporalDepthFilter combines the frames it keeps.
+    enum class TemporalFilterMode
+    {
+        Median, // Median of the valid samples, the mean of the middle two for an even count.
+        Exponential, // Average of the valid samples weighted by decay per frame of age.
+    };
+
+    struct TemporalFilterSettings
+    {
+        TemporalFilterMode mode = TemporalFilterMode::Median;
+
+        // Frames kept, the newest included. Between 1 and MaxTemporalFilterHistory.
+        uint32_t historyLength = 5;
+
+        // Exponential only: the weight of a sample relative to the one a frame newer, between 0 and 1,
+        // and how far, in meters, a sample may be from the newest valid one and still count, so that
+        // motion isn't smeared over the history.
+        float decay = 0.5f;
+        float motionThreshold = 0.015f;
+    };
+
+    bool operator==(const TemporalFilterSettings& left, const TemporalFilterSettings& right);
+    inline bool operator!=(const TemporalFilterSettings& left, const TemporalFilterSettings& right) { return !(left == right); }
+
+    // Smooths the flicker of raw 16 bit depth over the last few frames, which are kept in a ring allocated
+    // once per frame size. A raw value of 0 is invalid: it never counts as a sample, so a pixel that drops
+    // out for a frame keeps the depth of the frames around it, and is only 0 once every kept sample is.
+    // Pixels are filtered eight 16 bit lanes at a time with SSE2 or NEON; every path gives the same output.
+    // Only standard C++ is used, so the filter can be exercised off-device with recorded depth.
+    class TemporalDepthFilter
+    {
+    public:
+        explicit TemporalDepthFilter(const TemporalFilterSettings& settings = TemporalFilterSettings());
+
+        const TemporalFilterSettings& GetSettings() const { return m_settings; }
+
+        /// <summary>
+        /// Changes the settings. Forgets the history if they differ from the current ones.
+        /// </summary>
+        void Configure(const TemporalFilterSettings& settings);
+
+        /// <summary>
+        /// Forgets the history, so the next frame is filtered alone.
+        /// </summary>
+        void Reset();
+
+        /// <summary>
+        /// Adds a raw depth frame of width x height pixels, with depthRowStride samples per row and depthScale
+        /// meters per raw unit, to the history, and writes the filtered frame to filtered, width samples per
+        /// row. A frame of a different size starts the history over.
+        /// </summary>
+        void Filter(uint32_t width, uint32_t height, const uint16_t* depth, size_t depthRowStride, float depthScale, uint16_t* filtered);
+
+    private:
+        TemporalFilterSettings m_settings;
+
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+
+        // historyLength frames of width * height samples. m_newest is the slot of the newest frame,
+        // and older frames precede it, wrapping around.
+        std::vector<uint16_t> m_history;
+        uint32_t m_newest = 0;
+        uint32_t m_frameCount = 0;
+    };
+} // SDKTemplate
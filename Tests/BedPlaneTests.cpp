@@ -0,0 +1,132 @@
+#include "BedPlane.h"
+#include "SyntheticScene.h"
+#include "TestChecks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// The plate is tilted 15 degrees about the camera's x axis.
+static const float plateTilt = 15.0f;
+
+// Depth of the plate, with a 5 cm box on it, clutter over a side of the image, some pixels without depth and
+// 1.5 mm of noise. The box and the clutter don't lie on the plate, so RANSAC has outliers to reject.
+static std::vector<float> RenderScene(const RayTable& rays, const BedPlane& plane, std::minstd_rand& random)
+{
+    std::normal_distribution<float> noise(0.0f, 0.0015f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<float> depth = Tests::RenderBoxOnPlate(rays, plane, 0.05f, 0.12f);
+    for (size_t i = 0; i < depth.size(); i++)
+    {
+        if (rays.GetRayX()[i] > 0.45f)
+        {
+            depth[i] = 0.3f;
+        }
+        depth[i] = (uniform(random) < 0.2f) ? 0.0f : depth[i] + noise(random);
+    }
+    return depth;
+}
+
+static void CheckPlane(const BedPlane& plane, const BedPlane& expected)
+{
+    // Within half a degree, and 3 mm along the normal.
+    const float cosine = plane.normal[0] * expected.normal[0] + plane.normal[1] * expected.normal[1] + plane.normal[2] * expected.normal[2];
+    CHECK(cosine > std::cos(0.5f * 3.14159265f / 180.0f));
+    CHECK_NEAR(plane.offset, expected.offset, 0.003f);
+}
+
+static void TestPlaneIsFound()
+{
+    const RayTable rays(Tests::MakeTimeOfFlightCamera());
+    std::minstd_rand random(7);
+    const BedPlane truePlane = Tests::MakePlate(plateTilt, 0.6f);
+    std::vector<float> depth = RenderScene(rays, truePlane, random);
+
+    BedPlaneEstimator estimator;
+    CHECK(!estimator.HasPlane());
+    CHECK(estimator.Update(rays, depth.data()));
+    CHECK(estimator.HasPlane());
+    CheckPlane(estimator.GetPlane(), truePlane);
+    CHECK(estimator.GetStatistics().fits == 1);
+
+    // The box is 5 cm along the rays in front of the plate; its height is what the true plane gives it.
+    std::vector<float> heights(rays.GetCount());
+    ComputeHeightsAbovePlane(estimator.GetPlane(), rays, depth.data(), heights.data());
+    size_t invalid = 0;
+    float worstError = 0.0f;
+    for (size_t i = 0; i < heights.size(); i++)
+    {
+        if (!(depth[i] > 0.0f))
+        {
+            invalid += std::isnan(heights[i]) ? 0 : 1;
+            continue;
+        }
+        const float z = depth[i];
+        const float expected = truePlane.normal[0] * rays.GetRayX()[i] * z + truePlane.normal[1] * rays.GetRayY()[i] * z +
+            truePlane.normal[2] * z + truePlane.offset;
+        worstError = (std::max)(worstError, std::fabs(heights[i] - expected));
+    }
+    CHECK(invalid == 0);
+    CHECK(worstError < 0.004f);
+}
+
+static void TestRefitAndDrift()
+{
+    const RayTable rays(Tests::MakeTimeOfFlightCamera());
+    std::minstd_rand random(11);
+    BedPlaneSettings settings;
+    BedPlaneEstimator estimator(settings);
+
+    // A static plate is only refit every refitInterval frames.
+    const BedPlane truePlane = Tests::MakePlate(plateTilt, 0.6f);
+    for (uint32_t frame = 0; frame <= 2 * settings.refitInterval; frame++)
+    {
+        std::vector<float> depth = RenderScene(rays, truePlane, random);
+        CHECK(estimator.Update(rays, depth.data()));
+    }
+    CHECK(estimator.GetStatistics().fits == 1);
+    CHECK(estimator.GetStatistics().refits == 2);
+    CHECK(estimator.GetStatistics().drifts == 0);
+    CheckPlane(estimator.GetPlane(), truePlane);
+
+    // When the plate moves 2 cm, far beyond the inlier threshold, the next frame notices and fits from scratch.
+    const BedPlane movedPlane = Tests::MakePlate(plateTilt, 0.62f);
+    std::vector<float> depth = RenderScene(rays, movedPlane, random);
+    CHECK(estimator.Update(rays, depth.data()));
+    CHECK(estimator.GetStatistics().drifts == 1);
+    CHECK(estimator.GetStatistics().fits == 2);
+    CheckPlane(estimator.GetPlane(), movedPlane);
+}
+
+static void TestNoPlane()
+{
+    const RayTable rays(Tests::MakeTimeOfFlightCamera());
+    BedPlaneEstimator estimator;
+
+    // Without valid depth there is nothing to fit.
+    std::vector<float> depth(rays.GetCount(), std::numeric_limits<float>::quiet_NaN());
+    CHECK(!estimator.Update(rays, depth.data()));
+    CHECK(!estimator.HasPlane());
+
+    // Reset forgets a plane that was found.
+    std::minstd_rand random(3);
+    depth = RenderScene(rays, Tests::MakePlate(plateTilt, 0.5f), random);
+    CHECK(estimator.Update(rays, depth.data()));
+    estimator.Reset();
+    CHECK(!estimator.HasPlane());
+    CHECK(estimator.Update(rays, depth.data()));
+    CheckPlane(estimator.GetPlane(), Tests::MakePlate(plateTilt, 0.5f));
+}
+
+int main()
+{
+    TestPlaneIsFound();
+    TestRefitAndDrift();
+    TestNoPlane();
+    return Tests::FailureCount();
+}
@@ -0,0 +1,188 @@
+#include "BoundedFrameQueue.h"
+#include "TestChecks.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+using namespace SDKTemplate;
+
+// Frames are numbered; 0 is the empty item.
+typedef BoundedFrameQueue<int> Queue;
+
+// Pops count items, which must be first, first + 1, ..., and checks that the queue is then empty.
+static void CheckPops(Queue& queue, int first, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int item = 0;
+        CHECK(queue.GetDepth() > 0);
+        CHECK(queue.Pop(item));
+        CHECK(item == first + i);
+    }
+    CHECK(queue.GetDepth() == 0);
+}
+
+static void TestDropPolicies()
+{
+    // A full queue that drops the oldest item keeps the newest ones; Push reports the drop.
+    Queue dropOldest(3, FrameDropPolicy::DropOldest);
+    for (int frame = 1; frame <= 5; frame++)
+    {
+        CHECK(dropOldest.Push(frame) == (frame <= 3));
+    }
+    CHECK(dropOldest.GetDepth() == 3);
+    CHECK(dropOldest.GetPushedCount() == 5);
+    CHECK(dropOldest.GetDroppedCount() == 2);
+    CheckPops(dropOldest, 3, 3);
+
+    // One that drops the newest keeps what it has.
+    Queue dropNewest(3, FrameDropPolicy::DropNewest);
+    for (int frame = 1; frame <= 5; frame++)
+    {
+        CHECK(dropNewest.Push(frame) == (frame <= 3));
+    }
+    CHECK(dropNewest.GetPushedCount() == 3);
+    CHECK(dropNewest.GetDroppedCount() == 2);
+    CheckPops(dropNewest, 1, 3);
+
+    // The policy can change while items wait.
+    dropNewest.SetDropPolicy(FrameDropPolicy::DropOldest);
+    for (int frame = 6; frame <= 9; frame++)
+    {
+        dropNewest.Push(frame);
+    }
+    CheckPops(dropNewest, 7, 3);
+}
+
+static void TestSetCapacity()
+{
+    Queue queue(4, FrameDropPolicy::DropOldest);
+
+    // Move the ring's head off 0, so that resizing has to unwrap it.
+    for (int frame = 1; frame <= 3; frame++)
+    {
+        queue.Push(frame);
+    }
+    CheckPops(queue, 1, 3);
+    for (int frame = 4; frame <= 7; frame++)
+    {
+        queue.Push(frame);
+    }
+    CHECK(queue.GetDepth() == 4);
+
+    // Shrinking drops the oldest items that don't fit, and counts them.
+    queue.SetCapacity(2);
+    CHECK(queue.GetDepth() == 2);
+    CHECK(queue.GetDroppedCount() == 2);
+    CHECK(!queue.Push(8));
+    CHECK(queue.GetDroppedCount() == 3);
+    CheckPops(queue, 7, 2);
+
+    // Growing keeps every item in order and makes room for more.
+    queue.Push(9);
+    queue.Push(10);
+    queue.SetCapacity(5);
+    for (int frame = 11; frame <= 13; frame++)
+    {
+        CHECK(queue.Push(frame));
+    }
+    CHECK(queue.GetDroppedCount() == 3);
+    CHECK(queue.GetMaxDepth() == 5);
+    CheckPops(queue, 9, 5);
+
+    // A capacity of 0 still holds one item.
+    queue.SetCapacity(0);
+    CHECK(queue.Push(14));
+    CHECK(!queue.Push(15));
+    CheckPops(queue, 15, 1);
+}
+
+static void TestCloseAndReopen()
+{
+    Queue queue(2, FrameDropPolicy::DropOldest);
+
+    // A consumer waiting on an empty queue wakes up when it is closed.
+    std::atomic<bool> popped{ false };
+    std::atomic<bool> returned{ false };
+    std::thread consumer([&]()
+    {
+        int item = 0;
+        popped = queue.Pop(item);
+        returned = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(!returned);
+    queue.Close();
+    consumer.join();
+    CHECK(returned);
+    CHECK(!popped);
+
+    // A closed queue refuses pushes without counting them as pushed or dropped.
+    CHECK(!queue.Push(1));
+    CHECK(queue.GetPushedCount() == 0);
+    CHECK(queue.GetDroppedCount() == 0);
+
+    // Items queued before Close can still be popped, then Pop returns false.
+    queue.Reopen();
+    CHECK(queue.Push(2));
+    queue.Close();
+    int item = 0;
+    CHECK(queue.Pop(item) && item == 2);
+    CHECK(!queue.Pop(item));
+
+    // Reopened, the queue works as before, and a waiting consumer gets the next push.
+    queue.Reopen();
+    std::thread waiting([&]()
+    {
+        int frame = 0;
+        popped = queue.Pop(frame) && frame == 3;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(queue.Push(3));
+    waiting.join();
+    CHECK(popped);
+}
+
+static void TestCounters()
+{
+    BoundedFrameQueue<std::shared_ptr<int>> queue(2, FrameDropPolicy::DropOldest);
+    CHECK(queue.GetDepth() == 0);
+    CHECK(queue.GetMaxDepth() == 0);
+
+    // Dropped and cleared items are released at once rather than kept alive by the ring.
+    std::shared_ptr<int> first = std::make_shared<int>(1);
+    queue.Push(first);
+    queue.Push(std::make_shared<int>(2));
+    CHECK(first.use_count() == 2);
+    queue.Push(std::make_shared<int>(3));
+    CHECK(first.use_count() == 1);
+
+    std::shared_ptr<int> item;
+    CHECK(queue.Pop(item) && *item == 2);
+    CHECK(queue.GetDepth() == 1);
+    CHECK(queue.GetMaxDepth() == 2);
+    CHECK(queue.GetPushedCount() == 3);
+    CHECK(queue.GetDroppedCount() == 1);
+
+    // Clear empties the queue without counting drops; the maximum depth is kept.
+    std::shared_ptr<int> last = std::make_shared<int>(4);
+    queue.Push(last);
+    queue.Clear();
+    CHECK(last.use_count() == 1);
+    CHECK(queue.GetDepth() == 0);
+    CHECK(queue.GetMaxDepth() == 2);
+    CHECK(queue.GetPushedCount() == 4);
+    CHECK(queue.GetDroppedCount() == 1);
+}
+
+int main()
+{
+    TestDropPolicies();
+    TestSetCapacity();
+    TestCloseAndReopen();
+    TestCounters();
+    return Tests::FailureCount();
+}
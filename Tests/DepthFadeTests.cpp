@@ -0,0 +1,166 @@
+#include "DepthFade.h"
+#include "TestChecks.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// Every variant this processor can run, from the scalar one up.
+static std::vector<CpuFeatures> GetVariants(std::vector<const char*>& names)
+{
+    const CpuFeatures& supported = GetCpuFeatures();
+    std::vector<CpuFeatures> variants;
+    variants.push_back(CpuFeatures());
+    names.push_back("scalar");
+    if (supported.Sse41)
+    {
+        CpuFeatures features;
+        features.Sse41 = true;
+        variants.push_back(features);
+        names.push_back("SSE4.1");
+    }
+    if (supported.Sse41 && supported.Avx2)
+    {
+        CpuFeatures features;
+        features.Sse41 = true;
+        features.Avx2 = true;
+        variants.push_back(features);
+        names.push_back("AVX2");
+    }
+    if (supported.Neon)
+    {
+        CpuFeatures features;
+        features.Neon = true;
+        variants.push_back(features);
+        names.push_back("NEON");
+    }
+    return variants;
+}
+
+// Random colors, and depths from in front of fadeStart to past fadeEnd with some NaN, negative and exactly
+// fadeStart or fadeEnd samples mixed in, stored every depthStride floats.
+static void MakeInput(uint32_t pixelCount, size_t depthStride, float fadeStart, float fadeEnd, uint32_t& state,
+    std::vector<float>& depth, std::vector<ColorBGRA>& pixels)
+{
+    depth.assign(pixelCount * depthStride, -7.0f);
+    pixels.resize(pixelCount);
+    for (uint32_t i = 0; i < pixelCount; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        const uint32_t random = state >> 8;
+        float z = fadeStart - 0.25f * (fadeEnd - fadeStart) + 1.5f * (fadeEnd - fadeStart) * (random % 4096) / 4096.0f;
+        switch (random % 23)
+        {
+        case 0: z = std::numeric_limits<float>::quiet_NaN(); break;
+        case 1: z = -1.0f; break;
+        case 2: z = fadeStart; break;
+        case 3: z = fadeEnd; break;
+        default: break;
+        }
+        depth[i * depthStride] = z;
+        pixels[i] = { static_cast<uint8_t>(random), static_cast<uint8_t>(random >> 8), static_cast<uint8_t>(random >> 16),
+            static_cast<uint8_t>(random >> 3) };
+    }
+}
+
+static void TestVariantsMatchScalar()
+{
+    std::vector<const char*> names;
+    std::vector<CpuFeatures> variants = GetVariants(names);
+
+    // Counts that leave a tail after every vector width, the stride of packed depth and of the z of a float3,
+    // and the default fade range next to a wide one.
+    const uint32_t counts[] = { 1, 3, 4, 7, 8, 9, 37, 1000 };
+    const size_t strides[] = { 1, 3 };
+    const float ranges[][2] = { { DefaultDepthFadeStart, DefaultDepthFadeEnd }, { 0.5f, 1.5f } };
+    uint32_t state = 1;
+    for (uint32_t count : counts)
+    {
+        for (size_t stride : strides)
+        {
+            for (const auto& range : ranges)
+            {
+                std::vector<float> depth;
+                std::vector<ColorBGRA> original;
+                MakeInput(count, stride, range[0], range[1], state, depth, original);
+
+                std::vector<ColorBGRA> reference = original;
+                ApplyDepthFade(count, depth.data(), stride, reference.data(), range[0], range[1], variants[0]);
+
+                for (size_t variant = 1; variant < variants.size(); variant++)
+                {
+                    std::vector<ColorBGRA> pixels = original;
+                    ApplyDepthFade(count, depth.data(), stride, pixels.data(), range[0], range[1], variants[variant]);
+                    const bool same = std::memcmp(pixels.data(), reference.data(), count * sizeof(ColorBGRA)) == 0;
+                    if (!same)
+                    {
+                        std::fprintf(stderr, "%s differs from the scalar fade for %u pixels, depth stride %zu\n", names[variant], count, stride);
+                    }
+                    CHECK(same);
+                }
+
+                // The dispatched fade is one of them.
+                std::vector<ColorBGRA> pixels = original;
+                ApplyDepthFade(count, depth.data(), stride, pixels.data(), range[0], range[1]);
+                CHECK(std::memcmp(pixels.data(), reference.data(), count * sizeof(ColorBGRA)) == 0);
+
+                // Near pixels keep their color, far and NaN ones turn black, and alpha never changes.
+                size_t wrong = 0;
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    const float z = depth[i * stride];
+                    const ColorBGRA& before = original[i];
+                    const ColorBGRA& after = reference[i];
+                    const bool kept = after.B == before.B && after.G == before.G && after.R == before.R;
+                    const bool black = after.B == 0 && after.G == 0 && after.R == 0;
+                    wrong += (after.A != before.A) ? 1 : 0;
+                    wrong += (z <= range[0] && !kept) ? 1 : 0;
+                    wrong += ((z >= range[1] || z != z) && !black) ? 1 : 0;
+                }
+                CHECK(wrong == 0);
+            }
+        }
+    }
+}
+
+// Times every variant on the color resolutions the correlated image is faded at.
+static void BenchmarkVariants()
+{
+    const uint32_t sizes[][2] = { { 1920, 1080 }, { 1280, 720 } };
+    const int frames = 100;
+    std::vector<const char*> names;
+    std::vector<CpuFeatures> variants = GetVariants(names);
+
+    for (const auto& size : sizes)
+    {
+        const uint32_t pixelCount = size[0] * size[1];
+        uint32_t state = 5;
+        std::vector<float> depth;
+        std::vector<ColorBGRA> pixels;
+        MakeInput(pixelCount, 1, DefaultDepthFadeStart, DefaultDepthFadeEnd, state, depth, pixels);
+
+        std::printf("Depth fade, %ux%u, one thread:\n", size[0], size[1]);
+        for (size_t variant = 0; variant < variants.size(); variant++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; frame++)
+            {
+                ApplyDepthFade(pixelCount, depth.data(), 1, pixels.data(), DefaultDepthFadeStart, DefaultDepthFadeEnd, variants[variant]);
+            }
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+            std::printf("  %-7s %6.3f ms per frame, %6.0f frames/s\n", names[variant], milliseconds, 1000.0 / milliseconds);
+        }
+    }
+}
+
+int main()
+{
+    TestVariantsMatchScalar();
+    BenchmarkVariants();
+    return Tests::FailureCount();
+}
@@ -0,0 +1,235 @@
+#include "DepthRangeMask.h"
+#include "TestChecks.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+using namespace SDKTemplate;
+
+static const float nearLimit = 0.5f;
+static const float farLimit = 0.8f;
+
+// Every population count variant this processor can run, from the scalar one up.
+static std::vector<CpuFeatures> GetVariants(std::vector<const char*>& names)
+{
+    const CpuFeatures& supported = GetCpuFeatures();
+    std::vector<CpuFeatures> variants;
+    variants.push_back(CpuFeatures());
+    names.push_back("scalar");
+    if (supported.Popcnt)
+    {
+        CpuFeatures features;
+        features.Popcnt = true;
+        variants.push_back(features);
+        names.push_back("popcnt");
+    }
+    if (supported.Popcnt && supported.Avx2)
+    {
+        CpuFeatures features;
+        features.Popcnt = true;
+        features.Avx2 = true;
+        variants.push_back(features);
+        names.push_back("AVX2");
+    }
+    if (supported.Neon)
+    {
+        CpuFeatures features;
+        features.Neon = true;
+        variants.push_back(features);
+        names.push_back("NEON");
+    }
+    return variants;
+}
+
+// Depths around the band, with runs of inside pixels, NaN, and samples exactly on the limits.
+static std::vector<float> MakeDepth(uint32_t width, uint32_t height, uint32_t& state)
+{
+    std::vector<float> depth(size_t(width) * height);
+    bool inside = false;
+    for (float& z : depth)
+    {
+        state = state * 1664525u + 1013904223u;
+        const uint32_t random = state >> 8;
+        inside = (random % 8 == 0) ? !inside : inside;
+        z = inside ? 0.55f + 0.2f * (random % 100) / 100.0f : 0.3f + 0.8f * (random % 100) / 100.0f;
+        switch (random % 41)
+        {
+        case 0: z = std::numeric_limits<float>::quiet_NaN(); break;
+        case 1: z = nearLimit; break;
+        case 2: z = farLimit; break;
+        default: break;
+        }
+    }
+    return depth;
+}
+
+static bool IsInside(float z)
+{
+    return z > nearLimit && z < farLimit;
+}
+
+// The set pixels of the rectangle, clipped to the image, counted one pixel at a time.
+static uint64_t CountReference(const std::vector<float>& depth, uint32_t width, uint32_t height,
+    uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+{
+    uint64_t count = 0;
+    for (uint32_t y = top; y < (std::min)(bottom, height); y++)
+    {
+        for (uint32_t x = left; x < (std::min)(right, width); x++)
+        {
+            count += IsInside(depth[size_t(y) * width + x]) ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+static std::vector<MaskRun> EncodeReference(const std::vector<float>& depth, uint32_t width, uint32_t height)
+{
+    std::vector<MaskRun> runs;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            if (!IsInside(depth[size_t(y) * width + x]))
+            {
+                continue;
+            }
+            if (!runs.empty() && runs.back().y == y && runs.back().xEnd == x)
+            {
+                runs.back().xEnd++;
+            }
+            else
+            {
+                runs.push_back({ y, x, x + 1 });
+            }
+        }
+    }
+    return runs;
+}
+
+static void TestMatchesReference()
+{
+    std::vector<const char*> names;
+    std::vector<CpuFeatures> variants = GetVariants(names);
+
+    // Widths a word short of, exactly and a pixel past 64, and a full HD row of 30 words.
+    const uint32_t widths[] = { 63, 64, 65, 1920 };
+    const uint32_t height = 37;
+    uint32_t state = 1;
+    for (uint32_t width : widths)
+    {
+        const std::vector<float> depth = MakeDepth(width, height, state);
+        DepthRangeMask mask;
+        mask.Build(depth.data(), width, height, nearLimit, farLimit);
+        CHECK(mask.GetWidth() == width && mask.GetHeight() == height);
+        CHECK(mask.GetWordsPerRow() == (width + 63) / 64);
+
+        // Every bit, and the padding past the width, which must stay 0.
+        size_t wrongBits = 0;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < mask.GetWordsPerRow() * 64; x++)
+            {
+                const bool expected = x < width && IsInside(depth[size_t(y) * width + x]);
+                const bool set = ((mask.GetRow(y)[x / 64] >> (x % 64)) & 1) != 0;
+                wrongBits += (set != expected) ? 1 : 0;
+            }
+        }
+        CHECK(wrongBits == 0);
+
+        const uint64_t total = CountReference(depth, width, height, 0, 0, width, height);
+        CHECK(total > 0 && total < uint64_t(width) * height);
+        CHECK(mask.CountSet() == total);
+        CHECK(mask.CountSet(0, 0, width, height) == total);
+        CHECK(mask.CountSet(0, 0, width + 100, height + 100) == total);
+
+        // Rectangles within one word, across word edges, reaching past the mask, and empty ones.
+        std::vector<uint32_t> rectangles = { 0, 0, 1, 1, 3, 2, 60, 9, 63, 0, 65, height, 1, 5, width - 1, 6,
+            width / 2, height / 2, width + 10, height + 10, 10, 10, 10, 20, 20, 10, 5, 5, width + 1, 0, width + 5, height };
+        for (int i = 0; i < 200; i++)
+        {
+            state = state * 1664525u + 1013904223u;
+            const uint32_t left = (state >> 8) % (width + 8);
+            const uint32_t top = (state >> 20) % (height + 4);
+            state = state * 1664525u + 1013904223u;
+            rectangles.insert(rectangles.end(), { left, top, left + (state >> 8) % (width + 8), top + (state >> 20) % (height + 4) });
+        }
+
+        size_t wrongCounts = 0;
+        size_t wrongCoverage = 0;
+        for (size_t i = 0; i < rectangles.size(); i += 4)
+        {
+            const uint32_t left = rectangles[i];
+            const uint32_t top = rectangles[i + 1];
+            const uint32_t right = rectangles[i + 2];
+            const uint32_t bottom = rectangles[i + 3];
+            const uint64_t expected = CountReference(depth, width, height, left, top, right, bottom);
+            wrongCounts += (mask.CountSet(left, top, right, bottom) != expected) ? 1 : 0;
+            for (size_t variant = 0; variant < variants.size(); variant++)
+            {
+                wrongCounts += (mask.CountSet(left, top, right, bottom, variants[variant]) != expected) ? 1 : 0;
+            }
+
+            const uint32_t clippedRight = (std::min)(right, width);
+            const uint32_t clippedBottom = (std::min)(bottom, height);
+            const double area = (left < clippedRight && top < clippedBottom) ? double(clippedRight - left) * (clippedBottom - top) : 0.0;
+            const double coverage = (area > 0.0) ? expected / area : 0.0;
+            wrongCoverage += (mask.Coverage(left, top, right, bottom) != coverage) ? 1 : 0;
+        }
+        CHECK(wrongCounts == 0);
+        CHECK(wrongCoverage == 0);
+
+        for (size_t variant = 0; variant < variants.size(); variant++)
+        {
+            if (mask.CountSet(variants[variant]) != total)
+            {
+                std::fprintf(stderr, "%s counts %llu pixels at width %u, not %llu\n", names[variant],
+                    static_cast<unsigned long long>(mask.CountSet(variants[variant])), width, static_cast<unsigned long long>(total));
+            }
+            CHECK(mask.CountSet(variants[variant]) == total);
+        }
+
+        std::vector<MaskRun> runs;
+        mask.EncodeRuns(runs);
+        const std::vector<MaskRun> expectedRuns = EncodeReference(depth, width, height);
+        size_t wrongRuns = (runs.size() != expectedRuns.size()) ? 1 : 0;
+        for (size_t i = 0; i < (std::min)(runs.size(), expectedRuns.size()); i++)
+        {
+            wrongRuns += (runs[i].y != expectedRuns[i].y || runs[i].xBegin != expectedRuns[i].xBegin || runs[i].xEnd != expectedRuns[i].xEnd) ? 1 : 0;
+        }
+        CHECK(wrongRuns == 0);
+    }
+}
+
+// Rows that are all set, all clear or end in a run: the runs reach the width but never the padding.
+static void TestFullAndEmptyRows()
+{
+    for (uint32_t width : { 63u, 64u, 65u, 1920u })
+    {
+        std::vector<float> depth(size_t(width) * 3, 0.6f);
+        std::fill(depth.begin() + width, depth.begin() + 2 * width, std::numeric_limits<float>::quiet_NaN());
+        depth[2 * width] = 1.0f;
+
+        DepthRangeMask mask;
+        mask.Build(depth.data(), width, 3, nearLimit, farLimit);
+        CHECK(mask.CountSet() == 2 * uint64_t(width) - 1);
+        CHECK(mask.Coverage(0, 0, width, 1) == 1.0);
+        CHECK(mask.Coverage(0, 1, width, 2) == 0.0);
+
+        std::vector<MaskRun> runs;
+        mask.EncodeRuns(runs);
+        CHECK(runs.size() == 2);
+        CHECK(runs.size() == 2 && runs[0].y == 0 && runs[0].xBegin == 0 && runs[0].xEnd == width);
+        CHECK(runs.size() == 2 && runs[1].y == 2 && runs[1].xBegin == 1 && runs[1].xEnd == width);
+    }
+}
+
+int main()
+{
+    TestMatchesReference();
+    TestFullAndEmptyRows();
+    return Tests::FailureCount();
+}
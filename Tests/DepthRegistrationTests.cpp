@@ -0,0 +1,241 @@
+#include "DepthRegistration.h"
+#include "SyntheticScene.h"
+#include "TestChecks.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// The depth camera is Tests::MakeTimeOfFlightCamera; the color camera is narrower, with some lens distortion,
+// 32 mm to its left and slightly rotated.
+static PinholeIntrinsics MakeColorCamera()
+{
+    PinholeIntrinsics intrinsics = Tests::MakeCamera(640, 360, 700.0f);
+    intrinsics.principalPointX = 318.5f;
+    intrinsics.principalPointY = 181.0f;
+    intrinsics.radialK1 = 0.08f;
+    intrinsics.radialK2 = -0.05f;
+    intrinsics.tangentialP1 = 0.001f;
+    return intrinsics;
+}
+
+static RigidTransform MakeDepthToColor()
+{
+    // Rotation of 1 degree about y followed by 0.5 degrees about x.
+    const double a = 1.0 * 3.14159265358979 / 180.0;
+    const double b = 0.5 * 3.14159265358979 / 180.0;
+    const double ry[9] = { std::cos(a), 0.0, std::sin(a), 0.0, 1.0, 0.0, -std::sin(a), 0.0, std::cos(a) };
+    const double rx[9] = { 1.0, 0.0, 0.0, 0.0, std::cos(b), -std::sin(b), 0.0, std::sin(b), std::cos(b) };
+
+    RigidTransform transform;
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 3; column++)
+        {
+            double sum = 0.0;
+            for (int k = 0; k < 3; k++)
+            {
+                sum += rx[row * 3 + k] * ry[k * 3 + column];
+            }
+            transform.rotation[row * 3 + column] = static_cast<float>(sum);
+        }
+    }
+    transform.translation[0] = 0.032f;
+    return transform;
+}
+
+// A plane n . p = distance, tilted away from both cameras.
+struct Plane
+{
+    double normal[3];
+    double distance;
+};
+
+static Plane MakeDepthPlane()
+{
+    Plane plane = { { 0.25, -0.35, 1.0 }, 0.8 };
+    const double length = std::sqrt(0.25 * 0.25 + 0.35 * 0.35 + 1.0);
+    for (double& n : plane.normal)
+    {
+        n /= length;
+    }
+    plane.distance /= length;
+    return plane;
+}
+
+// The same plane in color camera space: n' = R n and d' = d + n' . t.
+static Plane ToColorSpace(const Plane& plane, const RigidTransform& transform)
+{
+    Plane result;
+    result.distance = plane.distance;
+    for (int row = 0; row < 3; row++)
+    {
+        result.normal[row] = 0.0;
+        for (int k = 0; k < 3; k++)
+        {
+            result.normal[row] += transform.rotation[row * 3 + k] * plane.normal[k];
+        }
+        result.distance += result.normal[row] * transform.translation[row];
+    }
+    return result;
+}
+
+// Depth along z where the ray (x, y, 1) meets the plane.
+static double IntersectRay(const Plane& plane, double x, double y)
+{
+    return plane.distance / (plane.normal[0] * x + plane.normal[1] * y + plane.normal[2]);
+}
+
+// Raw depth in millimeters, as a depth camera with a scale of 0.001 would report it.
+static std::vector<uint16_t> RenderPlane(const RayTable& depthRays, const Plane& plane)
+{
+    std::vector<uint16_t> depth(depthRays.GetCount());
+    for (size_t i = 0; i < depth.size(); i++)
+    {
+        double z = IntersectRay(plane, depthRays.GetRayX()[i], depthRays.GetRayY()[i]);
+        depth[i] = static_cast<uint16_t>(std::lround(z * 1000.0));
+    }
+    return depth;
+}
+
+static void CreateRegistration(DepthRegistration& registration, std::shared_ptr<const RayTable>& depthRays)
+{
+    depthRays = std::make_shared<RayTable>(Tests::MakeTimeOfFlightCamera());
+    registration.SetDepthRays(depthRays);
+    registration.SetColorIntrinsics(MakeColorCamera());
+    registration.SetDepthToColorTransform(MakeDepthToColor());
+}
+
+static void TestPlaneIsRecovered()
+{
+    DepthRegistration registration;
+    std::shared_ptr<const RayTable> depthRays;
+    CreateRegistration(registration, depthRays);
+
+    const Plane depthPlane = MakeDepthPlane();
+    std::vector<uint16_t> depth = RenderPlane(*depthRays, depthPlane);
+
+    std::vector<float> colorDepth(size_t(registration.GetColorWidth()) * registration.GetColorHeight());
+    registration.Register(depth.data(), depthRays->GetWidth(), 0.001f, colorDepth.data());
+
+    const Plane colorPlane = ToColorSpace(depthPlane, MakeDepthToColor());
+    const RayTable colorRays(MakeColorCamera());
+    size_t covered = 0;
+    double worstError = 0.0;
+    double totalError = 0.0;
+    for (size_t i = 0; i < colorDepth.size(); i++)
+    {
+        if (!(colorDepth[i] > 0.0f))
+        {
+            continue;
+        }
+        double expected = IntersectRay(colorPlane, colorRays.GetRayX()[i], colorRays.GetRayY()[i]);
+        double error = std::fabs(colorDepth[i] - expected);
+        worstError = (std::max)(worstError, error);
+        totalError += error;
+        covered++;
+    }
+
+    // The depth camera sees more than the color camera, so the plane covers every color pixel.
+    CHECK(covered >= colorDepth.size() * 995 / 1000);
+    CHECK(covered > 0);
+    if (covered > 0)
+    {
+        // Millimeter quantization and splatting over neighbouring color pixels on a tilted plane.
+        CHECK(worstError < 0.004);
+        CHECK(totalError / covered < 0.0015);
+    }
+}
+
+static void TestMissingDepthIsNaN()
+{
+    DepthRegistration registration;
+    std::shared_ptr<const RayTable> depthRays;
+    CreateRegistration(registration, depthRays);
+
+    // Cut a hole, wider than the splats, out of the middle of the depth image.
+    std::vector<uint16_t> depth = RenderPlane(*depthRays, MakeDepthPlane());
+    const uint32_t width = depthRays->GetWidth();
+    for (uint32_t y = 124; y < 164; y++)
+    {
+        for (uint32_t x = 140; x < 180; x++)
+        {
+            depth[y * width + x] = 0;
+        }
+    }
+
+    std::vector<float> colorDepth(size_t(registration.GetColorWidth()) * registration.GetColorHeight());
+    registration.Register(depth.data(), width, 0.001f, colorDepth.data());
+
+    // The color pixel seeing the middle of the hole got no depth, and reads as NaN like the coordinate mapper's.
+    const size_t center = size_t(registration.GetColorHeight() / 2) * registration.GetColorWidth() + registration.GetColorWidth() / 2;
+    CHECK(std::isnan(colorDepth[center]));
+
+    // Far from the hole, depth is still registered.
+    CHECK(colorDepth[size_t(20) * registration.GetColorWidth() + 20] > 0.0f);
+}
+
+static void TestNearestSurfaceWins()
+{
+    DepthRegistration registration;
+    std::shared_ptr<const RayTable> depthRays;
+    CreateRegistration(registration, depthRays);
+
+    // A box 30 cm in front of the plane, in the middle of the depth image.
+    std::vector<uint16_t> depth = RenderPlane(*depthRays, MakeDepthPlane());
+    const uint32_t width = depthRays->GetWidth();
+    for (uint32_t y = 104; y < 184; y++)
+    {
+        for (uint32_t x = 120; x < 200; x++)
+        {
+            depth[y * width + x] = static_cast<uint16_t>(depth[y * width + x] - 300);
+        }
+    }
+
+    std::vector<float> colorDepth(size_t(registration.GetColorWidth()) * registration.GetColorHeight());
+    registration.Register(depth.data(), width, 0.001f, colorDepth.data());
+
+    // Every color pixel a box pixel lands on keeps the box, including along its edges where the
+    // splats of the plane behind it land too.
+    const RigidTransform transform = MakeDepthToColor();
+    const PinholeIntrinsics colorCamera = MakeColorCamera();
+    size_t overwritten = 0;
+    for (uint32_t y = 104; y < 184; y++)
+    {
+        for (uint32_t x = 120; x < 200; x++)
+        {
+            const size_t i = size_t(y) * width + x;
+            const float z = depth[i] * 0.001f;
+            const float point[3] = { depthRays->GetRayX()[i] * z, depthRays->GetRayY()[i] * z, z };
+            float color[3];
+            for (int row = 0; row < 3; row++)
+            {
+                color[row] = transform.translation[row];
+                for (int k = 0; k < 3; k++)
+                {
+                    color[row] += transform.rotation[row * 3 + k] * point[k];
+                }
+            }
+
+            float pixelX, pixelY;
+            ProjectToPixel(colorCamera, color[0] / color[2], color[1] / color[2], pixelX, pixelY);
+            const size_t colorIndex = size_t(std::lround(pixelY)) * registration.GetColorWidth() + size_t(std::lround(pixelX));
+            if (!(colorDepth[colorIndex] < color[2] + 0.01f))
+            {
+                overwritten++;
+            }
+        }
+    }
+    CHECK(overwritten == 0);
+}
+
+int main()
+{
+    TestPlaneIsRecovered();
+    TestMissingDepthIsNaN();
+    TestNearestSurfaceWins();
+    return Tests::FailureCount();
+}
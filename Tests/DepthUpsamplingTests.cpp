@@ -0,0 +1,165 @@
+#include "DepthUpsampling.h"
+#include "TestChecks.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+using namespace SDKTemplate;
+
+static const float invalid = std::numeric_limits<float>::quiet_NaN();
+
+// A guide image that is black left of column edge and white from it on.
+static std::vector<uint8_t> MakeEdgeGuide(uint32_t width, uint32_t height, uint32_t edge)
+{
+    std::vector<uint8_t> guide(size_t(width) * height * 4);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint8_t value = (x < edge) ? 0 : 255;
+            uint8_t* pixel = &guide[(size_t(y) * width + x) * 4];
+            pixel[0] = pixel[1] = pixel[2] = value;
+            pixel[3] = 255;
+        }
+    }
+    return guide;
+}
+
+static void TestNearestValidTakesOwnBlock()
+{
+    // 3x2 samples at scale 4 upsample to 11x7, with partial blocks on the right and bottom.
+    const float samples[] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+    const LowResolutionDepth source = { samples, 3, 2, 4 };
+    std::vector<float> target(11 * 7);
+    UpsampleDepthNearestValid(source, target.data(), 11, 0, 7);
+
+    for (uint32_t y = 0; y < 7; y++)
+    {
+        for (uint32_t x = 0; x < 11; x++)
+        {
+            CHECK(target[y * 11 + x] == samples[(y / 4) * 3 + x / 4]);
+        }
+    }
+}
+
+static void TestNearestValidFillsFromNeighbors()
+{
+    // The middle block is invalid, and its pixels take the sample of the block whose center is nearest.
+    const float samples[] = { 1.0f, invalid, 3.0f };
+    const LowResolutionDepth source = { samples, 3, 1, 4 };
+    std::vector<float> target(12 * 4);
+    UpsampleDepthNearestValid(source, target.data(), 12, 0, 4);
+
+    CHECK(target[4] == 1.0f);
+    CHECK(target[5] == 1.0f);
+    CHECK(target[6] == 3.0f);
+    CHECK(target[7] == 3.0f);
+}
+
+static void TestNearestValidLeavesNaN()
+{
+    // No valid sample within one block of the middle: those pixels have no depth, like the backends report it.
+    const float samples[] = { 2.0f, 0.0f, 0.0f, 0.0f, invalid, 0.0f };
+    const LowResolutionDepth source = { samples, 6, 1, 2 };
+    std::vector<float> target(12 * 2);
+    UpsampleDepthNearestValid(source, target.data(), 12, 0, 2);
+
+    CHECK(target[0] == 2.0f);
+    CHECK(target[2] == 2.0f);
+    for (uint32_t x = 4; x < 12; x++)
+    {
+        CHECK(std::isnan(target[x]));
+    }
+}
+
+static void TestJointBilateralFollowsColorEdge()
+{
+    // Depth steps from 1 to 2 between blocks, but the color edge is at column 10, inside the third block.
+    // Its guide pixel (column 10) is white, so its sample belongs to the far surface.
+    const uint32_t scale = 4;
+    const uint32_t width = 24;
+    const uint32_t height = 8;
+    const float samples[] = {
+        1.0f, 1.0f, 2.0f, 2.0f, 2.0f, 2.0f,
+        1.0f, 1.0f, 2.0f, 2.0f, 2.0f, 2.0f,
+    };
+    const LowResolutionDepth source = { samples, 6, 2, scale };
+    std::vector<uint8_t> guide = MakeEdgeGuide(width, height, 10);
+    JointBilateralWeights weights(scale, 30.0f);
+
+    std::vector<float> target(size_t(width) * height);
+    UpsampleDepthJointBilateral(source, guide.data(), width * 4, weights, target.data(), width, height, 0, height);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const float* row = &target[y * width];
+
+        // Black pixels in the third block take the near surface, which nearest valid can't do.
+        CHECK_NEAR(row[8], 1.0f, 0.01f);
+        CHECK_NEAR(row[9], 1.0f, 0.01f);
+        CHECK_NEAR(row[10], 2.0f, 0.01f);
+
+        // Away from the edge, a constant surface stays constant.
+        CHECK_NEAR(row[1], 1.0f, 1e-5f);
+        CHECK_NEAR(row[20], 2.0f, 1e-5f);
+    }
+}
+
+static void TestJointBilateralLeavesNaN()
+{
+    const float samples[] = { 1.5f, 0.0f, 0.0f, 0.0f };
+    const LowResolutionDepth source = { samples, 4, 1, 2 };
+    std::vector<uint8_t> guide = MakeEdgeGuide(8, 2, 8);
+    JointBilateralWeights weights(2, 30.0f);
+
+    std::vector<float> target(8 * 2);
+    UpsampleDepthJointBilateral(source, guide.data(), 8 * 4, weights, target.data(), 8, 2, 0, 2);
+
+    CHECK_NEAR(target[0], 1.5f, 1e-5f);
+    CHECK_NEAR(target[3], 1.5f, 1e-5f);
+    CHECK(std::isnan(target[4]));
+    CHECK(std::isnan(target[7]));
+}
+
+static void TestRowBandsMatchWholeImage()
+{
+    // The renderer splits rows across threads, so bands must produce exactly what one pass does.
+    const uint32_t scale = 2;
+    const uint32_t width = 21;
+    const uint32_t height = 13;
+    const uint32_t sourceWidth = ReducedSize(width, scale);
+    const uint32_t sourceHeight = ReducedSize(height, scale);
+    std::vector<float> samples(size_t(sourceWidth) * sourceHeight);
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        samples[i] = (i % 7 == 3) ? 0.0f : 0.5f + 0.01f * static_cast<float>(i % 23);
+    }
+    const LowResolutionDepth source = { samples.data(), sourceWidth, sourceHeight, scale };
+    std::vector<uint8_t> guide = MakeEdgeGuide(width, height, 9);
+    JointBilateralWeights weights(scale, 30.0f);
+
+    std::vector<float> whole(size_t(width) * height);
+    std::vector<float> banded(size_t(width) * height);
+    UpsampleDepthJointBilateral(source, guide.data(), width * 4, weights, whole.data(), width, height, 0, height);
+    UpsampleDepthJointBilateral(source, guide.data(), width * 4, weights, banded.data(), width, height, 0, 5);
+    UpsampleDepthJointBilateral(source, guide.data(), width * 4, weights, banded.data(), width, height, 5, height);
+    CHECK(whole == banded);
+
+    UpsampleDepthNearestValid(source, whole.data(), width, 0, height);
+    UpsampleDepthNearestValid(source, banded.data(), width, 0, 7);
+    UpsampleDepthNearestValid(source, banded.data(), width, 7, height);
+    CHECK(whole == banded);
+}
+
+int main()
+{
+    TestNearestValidTakesOwnBlock();
+    TestNearestValidFillsFromNeighbors();
+    TestNearestValidLeavesNaN();
+    TestJointBilateralFollowsColorEdge();
+    TestJointBilateralLeavesNaN();
+    TestRowBandsMatchWholeImage();
+    return Tests::FailureCount();
+}
@@ -0,0 +1,190 @@
+#include "SlotMailbox.h"
+#include "TestChecks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// Three readers, as with color, depth and infrared sources, each posting to its own slot of a four slot mailbox.
+static const size_t slotCount = 4;
+static const size_t producerCount = 3;
+static const uint64_t framesPerProducer = 200000;
+
+// A frame is owned through exactly one pointer at a time; the count of live frames shows leaks.
+struct Frame
+{
+    Frame(size_t source, uint64_t sequence) : source(source), sequence(sequence) { liveFrames++; }
+    ~Frame() { liveFrames--; }
+
+    size_t source;
+    uint64_t sequence;
+    static std::atomic<int64_t> liveFrames;
+};
+
+std::atomic<int64_t> Frame::liveFrames{ 0 };
+
+// What the consumer saw, only written by whichever thread holds the consumer role.
+struct ConsumerState
+{
+    uint64_t taken = 0;
+    uint64_t outOfOrder = 0;
+    uint64_t lastSequence[slotCount] = {};
+    bool hasTaken[slotCount] = {};
+    std::atomic<int> consumers{ 0 };
+    int mostConsumers = 0;
+
+    void Consume(std::unique_ptr<Frame> frame)
+    {
+        // Frames of one source must come out in the order they were posted.
+        if (hasTaken[frame->source] && frame->sequence <= lastSequence[frame->source])
+        {
+            outOfOrder++;
+        }
+        lastSequence[frame->source] = frame->sequence;
+        hasTaken[frame->source] = true;
+        taken++;
+    }
+};
+
+static double RunLockFree(ConsumerState& state, uint64_t& overwritten, uint64_t& leftOver)
+{
+    SlotMailbox<Frame, slotCount> mailbox;
+
+    auto produce = [&](size_t source)
+    {
+        for (uint64_t sequence = 0; sequence < framesPerProducer; sequence++)
+        {
+            std::unique_ptr<Frame> previous(mailbox.Post(source, new Frame(source, sequence)));
+            if (!mailbox.TryBeginConsume())
+            {
+                continue;
+            }
+
+            do
+            {
+                int consumers = ++state.consumers;
+                state.mostConsumers = (std::max)(state.mostConsumers, consumers);
+
+                Frame* frames[slotCount];
+                mailbox.TakeReady(frames);
+                for (Frame* frame : frames)
+                {
+                    if (frame != nullptr)
+                    {
+                        state.Consume(std::unique_ptr<Frame>(frame));
+                    }
+                }
+                state.consumers--;
+            } while (mailbox.EndConsume());
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (size_t source = 0; source < producerCount; source++)
+    {
+        producers.emplace_back(produce, source);
+    }
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    Frame* frames[slotCount];
+    mailbox.TakeAll(frames);
+    leftOver = 0;
+    for (Frame* frame : frames)
+    {
+        leftOver += (frame != nullptr) ? 1 : 0;
+        delete frame;
+    }
+    overwritten = mailbox.GetOverwrittenCount();
+    return std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+// The scheme the mailbox replaced: every callback takes one lock and updates a map of the newest frames.
+static double RunLocked(ConsumerState& state, uint64_t& overwritten, uint64_t& leftOver)
+{
+    std::mutex lock;
+    std::map<size_t, std::unique_ptr<Frame>> newestFrames;
+    overwritten = 0;
+
+    auto produce = [&](size_t source)
+    {
+        for (uint64_t sequence = 0; sequence < framesPerProducer; sequence++)
+        {
+            std::unique_ptr<Frame> frame(new Frame(source, sequence));
+            std::lock_guard<std::mutex> guard(lock);
+            std::unique_ptr<Frame>& newest = newestFrames[source];
+            overwritten += newest ? 1 : 0;
+            newest = std::move(frame);
+
+            for (auto& entry : newestFrames)
+            {
+                if (entry.second)
+                {
+                    state.Consume(std::move(entry.second));
+                }
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (size_t source = 0; source < producerCount; source++)
+    {
+        producers.emplace_back(produce, source);
+    }
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    leftOver = 0;
+    for (auto& entry : newestFrames)
+    {
+        leftOver += entry.second ? 1 : 0;
+    }
+    newestFrames.clear();
+    return std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+int main()
+{
+    const uint64_t posted = producerCount * framesPerProducer;
+
+    ConsumerState lockFree;
+    uint64_t overwritten = 0;
+    uint64_t leftOver = 0;
+    double lockFreeTime = RunLockFree(lockFree, overwritten, leftOver);
+
+    // Every frame posted was taken by the consumer, replaced before it could be, or still waiting at the end.
+    CHECK(lockFree.taken + overwritten + leftOver == posted);
+    CHECK(lockFree.outOfOrder == 0);
+    CHECK(lockFree.mostConsumers == 1);
+    CHECK(Frame::liveFrames == 0);
+
+    ConsumerState locked;
+    double lockedTime = RunLocked(locked, overwritten, leftOver);
+    CHECK(locked.taken + overwritten + leftOver == posted);
+    CHECK(Frame::liveFrames == 0);
+
+    std::printf("%zu producers, %llu frames each, %u hardware threads\n", producerCount,
+        static_cast<unsigned long long>(framesPerProducer), std::thread::hardware_concurrency());
+    std::printf("  lock-free mailbox: %7.1f ns per frame, %llu taken\n", lockFreeTime / posted,
+        static_cast<unsigned long long>(lockFree.taken));
+    std::printf("  lock and map:      %7.1f ns per frame, %llu taken\n", lockedTime / posted,
+        static_cast<unsigned long long>(locked.taken));
+    return Tests::FailureCount();
+}
@@ -0,0 +1,322 @@
+#include "FramePipeline.h"
+#include "TestChecks.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// A synthetic frame. The live count shows whether the pipeline destroys every item it is handed.
+struct TestFrame
+{
+    explicit TestFrame(uint32_t sequence) : sequence(sequence) { liveFrames++; }
+    ~TestFrame() { liveFrames--; }
+
+    uint32_t sequence;
+    std::vector<int> stagesSeen;
+    static std::atomic<int> liveFrames;
+};
+
+std::atomic<int> TestFrame::liveFrames{ 0 };
+
+typedef std::unique_ptr<TestFrame> TestItem;
+typedef FramePipeline<TestItem> TestPipeline;
+
+// Polls until condition holds, for at most five seconds. Returns whether it held.
+template<typename Condition>
+static bool WaitFor(Condition condition)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static uint64_t GetProcessed(const TestPipeline& pipeline, size_t stage)
+{
+    return pipeline.GetStatistics()[stage].processed;
+}
+
+// Holds a stage inside its function until opened, like a stage stuck on a slow frame.
+class Gate
+{
+public:
+    void Pass() const
+    {
+        while (!m_open)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    void Open() { m_open = true; }
+
+private:
+    std::atomic<bool> m_open{ false };
+};
+
+static void TestOrderIsPreserved()
+{
+    const uint32_t frameCount = 1000;
+    std::vector<uint32_t> arrived;
+    bool stagesInOrder = true;
+    {
+        TestPipeline pipeline(2, PipelineOverflow::Wait);
+        for (int stage = 0; stage < 3; stage++)
+        {
+            pipeline.AddStage("Stage", [stage](TestItem& frame)
+            {
+                frame->stagesSeen.push_back(stage);
+                return true;
+            });
+        }
+        pipeline.AddStage("Last", [&](TestItem& frame)
+        {
+            stagesInOrder = stagesInOrder && (frame->stagesSeen == std::vector<int>{ 0, 1, 2 });
+            arrived.push_back(frame->sequence);
+            return true;
+        });
+        pipeline.Start();
+
+        for (uint32_t sequence = 0; sequence < frameCount; sequence++)
+        {
+            CHECK(pipeline.Submit(std::make_unique<TestFrame>(sequence)));
+        }
+        CHECK(WaitFor([&]() { return GetProcessed(pipeline, 3) == frameCount; }));
+        CHECK(pipeline.GetDroppedCount() == 0);
+    }
+
+    // Every frame went through every stage, in the order it was submitted.
+    CHECK(stagesInOrder);
+    CHECK(arrived.size() == frameCount);
+    for (uint32_t i = 0; i < arrived.size(); i++)
+    {
+        CHECK(arrived[i] == i);
+    }
+    CHECK(TestFrame::liveFrames == 0);
+}
+
+static void TestDiscardedFramesStop()
+{
+    std::vector<uint32_t> arrived;
+    {
+        TestPipeline pipeline(4, PipelineOverflow::Wait);
+        pipeline.AddStage("Filter", [](TestItem& frame) { return frame->sequence % 2 == 0; });
+        pipeline.AddStage("Last", [&](TestItem& frame)
+        {
+            arrived.push_back(frame->sequence);
+            return true;
+        });
+        pipeline.Start();
+
+        for (uint32_t sequence = 0; sequence < 100; sequence++)
+        {
+            pipeline.Submit(std::make_unique<TestFrame>(sequence));
+        }
+        CHECK(WaitFor([&]() { return GetProcessed(pipeline, 0) == 100; }));
+        CHECK(WaitFor([&]() { return GetProcessed(pipeline, 1) == 50; }));
+        CHECK(pipeline.GetStatistics()[0].discarded == 50);
+    }
+
+    CHECK(arrived.size() == 50);
+    for (uint32_t i = 0; i < arrived.size(); i++)
+    {
+        CHECK(arrived[i] == 2 * i);
+    }
+    CHECK(TestFrame::liveFrames == 0);
+}
+
+static void TestBackpressureHoldsProducer()
+{
+    const uint32_t frameCount = 20;
+    Gate gate;
+    std::vector<uint32_t> arrived;
+    std::atomic<uint32_t> submitted{ 0 };
+    {
+        TestPipeline pipeline(2, PipelineOverflow::Wait);
+        pipeline.AddStage("Fast", [](TestItem&) { return true; });
+        pipeline.AddStage("Blocked", [&](TestItem& frame)
+        {
+            gate.Pass();
+            arrived.push_back(frame->sequence);
+            return true;
+        });
+        pipeline.Start();
+
+        std::thread producer([&]()
+        {
+            for (uint32_t sequence = 0; sequence < frameCount; sequence++)
+            {
+                if (pipeline.Submit(std::make_unique<TestFrame>(sequence)))
+                {
+                    submitted++;
+                }
+            }
+        });
+
+        // With the last stage stuck, the first stage stalls on the full queue behind it, and the producer
+        // blocks once the first queue is full too. At most the queues and the two stages hold frames.
+        CHECK(WaitFor([&]() { return pipeline.GetStatistics()[0].stalls > 0; }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        const uint32_t held = submitted;
+        CHECK(held < frameCount);
+        CHECK(held <= 2 + 2 + 2);
+        CHECK(GetProcessed(pipeline, 1) == 0);
+
+        // Once the stage moves again, everything the producer held back goes through, and nothing was dropped.
+        gate.Open();
+        producer.join();
+        CHECK(WaitFor([&]() { return GetProcessed(pipeline, 1) == frameCount; }));
+        CHECK(submitted == frameCount);
+        CHECK(pipeline.GetDroppedCount() == 0);
+    }
+
+    CHECK(arrived.size() == frameCount);
+    for (uint32_t i = 0; i < arrived.size(); i++)
+    {
+        CHECK(arrived[i] == i);
+    }
+    CHECK(TestFrame::liveFrames == 0);
+}
+
+static void TestDropPolicyTurnsFramesAway()
+{
+    const uint32_t frameCount = 20;
+    Gate gate;
+    uint32_t accepted = 0;
+    {
+        TestPipeline pipeline(2, PipelineOverflow::Drop);
+        pipeline.AddStage("Blocked", [&](TestItem&)
+        {
+            gate.Pass();
+            return true;
+        });
+        pipeline.Start();
+
+        // Submit never waits: once the stage is stuck and its queue full, frames are dropped.
+        for (uint32_t sequence = 0; sequence < frameCount; sequence++)
+        {
+            if (pipeline.Submit(std::make_unique<TestFrame>(sequence)))
+            {
+                accepted++;
+            }
+        }
+        CHECK(accepted <= 3);
+        CHECK(pipeline.GetDroppedCount() == frameCount - accepted);
+
+        // Dropped frames are destroyed right away; only the accepted ones are alive.
+        CHECK(TestFrame::liveFrames == static_cast<int>(accepted));
+
+        gate.Open();
+        CHECK(WaitFor([&]() { return GetProcessed(pipeline, 0) == accepted; }));
+    }
+    CHECK(TestFrame::liveFrames == 0);
+}
+
+static void TestStopReleasesBlockedProducer()
+{
+    std::atomic<bool> producerDone{ false };
+    std::atomic<uint32_t> rejected{ 0 };
+
+    TestPipeline pipeline(2, PipelineOverflow::Wait);
+    pipeline.AddStage("Fast", [](TestItem&) { return true; });
+    pipeline.AddStage("Slow", [](TestItem&)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        return true;
+    });
+    pipeline.Start();
+
+    std::thread producer([&]()
+    {
+        for (uint32_t sequence = 0; sequence < 1000; sequence++)
+        {
+            if (!pipeline.Submit(std::make_unique<TestFrame>(sequence)))
+            {
+                rejected++;
+            }
+        }
+        producerDone = true;
+    });
+
+    // Let the queues fill up and the producer block, then stop while frames are queued in every stage.
+    CHECK(WaitFor([&]() { return pipeline.GetStatistics()[0].stalls > 0; }));
+    pipeline.Stop();
+
+    // The blocked Submit returns, and every later one is turned away without waiting.
+    CHECK(WaitFor([&]() { return producerDone.load(); }));
+    producer.join();
+    CHECK(rejected > 0);
+    CHECK(pipeline.GetDroppedCount() == rejected);
+    CHECK(!pipeline.Submit(std::make_unique<TestFrame>(0)));
+
+    // Stop destroyed the frames still queued and those the stages were holding.
+    CHECK(TestFrame::liveFrames == 0);
+}
+
+// Two stages that share a pool take turns on it; the stage that waited for the other's job reports it.
+static void TestSharedPoolWaitsAreReported()
+{
+    ThreadPool pool(1);
+    std::atomic<bool> firstJobRunning{ false };
+    std::atomic<bool> secondStageCalling{ false };
+    {
+        TestPipeline pipeline(2, PipelineOverflow::Wait);
+        pipeline.AddStage("First", [&](TestItem& frame)
+        {
+            if (frame->sequence == 1)
+            {
+                pool.ParallelFor(2, [&](uint32_t)
+                {
+                    firstJobRunning = true;
+                    CHECK(WaitFor([&]() { return secondStageCalling.load(); }));
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                });
+            }
+            return true;
+        });
+        pipeline.AddStage("Second", [&](TestItem& frame)
+        {
+            if (frame->sequence == 0)
+            {
+                CHECK(WaitFor([&]() { return firstJobRunning.load(); }));
+                secondStageCalling = true;
+                pool.ParallelFor(2, [](uint32_t) {});
+            }
+            return true;
+        });
+        pipeline.Start();
+
+        pipeline.Submit(std::make_unique<TestFrame>(0));
+        pipeline.Submit(std::make_unique<TestFrame>(1));
+        CHECK(WaitFor([&]() { return GetProcessed(pipeline, 1) == 2; }));
+
+        const std::vector<PipelineStageStatistics> statistics = pipeline.GetStatistics();
+        CHECK(statistics[0].poolWaits == 0);
+        CHECK(statistics[1].poolWaits == 1);
+        CHECK(statistics[1].poolWaitMilliseconds >= 10.0);
+        CHECK(pool.GetContendedCount() == 1);
+    }
+    CHECK(TestFrame::liveFrames == 0);
+}
+
+int main()
+{
+    TestOrderIsPreserved();
+    TestDiscardedFramesStop();
+    TestBackpressureHoldsProducer();
+    TestDropPolicyTurnsFramesAway();
+    TestStopReleasesBlockedProducer();
+    TestSharedPoolWaitsAreReported();
+    return Tests::FailureCount();
+}
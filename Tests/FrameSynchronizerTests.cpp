@@ -0,0 +1,150 @@
+#include "FrameSynchronizer.h"
+#include "TestChecks.h"
+
+#include <cstdint>
+
+using namespace SDKTemplate;
+
+// Frames are numbered; 0 is the empty handle.
+typedef FrameSynchronizer<int, 3> Synchronizer;
+
+static const int64_t tolerance = 100;
+
+static void TestToleranceBoundary()
+{
+    Synchronizer synchronizer(tolerance);
+    synchronizer.SetEnabledSources(0x3);
+    Synchronizer::FrameSet frameSet;
+
+    // Exactly the tolerance apart still matches.
+    CHECK(!synchronizer.AddFrame(0, 1000, 1, frameSet));
+    CHECK(synchronizer.AddFrame(1, 1000 + tolerance, 2, frameSet));
+    CHECK(frameSet[0] == 1);
+    CHECK(frameSet[1] == 2);
+    CHECK(frameSet[2] == 0);
+
+    // One tick more doesn't.
+    CHECK(!synchronizer.AddFrame(0, 2000, 3, frameSet));
+    CHECK(!synchronizer.AddFrame(1, 2000 + tolerance + 1, 4, frameSet));
+
+    // A newer frame of the first source matches the waiting one, and the unmatched older frame is dropped.
+    CHECK(synchronizer.AddFrame(0, 2000 + 2 * tolerance, 5, frameSet));
+    CHECK(frameSet[0] == 5);
+    CHECK(frameSet[1] == 4);
+
+    FrameSynchronizerStatistics statistics = synchronizer.GetStatistics();
+    CHECK(statistics.matched == 2);
+    CHECK(statistics.dropped == 1);
+    CHECK(statistics.late == 0);
+}
+
+static void TestTieTakesOlderFrame()
+{
+    Synchronizer synchronizer(tolerance);
+    synchronizer.SetEnabledSources(0x3);
+    Synchronizer::FrameSet frameSet;
+
+    CHECK(!synchronizer.AddFrame(0, 1000, 1, frameSet));
+    CHECK(!synchronizer.AddFrame(0, 1100, 2, frameSet));
+    CHECK(synchronizer.AddFrame(1, 1050, 3, frameSet));
+    CHECK(frameSet[0] == 1);
+
+    // The newer frame is still buffered and completes the next set.
+    CHECK(synchronizer.AddFrame(1, 1120, 4, frameSet));
+    CHECK(frameSet[0] == 2);
+    CHECK(frameSet[1] == 4);
+}
+
+static void TestMissingSource()
+{
+    Synchronizer synchronizer(tolerance);
+    Synchronizer::FrameSet frameSet;
+
+    // Frames of sources that aren't enabled are ignored, and sets carry an empty entry for them.
+    synchronizer.SetEnabledSources(0x5);
+    CHECK(!synchronizer.AddFrame(1, 1000, 1, frameSet));
+    CHECK(!synchronizer.AddFrame(0, 1000, 2, frameSet));
+    CHECK(synchronizer.AddFrame(2, 1010, 3, frameSet));
+    CHECK(frameSet[0] == 2);
+    CHECK(frameSet[1] == 0);
+    CHECK(frameSet[2] == 3);
+
+    // An enabled source that never delivers holds every set back; the others' rings keep their newest frames.
+    synchronizer.SetEnabledSources(0x7);
+    for (int frame = 0; frame < 6; frame++)
+    {
+        CHECK(!synchronizer.AddFrame(0, 2000 + frame * 333, 10 + frame, frameSet));
+        CHECK(!synchronizer.AddFrame(2, 2000 + frame * 333, 20 + frame, frameSet));
+    }
+    CHECK(synchronizer.GetStatistics().dropped == 4);
+
+    // Disabling it releases the sets at the next frame.
+    synchronizer.SetEnabledSources(0x5);
+    CHECK(!synchronizer.AddFrame(0, 2000 + 6 * 333, 16, frameSet));
+    CHECK(synchronizer.AddFrame(2, 2000 + 6 * 333, 26, frameSet));
+    CHECK(frameSet[0] == 16);
+    CHECK(frameSet[1] == 0);
+    CHECK(frameSet[2] == 26);
+}
+
+static void TestOutOfOrderArrival()
+{
+    Synchronizer synchronizer(50);
+    synchronizer.SetEnabledSources(0x3);
+    Synchronizer::FrameSet frameSet;
+
+    CHECK(!synchronizer.AddFrame(0, 300, 3, frameSet));
+    CHECK(!synchronizer.AddFrame(0, 100, 1, frameSet));
+    CHECK(!synchronizer.AddFrame(0, 200, 2, frameSet));
+
+    // The nearest frame is found whatever order the frames came in; the one older than it is dropped.
+    CHECK(synchronizer.AddFrame(1, 190, 4, frameSet));
+    CHECK(frameSet[0] == 2);
+    CHECK(synchronizer.GetStatistics().dropped == 1);
+
+    CHECK(synchronizer.AddFrame(1, 310, 5, frameSet));
+    CHECK(frameSet[0] == 3);
+
+    // Frames older than the last set can't be part of one any more.
+    CHECK(!synchronizer.AddFrame(0, 250, 6, frameSet));
+    CHECK(!synchronizer.AddFrame(1, 300, 7, frameSet));
+    CHECK(synchronizer.GetStatistics().late == 2);
+
+    // Each set is emitted once: the matched frames left the rings.
+    CHECK(!synchronizer.AddFrame(0, 320, 8, frameSet));
+    CHECK(synchronizer.GetStatistics().matched == 2);
+}
+
+static void TestReset()
+{
+    Synchronizer synchronizer(tolerance);
+    synchronizer.SetEnabledSources(0x3);
+    Synchronizer::FrameSet frameSet;
+
+    CHECK(!synchronizer.AddFrame(0, 5000, 1, frameSet));
+    CHECK(synchronizer.AddFrame(1, 5000, 2, frameSet));
+    CHECK(!synchronizer.AddFrame(0, 6000, 3, frameSet));
+
+    // After a restart the buffered frame is gone, and timestamps before the last set are no longer late.
+    synchronizer.Reset();
+    CHECK(!synchronizer.AddFrame(1, 6000, 4, frameSet));
+    CHECK(!synchronizer.AddFrame(0, 1000, 5, frameSet));
+    CHECK(synchronizer.AddFrame(1, 1010, 6, frameSet));
+    CHECK(frameSet[0] == 5);
+    CHECK(frameSet[1] == 6);
+
+    // The counters are kept across the reset.
+    FrameSynchronizerStatistics statistics = synchronizer.GetStatistics();
+    CHECK(statistics.matched == 2);
+    CHECK(statistics.late == 0);
+}
+
+int main()
+{
+    TestToleranceBoundary();
+    TestTieTakesOlderFrame();
+    TestMissingSource();
+    TestOutOfOrderArrival();
+    TestReset();
+    return Tests::FailureCount();
+}
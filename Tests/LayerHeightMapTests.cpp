@@ -0,0 +1,208 @@
+#include "LayerHeightMap.h"
+#include "SyntheticScene.h"
+#include "TestChecks.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// A color camera looking at a plate tilted 17 degrees about its x axis.
+static const float plateTilt = 17.0f;
+
+static PinholeIntrinsics MakeColorCamera()
+{
+    return Tests::MakeCamera(640, 360, 450.0f);
+}
+
+// Tests::RenderBoxOnPlate with every pixel of the given column, counted from 1, without depth.
+static std::vector<float> RenderScene(const RayTable& rays, const BedPlane& plane, float boxHeight, float boxSize, uint32_t missingColumn = 0)
+{
+    std::vector<float> depth = Tests::RenderBoxOnPlate(rays, plane, boxHeight, boxSize);
+    if (missingColumn != 0)
+    {
+        const uint32_t width = rays.GetIntrinsics().imageWidth;
+        for (size_t i = missingColumn - 1; i < depth.size(); i += width)
+        {
+            depth[i] = 0.0f;
+        }
+    }
+    return depth;
+}
+
+static void Update(LayerHeightMap& map, const BedPlane& plane, const RayTable& rays, const std::vector<float>& depth, int frames)
+{
+    for (int frame = 0; frame < frames; frame++)
+    {
+        map.Update(plane, rays, depth.data());
+    }
+}
+
+// Cells of the grid whose height is at least minHeight.
+static size_t CountCellsAbove(const LayerHeightMap& map, float minHeight)
+{
+    std::vector<float> heights;
+    map.CopyHeights(heights);
+    size_t count = 0;
+    for (float height : heights)
+    {
+        count += (height >= minHeight) ? 1 : 0;
+    }
+    return count;
+}
+
+// Height of the highest observed cell, found by looking at every cell.
+static float GetHighestCell(const LayerHeightMap& map)
+{
+    std::vector<float> heights;
+    map.CopyHeights(heights);
+    float highest = std::numeric_limits<float>::quiet_NaN();
+    for (float height : heights)
+    {
+        if (height > highest || std::isnan(highest))
+        {
+            highest = height;
+        }
+    }
+    return highest;
+}
+
+static void TestPlateIsObserved()
+{
+    const RayTable rays(MakeColorCamera());
+    const BedPlane plate = Tests::MakePlate(plateTilt, 0.6f);
+    const std::vector<float> depth = RenderScene(rays, plate, 0.0f, 0.0f);
+
+    LayerHeightMap map;
+    CHECK(std::isnan(map.GetMaxHeight()));
+    CHECK(std::isnan(map.GetHeightPercentile(0.5f)));
+
+    // A cell is only written once confirmFrames frames agree on its height.
+    map.Update(plate, rays, depth.data());
+    CHECK(map.GetStatistics().cellsObserved == 0);
+    CHECK(std::isnan(map.GetCell(80, 80).height));
+
+    map.Update(plate, rays, depth.data());
+    const LayerHeightMapSettings& settings = map.GetSettings();
+    const size_t cellCount = size_t(settings.width) * settings.height;
+    CHECK(map.GetStatistics().cellsObserved == cellCount);
+    CHECK(map.GetStatistics().cellsChangedLastFrame == cellCount);
+    CHECK(std::fabs(map.GetMaxHeight()) < 0.001f);
+    CHECK(map.GetHeightPercentile(1.0f) <= settings.histogramBinSize);
+
+    // A static plate leaves every cell alone.
+    Update(map, plate, rays, depth, 5);
+    CHECK(map.GetStatistics().cellsChangedLastFrame == 0);
+    CHECK(map.GetStatistics().cellsChanged == cellCount);
+    CHECK(map.GetCell(0, 0).changes == 1);
+    CHECK(map.GetCell(0, 0).lastChangeFrame == 2);
+}
+
+static void TestPartGrows()
+{
+    const RayTable rays(MakeColorCamera());
+    const BedPlane plate = Tests::MakePlate(plateTilt, 0.6f);
+    LayerHeightMap map;
+    const LayerHeightMapSettings& settings = map.GetSettings();
+    Update(map, plate, rays, RenderScene(rays, plate, 0.0f, 0.0f), 2);
+
+    // A 6 cm box 1 cm high appears on the plate. The cells under it are 30 by 30 cells of 2 mm.
+    Update(map, plate, rays, RenderScene(rays, plate, 0.01f, 0.06f), 6);
+    CHECK_NEAR(map.GetMaxHeight(), 0.01f, 0.001f);
+    CHECK_NEAR(map.GetCell(80, 80).height, 0.01f, 0.001f);
+    CHECK(std::fabs(map.GetCell(10, 10).height) < 0.001f);
+    const size_t boxCells = CountCellsAbove(map, 0.005f);
+    CHECK(boxCells >= 28 * 28 && boxCells <= 32 * 32);
+
+    // Most of the grid is plate; the highest cells are the box.
+    CHECK(map.GetHeightPercentile(0.5f) <= settings.histogramBinSize);
+    CHECK_NEAR(map.GetHeightPercentile(1.0f), map.GetMaxHeight(), settings.histogramBinSize);
+    CHECK_NEAR(map.GetHeightPercentile(1.0f - 0.5f * boxCells / (settings.width * settings.height)), 0.01f, 0.001f);
+
+    // It grows another centimeter. Every box cell changes once more and remembers its peak.
+    const uint32_t changesBefore = map.GetCell(80, 80).changes;
+    Update(map, plate, rays, RenderScene(rays, plate, 0.02f, 0.06f), 6);
+    CHECK_NEAR(map.GetMaxHeight(), 0.02f, 0.001f);
+    CHECK(map.GetCell(80, 80).changes == changesBefore + 1);
+    CHECK_NEAR(map.GetCell(80, 80).peakHeight, 0.02f, 0.001f);
+    CHECK(map.GetStatistics().cellsChangedLastFrame == 0);
+
+    // When it is cut down to a smaller, lower part the maximum is searched again, and the peaks are kept.
+    // Cells the smaller part hides from the camera keep their last height, so the maximum is compared
+    // with the highest cell rather than with the part.
+    Update(map, plate, rays, RenderScene(rays, plate, 0.01f, 0.02f), 6);
+    CHECK(map.GetMaxHeight() == GetHighestCell(map));
+    CHECK_NEAR(map.GetCell(80, 80).height, 0.01f, 0.001f);
+    CHECK(std::fabs(map.GetCell(68, 68).height) < 0.001f);
+    CHECK_NEAR(map.GetCell(68, 68).peakHeight, 0.02f, 0.001f);
+
+    // When the part is taken away, nothing is left above the plate.
+    Update(map, plate, rays, RenderScene(rays, plate, 0.0f, 0.0f), 6);
+    CHECK(std::fabs(map.GetMaxHeight()) < 0.001f);
+    CHECK_NEAR(map.GetCell(80, 80).peakHeight, 0.02f, 0.001f);
+}
+
+static void TestNoiseIsIgnored()
+{
+    const RayTable rays(MakeColorCamera());
+    const BedPlane plate = Tests::MakePlate(plateTilt, 0.6f);
+    LayerHeightMap map;
+    Update(map, plate, rays, RenderScene(rays, plate, 0.01f, 0.06f), 6);
+    const uint64_t changed = map.GetStatistics().cellsChanged;
+
+    // Heights within the noise threshold, a single frame outlier and missing depth don't change any cell.
+    Update(map, plate, rays, RenderScene(rays, plate, 0.011f, 0.06f), 3);
+    CHECK(map.GetStatistics().cellsChanged == changed);
+    Update(map, plate, rays, RenderScene(rays, plate, 0.03f, 0.06f), 1);
+    Update(map, plate, rays, RenderScene(rays, plate, 0.01f, 0.06f), 3);
+    CHECK(map.GetStatistics().cellsChanged == changed);
+    Update(map, plate, rays, RenderScene(rays, plate, 0.01f, 0.06f, 321), 3);
+    CHECK(map.GetStatistics().cellsChanged == changed);
+    CHECK_NEAR(map.GetMaxHeight(), 0.01f, 0.001f);
+}
+
+static void TestPlateMoveStartsOver()
+{
+    const RayTable rays(MakeColorCamera());
+    LayerHeightMap map;
+    const LayerHeightMapSettings& settings = map.GetSettings();
+    const size_t cellCount = size_t(settings.width) * settings.height;
+    const BedPlane plate = Tests::MakePlate(plateTilt, 0.6f);
+    Update(map, plate, rays, RenderScene(rays, plate, 0.01f, 0.06f), 6);
+
+    // Within planeResetDistance, the grid stays where it is.
+    const BedPlane nudged = Tests::MakePlate(plateTilt, 0.6f + 0.5f * settings.planeResetDistance);
+    map.Update(nudged, rays, RenderScene(rays, nudged, 0.01f, 0.06f).data());
+    CHECK(map.GetStatistics().resets == 0);
+
+    // A plate lowered by a centimeter is a new print: the old heights are dropped and measured again.
+    const BedPlane lowered = Tests::MakePlate(plateTilt, 0.61f);
+    const std::vector<float> depth = RenderScene(rays, lowered, 0.0f, 0.0f);
+    map.Update(lowered, rays, depth.data());
+    CHECK(map.GetStatistics().resets == 1);
+    CHECK(map.GetStatistics().cellsObserved == 0);
+    CHECK(std::isnan(map.GetMaxHeight()));
+    Update(map, lowered, rays, depth, 1);
+    CHECK(map.GetStatistics().cellsObserved == cellCount);
+    CHECK(std::fabs(map.GetMaxHeight()) < 0.001f);
+    CHECK(map.GetCell(80, 80).changes == 1);
+
+    // Reset forgets the cells and the counters.
+    map.Reset();
+    CHECK(std::isnan(map.GetMaxHeight()));
+    CHECK(map.GetStatistics().framesProcessed == 0);
+    CHECK(map.GetStatistics().resets == 0);
+    Update(map, plate, rays, RenderScene(rays, plate, 0.02f, 0.06f), 6);
+    CHECK_NEAR(map.GetMaxHeight(), 0.02f, 0.001f);
+}
+
+int main()
+{
+    TestPlateIsObserved();
+    TestPartGrows();
+    TestNoiseIsIgnored();
+    TestPlateMoveStartsOver();
+    return Tests::FailureCount();
+}
@@ -0,0 +1,308 @@
+#include "PointCloud.h"
+#include "SyntheticScene.h"
+#include "TestChecks.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace SDKTemplate;
+
+static PinholeIntrinsics MakeDepthCamera(uint32_t width, uint32_t height)
+{
+    PinholeIntrinsics intrinsics = Tests::MakeCamera(width, height, 0.8f * width);
+    intrinsics.principalPointX = 0.5f * width - 0.3f;
+    intrinsics.principalPointY = 0.5f * height + 0.2f;
+    intrinsics.radialK1 = 0.05f;
+    return intrinsics;
+}
+
+// Raw depths over the whole 16 bit range, with invalid pixels, in rows padded to rowStride samples.
+static std::vector<uint16_t> MakeDepth(uint32_t width, uint32_t height, size_t rowStride)
+{
+    std::vector<uint16_t> depth(rowStride * height, 0xBEEF);
+    uint32_t state = 12345;
+    for (uint32_t v = 0; v < height; v++)
+    {
+        for (uint32_t u = 0; u < width; u++)
+        {
+            state = state * 1664525u + 1013904223u;
+            uint16_t raw = static_cast<uint16_t>(state >> 16);
+            depth[v * rowStride + u] = (raw % 11 == 0) ? 0 : raw;
+        }
+    }
+    return depth;
+}
+
+// The conversion GeneratePointCloud documents, written out plainly.
+static void GenerateReference(const RayTable& rays, const uint16_t* depth, size_t rowStride, float depthScale, OrganizedPointCloud& cloud)
+{
+    for (uint32_t v = 0; v < cloud.GetHeight(); v++)
+    {
+        for (uint32_t u = 0; u < cloud.GetWidth(); u++)
+        {
+            const size_t i = size_t(v) * cloud.GetWidth() + u;
+            const float z = static_cast<float>(depth[v * rowStride + u]) * depthScale;
+            cloud.GetX()[i] = rays.GetRayX()[i] * z;
+            cloud.GetY()[i] = rays.GetRayY()[i] * z;
+            cloud.GetZ()[i] = z;
+        }
+    }
+}
+
+static bool SamePoints(const OrganizedPointCloud& a, const OrganizedPointCloud& b)
+{
+    const size_t bytes = a.GetCount() * sizeof(float);
+    return a.GetCount() == b.GetCount() &&
+        std::memcmp(a.GetX(), b.GetX(), bytes) == 0 &&
+        std::memcmp(a.GetY(), b.GetY(), bytes) == 0 &&
+        std::memcmp(a.GetZ(), b.GetZ(), bytes) == 0;
+}
+
+// Every variant this processor can run, from the scalar one up.
+static std::vector<CpuFeatures> GetVariants(std::vector<const char*>& names)
+{
+    const CpuFeatures& supported = GetCpuFeatures();
+    std::vector<CpuFeatures> variants;
+    variants.push_back(CpuFeatures());
+    names.push_back("scalar");
+    if (supported.Sse41)
+    {
+        CpuFeatures features;
+        features.Sse41 = true;
+        variants.push_back(features);
+        names.push_back("SSE4.1");
+    }
+    if (supported.Sse41 && supported.Avx2)
+    {
+        CpuFeatures features;
+        features.Sse41 = true;
+        features.Avx2 = true;
+        variants.push_back(features);
+        names.push_back("AVX2");
+    }
+    if (supported.Neon)
+    {
+        CpuFeatures features;
+        features.Neon = true;
+        variants.push_back(features);
+        names.push_back("NEON");
+    }
+    return variants;
+}
+
+static void TestVariantsMatchScalar()
+{
+    std::vector<const char*> names;
+    std::vector<CpuFeatures> variants = GetVariants(names);
+
+    // Widths that leave a tail after every vector width, and a padded depth stride.
+    const uint32_t sizes[][2] = { { 37, 5 }, { 1, 3 }, { 7, 2 }, { 64, 4 }, { 640, 576 } };
+    for (const auto& size : sizes)
+    {
+        const uint32_t width = size[0];
+        const uint32_t height = size[1];
+        const size_t rowStride = width + 3;
+        RayTable rays(MakeDepthCamera(width, height));
+        std::vector<uint16_t> depth = MakeDepth(width, height, rowStride);
+
+        OrganizedPointCloud reference;
+        reference.Resize(width, height, false);
+        GenerateReference(rays, depth.data(), rowStride, 0.001f, reference);
+
+        for (size_t variant = 0; variant < variants.size(); variant++)
+        {
+            OrganizedPointCloud cloud;
+            cloud.Resize(width, height, false);
+            GeneratePointCloud(rays, depth.data(), rowStride, 0.001f, cloud, variants[variant]);
+            if (!SamePoints(cloud, reference))
+            {
+                std::fprintf(stderr, "%s differs from the scalar conversion at %ux%u\n", names[variant], width, height);
+            }
+            CHECK(SamePoints(cloud, reference));
+        }
+
+        // The dispatched conversion is one of them.
+        OrganizedPointCloud cloud;
+        cloud.Resize(width, height, false);
+        GeneratePointCloud(rays, depth.data(), rowStride, 0.001f, cloud);
+        CHECK(SamePoints(cloud, reference));
+    }
+}
+
+// Times every variant at the resolution of a 640x576 time of flight depth mode.
+static void BenchmarkVariants()
+{
+    const uint32_t width = 640;
+    const uint32_t height = 576;
+    const int frames = 200;
+    RayTable rays(MakeDepthCamera(width, height));
+    std::vector<uint16_t> depth = MakeDepth(width, height, width);
+    OrganizedPointCloud cloud;
+    cloud.Resize(width, height, false);
+
+    std::vector<const char*> names;
+    std::vector<CpuFeatures> variants = GetVariants(names);
+    std::printf("Point cloud generation, %ux%u, one thread:\n", width, height);
+    for (size_t variant = 0; variant < variants.size(); variant++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            GeneratePointCloud(rays, depth.data(), width, 0.001f, cloud, variants[variant]);
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+        std::printf("  %-7s %6.3f ms per frame, %6.0f frames/s\n", names[variant], milliseconds, 1000.0 / milliseconds);
+    }
+}
+
+static PinholeIntrinsics MakeColorCamera()
+{
+    return Tests::MakeCamera(1280, 720, 900.0f);
+}
+
+// The color camera 3 cm beside the depth camera, looking the same way.
+static RigidTransform MakeDepthToColor()
+{
+    RigidTransform depthToColor;
+    depthToColor.translation[0] = -0.03f;
+    return depthToColor;
+}
+
+// A color image whose pixels all differ, brightened by lighting.
+static std::vector<uint32_t> MakeColorImage(const PinholeIntrinsics& intrinsics, uint32_t lighting)
+{
+    std::vector<uint32_t> pixels(size_t(intrinsics.imageWidth) * intrinsics.imageHeight);
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        pixels[i] = 0xFF000000u | ((static_cast<uint32_t>(i) * 2654435761u) & 0x00FFFF00u) | lighting;
+    }
+    return pixels;
+}
+
+// A static plate 0.6 m away, so no tile's depth changes from one frame to the next.
+static std::vector<uint16_t> MakeStaticDepth(uint32_t width, uint32_t height)
+{
+    return std::vector<uint16_t>(size_t(width) * height, 600);
+}
+
+static bool SameColors(const OrganizedPointCloud& a, const OrganizedPointCloud& b)
+{
+    return a.GetCount() == b.GetCount() && std::memcmp(a.GetColors(), b.GetColors(), a.GetCount() * sizeof(uint32_t)) == 0;
+}
+
+static void TestColorsAreRefreshed()
+{
+    const uint32_t width = 640;
+    const uint32_t height = 576;
+    const uint32_t refreshInterval = 8;
+    const PinholeIntrinsics colorIntrinsics = MakeColorCamera();
+    const RigidTransform depthToColor = MakeDepthToColor();
+    RayTable rays(MakeDepthCamera(width, height));
+    std::vector<uint16_t> depth = MakeStaticDepth(width, height);
+    std::vector<uint32_t> dim = MakeColorImage(colorIntrinsics, 0x10);
+    std::vector<uint32_t> bright = MakeColorImage(colorIntrinsics, 0xF0);
+
+    OrganizedPointCloud clouds[2];
+    for (OrganizedPointCloud& cloud : clouds)
+    {
+        cloud.Resize(width, height, true);
+        GeneratePointCloud(rays, depth.data(), width, 0.001f, cloud);
+    }
+    OrganizedPointCloud dimColors;
+    dimColors.Resize(width, height, true);
+    GeneratePointCloud(rays, depth.data(), width, 0.001f, dimColors);
+    ColorizePointCloud(depthToColor, colorIntrinsics, dim.data(), colorIntrinsics.imageWidth, dimColors);
+    OrganizedPointCloud brightColors;
+    brightColors.Resize(width, height, true);
+    GeneratePointCloud(rays, depth.data(), width, 0.001f, brightColors);
+    ColorizePointCloud(depthToColor, colorIntrinsics, bright.data(), colorIntrinsics.imageWidth, brightColors);
+    CHECK(!SameColors(dimColors, brightColors));
+
+    TileChangeMap unchanged;
+    unchanged.Resize(width, height);
+
+    // Without refreshing, the lights going up never reaches a static scene.
+    ColorizePointCloud(depthToColor, colorIntrinsics, dim.data(), colorIntrinsics.imageWidth, clouds[0]);
+    for (int frame = 0; frame < 2 * static_cast<int>(refreshInterval); frame++)
+    {
+        ColorizePointCloud(depthToColor, colorIntrinsics, bright.data(), colorIntrinsics.imageWidth, clouds[(frame + 1) % 2],
+            &unchanged, &clouds[frame % 2]);
+    }
+    CHECK(SameColors(clouds[0], dimColors));
+
+    // Refreshing one row of tiles in refreshInterval every frame brings every point up to date within that many
+    // frames, and not before.
+    for (uint32_t frame = 0; frame < refreshInterval; frame++)
+    {
+        ColorizePointCloud(depthToColor, colorIntrinsics, bright.data(), colorIntrinsics.imageWidth, clouds[(frame + 1) % 2],
+            &unchanged, &clouds[frame % 2], refreshInterval, frame);
+        CHECK(SameColors(clouds[(frame + 1) % 2], brightColors) == (frame + 1 == refreshInterval));
+    }
+
+    // A changed tile is projected again whatever the phase.
+    TileChangeMap oneChanged;
+    oneChanged.Resize(width, height);
+    oneChanged.SetChanged(5, 3);
+    ColorizePointCloud(depthToColor, colorIntrinsics, dim.data(), colorIntrinsics.imageWidth, clouds[1],
+        &oneChanged, &clouds[0], refreshInterval, 0);
+    const size_t inChangedTile = size_t(3 * ChangeTileSize + 2) * width + 5 * ChangeTileSize + 7;
+    const size_t inOtherTile = size_t(3 * ChangeTileSize + 2) * width + 6 * ChangeTileSize + 7;
+    CHECK(clouds[1].GetColors()[inChangedTile] == dimColors.GetColors()[inChangedTile]);
+    CHECK(clouds[1].GetColors()[inOtherTile] == brightColors.GetColors()[inOtherTile]);
+}
+
+// Times coloring a static scene in full against reusing the colors of unchanged tiles and refreshing one row
+// of tiles in eight.
+static void BenchmarkColorReuse()
+{
+    const uint32_t width = 640;
+    const uint32_t height = 576;
+    const int frames = 100;
+    const uint32_t refreshInterval = 8;
+    const PinholeIntrinsics colorIntrinsics = MakeColorCamera();
+    const RigidTransform depthToColor = MakeDepthToColor();
+    RayTable rays(MakeDepthCamera(width, height));
+    std::vector<uint16_t> depth = MakeStaticDepth(width, height);
+    std::vector<uint32_t> pixels = MakeColorImage(colorIntrinsics, 0x80);
+
+    OrganizedPointCloud clouds[2];
+    for (OrganizedPointCloud& cloud : clouds)
+    {
+        cloud.Resize(width, height, true);
+        GeneratePointCloud(rays, depth.data(), width, 0.001f, cloud);
+        ColorizePointCloud(depthToColor, colorIntrinsics, pixels.data(), colorIntrinsics.imageWidth, cloud);
+    }
+    TileChangeMap unchanged;
+    unchanged.Resize(width, height);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        ColorizePointCloud(depthToColor, colorIntrinsics, pixels.data(), colorIntrinsics.imageWidth, clouds[frame % 2]);
+    }
+    const double fullMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        ColorizePointCloud(depthToColor, colorIntrinsics, pixels.data(), colorIntrinsics.imageWidth, clouds[(frame + 1) % 2],
+            &unchanged, &clouds[frame % 2], refreshInterval, frame);
+    }
+    const double reuseMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    std::printf("Point cloud colors of a static scene, %ux%u:\n", width, height);
+    std::printf("  every point        %6.3f ms per frame\n", fullMilliseconds);
+    std::printf("  1 tile row in %u    %6.3f ms per frame\n", refreshInterval, reuseMilliseconds);
+}
+
+int main()
+{
+    TestVariantsMatchScalar();
+    TestColorsAreRefreshed();
+    BenchmarkVariants();
+    BenchmarkColorReuse();
+    return Tests::FailureCount();
+}
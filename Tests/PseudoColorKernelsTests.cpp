@@ -0,0 +1,353 @@
+#include "PseudoColorKernels.h"
+#include "LookupTable.h"
+#include "TestChecks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// Depth scales of the sensors the sample meets: millimeters, 1/8 mm, 0.25 mm and a coarse 1 cm.
+static const float depthScales[] = { 0.001f, 0.000125f, 0.00025f, 0.01f };
+
+// Every variant this processor can run, from the scalar one up.
+static std::vector<CpuFeatures> GetVariants(std::vector<const char*>& names)
+{
+    const CpuFeatures& supported = GetCpuFeatures();
+    std::vector<CpuFeatures> variants;
+    variants.push_back(CpuFeatures());
+    names.push_back("scalar");
+    if (supported.Sse41)
+    {
+        CpuFeatures features;
+        features.Sse41 = true;
+        variants.push_back(features);
+        names.push_back("SSE4.1");
+    }
+    if (supported.Sse41 && supported.Avx2)
+    {
+        CpuFeatures features;
+        features.Sse41 = true;
+        features.Avx2 = true;
+        variants.push_back(features);
+        names.push_back("AVX2");
+    }
+    if (supported.Neon)
+    {
+        CpuFeatures features;
+        features.Neon = true;
+        variants.push_back(features);
+        names.push_back("NEON");
+    }
+    return variants;
+}
+
+// A 640x576 depth frame of a plate 0.4 to 1.2 m away, with a few pixels without depth.
+static std::vector<uint16_t> MakeDepthFrame(uint32_t width, uint32_t height)
+{
+    std::vector<uint16_t> depth(size_t(width) * height);
+    uint32_t state = 1;
+    for (size_t i = 0; i < depth.size(); i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        const uint32_t random = state >> 8;
+        depth[i] = (random % 50 == 0) ? 0 : static_cast<uint16_t>(400 + (i % width) + random % 16);
+    }
+    return depth;
+}
+
+static void TestVariantsMatchScalar()
+{
+    std::vector<const char*> names;
+    std::vector<CpuFeatures> variants = GetVariants(names);
+
+    // Every raw value once, converted in rows whose widths leave a tail after every vector width.
+    std::vector<uint16_t> raw(DepthColorTableSize);
+    for (uint32_t i = 0; i < DepthColorTableSize; i++)
+    {
+        raw[i] = static_cast<uint16_t>(i);
+    }
+    const int widths[] = { 65536, 1, 7, 8, 9, 37 };
+
+    for (float depthScale : depthScales)
+    {
+        for (int width : widths)
+        {
+            std::vector<ColorBGRA> reference(DepthColorTableSize);
+            std::vector<ColorBGRA> colors(DepthColorTableSize);
+            for (uint32_t x = 0; x + width <= DepthColorTableSize; x += width)
+            {
+                PseudoColorForDepth(width, reinterpret_cast<uint8_t*>(raw.data() + x), reinterpret_cast<uint8_t*>(reference.data() + x),
+                    depthScale, variants[0]);
+            }
+
+            for (size_t variant = 1; variant < variants.size(); variant++)
+            {
+                for (uint32_t x = 0; x + width <= DepthColorTableSize; x += width)
+                {
+                    PseudoColorForDepth(width, reinterpret_cast<uint8_t*>(raw.data() + x), reinterpret_cast<uint8_t*>(colors.data() + x),
+                        depthScale, variants[variant]);
+                }
+                const bool same = std::memcmp(colors.data(), reference.data(), colors.size() * sizeof(ColorBGRA)) == 0;
+                if (!same)
+                {
+                    std::fprintf(stderr, "%s differs from the scalar kernel at depth scale %g, width %d\n", names[variant], depthScale, width);
+                }
+                CHECK(same);
+            }
+        }
+
+        // Raw 0 has no depth and is transparent; the dispatched kernel is one of the variants.
+        std::vector<ColorBGRA> reference(DepthColorTableSize);
+        std::vector<ColorBGRA> colors(DepthColorTableSize);
+        PseudoColorForDepth(DepthColorTableSize, reinterpret_cast<uint8_t*>(raw.data()), reinterpret_cast<uint8_t*>(reference.data()),
+            depthScale, variants[0]);
+        PseudoColorForDepth(DepthColorTableSize, reinterpret_cast<uint8_t*>(raw.data()), reinterpret_cast<uint8_t*>(colors.data()), depthScale);
+        CHECK(std::memcmp(colors.data(), reference.data(), colors.size() * sizeof(ColorBGRA)) == 0);
+        CHECK(reference[0].A == 0 && reference[0].R == 0 && reference[0].G == 0 && reference[0].B == 0);
+        CHECK(reference[1000].A == 0xFF);
+    }
+}
+
+static bool SameColor(const ColorBGRA& a, const ColorBGRA& b)
+{
+    return a.B == b.B && a.G == b.G && a.R == b.R && a.A == b.A;
+}
+
+// The index LookupTable::GetValue reads for value in a table of 1024 entries.
+static uint32_t FloatLookupIndex(float value)
+{
+    return static_cast<uint32_t>((std::min)((std::max)(0.0f, value * 1024), 1023.0f));
+}
+
+// The infrared kernels index their tables with integers. Before that, every sample went through the float
+// lookup, LookupTable::GetValue(sample / maximum sample), which every Gray16 and Gray8 sample is checked against.
+// The top entries of the infrared table have the same color, so the Gray16 index is compared as well.
+static void TestInfraredMatchesFloatLookup()
+{
+    const ColorBGRA* infraredColors = GetInfraredColorTable();
+    const LookupTable<ColorBGRA, 1024> infraredTable([infraredColors](uint32_t index, uint32_t) { return infraredColors[index]; });
+
+    std::vector<uint16_t> gray16(65536);
+    for (uint32_t i = 0; i < gray16.size(); i++)
+    {
+        gray16[i] = static_cast<uint16_t>(i);
+    }
+    std::vector<ColorBGRA> colors(gray16.size());
+    Infrared16BitKernel()(static_cast<int>(gray16.size()), reinterpret_cast<uint8_t*>(gray16.data()), reinterpret_cast<uint8_t*>(colors.data()));
+
+    size_t mismatches = 0;
+    for (uint32_t value = 0; value < gray16.size(); value++)
+    {
+        const ColorBGRA expected = infraredTable.GetValue(value / static_cast<float>(UINT16_MAX));
+        const bool same = SameColor(colors[value], expected) &&
+            InfraredIndexFor16Bit(static_cast<uint16_t>(value)) == FloatLookupIndex(value / static_cast<float>(UINT16_MAX));
+        if (!same && mismatches++ == 0)
+        {
+            std::fprintf(stderr, "Gray16 sample %u differs from the float lookup\n", value);
+        }
+    }
+    CHECK(mismatches == 0);
+
+    std::vector<uint8_t> gray8(256);
+    for (uint32_t i = 0; i < gray8.size(); i++)
+    {
+        gray8[i] = static_cast<uint8_t>(i);
+    }
+    colors.resize(gray8.size());
+    Infrared8BitKernel()(static_cast<int>(gray8.size()), gray8.data(), reinterpret_cast<uint8_t*>(colors.data()));
+
+    mismatches = 0;
+    for (uint32_t value = 0; value < gray8.size(); value++)
+    {
+        const ColorBGRA expected = infraredTable.GetValue(value / static_cast<float>(UINT8_MAX));
+        const bool same = SameColor(colors[value], expected) && SameColor(GetInfrared8BitColorTable()[value], expected);
+        if (!same && mismatches++ == 0)
+        {
+            std::fprintf(stderr, "Gray8 sample %u differs from the float lookup\n", value);
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+// Times every variant at the resolution of a 640x576 time of flight depth mode.
+static void BenchmarkVariants()
+{
+    const uint32_t width = 640;
+    const uint32_t height = 576;
+    const int frames = 200;
+    std::vector<uint16_t> depth = MakeDepthFrame(width, height);
+    std::vector<ColorBGRA> colors(depth.size());
+
+    std::vector<const char*> names;
+    std::vector<CpuFeatures> variants = GetVariants(names);
+    std::printf("Depth pseudo-color, %ux%u, one thread:\n", width, height);
+    for (size_t variant = 0; variant < variants.size(); variant++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (uint32_t y = 0; y < height; y++)
+            {
+                PseudoColorForDepth(width, reinterpret_cast<uint8_t*>(depth.data() + y * width), reinterpret_cast<uint8_t*>(colors.data() + y * width),
+                    0.001f, variants[variant]);
+            }
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+        std::printf("  %-7s %6.3f ms per frame, %6.0f frames/s\n", names[variant], milliseconds, 1000.0 / milliseconds);
+    }
+}
+
+// The depth table holds what the dispatched kernel gives every raw value, so looking colors up in it changes nothing.
+static void TestDepthTable()
+{
+    std::vector<uint16_t> raw(DepthColorTableSize);
+    for (uint32_t i = 0; i < DepthColorTableSize; i++)
+    {
+        raw[i] = static_cast<uint16_t>(i);
+    }
+
+    for (float depthScale : depthScales)
+    {
+        std::vector<ColorBGRA> table(DepthColorTableSize);
+        BuildDepthColorTable(depthScale, table.data());
+
+        std::vector<ColorBGRA> reference(DepthColorTableSize);
+        std::vector<ColorBGRA> colors(DepthColorTableSize);
+        PseudoColorForDepth(DepthColorTableSize, reinterpret_cast<uint8_t*>(raw.data()), reinterpret_cast<uint8_t*>(reference.data()), depthScale);
+        DepthTableKernel kernel = { table.data() };
+        kernel(DepthColorTableSize, reinterpret_cast<uint8_t*>(raw.data()), reinterpret_cast<uint8_t*>(colors.data()));
+        CHECK(std::memcmp(colors.data(), reference.data(), colors.size() * sizeof(ColorBGRA)) == 0);
+    }
+}
+
+// Times building the 64K entry table, which happens whenever the depth scale changes, and converting a 640x576 frame
+// through it against converting the frame with the dispatched kernel.
+static void BenchmarkDepthTable()
+{
+    const uint32_t width = 640;
+    const uint32_t height = 576;
+    const int frames = 200;
+    std::vector<uint16_t> depth = MakeDepthFrame(width, height);
+    std::vector<ColorBGRA> colors(depth.size());
+    std::vector<ColorBGRA> table(DepthColorTableSize);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int build = 0; build < frames; build++)
+    {
+        BuildDepthColorTable(0.001f, table.data());
+    }
+    const double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            PseudoColorForDepth(width, reinterpret_cast<uint8_t*>(depth.data() + y * width), reinterpret_cast<uint8_t*>(colors.data() + y * width), 0.001f);
+        }
+    }
+    const double kernelMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    const DepthTableKernel kernel = { table.data() };
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            kernel(width, reinterpret_cast<uint8_t*>(depth.data() + y * width), reinterpret_cast<uint8_t*>(colors.data() + y * width));
+        }
+    }
+    const double tableMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    std::printf("Depth table, %ux%u, one thread:\n", width, height);
+    std::printf("  build    %6.3f ms per depth scale\n", buildMilliseconds);
+    std::printf("  kernel   %6.3f ms per frame\n", kernelMilliseconds);
+    std::printf("  table    %6.3f ms per frame\n", tableMilliseconds);
+}
+
+// The row loop of FrameRenderer::TransformPixels, without the bitmaps. ScanlineKernel is a template parameter
+// there so that the kernel is inlined into the loop.
+template<typename ScanlineKernel>
+static void TransformRows(uint8_t* inputBytes, int inputStride, uint8_t* outputBytes, int outputStride, int pixelWidth, int pixelHeight,
+    ScanlineKernel pixelTransformation)
+{
+    for (int y = 0; y < pixelHeight; y++)
+    {
+        pixelTransformation(pixelWidth, inputBytes + y * inputStride, outputBytes + y * outputStride);
+    }
+}
+
+// Times one kernel over a frame called inline, as TransformBitmap calls it, and through std::function, as it used to.
+// The two alternate and the fastest of several rounds is kept, since each call only takes a fraction of a millisecond.
+template<typename ScanlineKernel>
+static void BenchmarkTransform(const char* name, std::vector<uint8_t>& input, int inputPixelBytes, int width, int height, ScanlineKernel kernel)
+{
+    const int rounds = 5;
+    const int frames = 50;
+    std::vector<ColorBGRA> colors(size_t(width) * height);
+    std::vector<ColorBGRA> inlineColors(colors.size());
+    const int outputStride = width * static_cast<int>(sizeof(ColorBGRA));
+    const std::function<void(int, uint8_t*, uint8_t*)> function = kernel;
+
+    double inlineMilliseconds = 1e9;
+    double functionMilliseconds = 1e9;
+    for (int round = 0; round < rounds; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            TransformRows(input.data(), width * inputPixelBytes, reinterpret_cast<uint8_t*>(inlineColors.data()), outputStride, width, height, kernel);
+        }
+        inlineMilliseconds = (std::min)(inlineMilliseconds,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames);
+
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            TransformRows(input.data(), width * inputPixelBytes, reinterpret_cast<uint8_t*>(colors.data()), outputStride, width, height, function);
+        }
+        functionMilliseconds = (std::min)(functionMilliseconds,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames);
+    }
+
+    CHECK(std::memcmp(colors.data(), inlineColors.data(), colors.size() * sizeof(ColorBGRA)) == 0);
+    std::printf("  %-8s inline %6.3f ms, std::function %6.3f ms per frame\n", name, inlineMilliseconds, functionMilliseconds);
+}
+
+// Times the kernels TransformBitmap runs over a 640x576 frame.
+static void BenchmarkTransformKernels()
+{
+    const int width = 640;
+    const int height = 576;
+    std::vector<uint16_t> depth = MakeDepthFrame(width, height);
+    std::vector<uint8_t> gray16(reinterpret_cast<uint8_t*>(depth.data()), reinterpret_cast<uint8_t*>(depth.data() + depth.size()));
+    std::vector<uint8_t> gray8(depth.size());
+    for (size_t i = 0; i < depth.size(); i++)
+    {
+        gray8[i] = static_cast<uint8_t>(depth[i]);
+    }
+    std::vector<ColorBGRA> table(DepthColorTableSize);
+    BuildDepthColorTable(0.001f, table.data());
+
+    std::printf("TransformBitmap kernels, %dx%d, one thread:\n", width, height);
+    BenchmarkTransform("depth", gray16, 2, width, height, DepthTableKernel{ table.data() });
+    BenchmarkTransform("Gray16", gray16, 2, width, height, Infrared16BitKernel());
+    BenchmarkTransform("Gray8", gray8, 1, width, height, Infrared8BitKernel());
+}
+
+int main()
+{
+    TestVariantsMatchScalar();
+    TestDepthTable();
+    TestInfraredMatchesFloatLookup();
+    BenchmarkVariants();
+    BenchmarkDepthTable();
+    BenchmarkTransformKernels();
+    return Tests::FailureCount();
+}
@@ -0,0 +1,146 @@
+#include "RegionOfInterest.h"
+#include "TestChecks.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace SDKTemplate;
+
+typedef RegionOfInterest::Point Point;
+
+// Even-odd point in polygon test, the rule RegionOfInterest documents, done the slow way for one point.
+static bool IsInside(const std::vector<Point>& vertices, float x, float y)
+{
+    bool inside = false;
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Point& a = vertices[i];
+        const Point& b = vertices[(i + 1) % vertices.size()];
+        if ((a.y <= y) != (b.y <= y))
+        {
+            const float crossingX = a.x + (y - a.y) / (b.y - a.y) * (b.x - a.x);
+            if (x < crossingX)
+            {
+                inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
+
+// Checks the spans of vertices in an image of width x height pixels against the point in polygon test at every
+// pixel center, and that the spans are sorted, disjoint and counted right.
+static void CheckSpans(const std::vector<Point>& vertices, uint32_t width, uint32_t height)
+{
+    std::shared_ptr<const RegionOfInterest> region = RegionOfInterest::CreatePolygon(vertices);
+    CHECK(region != nullptr);
+    std::shared_ptr<const RowSpans> spans = region->GetSpans(width, height);
+    CHECK(spans->GetWidth() == width && spans->GetHeight() == height);
+
+    size_t mismatches = 0;
+    size_t badSpans = 0;
+    size_t pixelCount = 0;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        // Pixels the spans of the row cover.
+        std::vector<bool> covered(width, false);
+        uint32_t previousEnd = 0;
+        for (size_t i = 0; i < spans->GetSpanCount(y); i++)
+        {
+            const RowSpan& span = spans->GetSpans(y)[i];
+            badSpans += (span.begin >= span.end || span.end > width || (i > 0 && span.begin <= previousEnd)) ? 1 : 0;
+            for (uint32_t x = span.begin; x < span.end && x < width; x++)
+            {
+                covered[x] = true;
+            }
+            pixelCount += span.end - span.begin;
+            previousEnd = span.end;
+        }
+        badSpans += (spans->GetSpanCount(y) > 0 && (y < spans->GetFirstRow() || y >= spans->GetEndRow())) ? 1 : 0;
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const bool expected = IsInside(vertices, (x + 0.5f) / width, (y + 0.5f) / height);
+            mismatches += (covered[x] != expected || spans->Contains(x, y) != expected) ? 1 : 0;
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(badSpans == 0);
+    CHECK(pixelCount == spans->GetPixelCount());
+
+    // The spans of a size are rasterized once and kept.
+    CHECK(region->GetSpans(width, height) == spans);
+}
+
+static void TestRectangle()
+{
+    std::shared_ptr<const RegionOfInterest> region = RegionOfInterest::CreateRectangle(0.25f, 0.25f, 0.75f, 0.5f);
+    std::shared_ptr<const RowSpans> spans = region->GetSpans(640, 576);
+    CHECK(spans->GetPixelCount() == 320 * 144);
+    CHECK(spans->GetFirstRow() == 144);
+    CHECK(spans->GetEndRow() == 288);
+    CHECK(spans->GetSpanCount(200) == 1);
+    CHECK(spans->GetSpans(200)[0].begin == 160);
+    CHECK(spans->GetSpans(200)[0].end == 480);
+    CHECK(spans->GetSpanCount(143) == 0);
+    CHECK(spans->GetSpanCount(288) == 0);
+
+    // The same region at another resolution covers the same part of the image.
+    std::shared_ptr<const RowSpans> smaller = region->GetSpans(320, 288);
+    CHECK(smaller->GetPixelCount() == 160 * 72);
+    CHECK(region->GetSpans(640, 576) == spans);
+}
+
+static void TestPolygons()
+{
+    // A triangle, a concave L shape, a self-crossing bow tie whose middle is outside, a polygon reaching past the
+    // image, and a square whose edges run exactly through pixel centers. Slanted edges through pixel centers are
+    // left out, since which side of them a center falls on depends on rounding.
+    CheckSpans({ { 0.1f, 0.1f }, { 0.9f, 0.3f }, { 0.4f, 0.95f } }, 37, 23);
+    CheckSpans({ { 0.1f, 0.1f }, { 0.5f, 0.1f }, { 0.5f, 0.5f }, { 0.9f, 0.5f }, { 0.9f, 0.9f }, { 0.1f, 0.9f } }, 64, 48);
+    CheckSpans({ { 0.1f, 0.1f }, { 0.9f, 0.9f }, { 0.9f, 0.1f }, { 0.1f, 0.9f } }, 50, 46);
+    CheckSpans({ { -0.2f, 0.3f }, { 0.6f, -0.1f }, { 1.3f, 0.7f }, { 0.3f, 1.2f } }, 31, 17);
+    CheckSpans({ { 0.5f / 8, 0.5f / 8 }, { 7.5f / 8, 0.5f / 8 }, { 7.5f / 8, 7.5f / 8 }, { 0.5f / 8, 7.5f / 8 } }, 8, 8);
+
+    // Random polygons of 3 to 8 vertices over image sizes that aren't multiples of anything.
+    uint32_t state = 1;
+    auto random = [&state]()
+    {
+        state = state * 1664525u + 1013904223u;
+        return static_cast<float>(state >> 8) / 16777216.0f;
+    };
+    for (int test = 0; test < 200; test++)
+    {
+        std::vector<Point> vertices(3 + test % 6);
+        for (Point& vertex : vertices)
+        {
+            vertex.x = -0.2f + 1.4f * random();
+            vertex.y = -0.2f + 1.4f * random();
+        }
+        CheckSpans(vertices, 17 + test % 50, 9 + test % 31);
+    }
+}
+
+static void TestDegenerate()
+{
+    CHECK(RegionOfInterest::CreatePolygon({ { 0.1f, 0.1f }, { 0.9f, 0.9f } }) == nullptr);
+
+    // A polygon of no area, or outside the image, covers nothing.
+    std::shared_ptr<const RowSpans> line = RegionOfInterest::CreatePolygon({ { 0.1f, 0.1f }, { 0.5f, 0.5f }, { 0.9f, 0.9f } })->GetSpans(40, 30);
+    CHECK(line->GetPixelCount() == 0);
+    std::shared_ptr<const RowSpans> outside = RegionOfInterest::CreateRectangle(1.1f, 0.2f, 1.5f, 0.8f)->GetSpans(40, 30);
+    CHECK(outside->GetPixelCount() == 0);
+    for (uint32_t y = 0; y < 30; y++)
+    {
+        CHECK(outside->GetSpanCount(y) == 0);
+    }
+}
+
+int main()
+{
+    TestRectangle();
+    TestPolygons();
+    TestDegenerate();
+    return Tests::FailureCount();
+}
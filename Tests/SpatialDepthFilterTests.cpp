@@ -0,0 +1,213 @@
+#include "SpatialDepthFilter.h"
+#include "TestChecks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+using namespace SDKTemplate;
+
+static const float depthScale = 0.001f;
+
+// Blends a pixel with the running value of the pixels before it in one sweep, as SpatialDepthFilter documents.
+static void SmoothStep(float& value, float& previous, float alpha, float edgeThreshold)
+{
+    const float difference = value - previous;
+    const bool blend = value > 0.0f && previous > 0.0f && std::fabs(difference) <= edgeThreshold;
+    const float result = blend ? previous + alpha * difference : value;
+    if (value > 0.0f)
+    {
+        previous = result;
+    }
+    value = result;
+}
+
+// The nearest valid sample from (x, y) in direction (dx, dy) within radius, or 0.
+static uint16_t NearestValid(const std::vector<uint16_t>& depth, int width, int height, int x, int y, int dx, int dy, int radius)
+{
+    for (int step = 1; step <= radius; step++)
+    {
+        const int sampleX = x + dx * step;
+        const int sampleY = y + dy * step;
+        if (sampleX < 0 || sampleY < 0 || sampleX >= width || sampleY >= height)
+        {
+            return 0;
+        }
+        if (depth[sampleY * width + sampleX] != 0)
+        {
+            return depth[sampleY * width + sampleX];
+        }
+    }
+    return 0;
+}
+
+// SpatialDepthFilter written out plainly, one pixel at a time, on an image without row padding.
+static void FilterReference(int width, int height, std::vector<uint16_t>& depth, const SpatialFilterSettings& settings)
+{
+    if (settings.iterations > 0)
+    {
+        std::vector<float> smoothed(depth.begin(), depth.end());
+        const float edgeThreshold = settings.edgeThreshold / depthScale;
+        for (uint32_t iteration = 0; iteration < settings.iterations; iteration++)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                float previous = 0.0f;
+                for (int x = 0; x < width; x++)
+                {
+                    SmoothStep(smoothed[y * width + x], previous, settings.alpha, edgeThreshold);
+                }
+                previous = 0.0f;
+                for (int x = width - 1; x >= 0; x--)
+                {
+                    SmoothStep(smoothed[y * width + x], previous, settings.alpha, edgeThreshold);
+                }
+            }
+            for (int x = 0; x < width; x++)
+            {
+                float previous = 0.0f;
+                for (int y = 0; y < height; y++)
+                {
+                    SmoothStep(smoothed[y * width + x], previous, settings.alpha, edgeThreshold);
+                }
+                previous = 0.0f;
+                for (int y = height - 1; y >= 0; y--)
+                {
+                    SmoothStep(smoothed[y * width + x], previous, settings.alpha, edgeThreshold);
+                }
+            }
+        }
+        for (size_t i = 0; i < depth.size(); i++)
+        {
+            depth[i] = static_cast<uint16_t>(smoothed[i] + 0.5f);
+        }
+    }
+
+    // Holes take the farther of their nearest valid neighbours, first along rows, then along columns.
+    const int radius = static_cast<int>(settings.holeFillRadius);
+    if (radius == 0)
+    {
+        return;
+    }
+    for (int pass = 0; pass < 2; pass++)
+    {
+        const std::vector<uint16_t> source = depth;
+        const int dx = (pass == 0) ? 1 : 0;
+        const int dy = 1 - dx;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                if (source[y * width + x] == 0)
+                {
+                    depth[y * width + x] = (std::max)(NearestValid(source, width, height, x, y, -dx, -dy, radius),
+                        NearestValid(source, width, height, x, y, dx, dy, radius));
+                }
+            }
+        }
+    }
+}
+
+// A noisy plate with a 4 cm box in the middle, scattered dropouts, a long hole and a corner without depth.
+static std::vector<uint16_t> MakeScene(uint32_t width, uint32_t height, uint32_t& state)
+{
+    std::vector<uint16_t> depth(size_t(width) * height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            state = state * 1664525u + 1013904223u;
+            const uint32_t random = state >> 8;
+            const bool onBox = x > width / 3 && x < 2 * width / 3 && y > height / 3 && y < 2 * height / 3;
+            uint16_t value = static_cast<uint16_t>((onBox ? 560 : 600) + random % 9 - 4);
+            if (random % 20 == 0 || (x + 3 > width / 2 && x < width / 2 + 3 && y < height / 4) || (y < 3 && x < 8))
+            {
+                value = 0;
+            }
+            depth[size_t(y) * width + x] = value;
+        }
+    }
+    return depth;
+}
+
+static void TestMatchesReference()
+{
+    // Sizes that leave partial 4x4 blocks, and a padded row stride whose padding must not be touched.
+    const uint32_t sizes[][2] = { { 37, 11 }, { 64, 48 }, { 13, 7 }, { 3, 5 } };
+    uint32_t state = 5;
+    for (const auto& size : sizes)
+    {
+        for (uint32_t iterations = 0; iterations <= 2; iterations++)
+        {
+            for (uint32_t radius : { 0u, 1u, 4u })
+            {
+                const uint32_t width = size[0];
+                const uint32_t height = size[1];
+                const size_t rowStride = width + 3;
+                std::vector<uint16_t> expected = MakeScene(width, height, state);
+                std::vector<uint16_t> image(rowStride * height, 7);
+                for (uint32_t y = 0; y < height; y++)
+                {
+                    std::copy(expected.begin() + size_t(y) * width, expected.begin() + size_t(y + 1) * width, image.begin() + y * rowStride);
+                }
+
+                SpatialFilterSettings settings;
+                settings.iterations = iterations;
+                settings.holeFillRadius = radius;
+                SpatialDepthFilter filter(settings);
+                filter.Filter(width, height, image.data(), rowStride, depthScale);
+                FilterReference(static_cast<int>(width), static_cast<int>(height), expected, settings);
+
+                size_t mismatches = 0;
+                for (uint32_t y = 0; y < height; y++)
+                {
+                    for (uint32_t x = 0; x < rowStride; x++)
+                    {
+                        const uint16_t reference = (x < width) ? expected[size_t(y) * width + x] : 7;
+                        mismatches += (image[y * rowStride + x] != reference) ? 1 : 0;
+                    }
+                }
+                CHECK(mismatches == 0);
+            }
+        }
+    }
+}
+
+static void TestEdgesAndHoles()
+{
+    const uint32_t width = 64;
+    const uint32_t height = 48;
+    uint32_t state = 9;
+    std::vector<uint16_t> depth = MakeScene(width, height, state);
+    const std::vector<uint16_t> original = depth;
+    SpatialDepthFilter filter;
+    filter.Filter(width, height, depth.data(), width, depthScale);
+
+    // The 4 cm step at the box's edge is far beyond the edge threshold, so neither side bleeds into the other.
+    const uint32_t y = height / 2;
+    for (uint32_t x = width / 3 - 3; x < width / 3 + 4; x++)
+    {
+        const bool onBox = x > width / 3;
+        CHECK(std::abs(int(depth[y * width + x]) - (onBox ? 560 : 600)) <= 4);
+    }
+
+    // Dropouts within the fill radius are filled; the hole five pixels wide is filled from its two sides.
+    size_t holesBefore = 0;
+    size_t holesAfter = 0;
+    for (size_t i = 0; i < depth.size(); i++)
+    {
+        holesBefore += (original[i] == 0) ? 1 : 0;
+        holesAfter += (depth[i] == 0) ? 1 : 0;
+    }
+    CHECK(holesBefore > 0);
+    CHECK(holesAfter == 0);
+}
+
+int main()
+{
+    TestMatchesReference();
+    TestEdgesAndHoles();
+    return Tests::FailureCount();
+}
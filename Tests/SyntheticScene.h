@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BedPlane.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Cameras and build plate scenes shared by the off-device tests, rendered by casting the rays of a RayTable.
+namespace SDKTemplate
+{
+    namespace Tests
+    {
+        // A camera without lens distortion whose principal point is the center of the image.
+        inline PinholeIntrinsics MakeCamera(uint32_t width, uint32_t height, float focalLength)
+        {
+            PinholeIntrinsics intrinsics;
+            intrinsics.imageWidth = width;
+            intrinsics.imageHeight = height;
+            intrinsics.focalLengthX = focalLength;
+            intrinsics.focalLengthY = focalLength;
+            intrinsics.principalPointX = 0.5f * width;
+            intrinsics.principalPointY = 0.5f * height;
+            return intrinsics;
+        }
+
+        // A depth camera with the resolution of a time of flight sensor.
+        inline PinholeIntrinsics MakeTimeOfFlightCamera()
+        {
+            return MakeCamera(320, 288, 252.0f);
+        }
+
+        // The plate offset meters away along its normal, tilted about the camera's x axis. At 0 degrees the
+        // camera looks straight down at it.
+        inline BedPlane MakePlate(float tiltDegrees, float offset)
+        {
+            BedPlane plane;
+            const float angle = tiltDegrees * 3.14159265f / 180.0f;
+            plane.normal[0] = 0.0f;
+            plane.normal[1] = -std::sin(angle);
+            plane.normal[2] = -std::cos(angle);
+            plane.offset = offset;
+            return plane;
+        }
+
+        // Casts every ray at the plate and at the top of a square box of boxHeight, boxSize wide. The box is centered
+        // boxX, boxY away from where the optical axis meets the plate, along the plate's grid axes; with the normal
+        // in the camera's y z plane, the grid's x axis is the camera's. Returns depths in meters.
+        inline std::vector<float> RenderBoxOnPlate(const RayTable& rays, const BedPlane& plane, float boxHeight, float boxSize,
+            float boxX = 0.0f, float boxY = 0.0f)
+        {
+            const float* normal = plane.normal;
+            const float center[3] = { 0.0f, 0.0f, -plane.offset / normal[2] };
+            const float axisY[3] = { 0.0f, -normal[2], normal[1] };
+
+            std::vector<float> depth(rays.GetCount());
+            for (size_t i = 0; i < depth.size(); i++)
+            {
+                // A point at depth d along the ray is (rayX * d, rayY * d, d); it is on the plane where its height is 0.
+                const float ray[3] = { rays.GetRayX()[i], rays.GetRayY()[i], 1.0f };
+                const float along = normal[0] * ray[0] + normal[1] * ray[1] + normal[2] * ray[2];
+                depth[i] = -plane.offset / along;
+                if (boxHeight > 0.0f)
+                {
+                    const float topDepth = (boxHeight - plane.offset) / along;
+                    const float x = ray[0] * topDepth - center[0] - boxX;
+                    const float y = (ray[1] * topDepth - center[1]) * axisY[1] + (topDepth - center[2]) * axisY[2] - boxY;
+                    if (std::fabs(x) < 0.5f * boxSize && std::fabs(y) < 0.5f * boxSize)
+                    {
+                        depth[i] = topDepth;
+                    }
+                }
+            }
+            return depth;
+        }
+    } // Tests
+} // SDKTemplate
@@ -0,0 +1,243 @@
+#include "TemporalDepthFilter.h"
+#include "TestChecks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace SDKTemplate;
+
+static const float depthScale = 0.001f;
+
+// The median TemporalDepthFilter documents, of one pixel's samples, newest first.
+static uint16_t ReferenceMedian(std::vector<uint16_t> samples)
+{
+    samples.erase(std::remove(samples.begin(), samples.end(), uint16_t(0)), samples.end());
+    if (samples.empty())
+    {
+        return 0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t count = samples.size();
+    return static_cast<uint16_t>((samples[(count - 1) / 2] + samples[count / 2] + 1) >> 1);
+}
+
+// The weighted average TemporalDepthFilter documents: samples within the motion threshold of the newest valid
+// one count, with fixed point weights from 256 for the newest sample down by decay per frame.
+static uint16_t ReferenceWeightedAverage(const std::vector<uint16_t>& samples, float decay, uint16_t motionThreshold)
+{
+    uint16_t reference = 0;
+    for (uint16_t sample : samples)
+    {
+        reference = (reference == 0) ? sample : reference;
+    }
+
+    uint32_t weightedSum = 0;
+    uint32_t weightSum = 0;
+    float weight = 256.0f;
+    for (uint16_t sample : samples)
+    {
+        const uint32_t fixedWeight = static_cast<uint32_t>((std::max)(1.0f, std::floor(weight + 0.5f)));
+        weight *= decay;
+        if (sample != 0 && std::abs(int(sample) - int(reference)) <= motionThreshold)
+        {
+            weightedSum += sample * fixedWeight;
+            weightSum += fixedWeight;
+        }
+    }
+    return (weightSum == 0) ? 0 : static_cast<uint16_t>(static_cast<float>(weightedSum) / static_cast<float>(weightSum) + 0.5f);
+}
+
+// A noisy plate whose right half moves back and forth, with dropouts, saturated pixels and a pixel that never
+// has depth, in rows padded to rowStride samples.
+static void MakeFrame(uint32_t width, uint32_t height, size_t rowStride, int frame, uint32_t& state, std::vector<uint16_t>& depth)
+{
+    depth.assign(rowStride * height, 0xBEEF);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            state = state * 1664525u + 1013904223u;
+            const uint32_t random = state >> 8;
+            uint16_t value = static_cast<uint16_t>(600 + ((x > width / 2 && frame % 6 >= 3) ? 40 : 0) + random % 7);
+            if (random % 20 == 0)
+            {
+                value = 0;
+            }
+            else if (random % 997 == 0)
+            {
+                value = 65535;
+            }
+            depth[y * rowStride + x] = (x == 3 && y == 1) ? 0 : value;
+        }
+    }
+}
+
+static void TestMatchesReference(TemporalFilterMode mode)
+{
+    // Widths that leave a tail after the eight lane SIMD path.
+    const uint32_t sizes[][2] = { { 37, 11 }, { 8, 2 }, { 5, 3 } };
+    for (uint32_t historyLength = 1; historyLength <= MaxTemporalFilterHistory; historyLength++)
+    {
+        for (const auto& size : sizes)
+        {
+            const uint32_t width = size[0];
+            const uint32_t height = size[1];
+            const size_t rowStride = width + 5;
+
+            TemporalFilterSettings settings;
+            settings.mode = mode;
+            settings.historyLength = historyLength;
+            settings.decay = 0.6f;
+            TemporalDepthFilter filter(settings);
+            const uint16_t motionThreshold = static_cast<uint16_t>(settings.motionThreshold / depthScale + 0.5f);
+
+            uint32_t state = historyLength * 31 + width;
+            std::vector<std::vector<uint16_t>> history;
+            std::vector<uint16_t> depth;
+            std::vector<uint16_t> filtered(size_t(width) * height);
+            size_t mismatches = 0;
+            for (int frame = 0; frame < 12; frame++)
+            {
+                MakeFrame(width, height, rowStride, frame, state, depth);
+                filter.Filter(width, height, depth.data(), rowStride, depthScale, filtered.data());
+
+                std::vector<uint16_t> newest(size_t(width) * height);
+                for (uint32_t y = 0; y < height; y++)
+                {
+                    std::copy(depth.begin() + y * rowStride, depth.begin() + y * rowStride + width, newest.begin() + size_t(y) * width);
+                }
+                history.insert(history.begin(), newest);
+                if (history.size() > historyLength)
+                {
+                    history.pop_back();
+                }
+
+                for (size_t pixel = 0; pixel < filtered.size(); pixel++)
+                {
+                    std::vector<uint16_t> samples;
+                    for (const std::vector<uint16_t>& past : history)
+                    {
+                        samples.push_back(past[pixel]);
+                    }
+                    const uint16_t expected = (mode == TemporalFilterMode::Median) ?
+                        ReferenceMedian(samples) : ReferenceWeightedAverage(samples, settings.decay, motionThreshold);
+                    mismatches += (filtered[pixel] != expected) ? 1 : 0;
+                }
+            }
+            CHECK(mismatches == 0);
+        }
+    }
+}
+
+static void TestDropoutsAndMotion()
+{
+    const uint32_t width = 16;
+    const uint32_t height = 1;
+    TemporalFilterSettings settings;
+    settings.mode = TemporalFilterMode::Exponential;
+    settings.historyLength = 4;
+    TemporalDepthFilter filter(settings);
+
+    std::vector<uint16_t> depth(width, 600);
+    std::vector<uint16_t> filtered(width);
+    for (int frame = 0; frame < 4; frame++)
+    {
+        filter.Filter(width, height, depth.data(), width, depthScale, filtered.data());
+    }
+
+    // A pixel that drops out keeps the depth of the frames before it.
+    depth[2] = 0;
+
+    // A surface that moves by more than the motion threshold is followed at once, not smeared with the past.
+    depth[5] = 650;
+    filter.Filter(width, height, depth.data(), width, depthScale, filtered.data());
+    CHECK(filtered[2] == 600);
+    CHECK(filtered[5] == 650);
+
+    // After Reset, the next frame is filtered alone, so the dropout shows.
+    filter.Reset();
+    filter.Filter(width, height, depth.data(), width, depthScale, filtered.data());
+    CHECK(filtered[2] == 0);
+
+    // So it does when the frame size changes, or the settings do.
+    for (int frame = 0; frame < 2; frame++)
+    {
+        depth[2] = 600;
+        filter.Filter(width, height, depth.data(), width, depthScale, filtered.data());
+    }
+    depth[2] = 0;
+    filter.Filter(width / 2, height, depth.data(), width, depthScale, filtered.data());
+    CHECK(filtered[2] == 0);
+
+    depth[2] = 600;
+    filter.Filter(width, height, depth.data(), width, depthScale, filtered.data());
+    settings.historyLength = 3;
+    filter.Configure(settings);
+    depth[2] = 0;
+    filter.Filter(width, height, depth.data(), width, depthScale, filtered.data());
+    CHECK(filtered[2] == 0);
+}
+
+// Times both modes on the resolution of the depth camera's narrow field of view mode, at the default history and
+// at the longest one.
+static void BenchmarkModes()
+{
+    const uint32_t width = 640;
+    const uint32_t height = 576;
+    const int frames = 30;
+    const int rounds = 5;
+
+    // Six frames cover a full back and forth of the moving half, and are replayed in turn.
+    uint32_t state = 7;
+    std::vector<std::vector<uint16_t>> depths(6);
+    for (int frame = 0; frame < 6; frame++)
+    {
+        MakeFrame(width, height, width, frame, state, depths[frame]);
+    }
+    std::vector<uint16_t> filtered(size_t(width) * height);
+
+    std::printf("Temporal depth filter, %ux%u, one thread:\n", width, height);
+    for (TemporalFilterMode mode : { TemporalFilterMode::Median, TemporalFilterMode::Exponential })
+    {
+        for (uint32_t historyLength : { 5u, MaxTemporalFilterHistory })
+        {
+            TemporalFilterSettings settings;
+            settings.mode = mode;
+            settings.historyLength = historyLength;
+            TemporalDepthFilter filter(settings);
+            for (uint32_t frame = 0; frame < historyLength; frame++)
+            {
+                filter.Filter(width, height, depths[frame % 6].data(), width, depthScale, filtered.data());
+            }
+
+            // The best of several rounds, since other work on the machine only ever adds time.
+            double milliseconds = 0.0;
+            for (int round = 0; round < rounds; round++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                for (int frame = 0; frame < frames; frame++)
+                {
+                    filter.Filter(width, height, depths[frame % 6].data(), width, depthScale, filtered.data());
+                }
+                const double roundMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+                milliseconds = (round == 0) ? roundMilliseconds : (std::min)(milliseconds, roundMilliseconds);
+            }
+            std::printf("  %-11s history %u %6.3f ms per frame\n", (mode == TemporalFilterMode::Median) ? "median" : "exponential",
+                historyLength, milliseconds);
+        }
+    }
+}
+
+int main()
+{
+    TestMatchesReference(TemporalFilterMode::Median);
+    TestMatchesReference(TemporalFilterMode::Exponential);
+    TestDropoutsAndMotion();
+    BenchmarkModes();
+    return Tests::FailureCount();
+}
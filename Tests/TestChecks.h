@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+// Minimal checks for the off-device tests. A failed check is reported with its location and
+// counted, so a test runs to the end and main returns the failure count to ctest.
+namespace SDKTemplate
+{
+    namespace Tests
+    {
+        inline int& FailureCount()
+        {
+            static int failures = 0;
+            return failures;
+        }
+
+        inline void ReportFailure(const char* file, int line, const char* expression)
+        {
+            std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+            FailureCount()++;
+        }
+    } // Tests
+} // SDKTemplate
+
+#define CHECK(condition) \
+    ((condition) ? (void)0 : ::SDKTemplate::Tests::ReportFailure(__FILE__, __LINE__, #condition))
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    ((std::fabs(double(actual) - double(expected)) <= double(tolerance)) ? (void)0 : \
+        ::SDKTemplate::Tests::ReportFailure(__FILE__, __LINE__, #actual " is near " #expected))
@@ -0,0 +1,226 @@
+#include "ThreadPool.h"
+#include "TestChecks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// Runs taskCount tasks and checks that every index ran exactly once.
+static void CheckEveryIndexRunsOnce(ThreadPool& pool, uint32_t taskCount)
+{
+    std::unique_ptr<std::atomic<uint32_t>[]> calls(new std::atomic<uint32_t>[taskCount + 1]);
+    for (uint32_t i = 0; i <= taskCount; i++)
+    {
+        calls[i] = 0;
+    }
+
+    pool.ParallelFor(taskCount, [&](uint32_t index)
+    {
+        calls[(std::min)(index, taskCount)]++;
+    });
+
+    size_t wrong = 0;
+    for (uint32_t i = 0; i < taskCount; i++)
+    {
+        wrong += (calls[i] != 1) ? 1 : 0;
+    }
+    CHECK(wrong == 0);
+    CHECK(calls[taskCount] == 0);
+}
+
+static void TestEveryIndexRunsOnce()
+{
+    for (unsigned int workerCount : { 0u, 1u, 3u })
+    {
+        ThreadPool pool(workerCount);
+        CHECK(pool.GetThreadCount() == workerCount + 1);
+        for (uint32_t taskCount : { 0u, 1u, 2u, 7u, 1000u })
+        {
+            CheckEveryIndexRunsOnce(pool, taskCount);
+        }
+
+        // The pool is reused frame after frame.
+        for (int job = 0; job < 200; job++)
+        {
+            CheckEveryIndexRunsOnce(pool, 1 + job % 13);
+        }
+    }
+}
+
+// The renderer's stages call the shared pool from their own threads; each call still runs all of its tasks once.
+static void TestConcurrentCallers()
+{
+    ThreadPool pool(3);
+    const int callerCount = 4;
+    const int jobsPerCaller = 100;
+    std::atomic<uint64_t> total{ 0 };
+    std::atomic<int> wrongJobs{ 0 };
+
+    std::vector<std::thread> callers;
+    for (int caller = 0; caller < callerCount; caller++)
+    {
+        callers.emplace_back([&, caller]()
+        {
+            for (int job = 0; job < jobsPerCaller; job++)
+            {
+                const uint32_t taskCount = 2 + (caller * 7 + job) % 40;
+                std::vector<std::atomic<uint32_t>> calls(taskCount);
+                for (std::atomic<uint32_t>& count : calls)
+                {
+                    count = 0;
+                }
+                pool.ParallelFor(taskCount, [&](uint32_t index)
+                {
+                    calls[index]++;
+                    total++;
+                });
+                for (std::atomic<uint32_t>& count : calls)
+                {
+                    wrongJobs += (count != 1) ? 1 : 0;
+                }
+            }
+        });
+    }
+
+    uint64_t expected = 0;
+    for (int caller = 0; caller < callerCount; caller++)
+    {
+        for (int job = 0; job < jobsPerCaller; job++)
+        {
+            expected += 2 + (caller * 7 + job) % 40;
+        }
+    }
+    for (std::thread& caller : callers)
+    {
+        caller.join();
+    }
+    CHECK(wrongJobs == 0);
+    CHECK(total == expected);
+}
+
+// A pool that never got work, or that is idle after it, stops its workers without hanging; returning is the check.
+static void TestDestroyWhileIdle()
+{
+    for (unsigned int workerCount : { 0u, 1u, 4u })
+    {
+        {
+            ThreadPool pool(workerCount);
+        }
+        {
+            ThreadPool pool(workerCount);
+            CheckEveryIndexRunsOnce(pool, 16);
+        }
+    }
+}
+
+// Splits rows into bands of about bandBytes as FrameRenderer::TransformPixels does, and checks the bands give the
+// same image as a plain loop over the rows, including the last, shorter band.
+static void TestBandSplit()
+{
+    const int width = 641;
+    const int height = 577;
+    const int inputStride = width * 2 + 6;
+    const int outputStride = width * 4;
+    const size_t bandBytes = 64 * 1024;
+
+    std::vector<uint8_t> input(size_t(inputStride) * height);
+    uint32_t state = 3;
+    for (uint8_t& value : input)
+    {
+        state = state * 1664525u + 1013904223u;
+        value = static_cast<uint8_t>(state >> 24);
+    }
+
+    auto transformRow = [&](int y, std::vector<uint32_t>& output)
+    {
+        const uint16_t* inputRow = reinterpret_cast<const uint16_t*>(input.data() + size_t(y) * inputStride);
+        uint32_t* outputRow = output.data() + size_t(y) * width;
+        for (int x = 0; x < width; x++)
+        {
+            outputRow[x] = inputRow[x] * 2654435761u + y;
+        }
+    };
+
+    std::vector<uint32_t> expected(size_t(width) * height);
+    for (int y = 0; y < height; y++)
+    {
+        transformRow(y, expected);
+    }
+
+    for (unsigned int workerCount : { 0u, 2u })
+    {
+        ThreadPool pool(workerCount);
+        std::vector<uint32_t> output(expected.size(), 0xDEADBEEF);
+        const int rowsPerBand = (std::max)(1, static_cast<int>(bandBytes / (inputStride + outputStride)));
+        const uint32_t bandCount = static_cast<uint32_t>((height + rowsPerBand - 1) / rowsPerBand);
+        CHECK(bandCount > 1 && height % rowsPerBand != 0);
+
+        pool.ParallelFor(bandCount, [&](uint32_t band)
+        {
+            const int firstRow = static_cast<int>(band) * rowsPerBand;
+            const int lastRow = (std::min)(firstRow + rowsPerBand, height);
+            for (int y = firstRow; y < lastRow; y++)
+            {
+                transformRow(y, output);
+            }
+        });
+        CHECK(output == expected);
+    }
+}
+
+// A caller that finds another caller's job running waits for it, and both the pool and the waiting thread count it.
+static void TestContentionIsCounted()
+{
+    ThreadPool pool(1);
+    std::atomic<bool> firstJobRunning{ false };
+    std::atomic<bool> secondCallerWaiting{ false };
+
+    std::thread first([&]()
+    {
+        pool.ParallelFor(2, [&](uint32_t)
+        {
+            firstJobRunning = true;
+            while (!secondCallerWaiting)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        });
+        CHECK(ThreadPool::GetCallerWaits().count == 0);
+    });
+
+    while (!firstJobRunning)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const ThreadPoolWaits before = ThreadPool::GetCallerWaits();
+    secondCallerWaiting = true;
+    CheckEveryIndexRunsOnce(pool, 4);
+    first.join();
+
+    const ThreadPoolWaits after = ThreadPool::GetCallerWaits();
+    CHECK(pool.GetContendedCount() == 1);
+    CHECK(after.count == before.count + 1);
+    CHECK(after.milliseconds - before.milliseconds >= 10.0);
+
+    // Calls one after another don't wait.
+    CheckEveryIndexRunsOnce(pool, 4);
+    CHECK(pool.GetContendedCount() == 1);
+    CHECK(ThreadPool::GetCallerWaits().count == after.count);
+}
+
+int main()
+{
+    TestEveryIndexRunsOnce();
+    TestConcurrentCallers();
+    TestContentionIsCounted();
+    TestDestroyWhileIdle();
+    TestBandSplit();
+    return Tests::FailureCount();
+}
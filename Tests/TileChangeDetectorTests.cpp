@@ -0,0 +1,407 @@
+#include "TileChangeDetector.h"
+#include "TestChecks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// One raw unit is a millimeter, so the default thresholds are 3 units per pixel with differences capped at 20.
+static const float depthScale = 0.001f;
+
+// A depth and luma frame stored with rows wider than the image, whose padding holds garbage.
+struct Frame
+{
+    Frame(uint32_t width, uint32_t height, size_t depthRowStride, size_t lumaRowStride) :
+        width(width), height(height), depthRowStride(depthRowStride), lumaRowStride(lumaRowStride),
+        depth(depthRowStride * height, 0), luma(lumaRowStride * height, 0)
+    {
+    }
+
+    uint16_t& Depth(uint32_t x, uint32_t y) { return depth[y * depthRowStride + x]; }
+    uint8_t& Luma(uint32_t x, uint32_t y) { return luma[y * lumaRowStride + x]; }
+
+    void Fill(uint16_t z, uint8_t level)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                Depth(x, y) = z;
+                Luma(x, y) = level;
+            }
+        }
+    }
+
+    void Detect(TileChangeDetector& detector, bool withLuma, TileChangeMap& changes)
+    {
+        detector.Detect(width, height, depth.data(), depthRowStride, depthScale,
+            withLuma ? luma.data() : nullptr, lumaRowStride, changes);
+    }
+
+    uint32_t width;
+    uint32_t height;
+    size_t depthRowStride;
+    size_t lumaRowStride;
+    std::vector<uint16_t> depth;
+    std::vector<uint8_t> luma;
+};
+
+// The detector written out plainly: full sums of absolute differences over every tile, against references
+// that are only updated where a tile changed.
+class ReferenceDetector
+{
+public:
+    explicit ReferenceDetector(const TileChangeSettings& settings) : m_settings(settings) {}
+
+    // Returns one flag per tile, row by row.
+    std::vector<bool> Detect(Frame& frame, bool withLuma)
+    {
+        const uint32_t tilesX = (frame.width + ChangeTileSize - 1) / ChangeTileSize;
+        const uint32_t tilesY = (frame.height + ChangeTileSize - 1) / ChangeTileSize;
+        const bool changeAll = m_depth.empty();
+        if (changeAll)
+        {
+            m_depth.resize(size_t(frame.width) * frame.height);
+            m_luma.resize(size_t(frame.width) * frame.height);
+        }
+
+        const uint32_t cap = static_cast<uint32_t>((std::min)(m_settings.maxDepthDifference / depthScale + 0.5f, 32767.0f));
+        std::vector<bool> changed(size_t(tilesX) * tilesY);
+        for (uint32_t tileY = 0; tileY < tilesY; tileY++)
+        {
+            for (uint32_t tileX = 0; tileX < tilesX; tileX++)
+            {
+                const uint32_t left = tileX * ChangeTileSize;
+                const uint32_t top = tileY * ChangeTileSize;
+                const uint32_t right = (std::min)(left + ChangeTileSize, frame.width);
+                const uint32_t bottom = (std::min)(top + ChangeTileSize, frame.height);
+                const uint32_t pixels = (right - left) * (bottom - top);
+
+                uint32_t depthSum = 0;
+                uint32_t lumaSum = 0;
+                for (uint32_t y = top; y < bottom; y++)
+                {
+                    for (uint32_t x = left; x < right; x++)
+                    {
+                        depthSum += (std::min)(uint32_t(std::abs(frame.Depth(x, y) - m_depth[y * frame.width + x])), cap);
+                        lumaSum += uint32_t(std::abs(frame.Luma(x, y) - m_luma[y * frame.width + x]));
+                    }
+                }
+
+                const bool tileChanged = changeAll ||
+                    depthSum > static_cast<uint32_t>(m_settings.depthThreshold / depthScale * pixels + 0.5f) ||
+                    (withLuma && lumaSum > static_cast<uint32_t>(m_settings.lumaThreshold * pixels + 0.5f));
+                changed[tileY * tilesX + tileX] = tileChanged;
+                for (uint32_t y = top; tileChanged && y < bottom; y++)
+                {
+                    for (uint32_t x = left; x < right; x++)
+                    {
+                        m_depth[y * frame.width + x] = frame.Depth(x, y);
+                        m_luma[y * frame.width + x] = frame.Luma(x, y);
+                    }
+                }
+            }
+        }
+        return changed;
+    }
+
+private:
+    const TileChangeSettings m_settings;
+    std::vector<uint16_t> m_depth;
+    std::vector<uint8_t> m_luma;
+};
+
+static size_t CountDifferences(const TileChangeMap& changes, const std::vector<bool>& expected)
+{
+    size_t wrong = (changes.GetTileCount() != expected.size()) ? 1 : 0;
+    size_t expectedCount = 0;
+    for (uint32_t tileY = 0; tileY < changes.GetTilesY(); tileY++)
+    {
+        for (uint32_t tileX = 0; tileX < changes.GetTilesX() && wrong == 0; tileX++)
+        {
+            const bool changed = expected[tileY * changes.GetTilesX() + tileX];
+            wrong += (changes.IsChanged(tileX, tileY) != changed) ? 1 : 0;
+            expectedCount += changed ? 1 : 0;
+        }
+    }
+    return wrong + ((wrong == 0 && changes.GetChangedCount() != expectedCount) ? 1 : 0);
+}
+
+static uint32_t NextRandom(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// Rewrites rectangles of the frame by amounts around the thresholds, adds a unit of noise everywhere, and fills the
+// row padding with new garbage, which the detector must never read.
+static void Disturb(Frame& frame, uint32_t& state)
+{
+    for (uint32_t y = 0; y < frame.height; y++)
+    {
+        for (uint32_t x = 0; x < frame.width; x++)
+        {
+            const uint32_t random = NextRandom(state);
+            frame.Depth(x, y) = static_cast<uint16_t>(600 + random % 3);
+            frame.Luma(x, y) = static_cast<uint8_t>(100 + (random >> 4) % 3);
+        }
+        for (size_t x = frame.width; x < frame.depthRowStride; x++)
+        {
+            frame.depth[y * frame.depthRowStride + x] = static_cast<uint16_t>(NextRandom(state));
+        }
+        for (size_t x = frame.width; x < frame.lumaRowStride; x++)
+        {
+            frame.luma[y * frame.lumaRowStride + x] = static_cast<uint8_t>(NextRandom(state));
+        }
+    }
+
+    for (int rectangle = 0; rectangle < 6; rectangle++)
+    {
+        const uint32_t left = NextRandom(state) % frame.width;
+        const uint32_t top = NextRandom(state) % frame.height;
+        const uint32_t right = (std::min)(left + 1 + NextRandom(state) % 24, frame.width);
+        const uint32_t bottom = (std::min)(top + 1 + NextRandom(state) % 24, frame.height);
+        const int depthStep = static_cast<int>(NextRandom(state) % 9) - 4;
+        const int lumaStep = static_cast<int>(NextRandom(state) % 17) - 8;
+        const bool dropout = NextRandom(state) % 4 == 0;
+        for (uint32_t y = top; y < bottom; y++)
+        {
+            for (uint32_t x = left; x < right; x++)
+            {
+                frame.Depth(x, y) = dropout ? 0 : static_cast<uint16_t>(frame.Depth(x, y) + depthStep);
+                frame.Luma(x, y) = static_cast<uint8_t>(frame.Luma(x, y) + lumaStep);
+            }
+        }
+    }
+}
+
+static void TestMatchesReference()
+{
+    // Sizes that are a whole number of tiles and ones whose right and bottom tiles are cut short, in rows padded
+    // past the width.
+    const uint32_t sizes[][2] = { { 64, 48 }, { 70, 45 }, { 13, 7 } };
+    uint32_t state = 1;
+    for (const auto& size : sizes)
+    {
+        for (bool withLuma : { false, true })
+        {
+            Frame frame(size[0], size[1], size[0] + 5, size[0] + 11);
+            TileChangeSettings settings;
+            TileChangeDetector detector(settings);
+            ReferenceDetector reference(settings);
+            TileChangeMap changes;
+
+            size_t wrong = 0;
+            size_t changedTiles = 0;
+            const int frames = 40;
+            for (int frameIndex = 0; frameIndex < frames; frameIndex++)
+            {
+                Disturb(frame, state);
+                frame.Detect(detector, withLuma, changes);
+                wrong += CountDifferences(changes, reference.Detect(frame, withLuma));
+                changedTiles += changes.GetChangedCount();
+            }
+            if (wrong != 0)
+            {
+                std::fprintf(stderr, "%u frames of %ux%u %s differ from the reference\n", static_cast<unsigned>(wrong),
+                    size[0], size[1], withLuma ? "with luma" : "without luma");
+            }
+            CHECK(wrong == 0);
+
+            // Both changed and unchanged tiles were seen after the first frame.
+            CHECK(changedTiles > changes.GetTileCount() && changedTiles < frames * changes.GetTileCount());
+
+            const TileChangeStatistics& statistics = detector.GetStatistics();
+            const uint64_t pixels = uint64_t(size[0]) * size[1] * (withLuma ? 2 : 1);
+            CHECK(statistics.frames == frames);
+            CHECK(statistics.tilesCompared == frames * changes.GetTileCount());
+            CHECK(statistics.tilesChanged == changedTiles);
+            CHECK(statistics.pixelsTotal == frames * pixels);
+            CHECK(statistics.pixelsCompared < statistics.pixelsTotal - pixels);
+        }
+    }
+}
+
+// With depth still, a tile changes only when the mean luma difference passes its threshold.
+static void TestLuma()
+{
+    Frame frame(64, 32, 64, 80);
+    frame.Fill(600, 100);
+    TileChangeDetector detector;
+    TileChangeMap changes;
+    frame.Detect(detector, true, changes);
+    CHECK(changes.GetChangedCount() == changes.GetTileCount());
+
+    // 6 levels over the whole first tile is on the threshold, not above it; 7 is above.
+    for (uint32_t y = 0; y < ChangeTileSize; y++)
+    {
+        for (uint32_t x = 0; x < ChangeTileSize; x++)
+        {
+            frame.Luma(x, y) = 106;
+            frame.Luma(x + 2 * ChangeTileSize, y + ChangeTileSize) = 107;
+        }
+    }
+    frame.Detect(detector, true, changes);
+    CHECK(changes.GetChangedCount() == 1);
+    CHECK(changes.IsChanged(2, 1));
+
+    // Without luma the same frame shows nothing, after the frame that switches luma off changes everything.
+    frame.Detect(detector, false, changes);
+    CHECK(changes.GetChangedCount() == changes.GetTileCount());
+    frame.Fill(600, 0);
+    frame.Detect(detector, false, changes);
+    CHECK(changes.GetChangedCount() == 0);
+}
+
+// Dropouts count for at most maxDepthDifference each, so a few of them don't change a tile but many do.
+static void TestDepthCap()
+{
+    Frame frame(32, 16, 40, 32);
+    frame.Fill(600, 100);
+    TileChangeDetector detector;
+    TileChangeMap changes;
+    frame.Detect(detector, false, changes);
+
+    // 3 mm over 256 pixels allows 768 units; 38 dropouts capped at 20 mm are 760, 39 are 780.
+    for (uint32_t i = 0; i < 39; i++)
+    {
+        frame.Depth(i % ChangeTileSize, i / ChangeTileSize) = (i < 38) ? 0 : 600;
+        frame.Depth(ChangeTileSize + i % ChangeTileSize, i / ChangeTileSize) = 0;
+    }
+    frame.Detect(detector, false, changes);
+    CHECK(changes.GetChangedCount() == 1);
+    CHECK(!changes.IsChanged(0, 0) && changes.IsChanged(1, 0));
+
+    // With a 0.5 m cap two dropouts are enough.
+    TileChangeSettings settings;
+    settings.maxDepthDifference = 0.5f;
+    TileChangeDetector uncapped(settings);
+    frame.Fill(600, 100);
+    frame.Detect(uncapped, false, changes);
+    frame.Depth(0, 0) = 0;
+    frame.Depth(1, 0) = 0;
+    frame.Detect(uncapped, false, changes);
+    CHECK(changes.GetChangedCount() == 1 && changes.IsChanged(0, 0));
+}
+
+// A surface creeping by a millimeter a frame changes nothing from one frame to the next, but each tile is
+// compared with what it was when it last changed, so the drift is caught every fourth frame.
+static void TestDrift()
+{
+    Frame frame(48, 32, 48, 48);
+    TileChangeDetector detector;
+    TileChangeMap changes;
+    std::vector<int> changedFrames;
+    for (int frameIndex = 0; frameIndex <= 12; frameIndex++)
+    {
+        frame.Fill(static_cast<uint16_t>(600 + frameIndex), 100);
+        frame.Detect(detector, false, changes);
+        CHECK(changes.GetChangedCount() == 0 || changes.GetChangedCount() == changes.GetTileCount());
+        if (changes.GetChangedCount() != 0)
+        {
+            changedFrames.push_back(frameIndex);
+        }
+    }
+    CHECK((changedFrames == std::vector<int>{ 0, 4, 8, 12 }));
+}
+
+// Reset, and a frame of another size or another choice of luma, change every tile.
+static void TestEverythingChanges()
+{
+    Frame frame(40, 24, 48, 40);
+    frame.Fill(600, 100);
+    Frame larger(56, 24, 56, 56);
+    larger.Fill(600, 100);
+    TileChangeDetector detector;
+    TileChangeMap changes;
+
+    frame.Detect(detector, true, changes);
+    CHECK(changes.GetChangedCount() == changes.GetTileCount());
+    frame.Detect(detector, true, changes);
+    CHECK(changes.GetChangedCount() == 0);
+
+    detector.Reset();
+    frame.Detect(detector, true, changes);
+    CHECK(changes.GetChangedCount() == changes.GetTileCount());
+    frame.Detect(detector, true, changes);
+    CHECK(changes.GetChangedCount() == 0);
+
+    larger.Detect(detector, true, changes);
+    CHECK(changes.GetTilesX() == 4 && changes.GetTilesY() == 2);
+    CHECK(changes.GetChangedCount() == changes.GetTileCount());
+    larger.Detect(detector, true, changes);
+    CHECK(changes.GetChangedCount() == 0);
+
+    larger.Detect(detector, false, changes);
+    CHECK(changes.GetChangedCount() == changes.GetTileCount());
+    larger.Detect(detector, false, changes);
+    CHECK(changes.GetChangedCount() == 0);
+    larger.Detect(detector, true, changes);
+    CHECK(changes.GetChangedCount() == changes.GetTileCount());
+
+    frame.Detect(detector, true, changes);
+    CHECK(changes.GetTilesX() == 3 && changes.GetTilesY() == 2);
+    CHECK(changes.GetChangedCount() == changes.GetTileCount());
+}
+
+// A print seen by a 640x576 depth camera: a static plate with a unit of noise and some dropouts, a part slowly
+// growing in the middle and the print head sweeping across. Prints how much of the image was skipped.
+static void BenchmarkSequence()
+{
+    const uint32_t width = 640;
+    const uint32_t height = 576;
+    const int frames = 200;
+    Frame frame(width, height, width + 8, width);
+    TileChangeDetector detector;
+    TileChangeMap changes;
+    uint32_t state = 9;
+    double milliseconds = 0.0;
+
+    for (int frameIndex = 0; frameIndex < frames; frameIndex++)
+    {
+        const uint32_t headX = 100 + (frameIndex * 7) % 400;
+        const uint32_t headY = 200;
+        const uint16_t partHeight = static_cast<uint16_t>(20 * frameIndex / frames);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const uint32_t random = NextRandom(state);
+                uint16_t z = 600;
+                z -= (x > 280 && x < 360 && y > 250 && y < 330) ? partHeight : 0;
+                z = (x + 30 > headX && x < headX + 30 && y + 30 > headY && y < headY + 30) ? 450 : z;
+                frame.Depth(x, y) = (random % 50 == 0) ? 0 : static_cast<uint16_t>(z - 1 + random / 50 % 3);
+                frame.Luma(x, y) = static_cast<uint8_t>(x + y);
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        frame.Detect(detector, true, changes);
+        milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const TileChangeStatistics& statistics = detector.GetStatistics();
+    CHECK(statistics.tilesChanged < statistics.tilesCompared / 4);
+    std::printf("Tile change detection, %ux%u depth and luma, %d frames:\n", width, height, frames);
+    std::printf("  tiles changed   %llu of %llu (%.1f%%)\n", static_cast<unsigned long long>(statistics.tilesChanged),
+        static_cast<unsigned long long>(statistics.tilesCompared), 100.0 * statistics.tilesChanged / statistics.tilesCompared);
+    std::printf("  pixels compared %llu of %llu (%.1f%%)\n", static_cast<unsigned long long>(statistics.pixelsCompared),
+        static_cast<unsigned long long>(statistics.pixelsTotal), 100.0 * statistics.pixelsCompared / statistics.pixelsTotal);
+    std::printf("  %6.3f ms per frame\n", milliseconds / frames);
+}
+
+int main()
+{
+    TestMatchesReference();
+    TestLuma();
+    TestDepthCap();
+    TestDrift();
+    TestEverythingChanges();
+    BenchmarkSequence();
+    return Tests::FailureCount();
+}
@@ -0,0 +1,232 @@
+#include "TsdfVolume.h"
+#include "SyntheticScene.h"
+#include "TestChecks.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace SDKTemplate;
+
+// A depth camera 0.5 m above the build plate, looking straight down, that sees a 0.2 m square of it.
+static const uint32_t depthWidth = 160;
+static const uint32_t depthHeight = 144;
+static const float depthScale = 0.00025f;
+static const float cameraHeight = 0.5f;
+
+static PinholeIntrinsics MakeDepthCamera()
+{
+    return Tests::MakeCamera(depthWidth, depthHeight, 400.0f);
+}
+
+// Camera x is volume x, camera y is volume -y and camera z points down, from centerX, centerY above the plate.
+static RigidTransform MakeCameraToVolume(float centerX, float centerY)
+{
+    RigidTransform transform;
+    const float rotation[9] = { 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, -1.0f };
+    for (int i = 0; i < 9; i++)
+    {
+        transform.rotation[i] = rotation[i];
+    }
+    transform.translation[0] = centerX;
+    transform.translation[1] = centerY;
+    transform.translation[2] = cameraHeight;
+    return transform;
+}
+
+// Renders the plate at z = 0 with a 6 cm square box of boxHeight centered at the volume origin. Seen from straight
+// above, the plate's grid axes are the camera's x and y, and the box is at -centerX, centerY along them.
+static std::vector<uint16_t> RenderScene(const RayTable& rays, float centerX, float centerY, float boxHeight)
+{
+    const std::vector<float> meters = Tests::RenderBoxOnPlate(rays, Tests::MakePlate(0.0f, cameraHeight), boxHeight, 0.06f, -centerX, centerY);
+    std::vector<uint16_t> depth(meters.size());
+    for (size_t i = 0; i < depth.size(); i++)
+    {
+        depth[i] = static_cast<uint16_t>(std::lround(meters[i] / depthScale));
+    }
+    return depth;
+}
+
+static float HeightAt(const VolumeHeightMap& heightMap, float x, float y)
+{
+    const uint32_t column = static_cast<uint32_t>((x - heightMap.originX) / heightMap.cellSize);
+    const uint32_t row = static_cast<uint32_t>((y - heightMap.originY) / heightMap.cellSize);
+    return heightMap.heights[size_t(row) * heightMap.width + column];
+}
+
+// Cells with a known height where x < maxX or y < maxY.
+static size_t CountKnownCells(const VolumeHeightMap& heightMap, float maxX, float maxY)
+{
+    size_t known = 0;
+    for (uint32_t row = 0; row < heightMap.height; row++)
+    {
+        for (uint32_t column = 0; column < heightMap.width; column++)
+        {
+            const float x = heightMap.originX + (column + 0.5f) * heightMap.cellSize;
+            const float y = heightMap.originY + (row + 0.5f) * heightMap.cellSize;
+            if ((x < maxX || y < maxY) && !std::isnan(heightMap.heights[size_t(row) * heightMap.width + column]))
+            {
+                known++;
+            }
+        }
+    }
+    return known;
+}
+
+static void Integrate(TsdfVolume& volume, const RayTable& rays, float centerX, float centerY, float boxHeight, int frames, ThreadPool* threadPool)
+{
+    std::vector<uint16_t> depth = RenderScene(rays, centerX, centerY, boxHeight);
+    for (int frame = 0; frame < frames; frame++)
+    {
+        volume.Integrate(rays, depth.data(), depthWidth, depthScale, MakeCameraToVolume(centerX, centerY), threadPool);
+    }
+}
+
+static void TestSurfaceIsRecovered()
+{
+    const RayTable rays(MakeDepthCamera());
+    TsdfVolume volume{ TsdfVolumeSettings() };
+    ThreadPool threadPool(3);
+    Integrate(volume, rays, 0.0f, 0.0f, 0.03f, 5, &threadPool);
+
+    VolumeHeightMap heightMap;
+    volume.ExtractHeightMap(heightMap, &threadPool);
+    const float voxelSize = volume.GetSettings().voxelSize;
+    CHECK_NEAR(HeightAt(heightMap, 0.0f, 0.0f), 0.03f, voxelSize);
+    CHECK_NEAR(HeightAt(heightMap, 0.015f, -0.02f), 0.03f, voxelSize);
+    CHECK_NEAR(HeightAt(heightMap, 0.07f, 0.05f), 0.0f, voxelSize);
+    CHECK_NEAR(HeightAt(heightMap, -0.08f, -0.06f), 0.0f, voxelSize);
+
+    // The camera sees 0.2 m of the 0.3 m envelope, and nothing is known about the rest.
+    CHECK(std::isnan(HeightAt(heightMap, 0.14f, 0.0f)));
+    CHECK(std::isnan(HeightAt(heightMap, 0.0f, -0.14f)));
+
+    // Fusing on the calling thread gives the same model.
+    TsdfVolume serialVolume{ TsdfVolumeSettings() };
+    Integrate(serialVolume, rays, 0.0f, 0.0f, 0.03f, 5, nullptr);
+    VolumeHeightMap serialHeightMap;
+    serialVolume.ExtractHeightMap(serialHeightMap, nullptr);
+    CHECK(serialHeightMap.heights.size() == heightMap.heights.size());
+    bool same = serialHeightMap.heights.size() == heightMap.heights.size();
+    for (size_t i = 0; same && i < heightMap.heights.size(); i++)
+    {
+        same = (heightMap.heights[i] == serialHeightMap.heights[i]) ||
+            (std::isnan(heightMap.heights[i]) && std::isnan(serialHeightMap.heights[i]));
+    }
+    CHECK(same);
+
+    // A part that grows is followed once newer frames outweigh the older ones.
+    Integrate(volume, rays, 0.0f, 0.0f, 0.04f, 20, &threadPool);
+    volume.ExtractHeightMap(heightMap, &threadPool);
+    CHECK_NEAR(HeightAt(heightMap, 0.0f, 0.0f), 0.04f, voxelSize);
+    CHECK(volume.GetStatistics().framesIntegrated == 25);
+}
+
+static void TestEvictionRoundTrip()
+{
+    // Room for the blocks of about one view, but not two.
+    const RayTable rays(MakeDepthCamera());
+    TsdfVolume probe{ TsdfVolumeSettings() };
+    Integrate(probe, rays, 0.0f, 0.0f, 0.03f, 1, nullptr);
+    const size_t blocksPerView = probe.GetStatistics().blocksInUse;
+
+    TsdfVolumeSettings settings;
+    settings.maxBlocks = blocksPerView + blocksPerView / 4;
+    TsdfVolume volume(settings);
+
+    // Insert: the first view fits without evicting anything.
+    Integrate(volume, rays, 0.0f, 0.0f, 0.03f, 3, nullptr);
+    CHECK(volume.GetStatistics().blocksEvicted == 0);
+    CHECK(volume.GetStatistics().blocksInUse == blocksPerView);
+
+    // The part of the plate only the first view sees, beyond the second view's corner at (-0.01, -0.01).
+    VolumeHeightMap heightMap;
+    volume.ExtractHeightMap(heightMap, nullptr);
+    const size_t firstViewOnly = CountKnownCells(heightMap, -0.02f, -0.02f);
+    CHECK(firstViewOnly > 0);
+
+    // Evict: a view of another part of the plate recycles blocks only the first view observed.
+    Integrate(volume, rays, 0.09f, 0.09f, 0.03f, 3, nullptr);
+    TsdfVolumeStatistics statistics = volume.GetStatistics();
+    CHECK(statistics.blocksEvicted > 0);
+    CHECK(statistics.blocksRejected == 0);
+    CHECK(statistics.blocksAllocated <= settings.maxBlocks);
+    CHECK(statistics.blocksInUse <= settings.maxBlocks);
+
+    volume.ExtractHeightMap(heightMap, nullptr);
+    CHECK(CountKnownCells(heightMap, -0.02f, -0.02f) < firstViewOnly);
+    CHECK_NEAR(HeightAt(heightMap, 0.1f, 0.1f), 0.0f, settings.voxelSize);
+    const size_t bytesAllocated = statistics.bytesAllocated;
+
+    // Insert again: looking back at the box recreates its blocks, and its height comes back.
+    Integrate(volume, rays, 0.0f, 0.0f, 0.03f, 3, nullptr);
+    volume.ExtractHeightMap(heightMap, nullptr);
+    CHECK_NEAR(HeightAt(heightMap, 0.0f, 0.0f), 0.03f, settings.voxelSize);
+    CHECK_NEAR(HeightAt(heightMap, -0.08f, -0.08f), 0.0f, settings.voxelSize);
+
+    // However many round trips, memory stays within the cap.
+    for (int trip = 0; trip < 5; trip++)
+    {
+        Integrate(volume, rays, 0.09f, 0.09f, 0.03f, 1, nullptr);
+        Integrate(volume, rays, -0.09f, 0.09f, 0.03f, 1, nullptr);
+        Integrate(volume, rays, 0.0f, 0.0f, 0.03f, 1, nullptr);
+    }
+    statistics = volume.GetStatistics();
+    CHECK(statistics.blocksAllocated <= settings.maxBlocks);
+    CHECK(statistics.bytesAllocated == bytesAllocated);
+    volume.ExtractHeightMap(heightMap, nullptr);
+    CHECK_NEAR(HeightAt(heightMap, 0.0f, 0.0f), 0.03f, settings.voxelSize);
+}
+
+static void TestFullFrameIsRejected()
+{
+    // Too few blocks for even one view: the frame keeps the blocks it has and turns the rest down.
+    const RayTable rays(MakeDepthCamera());
+    TsdfVolumeSettings settings;
+    settings.maxBlocks = 64;
+    TsdfVolume volume(settings);
+    Integrate(volume, rays, 0.0f, 0.0f, 0.03f, 1, nullptr);
+
+    TsdfVolumeStatistics statistics = volume.GetStatistics();
+    CHECK(statistics.blocksRejected > 0);
+    CHECK(statistics.blocksEvicted == 0);
+    CHECK(statistics.blocksInUse == settings.maxBlocks);
+    CHECK(statistics.blocksAllocated == settings.maxBlocks);
+}
+
+static void TestReset()
+{
+    const RayTable rays(MakeDepthCamera());
+    TsdfVolume volume{ TsdfVolumeSettings() };
+    Integrate(volume, rays, 0.0f, 0.0f, 0.03f, 2, nullptr);
+    const size_t blocksAllocated = volume.GetStatistics().blocksAllocated;
+
+    // Everything fused is forgotten, but the block memory stays for reuse.
+    volume.Reset();
+    TsdfVolumeStatistics statistics = volume.GetStatistics();
+    CHECK(statistics.blocksInUse == 0);
+    CHECK(statistics.blocksAllocated == blocksAllocated);
+
+    VolumeHeightMap heightMap;
+    volume.ExtractHeightMap(heightMap, nullptr);
+    bool allUnknown = true;
+    for (float height : heightMap.heights)
+    {
+        allUnknown = allUnknown && std::isnan(height);
+    }
+    CHECK(allUnknown);
+
+    Integrate(volume, rays, 0.0f, 0.0f, 0.02f, 2, nullptr);
+    volume.ExtractHeightMap(heightMap, nullptr);
+    CHECK_NEAR(HeightAt(heightMap, 0.0f, 0.0f), 0.02f, volume.GetSettings().voxelSize);
+    CHECK(volume.GetStatistics().blocksAllocated == blocksAllocated);
+}
+
+int main()
+{
+    TestSurfaceIsRecovered();
+    TestEvictionRoundTrip();
+    TestFullFrameIsRejected();
+    TestReset();
+    return Tests::FailureCount();
+}
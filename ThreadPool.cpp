@@ -0,0 +1,124 @@
+#include "ThreadPool.h"
+
+#include <chrono>
+
+using namespace SDKTemplate;
+
+// Waits of the current thread, across all pools.
+static thread_local ThreadPoolWaits callerWaits;
+
+ThreadPool::ThreadPool(unsigned int workerCount)
+{
+    m_workers.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+unsigned int ThreadPool::GetThreadCount() const
+{
+    return static_cast<unsigned int>(m_workers.size()) + 1;
+}
+
+uint64_t ThreadPool::GetContendedCount() const
+{
+    return m_contended;
+}
+
+ThreadPoolWaits ThreadPool::GetCallerWaits()
+{
+    return callerWaits;
+}
+
+void ThreadPool::ParallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+{
+    // Not worth waking the workers for a single task.
+    if (m_workers.empty() || taskCount <= 1)
+    {
+        for (uint32_t i = 0; i < taskCount; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> jobLock(m_jobMutex, std::try_to_lock);
+    if (!jobLock.owns_lock())
+    {
+        auto waitStart = std::chrono::steady_clock::now();
+        jobLock.lock();
+        callerWaits.count++;
+        callerWaits.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+        m_contended++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_taskCount = taskCount;
+        m_nextTask = 0;
+        m_busyWorkers = m_workers.size();
+        m_generation++;
+    }
+    m_workAvailable.notify_all();
+
+    // The calling thread takes tasks too instead of sitting idle.
+    RunTasks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_workDone.wait(lock, [this]() { return m_busyWorkers == 0; });
+    m_task = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    uint64_t completedGeneration = 0;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this, completedGeneration]()
+            {
+                return m_stopping || m_generation != completedGeneration;
+            });
+
+            if (m_stopping)
+            {
+                return;
+            }
+            completedGeneration = m_generation;
+        }
+
+        RunTasks();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0)
+        {
+            m_workDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunTasks()
+{
+    for (uint32_t index = m_nextTask++; index < m_taskCount; index = m_nextTask++)
+    {
+        (*m_task)(index);
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // Time a thread spent in ThreadPool::ParallelFor waiting for another caller's job to finish.
+    struct ThreadPoolWaits
+    {
+        uint64_t count = 0; // Calls that found the pool busy with another caller's job.
+        double milliseconds = 0.0; // Time those calls waited before their own tasks started.
+    };
+
+    // A fixed set of worker threads that stay alive for the lifetime of the pool, used to split
+    // per-frame work into independent pieces without creating threads per frame.
+    class ThreadPool
+    {
+    public:
+        /// <summary>
+        /// Starts workerCount worker threads. The thread calling ParallelFor also runs tasks,
+        /// so a pool with zero workers runs everything on the calling thread.
+        /// </summary>
+        explicit ThreadPool(unsigned int workerCount);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /// <summary>
+        /// Number of threads that run tasks, including the calling thread.
+        /// </summary>
+        unsigned int GetThreadCount() const;
+
+        /// <summary>
+        /// Calls task(index) once for every index in [0, taskCount) and returns when all calls have finished.
+        /// Tasks may run in any order and on any thread, so they must not depend on each other.
+        /// Concurrent callers are serialized: one job runs at a time, and a caller that finds another caller's
+        /// job running waits for all of it before its own starts. Callers that must not wait for each other
+        /// need separate pools.
+        /// </summary>
+        void ParallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+        /// <summary>
+        /// Number of ParallelFor calls that had to wait for another caller's job.
+        /// </summary>
+        uint64_t GetContendedCount() const;
+
+        /// <summary>
+        /// Waits of the calling thread in ParallelFor on any pool, since the thread started. A thread that always
+        /// calls for the same purpose, such as a pipeline stage, can report them as its own.
+        /// </summary>
+        static ThreadPoolWaits GetCallerWaits();
+
+    private:
+        void WorkerLoop();
+        void RunTasks();
+
+        std::vector<std::thread> m_workers;
+
+        // Serializes ParallelFor callers so only one job is in flight.
+        std::mutex m_jobMutex;
+        std::atomic<uint64_t> m_contended{ 0 };
+
+        // Protects the job description and the worker bookkeeping below.
+        std::mutex m_mutex;
+        std::condition_variable m_workAvailable;
+        std::condition_variable m_workDone;
+
+        const std::function<void(uint32_t)>* m_task = nullptr;
+        uint32_t m_taskCount = 0;
+        std::atomic<uint32_t> m_nextTask{ 0 };
+        size_t m_busyWorkers = 0;
+        uint64_t m_generation = 0;
+        bool m_stopping = false;
+    };
+} // SDKTemplate
@@ -0,0 +1,324 @@
+#include "TileChangeDetector.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TILECHANGE_X86
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define TILECHANGE_NEON
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+using namespace SDKTemplate;
+
+// A tile's running sum is checked against its threshold after every this many rows.
+static constexpr uint32_t rowsPerCheck = 4;
+
+void TileChangeMap::Resize(uint32_t width, uint32_t height)
+{
+    m_tilesX = (width + ChangeTileSize - 1) / ChangeTileSize;
+    m_tilesY = (height + ChangeTileSize - 1) / ChangeTileSize;
+    m_bits.assign((GetTileCount() + 63) / 64, 0);
+    m_changedCount = 0;
+}
+
+void TileChangeMap::SetChanged(uint32_t tileX, uint32_t tileY)
+{
+    const size_t tile = size_t(tileY) * m_tilesX + tileX;
+    const uint64_t bit = uint64_t(1) << (tile % 64);
+    if (!(m_bits[tile / 64] & bit))
+    {
+        m_bits[tile / 64] |= bit;
+        m_changedCount++;
+    }
+}
+
+// Returns the sum over a tile of the absolute depth differences, each capped at cap, or the part of it
+// summed by the time it passed limit. rowsRead receives the rows that were compared.
+static uint32_t SumDepthDifferences(
+    const uint16_t* current, size_t currentStride,
+    const uint16_t* reference, size_t referenceStride,
+    uint32_t tileWidth, uint32_t tileHeight,
+    uint16_t cap, uint32_t limit, uint32_t& rowsRead)
+{
+    uint32_t sum = 0;
+    uint32_t row = 0;
+
+#if defined(TILECHANGE_X86)
+    if (tileWidth == ChangeTileSize)
+    {
+        // Unsigned saturating differences in both directions give the absolute difference, and saturating
+        // off the excess over cap gives the minimum with it. Capped differences fit in 15 bits, so they can
+        // be summed pairwise by the signed multiply-add.
+        const __m128i capVector = _mm_set1_epi16(static_cast<short>(cap));
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sums = _mm_setzero_si128();
+        while (row < tileHeight)
+        {
+            const uint32_t checkRow = (std::min)(row + rowsPerCheck, tileHeight);
+            for (; row < checkRow; row++)
+            {
+                const uint16_t* a = current + row * currentStride;
+                const uint16_t* b = reference + row * referenceStride;
+                for (uint32_t i = 0; i < ChangeTileSize; i += 8)
+                {
+                    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+                    const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+                    __m128i difference = _mm_or_si128(_mm_subs_epu16(x, y), _mm_subs_epu16(y, x));
+                    difference = _mm_subs_epu16(difference, _mm_subs_epu16(difference, capVector));
+                    sums = _mm_add_epi32(sums, _mm_madd_epi16(difference, ones));
+                }
+            }
+
+            __m128i total = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+            total = _mm_add_epi32(total, _mm_shuffle_epi32(total, _MM_SHUFFLE(2, 3, 0, 1)));
+            sum = static_cast<uint32_t>(_mm_cvtsi128_si32(total));
+            if (sum > limit)
+            {
+                break;
+            }
+        }
+        rowsRead = row;
+        return sum;
+    }
+#elif defined(TILECHANGE_NEON)
+    if (tileWidth == ChangeTileSize)
+    {
+        const uint16x8_t capVector = vdupq_n_u16(cap);
+        uint32x4_t sums = vdupq_n_u32(0);
+        while (row < tileHeight)
+        {
+            const uint32_t checkRow = (std::min)(row + rowsPerCheck, tileHeight);
+            for (; row < checkRow; row++)
+            {
+                const uint16_t* a = current + row * currentStride;
+                const uint16_t* b = reference + row * referenceStride;
+                for (uint32_t i = 0; i < ChangeTileSize; i += 8)
+                {
+                    const uint16x8_t difference = vminq_u16(vabdq_u16(vld1q_u16(a + i), vld1q_u16(b + i)), capVector);
+                    sums = vpadalq_u16(sums, difference);
+                }
+            }
+
+            sum = vaddvq_u32(sums);
+            if (sum > limit)
+            {
+                break;
+            }
+        }
+        rowsRead = row;
+        return sum;
+    }
+#endif
+
+    // Tiles cut short by the right edge of the image.
+    while (row < tileHeight)
+    {
+        const uint32_t checkRow = (std::min)(row + rowsPerCheck, tileHeight);
+        for (; row < checkRow; row++)
+        {
+            const uint16_t* a = current + row * currentStride;
+            const uint16_t* b = reference + row * referenceStride;
+            for (uint32_t i = 0; i < tileWidth; i++)
+            {
+                const uint16_t difference = static_cast<uint16_t>(a[i] > b[i] ? a[i] - b[i] : b[i] - a[i]);
+                sum += (std::min)(difference, cap);
+            }
+        }
+        if (sum > limit)
+        {
+            break;
+        }
+    }
+    rowsRead = row;
+    return sum;
+}
+
+// Returns the sum over a tile of the absolute luma differences, or the part of it summed by the time it
+// passed limit. rowsRead receives the rows that were compared.
+static uint32_t SumLumaDifferences(
+    const uint8_t* current, size_t currentStride,
+    const uint8_t* reference, size_t referenceStride,
+    uint32_t tileWidth, uint32_t tileHeight,
+    uint32_t limit, uint32_t& rowsRead)
+{
+    uint32_t sum = 0;
+    uint32_t row = 0;
+
+#if defined(TILECHANGE_X86)
+    if (tileWidth == ChangeTileSize)
+    {
+        // A tile row is one register, and the sum of absolute differences instruction reduces it to two halves.
+        __m128i sums = _mm_setzero_si128();
+        while (row < tileHeight)
+        {
+            const uint32_t checkRow = (std::min)(row + rowsPerCheck, tileHeight);
+            for (; row < checkRow; row++)
+            {
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + row * currentStride));
+                const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reference + row * referenceStride));
+                sums = _mm_add_epi64(sums, _mm_sad_epu8(x, y));
+            }
+
+            sum = static_cast<uint32_t>(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums)));
+            if (sum > limit)
+            {
+                break;
+            }
+        }
+        rowsRead = row;
+        return sum;
+    }
+#elif defined(TILECHANGE_NEON)
+    if (tileWidth == ChangeTileSize)
+    {
+        uint32x4_t sums = vdupq_n_u32(0);
+        while (row < tileHeight)
+        {
+            const uint32_t checkRow = (std::min)(row + rowsPerCheck, tileHeight);
+            for (; row < checkRow; row++)
+            {
+                const uint8x16_t difference = vabdq_u8(vld1q_u8(current + row * currentStride), vld1q_u8(reference + row * referenceStride));
+                sums = vpadalq_u16(sums, vpaddlq_u8(difference));
+            }
+
+            sum = vaddvq_u32(sums);
+            if (sum > limit)
+            {
+                break;
+            }
+        }
+        rowsRead = row;
+        return sum;
+    }
+#endif
+
+    while (row < tileHeight)
+    {
+        const uint32_t checkRow = (std::min)(row + rowsPerCheck, tileHeight);
+        for (; row < checkRow; row++)
+        {
+            const uint8_t* a = current + row * currentStride;
+            const uint8_t* b = reference + row * referenceStride;
+            for (uint32_t i = 0; i < tileWidth; i++)
+            {
+                sum += static_cast<uint32_t>(std::abs(int(a[i]) - int(b[i])));
+            }
+        }
+        if (sum > limit)
+        {
+            break;
+        }
+    }
+    rowsRead = row;
+    return sum;
+}
+
+TileChangeDetector::TileChangeDetector(const TileChangeSettings& settings) :
+    m_settings(settings)
+{
+}
+
+void TileChangeDetector::Reset()
+{
+    m_hasReference = false;
+}
+
+void TileChangeDetector::UpdateReference(uint32_t x, uint32_t y, uint32_t tileWidth, uint32_t tileHeight,
+    const uint16_t* depth, size_t depthRowStride, const uint8_t* luma, size_t lumaRowStride)
+{
+    for (uint32_t row = y; row < y + tileHeight; row++)
+    {
+        std::memcpy(&m_referenceDepth[size_t(row) * m_width + x], depth + row * depthRowStride + x, tileWidth * sizeof(uint16_t));
+        if (luma != nullptr)
+        {
+            std::memcpy(&m_referenceLuma[size_t(row) * m_width + x], luma + row * lumaRowStride + x, tileWidth);
+        }
+    }
+}
+
+void TileChangeDetector::Detect(
+    uint32_t width,
+    uint32_t height,
+    const uint16_t* depth,
+    size_t depthRowStride,
+    float depthScale,
+    const uint8_t* luma,
+    size_t lumaRowStride,
+    TileChangeMap& changes)
+{
+    changes.Resize(width, height);
+
+    const bool hasLuma = (luma != nullptr);
+    const bool changeAll = !m_hasReference || width != m_width || height != m_height || hasLuma != m_hasLuma;
+    if (changeAll)
+    {
+        m_width = width;
+        m_height = height;
+        m_hasLuma = hasLuma;
+        m_hasReference = true;
+        m_referenceDepth.resize(size_t(width) * height);
+        m_referenceLuma.resize(hasLuma ? size_t(width) * height : 0);
+    }
+
+    // Thresholds in raw units, rounded to whole units. The depth cap must stay within 15 bits for the SIMD sums.
+    const float depthLimitPerPixel = m_settings.depthThreshold / depthScale;
+    const uint16_t depthCap = static_cast<uint16_t>((std::min)(m_settings.maxDepthDifference / depthScale + 0.5f, 32767.0f));
+    const float lumaLimitPerPixel = m_settings.lumaThreshold;
+
+    size_t changed = 0;
+    for (uint32_t tileY = 0; tileY < changes.GetTilesY(); tileY++)
+    {
+        const uint32_t y = tileY * ChangeTileSize;
+        const uint32_t tileHeight = (std::min)(ChangeTileSize, height - y);
+        for (uint32_t tileX = 0; tileX < changes.GetTilesX(); tileX++)
+        {
+            const uint32_t x = tileX * ChangeTileSize;
+            const uint32_t tileWidth = (std::min)(ChangeTileSize, width - x);
+            const uint32_t pixels = tileWidth * tileHeight;
+            m_statistics.pixelsTotal += hasLuma ? 2 * pixels : pixels;
+
+            bool tileChanged = changeAll;
+            if (!tileChanged)
+            {
+                uint32_t rowsRead;
+                const uint32_t depthLimit = static_cast<uint32_t>(depthLimitPerPixel * pixels + 0.5f);
+                tileChanged = SumDepthDifferences(
+                    depth + y * depthRowStride + x, depthRowStride,
+                    &m_referenceDepth[size_t(y) * width + x], width,
+                    tileWidth, tileHeight, depthCap, depthLimit, rowsRead) > depthLimit;
+                m_statistics.pixelsCompared += rowsRead * tileWidth;
+
+                // The luma of a tile whose depth changed doesn't need to be read.
+                if (!tileChanged && hasLuma)
+                {
+                    const uint32_t lumaLimit = static_cast<uint32_t>(lumaLimitPerPixel * pixels + 0.5f);
+                    tileChanged = SumLumaDifferences(
+                        luma + y * lumaRowStride + x, lumaRowStride,
+                        &m_referenceLuma[size_t(y) * width + x], width,
+                        tileWidth, tileHeight, lumaLimit, rowsRead) > lumaLimit;
+                    m_statistics.pixelsCompared += rowsRead * tileWidth;
+                }
+            }
+
+            if (tileChanged)
+            {
+                changes.SetChanged(tileX, tileY);
+                UpdateReference(x, y, tileWidth, tileHeight, depth, depthRowStride, luma, lumaRowStride);
+                changed++;
+            }
+        }
+    }
+
+    m_statistics.frames++;
+    m_statistics.tilesCompared += changes.GetTileCount();
+    m_statistics.tilesChanged += changed;
+    m_statistics.tilesChangedLastFrame = changed;
+}
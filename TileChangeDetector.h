@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // Edge length, in pixels, of the square tiles change detection works on. Tiles at the right and bottom
+    // edges of an image whose size isn't a multiple of it are smaller.
+    constexpr uint32_t ChangeTileSize = 16;
+
+    // One bit per tile of an image, set for the tiles that changed. Tiles are numbered row by row.
+    class TileChangeMap
+    {
+    public:
+        /// <summary>
+        /// Sizes the map for an image of width x height pixels and clears every bit.
+        /// </summary>
+        void Resize(uint32_t width, uint32_t height);
+
+        uint32_t GetTilesX() const { return m_tilesX; }
+        uint32_t GetTilesY() const { return m_tilesY; }
+        size_t GetTileCount() const { return size_t(m_tilesX) * m_tilesY; }
+        size_t GetChangedCount() const { return m_changedCount; }
+
+        bool IsChanged(uint32_t tileX, uint32_t tileY) const
+        {
+            const size_t tile = size_t(tileY) * m_tilesX + tileX;
+            return (m_bits[tile / 64] >> (tile % 64)) & 1;
+        }
+
+        /// <summary>
+        /// Returns whether the tile holding pixel (x, y) changed.
+        /// </summary>
+        bool IsPixelChanged(uint32_t x, uint32_t y) const { return IsChanged(x / ChangeTileSize, y / ChangeTileSize); }
+
+        void SetChanged(uint32_t tileX, uint32_t tileY);
+
+        const uint64_t* GetBits() const { return m_bits.data(); }
+
+    private:
+        uint32_t m_tilesX = 0;
+        uint32_t m_tilesY = 0;
+        size_t m_changedCount = 0;
+        std::vector<uint64_t> m_bits;
+    };
+
+    // When a TileChangeDetector considers a tile changed.
+    struct TileChangeSettings
+    {
+        // Mean absolute depth difference over a tile, in meters, above which it changed. A pixel counts for
+        // at most maxDepthDifference, so dropouts and flickering edges add up to a change only when they
+        // cover much of the tile.
+        float depthThreshold = 0.003f;
+        float maxDepthDifference = 0.02f;
+
+        // Mean absolute luma difference over a tile, in levels, above which it changed.
+        float lumaThreshold = 6.0f;
+    };
+
+    // Counters of a TileChangeDetector.
+    struct TileChangeStatistics
+    {
+        uint64_t frames = 0;
+        uint64_t tilesCompared = 0;
+        uint64_t tilesChanged = 0;
+        size_t tilesChangedLastFrame = 0;
+
+        // Pixels, of depth and luma, that a full comparison of every tile would have read, and those actually
+        // read before each tile's early exit.
+        uint64_t pixelsTotal = 0;
+        uint64_t pixelsCompared = 0;
+    };
+
+    // Finds the tiles of a depth image, and optionally of a luma image of the same size such as the depth
+    // camera's infrared, that changed. Each tile is compared with the tile as it was the last time it changed,
+    // not with the previous frame, so a slow drift is caught once it adds up. The sum of absolute differences
+    // of a tile is accumulated with SIMD a few rows at a time, and stops as soon as it passes the threshold.
+    // Only standard C++ is used, so the detector can be exercised off-device with recorded depth.
+    class TileChangeDetector
+    {
+    public:
+        explicit TileChangeDetector(const TileChangeSettings& settings = TileChangeSettings());
+
+        /// <summary>
+        /// Forgets the reference images, so the next frame changes every tile.
+        /// </summary>
+        void Reset();
+
+        /// <summary>
+        /// Compares a raw 16 bit depth image of width x height pixels, with depthRowStride samples per row and
+        /// depthScale meters per raw unit, with the reference, and sets the bits of changes for the tiles that
+        /// changed. luma may be nullptr; otherwise it is an 8 bit image of the same size with lumaRowStride
+        /// bytes per row, and a tile changes if either image does. The first frame, and any frame with a
+        /// different size or a different choice of luma, changes every tile.
+        /// </summary>
+        void Detect(
+            uint32_t width,
+            uint32_t height,
+            const uint16_t* depth,
+            size_t depthRowStride,
+            float depthScale,
+            const uint8_t* luma,
+            size_t lumaRowStride,
+            TileChangeMap& changes);
+
+        const TileChangeStatistics& GetStatistics() const { return m_statistics; }
+
+    private:
+        /// <summary>
+        /// Copies a tile of the current images into the references.
+        /// </summary>
+        void UpdateReference(uint32_t x, uint32_t y, uint32_t tileWidth, uint32_t tileHeight,
+            const uint16_t* depth, size_t depthRowStride, const uint8_t* luma, size_t lumaRowStride);
+
+        const TileChangeSettings m_settings;
+
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        bool m_hasReference = false;
+        bool m_hasLuma = false;
+        std::vector<uint16_t> m_referenceDepth;
+        std::vector<uint8_t> m_referenceLuma;
+
+        TileChangeStatistics m_statistics;
+    };
+} // SDKTemplate
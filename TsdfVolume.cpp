@@ -0,0 +1,570 @@
+#include "TsdfVolume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace SDKTemplate;
+
+// Voxels along each edge of a block, and in a whole block.
+static constexpr int blockEdge = 8;
+static constexpr size_t blockVoxelCount = blockEdge * blockEdge * blockEdge;
+
+// Blocks whose memory is allocated together when the pool grows.
+static constexpr size_t blocksPerChunk = 256;
+
+// Voxel distances are stored as 16 bit fractions of the truncation distance.
+static constexpr float distanceScale = 32767.0f;
+
+// Marks an empty hash table slot. Packed keys only use 63 bits, so no block has this key.
+static constexpr uint64_t emptyTableKey = ~0ull;
+
+// Block coordinates are packed into 21 bits each, offset so negative coordinates fit.
+static constexpr int32_t keyBias = 1 << 20;
+static constexpr uint64_t keyFieldMask = (1ull << 21) - 1;
+
+// Block allocation looks at every second pixel in both directions. A block is far wider than the
+// distance between neighboring depth samples, so skipping pixels doesn't miss blocks.
+static constexpr uint32_t allocationPixelStride = 2;
+
+// Blocks looked at to pick the least recently observed one when the pool is full.
+static constexpr size_t evictionCandidates = 32;
+
+// Blocks fused by one thread pool task.
+static constexpr uint32_t blocksPerTask = 8;
+
+static inline int32_t FloorDivide(int32_t value, int32_t divisor)
+{
+    return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+// Returns the inverse of a rigid transform: the transposed rotation, and the translation rotated back and negated.
+static RigidTransform InvertRigidTransform(const RigidTransform& transform)
+{
+    const float* r = transform.rotation;
+    const float* t = transform.translation;
+
+    RigidTransform inverse;
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            inverse.rotation[i * 3 + j] = r[j * 3 + i];
+        }
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        inverse.translation[i] = -(inverse.rotation[i * 3] * t[0] + inverse.rotation[i * 3 + 1] * t[1] + inverse.rotation[i * 3 + 2] * t[2]);
+    }
+    return inverse;
+}
+
+TsdfVolume::TsdfVolume(const TsdfVolumeSettings& settings) :
+    m_settings(settings),
+    m_blockSize(settings.voxelSize * blockEdge)
+{
+    size_t tableSize = 1;
+    while (tableSize < m_settings.maxBlocks * 2)
+    {
+        tableSize <<= 1;
+    }
+    m_tableKeys.assign(tableSize, emptyTableKey);
+    m_tableBlocks.assign(tableSize, -1);
+    m_tableMask = tableSize - 1;
+
+    m_blocks.reserve(m_settings.maxBlocks);
+}
+
+void TsdfVolume::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::fill(m_tableKeys.begin(), m_tableKeys.end(), emptyTableKey);
+    std::fill(m_tableBlocks.begin(), m_tableBlocks.end(), -1);
+
+    m_freeBlocks.clear();
+    for (size_t i = 0; i < m_blocks.size(); i++)
+    {
+        m_blocks[i].inUse = false;
+        m_freeBlocks.push_back(static_cast<int32_t>(i));
+    }
+
+    m_frameBlocks.clear();
+    m_evictionCursor = 0;
+    m_frame = 0;
+    m_exhaustedFrame = 0;
+    m_blocksInUse = 0;
+    m_blocksEvicted = 0;
+    m_blocksRejected = 0;
+}
+
+uint64_t TsdfVolume::PackKey(const BlockKey& key)
+{
+    return (static_cast<uint64_t>(key.x + keyBias) & keyFieldMask) |
+        ((static_cast<uint64_t>(key.y + keyBias) & keyFieldMask) << 21) |
+        ((static_cast<uint64_t>(key.z + keyBias) & keyFieldMask) << 42);
+}
+
+size_t TsdfVolume::HashKey(uint64_t packedKey)
+{
+    // Mixes the three fields into every bit, since the table is indexed by the low bits only.
+    packedKey ^= packedKey >> 31;
+    packedKey *= 0x7fb5d329728ea185ull;
+    packedKey ^= packedKey >> 27;
+    packedKey *= 0x81dadef4bc2dd44dull;
+    packedKey ^= packedKey >> 33;
+    return static_cast<size_t>(packedKey);
+}
+
+int32_t TsdfVolume::FindBlock(const BlockKey& key) const
+{
+    const uint64_t packedKey = PackKey(key);
+    for (size_t slot = HashKey(packedKey) & m_tableMask; m_tableKeys[slot] != emptyTableKey; slot = (slot + 1) & m_tableMask)
+    {
+        if (m_tableKeys[slot] == packedKey)
+        {
+            return m_tableBlocks[slot];
+        }
+    }
+    return -1;
+}
+
+void TsdfVolume::InsertIntoTable(uint64_t packedKey, int32_t blockIndex)
+{
+    size_t slot = HashKey(packedKey) & m_tableMask;
+    while (m_tableKeys[slot] != emptyTableKey)
+    {
+        slot = (slot + 1) & m_tableMask;
+    }
+    m_tableKeys[slot] = packedKey;
+    m_tableBlocks[slot] = blockIndex;
+}
+
+void TsdfVolume::RemoveFromTable(uint64_t packedKey)
+{
+    size_t slot = HashKey(packedKey) & m_tableMask;
+    while (m_tableKeys[slot] != packedKey)
+    {
+        if (m_tableKeys[slot] == emptyTableKey)
+        {
+            return;
+        }
+        slot = (slot + 1) & m_tableMask;
+    }
+
+    // Shift later entries of the probe run back into the hole, unless that would move them in front of
+    // their home slot, so lookups never stop early at an empty slot.
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & m_tableMask; m_tableKeys[next] != emptyTableKey; next = (next + 1) & m_tableMask)
+    {
+        size_t home = HashKey(m_tableKeys[next]) & m_tableMask;
+        bool homeBetween = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!homeBetween)
+        {
+            m_tableKeys[hole] = m_tableKeys[next];
+            m_tableBlocks[hole] = m_tableBlocks[next];
+            hole = next;
+        }
+    }
+    m_tableKeys[hole] = emptyTableKey;
+    m_tableBlocks[hole] = -1;
+}
+
+TsdfVolume::Voxel* TsdfVolume::GetVoxels(int32_t blockIndex)
+{
+    return m_voxelChunks[blockIndex / blocksPerChunk].get() + (blockIndex % blocksPerChunk) * blockVoxelCount;
+}
+
+const TsdfVolume::Voxel* TsdfVolume::GetVoxels(int32_t blockIndex) const
+{
+    return m_voxelChunks[blockIndex / blocksPerChunk].get() + (blockIndex % blocksPerChunk) * blockVoxelCount;
+}
+
+int32_t TsdfVolume::TakeFreeBlock()
+{
+    if (!m_freeBlocks.empty())
+    {
+        int32_t blockIndex = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+        return blockIndex;
+    }
+
+    if (m_blocks.size() < m_settings.maxBlocks)
+    {
+        if (m_blocks.size() == m_voxelChunks.size() * blocksPerChunk)
+        {
+            m_voxelChunks.emplace_back(new Voxel[blocksPerChunk * blockVoxelCount]);
+        }
+        m_blocks.push_back(Block());
+        return static_cast<int32_t>(m_blocks.size() - 1);
+    }
+
+    // The pool is full: recycle the least recently observed of a few blocks, skipping the ones this frame
+    // already uses. Sampling a few candidates from a rotating cursor approximates LRU without keeping a list.
+    // Once a scan finds every block in use by this frame, the rest of the frame doesn't scan again.
+    if (m_exhaustedFrame == m_frame)
+    {
+        return -1;
+    }
+
+    int32_t oldest = -1;
+    size_t candidates = 0;
+    for (size_t scanned = 0; scanned < m_blocks.size() && candidates < evictionCandidates; scanned++)
+    {
+        size_t blockIndex = m_evictionCursor;
+        m_evictionCursor = (m_evictionCursor + 1) % m_blocks.size();
+
+        const Block& block = m_blocks[blockIndex];
+        if (block.lastObservedFrame == m_frame)
+        {
+            continue;
+        }
+        candidates++;
+        if (oldest < 0 || block.lastObservedFrame < m_blocks[oldest].lastObservedFrame)
+        {
+            oldest = static_cast<int32_t>(blockIndex);
+        }
+    }
+
+    if (oldest >= 0)
+    {
+        RemoveFromTable(PackKey(m_blocks[oldest].key));
+        m_blocks[oldest].inUse = false;
+        m_blocksInUse--;
+        m_blocksEvicted++;
+    }
+    else
+    {
+        m_exhaustedFrame = m_frame;
+    }
+    return oldest;
+}
+
+int32_t TsdfVolume::FindOrCreateBlock(const BlockKey& key)
+{
+    int32_t blockIndex = FindBlock(key);
+    if (blockIndex >= 0)
+    {
+        return blockIndex;
+    }
+
+    blockIndex = TakeFreeBlock();
+    if (blockIndex < 0)
+    {
+        m_blocksRejected++;
+        return -1;
+    }
+
+    Block& block = m_blocks[blockIndex];
+    block.key = key;
+    block.lastObservedFrame = 0;
+    block.inUse = true;
+    memset(GetVoxels(blockIndex), 0, blockVoxelCount * sizeof(Voxel));
+
+    InsertIntoTable(PackKey(key), blockIndex);
+    m_blocksInUse++;
+    return blockIndex;
+}
+
+void TsdfVolume::Integrate(
+    const RayTable& depthRays,
+    const uint16_t* depth,
+    size_t depthRowStride,
+    float depthScale,
+    const RigidTransform& cameraToVolume,
+    ThreadPool* threadPool)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_frame++;
+    m_frameBlocks.clear();
+
+    const uint32_t width = depthRays.GetWidth();
+    const uint32_t height = depthRays.GetHeight();
+    const float* r = cameraToVolume.rotation;
+    const float* t = cameraToVolume.translation;
+    const float* envelopeMin = m_settings.envelopeMin;
+    const float* envelopeMax = m_settings.envelopeMax;
+    const float truncation = m_settings.truncationDistance;
+    const float inverseBlockSize = 1.0f / m_blockSize;
+
+    // Blocks are needed wherever the truncation band around a measured surface passes. Sample the band along
+    // each ray at most half a block apart, so no block the band crosses is skipped.
+    const int bandSteps = static_cast<int>(std::ceil(truncation / (m_blockSize * 0.5f)));
+    const float bandSpacing = (bandSteps > 0) ? truncation / bandSteps : 0.0f;
+
+    uint64_t previousKey = emptyTableKey;
+    for (uint32_t v = 0; v < height; v += allocationPixelStride)
+    {
+        const uint16_t* depthRow = depth + v * depthRowStride;
+        const float* rayXRow = depthRays.GetRayX() + size_t(v) * width;
+        const float* rayYRow = depthRays.GetRayY() + size_t(v) * width;
+
+        for (uint32_t u = 0; u < width; u += allocationPixelStride)
+        {
+            if (depthRow[u] == 0)
+            {
+                continue;
+            }
+
+            const float surfaceZ = depthRow[u] * depthScale;
+            for (int step = -bandSteps; step <= bandSteps; step++)
+            {
+                const float z = surfaceZ + step * bandSpacing;
+                if (!(z > 0.0f))
+                {
+                    continue;
+                }
+
+                const float px = rayXRow[u] * z;
+                const float py = rayYRow[u] * z;
+                const float point[3] = {
+                    r[0] * px + r[1] * py + r[2] * z + t[0],
+                    r[3] * px + r[4] * py + r[5] * z + t[1],
+                    r[6] * px + r[7] * py + r[8] * z + t[2]
+                };
+                if (!(point[0] >= envelopeMin[0] && point[0] < envelopeMax[0] &&
+                      point[1] >= envelopeMin[1] && point[1] < envelopeMax[1] &&
+                      point[2] >= envelopeMin[2] && point[2] < envelopeMax[2]))
+                {
+                    continue;
+                }
+
+                const BlockKey key = {
+                    static_cast<int32_t>(std::floor(point[0] * inverseBlockSize)),
+                    static_cast<int32_t>(std::floor(point[1] * inverseBlockSize)),
+                    static_cast<int32_t>(std::floor(point[2] * inverseBlockSize))
+                };
+
+                // Neighboring samples mostly fall into the block just seen.
+                const uint64_t packedKey = PackKey(key);
+                if (packedKey == previousKey)
+                {
+                    continue;
+                }
+                previousKey = packedKey;
+
+                int32_t blockIndex = FindOrCreateBlock(key);
+                if (blockIndex >= 0 && m_blocks[blockIndex].lastObservedFrame != m_frame)
+                {
+                    m_blocks[blockIndex].lastObservedFrame = m_frame;
+                    m_frameBlocks.push_back(blockIndex);
+                }
+            }
+        }
+    }
+
+    // Each block's voxels only depend on the frame, so blocks are fused independently.
+    const PinholeIntrinsics& intrinsics = depthRays.GetIntrinsics();
+    const RigidTransform volumeToCamera = InvertRigidTransform(cameraToVolume);
+    const uint32_t blockCount = static_cast<uint32_t>(m_frameBlocks.size());
+    const uint32_t taskCount = (blockCount + blocksPerTask - 1) / blocksPerTask;
+    auto integrateBlocks = [&](uint32_t task)
+    {
+        const uint32_t end = (std::min)((task + 1) * blocksPerTask, blockCount);
+        for (uint32_t i = task * blocksPerTask; i < end; i++)
+        {
+            IntegrateBlock(m_frameBlocks[i], intrinsics, depth, depthRowStride, depthScale, volumeToCamera);
+        }
+    };
+
+    if (threadPool != nullptr)
+    {
+        threadPool->ParallelFor(taskCount, integrateBlocks);
+    }
+    else
+    {
+        for (uint32_t task = 0; task < taskCount; task++)
+        {
+            integrateBlocks(task);
+        }
+    }
+}
+
+void TsdfVolume::IntegrateBlock(
+    int32_t blockIndex,
+    const PinholeIntrinsics& intrinsics,
+    const uint16_t* depth,
+    size_t depthRowStride,
+    float depthScale,
+    const RigidTransform& volumeToCamera)
+{
+    const BlockKey& key = m_blocks[blockIndex].key;
+    Voxel* voxels = GetVoxels(blockIndex);
+
+    const float voxelSize = m_settings.voxelSize;
+    const float truncation = m_settings.truncationDistance;
+    const float inverseTruncation = 1.0f / truncation;
+    const float maxWeight = m_settings.maxWeight;
+    const float width = static_cast<float>(intrinsics.imageWidth);
+    const float height = static_cast<float>(intrinsics.imageHeight);
+    const float* r = volumeToCamera.rotation;
+    const float* t = volumeToCamera.translation;
+
+    // Center of the block's first voxel in camera space, and the camera space step along each volume axis.
+    const float first[3] = {
+        (key.x * blockEdge + 0.5f) * voxelSize,
+        (key.y * blockEdge + 0.5f) * voxelSize,
+        (key.z * blockEdge + 0.5f) * voxelSize
+    };
+    float origin[3];
+    float axisStep[3][3];
+    for (int i = 0; i < 3; i++)
+    {
+        origin[i] = r[i * 3] * first[0] + r[i * 3 + 1] * first[1] + r[i * 3 + 2] * first[2] + t[i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            axisStep[axis][i] = r[i * 3 + axis] * voxelSize;
+        }
+    }
+
+    for (int z = 0; z < blockEdge; z++)
+    {
+        for (int y = 0; y < blockEdge; y++)
+        {
+            Voxel* row = voxels + (z * blockEdge + y) * blockEdge;
+            for (int x = 0; x < blockEdge; x++)
+            {
+                const float cameraX = origin[0] + x * axisStep[0][0] + y * axisStep[1][0] + z * axisStep[2][0];
+                const float cameraY = origin[1] + x * axisStep[0][1] + y * axisStep[1][1] + z * axisStep[2][1];
+                const float cameraZ = origin[2] + x * axisStep[0][2] + y * axisStep[1][2] + z * axisStep[2][2];
+                if (!(cameraZ > 0.0f))
+                {
+                    continue;
+                }
+
+                float pixelX, pixelY;
+                ProjectToPixel(intrinsics, cameraX / cameraZ, cameraY / cameraZ, pixelX, pixelY);
+                const float u = std::floor(pixelX + 0.5f);
+                const float v = std::floor(pixelY + 0.5f);
+                if (!(u >= 0.0f && v >= 0.0f && u < width && v < height))
+                {
+                    continue;
+                }
+
+                const uint16_t raw = depth[static_cast<size_t>(v) * depthRowStride + static_cast<size_t>(u)];
+                if (raw == 0)
+                {
+                    continue;
+                }
+
+                // Positive in front of the measured surface, negative behind it. Voxels far behind are
+                // hidden by the surface and keep what earlier frames saw.
+                const float distance = raw * depthScale - cameraZ;
+                if (distance < -truncation)
+                {
+                    continue;
+                }
+
+                Voxel& voxel = row[x];
+                const float sample = (std::min)(distance * inverseTruncation, 1.0f);
+                const float weight = voxel.weight;
+                const float fused = (voxel.distance * (1.0f / distanceScale) * weight + sample) / (weight + 1.0f);
+                voxel.distance = static_cast<int16_t>(std::floor(fused * distanceScale + 0.5f));
+                voxel.weight = static_cast<uint16_t>((std::min)(weight + 1.0f, maxWeight));
+            }
+        }
+    }
+}
+
+void TsdfVolume::ExtractHeightMap(VolumeHeightMap& heightMap, ThreadPool* threadPool) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const float voxelSize = m_settings.voxelSize;
+    const float* envelopeMin = m_settings.envelopeMin;
+    const float* envelopeMax = m_settings.envelopeMax;
+
+    heightMap.cellSize = voxelSize;
+    heightMap.originX = envelopeMin[0];
+    heightMap.originY = envelopeMin[1];
+    heightMap.width = static_cast<uint32_t>(std::ceil((envelopeMax[0] - envelopeMin[0]) / voxelSize));
+    heightMap.height = static_cast<uint32_t>(std::ceil((envelopeMax[1] - envelopeMin[1]) / voxelSize));
+    heightMap.heights.assign(size_t(heightMap.width) * heightMap.height, std::numeric_limits<float>::quiet_NaN());
+
+    // Voxel layers of the envelope, from the top down.
+    const int32_t topLayer = static_cast<int32_t>(std::ceil(envelopeMax[2] / voxelSize)) - 1;
+    const int32_t bottomLayer = static_cast<int32_t>(std::floor(envelopeMin[2] / voxelSize));
+
+    auto extractRow = [&](uint32_t row)
+    {
+        const int32_t voxelY = static_cast<int32_t>(std::floor(heightMap.originY / voxelSize + row + 0.5f));
+        float* heights = heightMap.heights.data() + size_t(row) * heightMap.width;
+
+        for (uint32_t column = 0; column < heightMap.width; column++)
+        {
+            const int32_t voxelX = static_cast<int32_t>(std::floor(heightMap.originX / voxelSize + column + 0.5f));
+            const BlockKey columnKey = { FloorDivide(voxelX, blockEdge), FloorDivide(voxelY, blockEdge), 0 };
+            const int localIndex = (voxelY - columnKey.y * blockEdge) * blockEdge + (voxelX - columnKey.x * blockEdge);
+
+            // March down until a voxel in front of the surface is followed by one behind it. Unknown space
+            // breaks the pair, so a surface is only reported where both sides were observed.
+            bool havePrevious = false;
+            float previousDistance = 0.0f;
+            int32_t layer = topLayer;
+            while (layer >= bottomLayer)
+            {
+                const BlockKey key = { columnKey.x, columnKey.y, FloorDivide(layer, blockEdge) };
+                const int32_t blockIndex = FindBlock(key);
+                const int32_t blockBottom = key.z * blockEdge;
+                if (blockIndex < 0)
+                {
+                    havePrevious = false;
+                    layer = blockBottom - 1;
+                    continue;
+                }
+
+                const Voxel* voxels = GetVoxels(blockIndex);
+                for (; layer >= blockBottom && layer >= bottomLayer; layer--)
+                {
+                    const Voxel& voxel = voxels[(layer - blockBottom) * blockEdge * blockEdge + localIndex];
+                    if (voxel.weight == 0)
+                    {
+                        havePrevious = false;
+                        continue;
+                    }
+
+                    const float distance = voxel.distance * (1.0f / distanceScale);
+                    if (havePrevious && previousDistance > 0.0f && distance <= 0.0f)
+                    {
+                        // The zero crossing between the two voxel centers, by linear interpolation.
+                        const float previousCenter = (layer + 1.5f) * voxelSize;
+                        heights[column] = previousCenter - voxelSize * previousDistance / (previousDistance - distance);
+                        layer = bottomLayer - 1;
+                        break;
+                    }
+                    havePrevious = true;
+                    previousDistance = distance;
+                }
+            }
+        }
+    };
+
+    if (threadPool != nullptr)
+    {
+        threadPool->ParallelFor(heightMap.height, extractRow);
+    }
+    else
+    {
+        for (uint32_t row = 0; row < heightMap.height; row++)
+        {
+            extractRow(row);
+        }
+    }
+}
+
+TsdfVolumeStatistics TsdfVolume::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    TsdfVolumeStatistics statistics;
+    statistics.framesIntegrated = m_frame;
+    statistics.blocksInUse = m_blocksInUse;
+    statistics.blocksAllocated = m_blocks.size();
+    statistics.bytesAllocated = m_voxelChunks.size() * blocksPerChunk * blockVoxelCount * sizeof(Voxel);
+    statistics.blocksLastFrame = m_frameBlocks.size();
+    statistics.blocksEvicted = m_blocksEvicted;
+    statistics.blocksRejected = m_blocksRejected;
+    return statistics;
+}
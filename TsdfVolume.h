@@ -0,0 +1,186 @@
+#pragma once
+
+#include "DepthRegistration.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace SDKTemplate
+{
+    // Where and how finely a TsdfVolume models the print volume. Volume space is in meters with +z up,
+    // away from the build plate, so a height map is a z per (x, y) cell.
+    struct TsdfVolumeSettings
+    {
+        // Corners of the print envelope. Depth outside of it is ignored. The envelope reaches a little below
+        // the build plate, since a surface is only found where there are voxels on both sides of it.
+        float envelopeMin[3] = { -0.15f, -0.15f, -0.01f };
+        float envelopeMax[3] = { 0.15f, 0.15f, 0.2f };
+
+        // Edge length of a voxel, and how far in front of and behind the measured surface a frame updates voxels.
+        float voxelSize = 0.002f;
+        float truncationDistance = 0.008f;
+
+        // Cap on a voxel's weight. Older observations then count as much as this many new ones,
+        // so the model keeps following the part as it grows.
+        uint16_t maxWeight = 64;
+
+        // Voxel blocks the volume may hold at once. Their memory is only allocated as blocks are first needed.
+        size_t maxBlocks = 16384;
+    };
+
+    // A height per cell of a regular grid over the print envelope, in volume space.
+    // Cell (i, j) covers x in [originX + i * cellSize, originX + (i + 1) * cellSize), and likewise for y.
+    // Cells where no surface was found hold NaN.
+    struct VolumeHeightMap
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        float cellSize = 0.0f;
+        float originX = 0.0f;
+        float originY = 0.0f;
+        std::vector<float> heights;
+    };
+
+    // Counters of a TsdfVolume.
+    struct TsdfVolumeStatistics
+    {
+        uint64_t framesIntegrated = 0;
+        size_t blocksInUse = 0;
+        size_t blocksAllocated = 0; // Blocks whose memory exists, in use or free. Never more than maxBlocks.
+        size_t bytesAllocated = 0;
+        size_t blocksLastFrame = 0; // Blocks the most recent frame updated.
+        uint64_t blocksEvicted = 0; // Blocks recycled for newly observed space once the volume was full.
+        uint64_t blocksRejected = 0; // Requests for a new block turned down because the current frame used every block.
+    };
+
+    // Truncated signed distance volume that depth frames are fused into incrementally, so the noise of
+    // single frames averages out into a stable model of the part.
+    // Space is split into blocks of 8x8x8 voxels, and only blocks near an observed surface exist. They are
+    // found through a hash table on their coordinates, and live in a pool capped at maxBlocks: once it is
+    // full, the block observed least recently is recycled, so memory stays bounded however long a print runs.
+    // Fusion runs across blocks on a ThreadPool. Only standard C++ is used, so the volume can be exercised
+    // off-device with synthetic depth.
+    class TsdfVolume
+    {
+    public:
+        explicit TsdfVolume(const TsdfVolumeSettings& settings);
+
+        TsdfVolume(const TsdfVolume&) = delete;
+        TsdfVolume& operator=(const TsdfVolume&) = delete;
+
+        const TsdfVolumeSettings& GetSettings() const { return m_settings; }
+
+        /// <summary>
+        /// Forgets everything fused so far. Block memory is kept for reuse.
+        /// </summary>
+        void Reset();
+
+        /// <summary>
+        /// Fuses a raw 16 bit depth frame with the rays' size. depth has depthRowStride samples per row, a raw
+        /// value of 0 is invalid and depthScale converts the rest to meters. cameraToVolume maps depth camera
+        /// space to volume space. threadPool may be nullptr to fuse on the calling thread only.
+        /// </summary>
+        void Integrate(
+            const RayTable& depthRays,
+            const uint16_t* depth,
+            size_t depthRowStride,
+            float depthScale,
+            const RigidTransform& cameraToVolume,
+            ThreadPool* threadPool);
+
+        /// <summary>
+        /// Casts a ray straight down through every cell of a grid of voxelSize cells over the envelope, and
+        /// stores the height of the first surface it crosses. Safe to call from any thread.
+        /// </summary>
+        void ExtractHeightMap(VolumeHeightMap& heightMap, ThreadPool* threadPool) const;
+
+        TsdfVolumeStatistics GetStatistics() const;
+
+    private:
+        // Block coordinates are voxel coordinates divided by the block size.
+        struct BlockKey
+        {
+            int32_t x;
+            int32_t y;
+            int32_t z;
+        };
+
+        struct Voxel
+        {
+            int16_t distance; // Truncated signed distance, scaled so that 32767 is one truncation distance.
+            uint16_t weight; // 0 for a voxel no frame has updated.
+        };
+
+        struct Block
+        {
+            BlockKey key;
+            uint64_t lastObservedFrame;
+            bool inUse;
+        };
+
+        static uint64_t PackKey(const BlockKey& key);
+        static size_t HashKey(uint64_t packedKey);
+
+        /// <summary>
+        /// Returns the index of the block with the given key, or -1.
+        /// </summary>
+        int32_t FindBlock(const BlockKey& key) const;
+
+        /// <summary>
+        /// Returns the index of the block with the given key, creating it if needed. Returns -1 if the
+        /// pool is full and every block was observed by the current frame.
+        /// </summary>
+        int32_t FindOrCreateBlock(const BlockKey& key);
+
+        int32_t TakeFreeBlock();
+        void InsertIntoTable(uint64_t packedKey, int32_t blockIndex);
+        void RemoveFromTable(uint64_t packedKey);
+
+        Voxel* GetVoxels(int32_t blockIndex);
+        const Voxel* GetVoxels(int32_t blockIndex) const;
+
+        /// <summary>
+        /// Fuses the frame into the voxels of one block.
+        /// </summary>
+        void IntegrateBlock(
+            int32_t blockIndex,
+            const PinholeIntrinsics& intrinsics,
+            const uint16_t* depth,
+            size_t depthRowStride,
+            float depthScale,
+            const RigidTransform& volumeToCamera);
+
+        const TsdfVolumeSettings m_settings;
+        const float m_blockSize;
+
+        // Guards everything below, so fusion and height map extraction don't overlap.
+        mutable std::mutex m_mutex;
+
+        // Block memory grows in chunks up to maxBlocks, so a small print never pays for the whole pool.
+        std::vector<std::unique_ptr<Voxel[]>> m_voxelChunks;
+        std::vector<Block> m_blocks;
+        std::vector<int32_t> m_freeBlocks;
+
+        // Open addressing hash table from packed block keys to block indices, at most half full.
+        std::vector<uint64_t> m_tableKeys;
+        std::vector<int32_t> m_tableBlocks;
+        size_t m_tableMask = 0;
+
+        // Blocks touched by the frame being integrated.
+        std::vector<int32_t> m_frameBlocks;
+
+        // Where the search for a block to evict resumes.
+        size_t m_evictionCursor = 0;
+
+        // Frames are numbered from 1, so no frame matches a block that was never observed.
+        uint64_t m_frame = 0;
+        uint64_t m_exhaustedFrame = 0;
+        size_t m_blocksInUse = 0;
+        uint64_t m_blocksEvicted = 0;
+        uint64_t m_blocksRejected = 0;
+    };
+} // SDKTemplate